@@ -0,0 +1,189 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef _WIN32
+    #include <arpa/inet.h>
+#else
+    #include <ws2tcpip.h>
+#endif
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cstdlib>
+#include <tins/tins.h>
+
+using std::cout;
+using std::endl;
+using std::string;
+using std::vector;
+using std::ostringstream;
+using std::mt19937;
+using std::uniform_int_distribution;
+using std::chrono::steady_clock;
+using std::chrono::duration_cast;
+using std::chrono::nanoseconds;
+
+using namespace Tins;
+
+// Measures the average time it takes to format and parse addresses using 
+// to_chars/from_chars against the stream and inet_pton/inet_ntop based 
+// conversions libtins used before.
+
+template <typename Function>
+double nanoseconds_per_call(size_t iterations, Function function) {
+    const steady_clock::time_point start = steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+        function(i);
+    }
+    const steady_clock::time_point end = steady_clock::now();
+    return static_cast<double>(duration_cast<nanoseconds>(end - start).count()) / iterations;
+}
+
+string stream_ipv4_to_string(const IPv4Address& address) {
+    ostringstream output;
+    const uint32_t value = Endian::be_to_host<uint32_t>(address);
+    output << (value >> 24) << '.' << ((value >> 16) & 0xff) << '.' 
+           << ((value >> 8) & 0xff) << '.' << (value & 0xff);
+    return output.str();
+}
+
+string stream_hw_address_to_string(const HWAddress<6>& address) {
+    ostringstream output;
+    for (size_t i = 0; i < address.size(); ++i) {
+        if (i != 0) {
+            output << ':';
+        }
+        output << std::hex;
+        if (address[i] < 0x10) {
+            output << '0';
+        }
+        output << static_cast<unsigned>(address[i]);
+    }
+    return output.str();
+}
+
+int main(int argc, char* argv[]) {
+    const size_t iterations = argc > 1 ? std::atoi(argv[1]) : 2000000;
+    mt19937 generator(1234);
+    uniform_int_distribution<uint32_t> distribution;
+
+    vector<IPv4Address> ipv4_addresses;
+    vector<IPv6Address> ipv6_addresses;
+    vector<HWAddress<6> > hw_addresses;
+    for (size_t i = 0; i < 4096; ++i) {
+        ipv4_addresses.push_back(IPv4Address(distribution(generator)));
+        IPv6Address ipv6;
+        for (IPv6Address::iterator it = ipv6.begin(); it != ipv6.end(); ++it) {
+            // Leave some zero groups around so "::" compression kicks in
+            const uint32_t value = distribution(generator);
+            *it = (value & 0x300) ? static_cast<uint8_t>(value) : 0;
+        }
+        ipv6_addresses.push_back(ipv6);
+        HWAddress<6> hw_address;
+        for (size_t j = 0; j < hw_address.size(); ++j) {
+            hw_address[j] = static_cast<uint8_t>(distribution(generator));
+        }
+        hw_addresses.push_back(hw_address);
+    }
+    vector<string> ipv4_strings, ipv6_strings;
+    for (size_t i = 0; i < ipv4_addresses.size(); ++i) {
+        ipv4_strings.push_back(ipv4_addresses[i].to_string());
+        ipv6_strings.push_back(ipv6_addresses[i].to_string());
+    }
+    const size_t mask = ipv4_addresses.size() - 1;
+    // Accumulate something out of every result so nothing gets optimized away
+    size_t checksum = 0;
+    char buffer[IPv6Address::max_string_length];
+
+    cout << "IPv4Address formatting" << endl;
+    cout << "  ostringstream: " << nanoseconds_per_call(iterations, [&](size_t i) {
+        checksum += stream_ipv4_to_string(ipv4_addresses[i & mask]).size();
+    }) << "ns" << endl;
+    cout << "  to_string:     " << nanoseconds_per_call(iterations, [&](size_t i) {
+        checksum += ipv4_addresses[i & mask].to_string().size();
+    }) << "ns" << endl;
+    cout << "  to_chars:      " << nanoseconds_per_call(iterations, [&](size_t i) {
+        checksum += ipv4_addresses[i & mask].to_chars(buffer, sizeof(buffer));
+    }) << "ns" << endl;
+
+    cout << "IPv4Address parsing" << endl;
+    cout << "  inet_pton:     " << nanoseconds_per_call(iterations, [&](size_t i) {
+        in_addr address;
+        checksum += inet_pton(AF_INET, ipv4_strings[i & mask].c_str(), &address);
+        checksum += address.s_addr;
+    }) << "ns" << endl;
+    cout << "  from_chars:    " << nanoseconds_per_call(iterations, [&](size_t i) {
+        const string& input = ipv4_strings[i & mask];
+        IPv4Address address;
+        checksum += IPv4Address::from_chars(input.data(), input.data() + input.size(), address);
+        checksum += static_cast<uint32_t>(address);
+    }) << "ns" << endl;
+
+    cout << "IPv6Address formatting" << endl;
+    cout << "  inet_ntop:     " << nanoseconds_per_call(iterations, [&](size_t i) {
+        char output[INET6_ADDRSTRLEN];
+        inet_ntop(AF_INET6, ipv6_addresses[i & mask].begin(), output, sizeof(output));
+        checksum += string(output).size();
+    }) << "ns" << endl;
+    cout << "  to_string:     " << nanoseconds_per_call(iterations, [&](size_t i) {
+        checksum += ipv6_addresses[i & mask].to_string().size();
+    }) << "ns" << endl;
+    cout << "  to_chars:      " << nanoseconds_per_call(iterations, [&](size_t i) {
+        checksum += ipv6_addresses[i & mask].to_chars(buffer, sizeof(buffer));
+    }) << "ns" << endl;
+
+    cout << "IPv6Address parsing" << endl;
+    cout << "  inet_pton:     " << nanoseconds_per_call(iterations, [&](size_t i) {
+        uint8_t address[IPv6Address::address_size];
+        checksum += inet_pton(AF_INET6, ipv6_strings[i & mask].c_str(), address);
+        checksum += address[15];
+    }) << "ns" << endl;
+    cout << "  from_chars:    " << nanoseconds_per_call(iterations, [&](size_t i) {
+        const string& input = ipv6_strings[i & mask];
+        IPv6Address address;
+        checksum += IPv6Address::from_chars(input.data(), input.data() + input.size(), address);
+        checksum += *(address.begin() + 15);
+    }) << "ns" << endl;
+
+    cout << "HWAddress<6> formatting" << endl;
+    cout << "  ostringstream: " << nanoseconds_per_call(iterations, [&](size_t i) {
+        checksum += stream_hw_address_to_string(hw_addresses[i & mask]).size();
+    }) << "ns" << endl;
+    cout << "  to_string:     " << nanoseconds_per_call(iterations, [&](size_t i) {
+        checksum += hw_addresses[i & mask].to_string().size();
+    }) << "ns" << endl;
+    cout << "  to_chars:      " << nanoseconds_per_call(iterations, [&](size_t i) {
+        checksum += hw_addresses[i & mask].to_chars(buffer, sizeof(buffer));
+    }) << "ns" << endl;
+
+    cout << "(checksum " << checksum << ")" << endl;
+}
@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <iostream>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cstdlib>
+#include <tins/tins.h>
+
+using std::cout;
+using std::endl;
+using std::vector;
+using std::mt19937;
+using std::uniform_int_distribution;
+using std::chrono::steady_clock;
+using std::chrono::duration_cast;
+using std::chrono::nanoseconds;
+
+using namespace Tins;
+
+// Measures the average time it takes to look up an address using an 
+// AddressSet against the time it takes to test the same addresses against
+// every range, one at a time.
+
+template <typename Function>
+double nanoseconds_per_call(size_t iterations, Function function) {
+    const steady_clock::time_point start = steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+        function(i);
+    }
+    const steady_clock::time_point end = steady_clock::now();
+    return static_cast<double>(duration_cast<nanoseconds>(end - start).count()) / iterations;
+}
+
+int main(int argc, char* argv[]) {
+    const size_t prefix_count = argc > 1 ? std::atoi(argv[1]) : 50000;
+    const size_t lookup_count = argc > 2 ? std::atoi(argv[2]) : 10000000;
+    mt19937 generator(1234);
+    uniform_int_distribution<uint32_t> address_distribution;
+    uniform_int_distribution<int> length_distribution(16, 32);
+
+    vector<IPv4Range> ranges;
+    for (size_t i = 0; i < prefix_count; ++i) {
+        IPv4Address address(address_distribution(generator));
+        ranges.push_back(address / length_distribution(generator));
+    }
+    vector<IPv4Address> addresses;
+    for (size_t i = 0; i < 1024 * 1024; ++i) {
+        addresses.push_back(IPv4Address(address_distribution(generator)));
+    }
+    const size_t address_mask = addresses.size() - 1;
+
+    IPv4AddressSet set;
+    const steady_clock::time_point start = steady_clock::now();
+    for (size_t i = 0; i < ranges.size(); ++i) {
+        set.insert(ranges[i]);
+    }
+    const steady_clock::time_point end = steady_clock::now();
+    cout << "Inserted " << set.size() << " prefixes in " 
+         << duration_cast<nanoseconds>(end - start).count() / 1000000.0 << "ms" << endl;
+
+    size_t matches = 0;
+    double elapsed = nanoseconds_per_call(lookup_count, [&](size_t i) {
+        matches += set.contains(addresses[i & address_mask]);
+    });
+    cout << "IPv4AddressSet: " << elapsed << "ns per lookup (" 
+         << matches << " matches)" << endl;
+
+    // Testing every range is much slower, so use fewer lookups
+    matches = 0;
+    elapsed = nanoseconds_per_call(lookup_count / 1000 + 1, [&](size_t i) {
+        const IPv4Address& address = addresses[i & address_mask];
+        for (size_t j = 0; j < ranges.size(); ++j) {
+            if (ranges[j].contains(address)) {
+                ++matches;
+                break;
+            }
+        }
+    });
+    cout << "Linear scan:    " << elapsed << "ns per lookup (" 
+         << matches << " matches)" << endl;
+}
@@ -51,11 +51,19 @@ bool callback(const PDU& pdu) {
 
     // Is it a DNS query?
     if (dns.type() == DNS::QUERY) {
+        // The response is built using name compression, so the answers
+        // just point to the names in the queries
+        DNS::message_builder builder;
+        const DNS::queries_type queries = dns.queries();
+        for (const auto& query : queries) {
+            builder.add_query(query);
+        }
         // Let's see if there's any query for an "A" record.
-        for (const auto& query : dns.queries()) {
+        bool answered = false;
+        for (const auto& query : queries) {
             if (query.query_type() == DNS::A) {
                 // Here's one! Let's add an answer.
-                dns.add_answer(
+                builder.add_answer(
                     DNS::resource(
                         query.dname(), 
                         "127.0.0.1",
@@ -65,19 +73,24 @@ bool callback(const PDU& pdu) {
                         777
                     )
                 );
+                answered = true;
             }
         }
         // Have we added some answers?
-        if (dns.answers_count() > 0) {
+        if (answered) {
+            DNS response = builder.build();
+            response.id(dns.id());
+            response.opcode(dns.opcode());
+            response.recursion_desired(dns.recursion_desired());
             // It's a response now
-            dns.type(DNS::RESPONSE);
+            response.type(DNS::RESPONSE);
             // Recursion is available(just in case)
-            dns.recursion_available(1);
+            response.recursion_available(1);
             // Build our packet
             auto pkt = EthernetII(eth.src_addr(), eth.dst_addr()) /
                        IP(ip.src_addr(), ip.dst_addr()) /
                        UDP(udp.sport(), udp.dport()) /
-                       dns;
+                       response;
             // Send it!
             sender.send(pkt);
         }
@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <tins/tins.h>
+
+using std::cout;
+using std::cerr;
+using std::endl;
+using std::string;
+using std::vector;
+using std::chrono::steady_clock;
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+using std::chrono::seconds;
+
+using namespace Tins;
+
+// Builds the sidecar index for a pcap file and reads the packets in a time
+// window or belonging to a flow using it.
+
+void usage(const char* name) {
+    cerr << "Usage: " << name << " <file>" << endl;
+    cerr << "       " << name << " <file> window <start> <end>" << endl;
+    cerr << "       " << name << " <file> flow <address> <port> <address> <port> <tcp|udp>" << endl;
+    cerr << endl;
+    cerr << "The first form builds and stores the index. Times are UNIX timestamps." << endl;
+}
+
+double elapsed_ms(const steady_clock::time_point& start) {
+    return duration_cast<microseconds>(steady_clock::now() - start).count() / 1000.0;
+}
+
+void print_records(const vector<IndexedPcapReader::record>& records) {
+    for (size_t i = 0; i < records.size(); ++i) {
+        cout << records[i].timestamp.seconds() << "." << std::setfill('0') << std::setw(6) 
+             << records[i].timestamp.microseconds()
+             << " offset " << records[i].offset << ", " << records[i].data.size() 
+             << " bytes" << endl;
+    }
+}
+
+uint64_t parse_flow(char* argv[]) {
+    const uint16_t port1 = static_cast<uint16_t>(std::atoi(argv[1]));
+    const uint16_t port2 = static_cast<uint16_t>(std::atoi(argv[3]));
+    const uint8_t protocol = string(argv[4]) == "udp" ? 17 : 6;
+    if (string(argv[0]).find(':') != string::npos) {
+        return PcapIndex::flow_hash(IPv6Address(argv[0]), port1, IPv6Address(argv[2]), 
+                                    port2, protocol);
+    }
+    return PcapIndex::flow_hash(IPv4Address(argv[0]), port1, IPv4Address(argv[2]), 
+                                port2, protocol);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        usage(*argv);
+        return 1;
+    }
+    const string file_name = argv[1];
+    try {
+        if (argc == 2) {
+            steady_clock::time_point start = steady_clock::now();
+            const PcapIndex index = PcapIndex::build(file_name);
+            index.save(PcapIndex::index_file_name(file_name));
+            cout << "Indexed " << index.record_count() << " records in " 
+                 << index.blocks().size() << " blocks in " << elapsed_ms(start) << "ms" << endl;
+            return 0;
+        }
+        steady_clock::time_point start = steady_clock::now();
+        IndexedPcapReader reader(file_name);
+        cout << (reader.index_loaded() ? "Loaded" : "Built") << " index in " 
+             << elapsed_ms(start) << "ms" << endl;
+        vector<IndexedPcapReader::record> records;
+        start = steady_clock::now();
+        if (argc == 5 && string(argv[2]) == "window") {
+            records = reader.read_window(seconds(std::atoll(argv[3])), 
+                                         seconds(std::atoll(argv[4])));
+        }
+        else if (argc == 8 && string(argv[2]) == "flow") {
+            records = reader.read_flow(parse_flow(argv + 3));
+        }
+        else {
+            usage(*argv);
+            return 1;
+        }
+        const double lookup_time = elapsed_ms(start);
+        print_records(records);
+        cout << "Read " << records.size() << " records in " << lookup_time << "ms" << endl;
+    }
+    catch (std::exception& ex) {
+        cerr << "Error: " << ex.what() << endl;
+        return 1;
+    }
+}
@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <tins/tins.h>
+
+using std::cout;
+using std::endl;
+using std::vector;
+using std::chrono::steady_clock;
+using std::chrono::duration_cast;
+using std::chrono::nanoseconds;
+
+using namespace Tins;
+
+// Measures the average time it takes to find a layer using PDU::find_pdu,
+// which uses the index kept by the outermost PDU of the chain, against the
+// time it takes to walk the chain looking for it.
+
+template <typename Function>
+double nanoseconds_per_call(size_t iterations, Function function) {
+    const steady_clock::time_point start = steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+        function(i);
+    }
+    const steady_clock::time_point end = steady_clock::now();
+    return static_cast<double>(duration_cast<nanoseconds>(end - start).count()) / iterations;
+}
+
+// What find_pdu does without an index
+const PDU* walk_chain(const PDU& pdu, PDU::PDUType type) {
+    const PDU* current = &pdu;
+    while (current) {
+        if (current->matches_flag(type)) {
+            return current;
+        }
+        current = current->inner_pdu();
+    }
+    return 0;
+}
+
+void report(const char* name, double indexed, double walked) {
+    cout << name << ": find_pdu " << indexed << "ns, walk " << walked
+         << "ns per lookup" << endl;
+}
+
+int main(int argc, char* argv[]) {
+    const size_t packet_count = argc > 1 ? std::atoi(argv[1]) : 1000;
+    const size_t lookup_count = argc > 2 ? std::atoi(argv[2]) : 10000000;
+
+    // A VLAN tagged TCP segment carried over an IPv4 in IPv4 tunnel
+    EthernetII packet = EthernetII() / Dot1Q(10) / IP("10.0.0.1", "10.0.0.2") / 
+                        IP("192.168.0.1", "192.168.0.2") / 
+                        TCP(80, 52000) / RawPDU("GET / HTTP/1.1\r\n\r\n");
+    const PDU::serialization_type buffer = packet.serialize();
+    vector<EthernetII> packets;
+    for (size_t i = 0; i < packet_count; ++i) {
+        packets.push_back(EthernetII(&buffer[0], buffer.size()));
+    }
+    size_t found = 0;
+
+    // The first lookup on each packet builds its index
+    double indexed = nanoseconds_per_call(lookup_count / 100 + 1, [&](size_t) {
+        EthernetII parsed(&buffer[0], buffer.size());
+        found += parsed.find_pdu<TCP>() != 0;
+    });
+    double walked = nanoseconds_per_call(lookup_count / 100 + 1, [&](size_t) {
+        EthernetII parsed(&buffer[0], buffer.size());
+        found += walk_chain(parsed, PDU::TCP) != 0;
+    });
+    report("Parse and find TCP", indexed, walked);
+
+    // Looking up several layers in the same packet, like most applications do
+    indexed = nanoseconds_per_call(lookup_count, [&](size_t i) {
+        const EthernetII& pdu = packets[i % packets.size()];
+        found += pdu.find_pdu<RawPDU>() != 0;
+    });
+    walked = nanoseconds_per_call(lookup_count, [&](size_t i) {
+        const EthernetII& pdu = packets[i % packets.size()];
+        found += walk_chain(pdu, PDU::RAW) != 0;
+    });
+    report("Find RawPDU       ", indexed, walked);
+
+    indexed = nanoseconds_per_call(lookup_count, [&](size_t i) {
+        const EthernetII& pdu = packets[i % packets.size()];
+        found += pdu.find_pdu<UDP>() != 0;
+    });
+    walked = nanoseconds_per_call(lookup_count, [&](size_t i) {
+        const EthernetII& pdu = packets[i % packets.size()];
+        found += walk_chain(pdu, PDU::UDP) != 0;
+    });
+    report("Find missing UDP  ", indexed, walked);
+
+    // Inner PDUs use the index of the outermost one
+    indexed = nanoseconds_per_call(lookup_count, [&](size_t i) {
+        const TCP& tcp = *packets[i % packets.size()].find_pdu<TCP>();
+        found += tcp.find_pdu<RawPDU>() != 0;
+    });
+    walked = nanoseconds_per_call(lookup_count, [&](size_t i) {
+        const TCP& tcp = *packets[i % packets.size()].find_pdu<TCP>();
+        found += walk_chain(tcp, PDU::RAW) != 0;
+    });
+    report("Find RawPDU in TCP", indexed, walked);
+    cout << found << " layers found" << endl;
+}
@@ -217,6 +217,26 @@ public:
         );
     }
 
+    /**
+     * \brief Returns the first address in this range.
+     *
+     * Note that, unlike AddressRange::begin, this includes the network
+     * address for ranges which only contain hosts.
+     */
+    const address_type& first() const {
+        return first_;
+    }
+
+    /**
+     * \brief Returns the last address in this range.
+     *
+     * Note that this includes the broadcast address for ranges which 
+     * only contain hosts.
+     */
+    const address_type& last() const {
+        return last_;
+    }
+
     /**
      * \brief Indicates whether an address is included in this range.
      * \param addr The address to test.
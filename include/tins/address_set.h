@@ -0,0 +1,409 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TINS_ADDRESS_SET_H
+#define TINS_ADDRESS_SET_H
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <stdint.h>
+#include <tins/endianness.h>
+#include <tins/ip_address.h>
+#include <tins/ipv6_address.h>
+#include <tins/address_range.h>
+#include <tins/detail/address_helpers.h>
+
+namespace Tins {
+
+/**
+ * \cond
+ */
+namespace Internals {
+
+template <typename Address>
+struct address_trie_traits;
+
+// IPv4 addresses are split into 4 chunks of 8 bits
+template <>
+struct address_trie_traits<IPv4Address> {
+    typedef uint32_t key_type;
+
+    static const int address_bits = 32;
+    static const int stride = 8;
+
+    static key_type make_key(IPv4Address addr) {
+        return Endian::be_to_host<uint32_t>(addr);
+    }
+
+    static unsigned chunk(key_type key, int depth) {
+        return (key >> (24 - depth * 8)) & 0xff;
+    }
+};
+
+// IPv6 addresses are split into 32 chunks of 4 bits. Using 8 bit chunks 
+// would make each node 16 times larger, which is too much for the mostly
+// sparse sets of IPv6 prefixes
+template <>
+struct address_trie_traits<IPv6Address> {
+    struct key_type {
+        uint8_t bytes[IPv6Address::address_size];
+    };
+
+    static const int address_bits = 128;
+    static const int stride = 4;
+
+    static key_type make_key(const IPv6Address& addr) {
+        key_type key;
+        std::copy(addr.begin(), addr.end(), key.bytes);
+        return key;
+    }
+
+    static unsigned chunk(const key_type& key, int depth) {
+        const uint8_t value = key.bytes[depth / 2];
+        return (depth % 2 == 0) ? (value >> 4) : (value & 0x0f);
+    }
+};
+
+} // Internals
+
+/**
+ * \endcond
+ */
+
+/**
+ * \brief Maps address prefixes to values, performing longest prefix match
+ * lookups.
+ *
+ * This is a multibit trie: each node covers a fixed amount of bits of the 
+ * address (8 bits for IPv4, 4 for IPv6) and prefixes which don't end on a
+ * node boundary are expanded into every slot they cover. A lookup therefore
+ * takes at most one memory access for each chunk of the address (4 for 
+ * IPv4), regardless of how many prefixes are stored. Nodes are stored
+ * contiguously in a single vector.
+ *
+ * Prefixes can't be removed, since this is meant to be built once and then
+ * queried for every packet. Use AddressMap::clear to start over.
+ *
+ * \code
+ * AddressMap<IPv4Address, std::string> networks;
+ * networks.insert(IPv4Address("10.0.0.0") / 8, "internal");
+ * networks.insert(IPv4Address("10.1.0.0") / 16, "customer");
+ * // Prints "customer"
+ * std::cout << *networks.find("10.1.2.3") << std::endl;
+ * \endcode
+ *
+ * \tparam Address The address type. Either IPv4Address or IPv6Address.
+ * \tparam T The type of the stored values.
+ */
+template <typename Address, typename T>
+class AddressMap {
+public:
+    /**
+     * The address type.
+     */
+    typedef Address address_type;
+
+    /**
+     * The type of the stored values.
+     */
+    typedef T value_type;
+
+    /**
+     * \brief Constructs an empty map.
+     */
+    AddressMap() {
+        clear();
+    }
+
+    /**
+     * \brief Maps a prefix to a value.
+     *
+     * If this exact prefix was already inserted, its value is replaced.
+     *
+     * \param prefix The prefix's address. Bits beyond the prefix length 
+     * are ignored.
+     * \param prefix_length The prefix length, in bits.
+     * \param value The value to be mapped to this prefix.
+     */
+    void insert(const address_type& prefix, uint32_t prefix_length, const value_type& value) {
+        if (prefix_length > static_cast<uint32_t>(traits_type::address_bits)) {
+            throw exception_base("Invalid prefix length");
+        }
+        const int length = static_cast<int>(prefix_length);
+        const key_type key = traits_type::make_key(
+            prefix & address_type::from_prefix_length(prefix_length)
+        );
+        const int last_depth = (length == 0) ? 0 : (length - 1) / stride;
+        size_t node = 0;
+        for (int depth = 0; depth < last_depth; ++depth) {
+            const size_t index = node * fanout + traits_type::chunk(key, depth);
+            if (slots_[index].child == 0) {
+                const uint32_t child = allocate_node();
+                slots_[index].child = child;
+            }
+            node = slots_[index].child;
+        }
+        // Expand the prefix into every slot it covers in this node
+        const unsigned first = traits_type::chunk(key, last_depth);
+        const unsigned count = 1U << (stride - (length - last_depth * stride));
+        slot_type* slots = &slots_[node * fanout + first];
+        // Prefixes of the same length that end in this node can't overlap, 
+        // so any of these slots pointing to one means it's this same prefix
+        for (unsigned i = 0; i < count; ++i) {
+            if (slots[i].value != 0 && entries_[slots[i].value - 1].second == length) {
+                entries_[slots[i].value - 1].first = value;
+                return;
+            }
+        }
+        entries_.push_back(std::make_pair(value, length));
+        const uint32_t entry_index = static_cast<uint32_t>(entries_.size());
+        for (unsigned i = 0; i < count; ++i) {
+            // Longer prefixes which were already expanded here take precedence
+            if (slots[i].value == 0 || entries_[slots[i].value - 1].second < length) {
+                slots[i].value = entry_index;
+            }
+        }
+    }
+
+    /**
+     * \brief Maps every address in a range to a value.
+     *
+     * The range is split into the smallest set of prefixes that covers it.
+     * Ranges created using a mask (e.g. <tt>IPv4Address("10.0.0.0") / 8</tt>)
+     * are always stored as a single prefix.
+     *
+     * \param range The range to be inserted.
+     * \param value The value to be mapped to the range's addresses.
+     */
+    void insert(const AddressRange<address_type>& range, const value_type& value) {
+        address_type first = range.first();
+        const address_type& last = range.last();
+        while (true) {
+            // Find the largest prefix starting at first which doesn't go past last
+            uint32_t length = 0;
+            address_type prefix_last;
+            while (true) {
+                const address_type mask = address_type::from_prefix_length(length);
+                prefix_last = Internals::last_address_from_mask(first, mask);
+                if ((first & mask) == first && !(last < prefix_last)) {
+                    break;
+                }
+                ++length;
+            }
+            insert(first, length, value);
+            if (prefix_last == last) {
+                break;
+            }
+            first = prefix_last;
+            Internals::increment(first);
+        }
+    }
+
+    /**
+     * \brief Finds the value mapped to the longest prefix matching an address.
+     *
+     * \param addr The address to be looked up.
+     * \return A pointer to the value, or a null pointer if no prefix matches
+     * this address.
+     */
+    const value_type* find(const address_type& addr) const {
+        const key_type key = traits_type::make_key(addr);
+        size_t node = 0;
+        uint32_t best = 0;
+        for (int depth = 0; depth < max_depth; ++depth) {
+            const slot_type& slot = slots_[node * fanout + traits_type::chunk(key, depth)];
+            if (slot.value != 0) {
+                best = slot.value;
+            }
+            if (slot.child == 0) {
+                break;
+            }
+            node = slot.child;
+        }
+        return best != 0 ? &entries_[best - 1].first : 0;
+    }
+
+    /**
+     * \brief Indicates whether any prefix matches an address.
+     *
+     * \param addr The address to be looked up.
+     */
+    bool contains(const address_type& addr) const {
+        return find(addr) != 0;
+    }
+
+    /**
+     * \brief Returns the number of distinct prefixes in this map.
+     */
+    size_t size() const {
+        return entries_.size();
+    }
+
+    /**
+     * \brief Indicates whether this map is empty.
+     */
+    bool empty() const {
+        return entries_.empty();
+    }
+
+    /**
+     * \brief Returns the number of trie nodes allocated by this map.
+     *
+     * Each node takes <tt>2^stride * 8</tt> bytes.
+     */
+    size_t node_count() const {
+        return slots_.size() / fanout;
+    }
+
+    /**
+     * \brief Removes every prefix in this map.
+     */
+    void clear() {
+        entries_.clear();
+        slots_.assign(fanout, slot_type());
+    }
+private:
+    typedef Internals::address_trie_traits<address_type> traits_type;
+    typedef typename traits_type::key_type key_type;
+
+    static const int stride = traits_type::stride;
+    static const unsigned fanout = 1U << traits_type::stride;
+    static const int max_depth = traits_type::address_bits / traits_type::stride;
+
+    struct slot_type {
+        slot_type() : child(0), value(0) { }
+
+        // The index of the child node, or 0 if there's none
+        uint32_t child;
+        // The index + 1 of the longest prefix covering this slot, or 0
+        uint32_t value;
+    };
+
+    uint32_t allocate_node() {
+        const size_t node = slots_.size() / fanout;
+        slots_.resize(slots_.size() + fanout);
+        return static_cast<uint32_t>(node);
+    }
+
+    std::vector<slot_type> slots_;
+    // Each value along with its prefix length
+    std::vector<std::pair<value_type, int> > entries_;
+};
+
+/**
+ * \brief A set of address prefixes supporting fast membership tests.
+ *
+ * This is an AddressMap which doesn't store any values.
+ *
+ * \code
+ * IPv4AddressSet blocklist;
+ * blocklist.insert(IPv4Address("192.0.2.0") / 24);
+ * blocklist.insert(IPv4Range(IPv4Address("198.51.100.10"), IPv4Address("198.51.100.20")));
+ * if (blocklist.contains(ip.src_addr())) {
+ *     // ...
+ * }
+ * \endcode
+ *
+ * \sa AddressMap
+ */
+template <typename Address>
+class AddressSet {
+public:
+    /**
+     * The address type.
+     */
+    typedef Address address_type;
+
+    /**
+     * \brief Adds a prefix to this set.
+     *
+     * \param prefix The prefix's address. Bits beyond the prefix length 
+     * are ignored.
+     * \param prefix_length The prefix length, in bits.
+     */
+    void insert(const address_type& prefix, uint32_t prefix_length) {
+        prefixes_.insert(prefix, prefix_length, true);
+    }
+
+    /**
+     * \brief Adds every address in a range to this set.
+     *
+     * \param range The range to be inserted.
+     */
+    void insert(const AddressRange<address_type>& range) {
+        prefixes_.insert(range, true);
+    }
+
+    /**
+     * \brief Indicates whether an address is in this set.
+     *
+     * \param addr The address to be looked up.
+     */
+    bool contains(const address_type& addr) const {
+        return prefixes_.contains(addr);
+    }
+
+    /**
+     * \brief Returns the number of distinct prefixes in this set.
+     */
+    size_t size() const {
+        return prefixes_.size();
+    }
+
+    /**
+     * \brief Indicates whether this set is empty.
+     */
+    bool empty() const {
+        return prefixes_.empty();
+    }
+
+    /**
+     * \brief Removes every prefix in this set.
+     */
+    void clear() {
+        prefixes_.clear();
+    }
+private:
+    AddressMap<address_type, bool> prefixes_;
+};
+
+/**
+ * A set of IPv4 prefixes.
+ */
+typedef AddressSet<IPv4Address> IPv4AddressSet;
+
+/**
+ * A set of IPv6 prefixes.
+ */
+typedef AddressSet<IPv6Address> IPv6AddressSet;
+
+} // Tins
+
+#endif // TINS_ADDRESS_SET_H
@@ -0,0 +1,348 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TINS_BUFFERED_PACKET_WRITER_H
+#define TINS_BUFFERED_PACKET_WRITER_H
+
+#include <tins/cxxstd.h>
+
+#if TINS_IS_CXX11
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <stdint.h>
+#include <tins/macros.h>
+#include <tins/timestamp.h>
+#include <tins/pcap_index.h>
+#include <tins/utils/pdu_utils.h>
+
+namespace Tins {
+
+class PDU;
+class Packet;
+
+template<typename T>
+struct DataLinkType;
+
+/**
+ * \class BufferedPacketWriter
+ * \brief Writes packets to pcap format files from a background thread.
+ *
+ * PacketWriter serializes every packet into a new buffer and writes it 
+ * to the file on the caller's thread. This class instead appends records 
+ * to a few large buffers which are allocated once, and hands them over to
+ * a background thread when they're full. That thread writes them to disk 
+ * using writev, so the caller only pays for serializing or copying the 
+ * packet.
+ *
+ * If every buffer is waiting to be written, BufferedPacketWriter::write 
+ * either blocks until one is available or drops the packet, depending on
+ * options::drop_when_full.
+ *
+ * Output files can be rotated once they reach some size or after some 
+ * time has passed, just like tcpdump's -C, -G and -W options. Rotation 
+ * uses the packets' timestamps, not the wall clock time.
+ *
+ * The pcap format is written directly, so this class doesn't depend on
+ * libpcap. It's only available on POSIX systems: the constructor throws 
+ * feature_disabled on other platforms.
+ *
+ * Note that BufferedPacketWriter::write and BufferedPacketWriter::flush 
+ * must not be called concurrently from different threads.
+ *
+ * \code
+ * BufferedPacketWriter::options opts;
+ * // Start a new file every 100MB: capture.pcap, capture.pcap1, ...
+ * opts.rotate_size = 100 * 1024 * 1024;
+ * BufferedPacketWriter writer("capture.pcap", DataLinkType<EthernetII>(), opts);
+ * Sniffer sniffer("eth0");
+ * while (true) {
+ *     Packet packet = sniffer.next_packet();
+ *     writer.write(packet);
+ * }
+ * \endcode
+ */
+class TINS_API BufferedPacketWriter {
+public:
+    /**
+     * \brief Configures buffering and file rotation.
+     */
+    struct options {
+        /**
+         * The size of each buffer. It's rounded up to a multiple of 4096 
+         * and to fit at least one record of snap_length bytes.
+         */
+        size_t buffer_size;
+
+        /**
+         * The amount of buffers to allocate.
+         */
+        size_t buffer_count;
+
+        /**
+         * The maximum amount of bytes of each packet to store.
+         */
+        uint32_t snap_length;
+
+        /**
+         * Start a new file once the current one would grow beyond this many
+         * bytes. The first file is named after the file name provided and 
+         * the following ones have a number appended to it. 0 disables this.
+         */
+        uint64_t rotate_size;
+
+        /**
+         * Start a new file once this many seconds have passed since the first
+         * packet in the current one. The file name is expanded using strftime
+         * for every file. 0 disables this.
+         */
+        uint32_t rotate_interval;
+
+        /**
+         * If rotate_size is set, file numbers wrap around after this many 
+         * files, overwriting the oldest ones. Every file gets a number in 
+         * this case, starting at 0. 0 disables this.
+         */
+        uint32_t max_files;
+
+        /**
+         * Whether to drop packets rather than block when all buffers are
+         * waiting to be written.
+         */
+        bool drop_when_full;
+
+        /**
+         * Whether to build a PcapIndex for every file. Each index is stored
+         * next to its file, named after PcapIndex::index_file_name, once 
+         * the file is rotated or the writer is closed.
+         */
+        bool write_index;
+
+        /**
+         * Constructs the default options: 8 buffers of 1MB, a snap length
+         * of 65535, no rotation, blocking when full and no indexes.
+         */
+        options();
+    };
+
+    /**
+     * \brief Constructs a BufferedPacketWriter.
+     *
+     * The first file is created before returning.
+     *
+     * \param file_name The file in which to store the written packets.
+     * \param lt A DataLinkType that represents the link layer protocol to use.
+     * \param opts The options to use.
+     */
+    template<typename T>
+    BufferedPacketWriter(const std::string& file_name, const DataLinkType<T>& lt,
+                         const options& opts = options()) {
+        init(file_name, lt.get_type(), opts);
+    }
+
+    /**
+     * \brief Constructs a BufferedPacketWriter.
+     *
+     * The first file is created before returning.
+     *
+     * \param file_name The file in which to store the written packets.
+     * \param link_type The pcap link type identifier (DLT_*) to use.
+     * \param opts The options to use.
+     */
+    BufferedPacketWriter(const std::string& file_name, int link_type,
+                         const options& opts = options());
+
+    /**
+     * \brief Destructor.
+     *
+     * Writes any buffered packets and closes the current file. Errors are
+     * ignored: use BufferedPacketWriter::close to find out about them.
+     */
+    ~BufferedPacketWriter();
+
+    /**
+     * \brief Writes a PDU using the current time as its timestamp.
+     *
+     * \param pdu The PDU to be written.
+     */
+    void write(PDU& pdu);
+
+    /**
+     * \brief Writes a PDU.
+     *
+     * \param pdu The PDU to be written.
+     * \param ts The timestamp to use for this packet.
+     */
+    void write(PDU& pdu, const Timestamp& ts);
+
+    /**
+     * \brief Writes a Packet using its timestamp.
+     *
+     * \param packet The packet to be written.
+     */
+    void write(Packet& packet);
+
+    /**
+     * \brief Writes an already serialized packet.
+     *
+     * This is the cheapest way of storing captured packets, as they 
+     * don't need to be parsed or serialized.
+     *
+     * \param data The packet's contents.
+     * \param size The amount of bytes in data.
+     * \param ts The timestamp to use for this packet.
+     * \param original_size The packet's size on the wire, if data was 
+     * already truncated. 0 means it's the same as size.
+     */
+    void write(const uint8_t* data, uint32_t size, const Timestamp& ts,
+               uint32_t original_size = 0);
+
+    /**
+     * \brief Writes a PDU using the current time as its timestamp.
+     *
+     * The template parameter T must at some point yield a PDU& after
+     * applying operator* one or more than one time. This accepts both
+     * raw and smart pointers.
+     */
+    template<typename T>
+    void write(T& pdu) {
+        write(Utils::dereference_until_pdu(pdu));
+    }
+
+    /**
+     * \brief Writes all the PDUs in the range [start, end)
+     * \param start A forward iterator pointing to the first PDU
+     * to be written.
+     * \param end A forward iterator pointing to one past the last
+     * PDU in the range.
+     */
+    template<typename ForwardIterator>
+    void write(ForwardIterator start, ForwardIterator end) {
+        while (start != end) {
+            write(Utils::dereference_until_pdu(*start++));
+        }
+    }
+
+    /**
+     * \brief Waits until every packet written so far is handed to the OS.
+     *
+     * If the background thread failed to write or create a file, this 
+     * throws file_write_error.
+     */
+    void flush();
+
+    /**
+     * \brief Writes any buffered packets, stops the background thread and
+     * closes the current file.
+     *
+     * Calling write after this throws file_write_error. If the background
+     * thread failed to write or create a file, this throws file_write_error.
+     */
+    void close();
+
+    /**
+     * \brief The name of the file new packets are being written to.
+     */
+    const std::string& current_file_name() const;
+
+    /**
+     * \brief The amount of packets written or buffered so far.
+     */
+    uint64_t packets_written() const;
+
+    /**
+     * \brief The amount of packets dropped because all buffers were full.
+     */
+    uint64_t packets_dropped() const;
+private:
+    struct buffer_type {
+        std::vector<uint8_t> data;
+        size_t size;
+        // If not empty, this file has to be created before writing this buffer
+        std::string file_name;
+    };
+
+    // You shall not copy
+    BufferedPacketWriter(const BufferedPacketWriter&);
+    BufferedPacketWriter& operator=(const BufferedPacketWriter&);
+
+    void init(const std::string& file_name, int link_type, const options& opts);
+    uint8_t* reserve(uint32_t captured_size, uint32_t original_size, const Timestamp& ts);
+    bool rotation_needed(size_t record_size, const Timestamp& ts) const;
+    std::string make_file_name(const Timestamp& ts) const;
+    void write_file_header(uint8_t* buffer) const;
+    void save_index();
+    void submit_active_buffer();
+    buffer_type* acquire_buffer();
+    void check_error();
+    void stop();
+    void run();
+    void write_buffers(const std::vector<buffer_type*>& buffers);
+    bool open_file(const std::string& file_name);
+
+    options options_;
+    std::string base_name_;
+    std::string current_file_name_;
+    std::string pending_file_name_;
+    int link_type_;
+    std::vector<buffer_type> buffers_;
+    buffer_type* active_;
+    uint64_t file_size_;
+    uint64_t file_start_;
+    uint32_t file_index_;
+    bool file_started_;
+    uint64_t packets_written_;
+    uint64_t packets_dropped_;
+    PcapIndex index_;
+    uint64_t record_offset_;
+    // Shared with the background thread
+    std::mutex mutex_;
+    std::condition_variable work_available_;
+    std::condition_variable buffer_available_;
+    std::deque<buffer_type*> queued_buffers_;
+    std::vector<buffer_type*> free_buffers_;
+    size_t buffers_in_flight_;
+    std::string error_;
+    bool stopping_;
+    bool closed_;
+    // Only used by the background thread once it's started
+    int fd_;
+    std::string open_file_name_;
+    std::thread thread_;
+};
+
+} // Tins
+
+#endif // TINS_IS_CXX11
+
+#endif // TINS_BUFFERED_PACKET_WRITER_H
@@ -39,7 +39,16 @@
     #include <functional>
 #endif // TINS_HAVE_WPA2_CALLBACKS
 #include <tins/macros.h>
+#include <tins/cxxstd.h>
 #include <tins/handshake_capturer.h>
+#if TINS_IS_CXX11
+    #include <memory>
+#endif // TINS_IS_CXX11
+
+#ifdef TINS_HAVE_WPA2_DECRYPTION
+// OpenSSL's EVP_CIPHER_CTX
+struct evp_cipher_ctx_st;
+#endif // TINS_HAVE_WPA2_DECRYPTION
 
 namespace Tins {
 
@@ -132,6 +141,149 @@ private:
     bool is_ccmp_;
 };
 
+/**
+ * \brief Decrypts CCMP-protected unicast frames.
+ *
+ * This uses OpenSSL's AES-128-CCM implementation, which makes use of
+ * AES-NI when available. A cipher context is kept for every temporal
+ * key seen, so the AES key schedule is computed once per session rather
+ * than once per frame.
+ *
+ * Frames are decrypted in place: on success, the plaintext is stored in
+ * the same buffer, right after the CCMP header.
+ *
+ * Objects of this class can't be used concurrently from several threads.
+ * Copying one yields an object with no cached contexts.
+ */
+class TINS_API CCMPDecrypter {
+public:
+    /**
+     * The size of the CCMP header that precedes the encrypted data.
+     */
+    static const size_t HEADER_SIZE;
+
+    /**
+     * The size of the MIC that follows the encrypted data.
+     */
+    static const size_t MIC_SIZE;
+
+    /**
+     * The maximum number of cipher contexts kept. Once it's exceeded,
+     * all of them are released.
+     */
+    static const size_t MAX_CONTEXTS;
+
+    /**
+     * \brief Represents a frame to be decrypted by the batch overload
+     * of CCMPDecrypter::decrypt.
+     */
+    struct frame {
+        /**
+         * The keys for the session this frame belongs to.
+         */
+        const SessionKeys* keys;
+
+        /**
+         * The frame's 802.11 header.
+         */
+        const Dot11Data* dot11;
+
+        /**
+         * The frame's payload, starting at the CCMP header.
+         */
+        uint8_t* buffer;
+
+        /**
+         * The size of the payload, including the CCMP header and MIC.
+         */
+        uint32_t size;
+
+        /**
+         * Set to true iff the frame was successfully decrypted.
+         */
+        bool decrypted;
+    };
+
+    /**
+     * Default constructs a CCMPDecrypter.
+     */
+    CCMPDecrypter();
+
+    /**
+     * \brief Copy constructor.
+     *
+     * Cipher contexts are not copied.
+     */
+    CCMPDecrypter(const CCMPDecrypter& other);
+
+    /**
+     * \brief Copy assignment operator.
+     *
+     * This releases this object's cipher contexts.
+     */
+    CCMPDecrypter& operator=(const CCMPDecrypter& other);
+
+    /**
+     * Destructs this object, releasing its cipher contexts.
+     */
+    ~CCMPDecrypter();
+
+    /**
+     * \brief Decrypts a frame in place.
+     *
+     * On success, the plaintext is stored at buffer + HEADER_SIZE and is
+     * size - HEADER_SIZE - MIC_SIZE bytes long. If the MIC is invalid, the
+     * contents of the buffer are unspecified.
+     *
+     * \param keys The keys for the session this frame belongs to.
+     * \param dot11 The frame's 802.11 header.
+     * \param buffer The frame's payload, starting at the CCMP header.
+     * \param size The size of the payload, including CCMP header and MIC.
+     * \return true iff the frame was decrypted and its MIC was valid.
+     */
+    bool decrypt(const SessionKeys& keys, const Dot11Data& dot11, uint8_t* buffer,
+                 uint32_t size);
+
+    /**
+     * \brief Decrypts the payload in the given RawPDU.
+     *
+     * \param keys The keys for the session this frame belongs to.
+     * \param dot11 The frame's 802.11 header.
+     * \param raw The RawPDU that holds the encrypted payload.
+     * \return A SNAP layer containing the decrypted traffic or a null pointer
+     * if decryption failed.
+     */
+    SNAP* decrypt(const SessionKeys& keys, const Dot11Data& dot11, RawPDU& raw);
+
+    /**
+     * \brief Decrypts several frames in place.
+     *
+     * This is equivalent to decrypting each frame individually, but
+     * avoids looking up the cipher context again when consecutive
+     * frames belong to the same session.
+     *
+     * \param frames The frames to decrypt. Their decrypted member will be
+     * set to indicate whether they were decrypted.
+     * \return The number of frames that were decrypted.
+     */
+    size_t decrypt(std::vector<frame>& frames);
+
+    /**
+     * Releases all cipher contexts.
+     */
+    void clear();
+private:
+    // The temporal key, as two 64 bit words
+    typedef std::pair<uint64_t, uint64_t> context_key;
+    typedef std::map<context_key, evp_cipher_ctx_st*> contexts_type;
+
+    evp_cipher_ctx_st* find_context(const SessionKeys& keys);
+    bool decrypt(evp_cipher_ctx_st* ctx, const Dot11Data& dot11, uint8_t* buffer,
+                 uint32_t size);
+
+    contexts_type contexts_;
+};
+
 /**
  * \brief Represents a WPA2 supplicant's data.
  *
@@ -152,6 +304,14 @@ public:
      * \param ssid The access point's SSID.
      */
     SupplicantData(const std::string& psk, const std::string& ssid);
+
+    /**
+     * \brief Constructs a SupplicantData from an already derived PMK.
+     *
+     * \param pmk The PMK, which has to be SessionKeys::PMK_SIZE bytes long.
+     * \param ssid The access point's SSID.
+     */
+    SupplicantData(const pmk_type& pmk, const std::string& ssid);
     
     /**
      * \brief Getter for the PMK.
@@ -169,6 +329,143 @@ private:
     std::string ssid_;
 };
 
+/**
+ * \brief Stores derived PMKs so they don't have to be computed again.
+ *
+ * Deriving a PMK requires 4096 iterations of PBKDF2-HMAC-SHA1, which
+ * adds up when loading lots of PSK/SSID pairs. This class keeps the
+ * derived PMKs indexed by SSID and by an HMAC-SHA256 of the PSK, and
+ * can save them to and load them from a file. The HMAC is keyed using a
+ * random salt, generated for each cache and stored in its file, so 
+ * precomputed tables can't be used against it.
+ *
+ * The PSKs are not stored in plain text, but a cache file still works as
+ * a fast PSK verifier: anyone who can read it can test a guessed PSK 
+ * using a single HMAC rather than deriving its PMK. Besides, a PMK is as
+ * sensitive as the PSK it was derived from. Cache files must therefore 
+ * only be readable by their owner, which is how PMKCache::save creates 
+ * them.
+ *
+ * \code
+ * WPA2::PMKCache cache;
+ * try {
+ *     cache.load("pmks.cache");
+ * }
+ * catch (WPA2::invalid_pmk_cache&) {
+ *     // Missing or corrupted, start from scratch
+ * }
+ * WPA2Decrypter decrypter;
+ * decrypter.pmk_cache(&cache);
+ * decrypter.add_ap_data(networks);
+ * cache.save("pmks.cache");
+ * \endcode
+ */
+class TINS_API PMKCache {
+public:
+    /**
+     * The type used to store the PMK.
+     */
+    typedef SessionKeys::pmk_type pmk_type;
+
+    /**
+     * \brief Constructs an empty cache.
+     *
+     * The salt used to key its entries is generated when the first one is
+     * added.
+     */
+    PMKCache();
+
+    /**
+     * \brief Derives a PMK from a PSK and an SSID.
+     *
+     * \param psk The pre-shared key.
+     * \param ssid The access point's SSID.
+     * \return The derived PMK.
+     */
+    static pmk_type derive_pmk(const std::string& psk, const std::string& ssid);
+
+    /**
+     * \brief Loads the entries stored in a file created by PMKCache::save.
+     *
+     * Loaded entries are added to the ones already in this cache. An empty
+     * cache takes the file's salt. Otherwise, the file must have been 
+     * saved by a cache using the same salt, like one loaded from the same 
+     * file, since entries can't be keyed again without their PSKs.
+     *
+     * \param file_name The file to load.
+     * \throw invalid_pmk_cache If the file can't be read, is malformed or
+     * uses a different salt than this non-empty cache.
+     */
+    void load(const std::string& file_name);
+
+    /**
+     * \brief Saves this cache's entries into a file.
+     *
+     * The entries are written to a temporary file only readable and 
+     * writable by its owner, which then replaces the given one. If saving
+     * fails, the existing file is left untouched.
+     *
+     * \param file_name The file to write.
+     * \throw file_write_error If the file can't be written.
+     */
+    void save(const std::string& file_name) const;
+
+    /**
+     * \brief Looks up the PMK for a PSK/SSID pair.
+     *
+     * \param psk The pre-shared key.
+     * \param ssid The access point's SSID.
+     * \param pmk The variable in which the PMK will be stored, if found.
+     * \return true iff the PMK was found.
+     */
+    bool find(const std::string& psk, const std::string& ssid, pmk_type& pmk) const;
+
+    /**
+     * \brief Adds the PMK for a PSK/SSID pair.
+     *
+     * Any existing entry for the same pair is replaced.
+     *
+     * \param psk The pre-shared key.
+     * \param ssid The access point's SSID.
+     * \param pmk The PMK, which has to be SessionKeys::PMK_SIZE bytes long.
+     */
+    void insert(const std::string& psk, const std::string& ssid, const pmk_type& pmk);
+
+    /**
+     * \brief Returns the PMK for a PSK/SSID pair, deriving and storing
+     * it if it's not in the cache yet.
+     *
+     * \param psk The pre-shared key.
+     * \param ssid The access point's SSID.
+     * \return The PMK.
+     */
+    const pmk_type& get(const std::string& psk, const std::string& ssid);
+
+    /**
+     * Returns the number of entries in this cache.
+     */
+    size_t size() const;
+
+    /**
+     * Indicates whether this cache is empty.
+     */
+    bool empty() const;
+
+    /**
+     * Removes all entries from this cache.
+     */
+    void clear();
+private:
+    typedef std::pair<std::string, std::string> key_type;
+    typedef std::map<key_type, pmk_type> pmks_type;
+
+    key_type make_key(const std::string& psk, const std::string& ssid) const;
+    void generate_salt();
+
+    pmks_type pmks_;
+    std::string salt_;
+};
+
 } // WPA2
 #endif // TINS_HAVE_WPA2_DECRYPTION
 
@@ -179,6 +476,35 @@ class TINS_API WEPDecrypter {
 public:
     typedef HWAddress<6> address_type;
 
+    /**
+     * The type returned by find_frame_keys, which holds what's needed to
+     * decrypt a frame. For WEP, this is the password.
+     */
+    typedef std::string frame_keys_type;
+
+    /**
+     * \brief Decrypts frames using the keys found by find_frame_keys.
+     *
+     * This holds the state used while decrypting frames, so objects of
+     * this class can decrypt frames concurrently, as long as each of
+     * them is only used by one thread.
+     */
+    class TINS_API frame_decrypter {
+    public:
+        /**
+         * \brief Decrypts a frame.
+         *
+         * \param pdu The frame to decrypt.
+         * \param keys The keys found by find_frame_keys for this frame.
+         * \return true iff the frame was decrypted.
+         */
+        bool decrypt(PDU& pdu, const frame_keys_type& keys);
+    private:
+        PDU* decrypt(RawPDU& raw, const std::string& password);
+
+        std::vector<uint8_t> key_buffer_;
+    };
+
     /**
      * \brief Constructs a WEPDecrypter object.
      */
@@ -215,13 +541,26 @@ public:
      * failed, true otherwise.
      */
     bool decrypt(PDU& pdu);
+
+    /**
+     * \brief Finds the keys needed to decrypt a frame, without decrypting it.
+     *
+     * Calling this and then decrypting the frame using a frame_decrypter
+     * is equivalent to calling decrypt. This allows the actual decryption
+     * to be performed on another thread.
+     *
+     * \param pdu The frame to look at.
+     * \param keys The variable in which the keys will be stored.
+     * \return true iff the frame can be decrypted.
+     */
+    bool find_frame_keys(const PDU& pdu, frame_keys_type& keys) const;
 private:
     typedef std::map<address_type, std::string> passwords_type;
 
-    PDU* decrypt(RawPDU& raw, const std::string& password);
+    const std::string* find_password(const PDU& pdu) const;
 
     passwords_type passwords_;
-    std::vector<uint8_t> key_buffer_;
+    frame_decrypter frame_decrypter_;
 };
 
 #ifdef TINS_HAVE_WPA2_DECRYPTION
@@ -259,6 +598,61 @@ public:
      */
     typedef std::map<addr_pair, WPA2::SessionKeys> keys_map;
 
+    /**
+     * \brief The type used to pass access points' data in bulk.
+     *
+     * The first element is the PSK and the second one the SSID.
+     */
+    typedef std::pair<std::string, std::string> ap_data_type;
+
+    #if TINS_IS_CXX11
+        /**
+         * The type returned by find_frame_keys, which holds what's needed to
+         * decrypt a frame. For WPA2, these are the session's keys, which are 
+         * shared with the decrypter rather than copied for every frame. They
+         * stay valid after the decrypter replaces them.
+         */
+        typedef std::shared_ptr<const WPA2::SessionKeys> frame_keys_type;
+    #else
+        /**
+         * The type returned by find_frame_keys, which holds what's needed to
+         * decrypt a frame. For WPA2, this is a copy of the session's keys.
+         */
+        typedef WPA2::SessionKeys frame_keys_type;
+    #endif // TINS_IS_CXX11
+
+    /**
+     * \brief Decrypts frames using the keys found by find_frame_keys.
+     *
+     * This holds the state used while decrypting frames, so objects of
+     * this class can decrypt frames concurrently, as long as each of
+     * them is only used by one thread.
+     */
+    class TINS_API frame_decrypter {
+    public:
+        /**
+         * \brief Decrypts a frame.
+         *
+         * \param pdu The frame to decrypt.
+         * \param keys The session keys to use.
+         * \return true iff the frame was decrypted.
+         */
+        bool decrypt(PDU& pdu, const WPA2::SessionKeys& keys);
+
+        #if TINS_IS_CXX11
+        /**
+         * \brief Decrypts a frame.
+         *
+         * \param pdu The frame to decrypt.
+         * \param keys The keys found by find_frame_keys for this frame.
+         * \return true iff the frame was decrypted.
+         */
+        bool decrypt(PDU& pdu, const frame_keys_type& keys);
+        #endif // TINS_IS_CXX11
+    private:
+        WPA2::CCMPDecrypter ccmp_;
+    };
+
     #ifdef TINS_HAVE_WPA2_CALLBACKS
 
     /**
@@ -285,6 +679,11 @@ public:
     
     #endif // TINS_HAVE_WPA2_CALLBACKS
 
+    /**
+     * \brief Default constructs a WPA2Decrypter.
+     */
+    WPA2Decrypter();
+
     /**
      * \brief Adds an access points's information.
      *
@@ -322,6 +721,35 @@ public:
     void add_ap_data(const std::string& psk,
                      const std::string& ssid,
                      const address_type& addr);
+
+    /**
+     * \brief Adds several access points' information at once.
+     *
+     * This is equivalent to calling add_ap_data(psk, ssid) for each
+     * element in ap_data, but the PMKs are derived in parallel, which
+     * makes a big difference when loading lots of access points.
+     *
+     * Parallel derivation requires C++11 support; otherwise the PMKs
+     * are derived one after the other.
+     *
+     * \param ap_data The (PSK, SSID) pairs to add.
+     * \param thread_count The maximum number of threads to use. If 0,
+     * the number of hardware threads is used.
+     */
+    void add_ap_data(const std::vector<ap_data_type>& ap_data,
+                     size_t thread_count = 0);
+
+    /**
+     * \brief Sets the cache used when deriving PMKs.
+     *
+     * Every add_ap_data overload will look up PMKs in this cache before
+     * deriving them, and will store the ones it derives. The cache is
+     * not owned by this decrypter, so it has to outlive it. Use a null
+     * pointer to stop using a cache.
+     *
+     * \param cache The cache to use.
+     */
+    void pmk_cache(WPA2::PMKCache* cache);
     
     /**
      * \brief Explicitly add decryption keys.
@@ -363,6 +791,21 @@ public:
      */
     bool decrypt(PDU& pdu);
 
+    /**
+     * \brief Finds the keys needed to decrypt a frame, without decrypting it.
+     *
+     * This performs all the bookkeeping done by decrypt, like capturing
+     * handshakes and looking for access points, so it has to be called on
+     * every packet, in capture order. Calling this and then decrypting the
+     * frame using a frame_decrypter is equivalent to calling decrypt. This
+     * allows the actual decryption to be performed on another thread.
+     *
+     * \param pdu The frame to look at.
+     * \param keys The variable in which the keys will be stored.
+     * \return true iff the frame can be decrypted.
+     */
+    bool find_frame_keys(const PDU& pdu, frame_keys_type& keys);
+
     #ifdef TINS_HAVE_WPA2_CALLBACKS
     /**
      * \brief Sets the handshake captured callback
@@ -410,11 +853,19 @@ private:
     addr_pair extract_addr_pair_dst(const Dot11Data& dot11);
     bssids_map::const_iterator find_ap(const Dot11Data& dot11);
     void add_access_point(const std::string& ssid, const address_type& addr);
+    void store_keys(const addr_pair& addresses, const WPA2::SessionKeys& session_keys);
+    keys_map::const_iterator process_packet(const PDU& pdu);
 
     RSNHandshakeCapturer capturer_;
     pmks_map pmks_;
+    WPA2::PMKCache* pmk_cache_;
+    frame_decrypter frame_decrypter_;
     bssids_map aps_;
     keys_map keys_;
+    #if TINS_IS_CXX11
+        // The same keys as keys_, handed out by find_frame_keys
+        std::map<addr_pair, frame_keys_type> frame_keys_;
+    #endif // TINS_IS_CXX11
     #ifdef TINS_HAVE_WPA2_CALLBACKS
         handshake_captured_callback_type handshake_captured_callback_;
         ap_found_callback_type ap_found_callback_;
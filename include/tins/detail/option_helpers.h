@@ -0,0 +1,311 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TINS_OPTION_HELPERS_H
+#define TINS_OPTION_HELPERS_H
+
+#include <vector>
+#include <iterator>
+#include <cstddef>
+#include <stdint.h>
+#include <tins/macros.h>
+#include <tins/cxxstd.h>
+#if TINS_IS_CXX11
+    #include <atomic>
+    #include <thread>
+    #include <utility>
+#endif // TINS_IS_CXX11
+
+/**
+ * \cond
+ */
+namespace Tins {
+namespace Internals {
+
+// The ways in which PDUs encode their option lists
+enum OptionLayout {
+    // 0 ends the list and 1 is a single byte option. The length field 
+    // accounts for the type and length fields
+    TCP_OPTION_LAYOUT,
+    // Same as TCP, except options numbered 0 or 1 are single byte ones 
+    // and the end of list option has to be the last byte
+    IP_OPTION_LAYOUT,
+    // 802.11 tagged parameters. A trailing byte that can't hold a 
+    // tag and its length is ignored
+    DOT11_OPTION_LAYOUT,
+    // 0 (pad) and 255 (end) are single byte options
+    DHCP_OPTION_LAYOUT,
+    // Neighbor discovery options. The length field is expressed in units
+    // of 8 bytes and accounts for the type and length fields
+    ICMPV6_OPTION_LAYOUT
+};
+
+// An option that points into the buffer it was read from
+struct RawOption {
+    RawOption() : type(0), data(0), data_size(0) { }
+
+    uint8_t type;
+    const uint8_t* data;
+    uint32_t data_size;
+};
+
+// Walks over the options stored in a buffer without copying them. 
+// Advancing over a malformed option throws malformed_packet.
+class TINS_API RawOptionIterator {
+public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef RawOption value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const RawOption* pointer;
+    typedef const RawOption& reference;
+
+    // Constructs an end iterator
+    RawOptionIterator();
+    RawOptionIterator(OptionLayout layout, const uint8_t* first, const uint8_t* last);
+
+    reference operator*() const {
+        return current_;
+    }
+
+    pointer operator->() const {
+        return &current_;
+    }
+
+    RawOptionIterator& operator++() {
+        read_option();
+        return *this;
+    }
+
+    RawOptionIterator operator++(int) {
+        RawOptionIterator output = *this;
+        read_option();
+        return output;
+    }
+
+    bool operator==(const RawOptionIterator& rhs) const {
+        return position_ == rhs.position_;
+    }
+
+    bool operator!=(const RawOptionIterator& rhs) const {
+        return position_ != rhs.position_;
+    }
+private:
+    void read_option();
+
+    OptionLayout layout_;
+    // The beginning of the current option, null if at the end
+    const uint8_t* position_;
+    const uint8_t* next_;
+    const uint8_t* last_;
+    RawOption current_;
+};
+
+// The option list of a PDU.
+//
+// When the PDU is constructed from a buffer, the raw option bytes are stored
+// and the list of options is only built the first time it's needed. Until
+// the list is modified, searching for an option walks over the raw bytes and
+// doesn't allocate. Building the list from a const member is thread safe.
+//
+// On C++03 there's no portable way to synchronize the lazy parse, so the
+// list is built as soon as the raw bytes are assigned.
+template <typename Option, OptionLayout Layout>
+class LazyOptionList {
+public:
+    typedef std::vector<Option> container_type;
+    typedef typename Option::option_type option_type;
+
+    LazyOptionList() 
+    : has_raw_bytes_(false) {
+        #if TINS_IS_CXX11
+            state_.store(READY, std::memory_order_relaxed);
+        #endif // TINS_IS_CXX11
+    }
+
+    LazyOptionList(const LazyOptionList& rhs) {
+        #if TINS_IS_CXX11
+            state_.store(READY, std::memory_order_relaxed);
+        #endif // TINS_IS_CXX11
+        *this = rhs;
+    }
+
+    #if TINS_IS_CXX11
+    LazyOptionList(LazyOptionList&& rhs) {
+        state_.store(READY, std::memory_order_relaxed);
+        *this = std::move(rhs);
+    }
+
+    LazyOptionList& operator=(LazyOptionList&& rhs) {
+        raw_bytes_ = std::move(rhs.raw_bytes_);
+        has_raw_bytes_ = rhs.has_raw_bytes_;
+        if (rhs.state_.load(std::memory_order_acquire) == READY) {
+            options_ = std::move(rhs.options_);
+            state_.store(READY, std::memory_order_relaxed);
+        }
+        else {
+            options_.clear();
+            state_.store(UNPARSED, std::memory_order_relaxed);
+        }
+        return *this;
+    }
+    #endif // TINS_IS_CXX11
+
+    LazyOptionList& operator=(const LazyOptionList& rhs) {
+        raw_bytes_ = rhs.raw_bytes_;
+        has_raw_bytes_ = rhs.has_raw_bytes_;
+        #if TINS_IS_CXX11
+            // Only copy the list if it's been built, otherwise use the raw bytes
+            if (rhs.state_.load(std::memory_order_acquire) == READY) {
+                options_ = rhs.options_;
+                state_.store(READY, std::memory_order_relaxed);
+            }
+            else {
+                options_.clear();
+                state_.store(UNPARSED, std::memory_order_relaxed);
+            }
+        #else
+            options_ = rhs.options_;
+        #endif // TINS_IS_CXX11
+        return *this;
+    }
+
+    // Stores the raw option bytes. These must have been validated already
+    void assign(const uint8_t* first, const uint8_t* last) {
+        raw_bytes_.assign(first, last);
+        has_raw_bytes_ = true;
+        options_.clear();
+        #if TINS_IS_CXX11
+            state_.store(UNPARSED, std::memory_order_relaxed);
+        #else
+            parse();
+        #endif // TINS_IS_CXX11
+    }
+
+    // Retrieves the option list, building it if it's the first time it's needed
+    const container_type& get() const {
+        #if TINS_IS_CXX11
+            if (state_.load(std::memory_order_acquire) != READY) {
+                int expected = UNPARSED;
+                if (state_.compare_exchange_strong(expected, PARSING,
+                                                   std::memory_order_acquire)) {
+                    parse();
+                    state_.store(READY, std::memory_order_release);
+                }
+                else {
+                    // Another thread is parsing the options
+                    while (state_.load(std::memory_order_acquire) != READY) {
+                        std::this_thread::yield();
+                    }
+                }
+            }
+        #endif // TINS_IS_CXX11
+        return options_;
+    }
+
+    // Retrieves the option list so it can be modified. From now on, the 
+    // raw bytes are no longer used
+    container_type& get_mutable() {
+        get();
+        raw_bytes_.clear();
+        has_raw_bytes_ = false;
+        return options_;
+    }
+
+    // Searches for the first option of the given type. If the raw bytes are 
+    // still in use, the option is copied into storage and a pointer to it is 
+    // returned. Otherwise, the pointer points into the option list.
+    const Option* search(option_type type, Option& storage) const {
+        if (has_raw_bytes_) {
+            const RawOptionIterator end;
+            for (RawOptionIterator iter = raw_begin(); iter != end; ++iter) {
+                if (static_cast<option_type>(iter->type) == type) {
+                    storage = Option(type, iter->data, iter->data + iter->data_size);
+                    return &storage;
+                }
+            }
+            return 0;
+        }
+        const container_type& options = get();
+        for (size_t i = 0; i < options.size(); ++i) {
+            if (options[i].option() == type) {
+                return &options[i];
+            }
+        }
+        return 0;
+    }
+private:
+    #if TINS_IS_CXX11
+    enum State {
+        UNPARSED,
+        PARSING,
+        READY
+    };
+    #endif // TINS_IS_CXX11
+
+    RawOptionIterator raw_begin() const {
+        if (raw_bytes_.empty()) {
+            return RawOptionIterator();
+        }
+        const uint8_t* first = &raw_bytes_[0];
+        return RawOptionIterator(Layout, first, first + raw_bytes_.size());
+    }
+
+    void parse() const {
+        const RawOptionIterator end;
+        for (RawOptionIterator iter = raw_begin(); iter != end; ++iter) {
+            options_.push_back(
+                Option(
+                    static_cast<option_type>(iter->type),
+                    iter->data,
+                    iter->data + iter->data_size
+                )
+            );
+        }
+    }
+
+    std::vector<uint8_t> raw_bytes_;
+    bool has_raw_bytes_;
+    mutable container_type options_;
+    #if TINS_IS_CXX11
+        mutable std::atomic<int> state_;
+    #endif // TINS_IS_CXX11
+};
+
+// Walks over the options in the given buffer, throwing malformed_packet
+// if any of them is malformed
+TINS_API void validate_options(OptionLayout layout, const uint8_t* first,
+                               const uint8_t* last);
+
+} // namespace Internals
+} // namespace Tins
+/**
+ * \endcond
+ */
+
+#endif // TINS_OPTION_HELPERS_H
@@ -30,6 +30,7 @@
 #ifndef TINS_PDU_HELPERS_H
 #define TINS_PDU_HELPERS_H
 
+#include <map>
 #include <tins/constants.h>
 #include <tins/config.h>
 #include <tins/pdu.h>
@@ -56,6 +57,40 @@ PDU::PDUType ether_type_to_pdu_flag(Constants::Ethernet::e flag);
 Constants::IP::e pdu_flag_to_ip_type(PDU::PDUType flag);
 PDU::PDUType ip_type_to_pdu_flag(Constants::IP::e flag);
 
+typedef PDU* (*pdu_factory)(const uint8_t* buffer, uint32_t size);
+
+template <typename T>
+PDU* create_pdu(const uint8_t* buffer, uint32_t size) {
+    return new T(buffer, size);
+}
+
+// While one of these is alive, layers decoded through decode_layer in the
+// same thread don't throw malformed_packet but are counted and replaced 
+// by a RawPDU
+class TINS_API decode_context {
+public:
+    typedef std::map<PDU::PDUType, uint64_t> counters_type;
+
+    decode_context(counters_type& malformed_layers);
+    ~decode_context();
+
+    void layer_failed(PDU::PDUType type);
+    uint32_t failed_layers() const;
+private:
+    decode_context(const decode_context&);
+    decode_context& operator=(const decode_context&);
+
+    counters_type& malformed_layers_;
+    decode_context* previous_;
+    uint32_t failed_layers_;
+};
+
+// Cheap checks performed before decoding a layer in a decode_context. 
+// Returns false if the buffer can't hold a valid header of this type.
+bool header_fits(PDU::PDUType type, const uint8_t* buffer, uint32_t size);
+PDU* decode_layer(PDU::PDUType type, pdu_factory factory,
+                  const uint8_t* buffer, uint32_t size);
+
 inline bool is_dot3(const uint8_t* ptr, size_t sz) {
     return (sz >= 13 && ptr[12] < 8);
 }
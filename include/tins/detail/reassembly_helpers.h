@@ -0,0 +1,271 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TINS_REASSEMBLY_HELPERS_H
+#define TINS_REASSEMBLY_HELPERS_H
+
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include <stdint.h>
+#include <tins/macros.h>
+#include <tins/cxxstd.h>
+#include <tins/timestamp.h>
+#if TINS_IS_CXX11
+    #include <chrono>
+#endif // TINS_IS_CXX11
+
+/**
+ * \cond
+ */
+namespace Tins {
+
+class PDU;
+
+namespace Internals {
+
+// The type used by the reassemblers to represent timestamps and timeouts
+#if TINS_IS_CXX11
+    typedef std::chrono::microseconds reassembly_timestamp_type;
+#else
+    typedef Timestamp reassembly_timestamp_type;
+#endif // TINS_IS_CXX11
+
+// Converts a reassembly timestamp into microseconds
+TINS_API uint64_t reassembly_timestamp_value(const reassembly_timestamp_type& ts);
+// Builds a reassembly timestamp that represents the given amount of seconds
+TINS_API reassembly_timestamp_type make_reassembly_timestamp(uint32_t seconds);
+
+// Buffer holding a fragmented datagram's payload. Missing ranges are tracked
+// using RFC 815 hole descriptors. Bytes that were already received are never
+// overwritten by overlapping fragments.
+class TINS_API DatagramBuffer {
+public:
+    typedef std::vector<uint8_t> payload_type;
+
+    DatagramBuffer();
+
+    // Returns false if the fragment is inconsistent with the ones seen so far
+    // or if it'd make the datagram exceed max_size bytes
+    bool add_fragment(uint32_t offset, const uint8_t* data, uint32_t size,
+                      bool more_fragments, uint32_t max_size);
+    // Same as above, using the serialization of the given PDU as the data
+    bool add_fragment(uint32_t offset, PDU& data, bool more_fragments,
+                      uint32_t max_size);
+    bool is_complete() const;
+    const payload_type& payload() const;
+    size_t size() const;
+private:
+    // Both ends are inclusive
+    struct hole {
+        hole(uint32_t first, uint32_t last) : first(first), last(last) { }
+
+        uint32_t first;
+        uint32_t last;
+    };
+
+    typedef std::vector<hole> holes_type;
+
+    holes_type holes_;
+    payload_type payload_;
+    bool received_end_;
+};
+
+// Table of partially reassembled datagrams. This keeps track of how many
+// bytes are buffered in total and per source address and discards datagrams
+// that time out or that make the buffered bytes go over the configured caps.
+//
+// StreamMap maps datagram keys to streams, which must provide first_seen(),
+// source() and buffered_bytes(). SourceMap maps source addresses to byte counts.
+template <typename StreamMap, typename SourceMap>
+class ReassemblyTable {
+public:
+    typedef typename StreamMap::key_type key_type;
+    typedef typename StreamMap::mapped_type stream_type;
+    typedef typename StreamMap::iterator iterator;
+
+    // The timeout is expressed in microseconds
+    ReassemblyTable(uint64_t timeout, size_t max_buffered_bytes,
+                    size_t max_buffered_bytes_per_source)
+    : timeout_(timeout), last_cleanup_(0), max_buffered_bytes_(max_buffered_bytes),
+      max_buffered_bytes_per_source_(max_buffered_bytes_per_source),
+      buffered_bytes_(0), discarded_datagrams_(0) {
+
+    }
+
+    // Discards the datagrams that timed out, at most once per timeout period
+    void expire(uint64_t now) {
+        if (last_cleanup_ + timeout_ > now) {
+            return;
+        }
+        iterator iter = streams_.begin();
+        while (iter != streams_.end()) {
+            if (iter->second.first_seen() + timeout_ <= now) {
+                discard(iter++);
+            }
+            else {
+                ++iter;
+            }
+        }
+        last_cleanup_ = now;
+    }
+
+    iterator find(const key_type& key) {
+        return streams_.find(key);
+    }
+
+    iterator end() {
+        return streams_.end();
+    }
+
+    // Looks up the stream for the given key, creating it if it's missing
+    template <typename Address>
+    iterator find_or_insert(const key_type& key, const Address& source, uint64_t first_seen) {
+        iterator iter = streams_.find(key);
+        if (iter == streams_.end()) {
+            iter = streams_.insert(std::make_pair(key, stream_type(source, first_seen))).first;
+        }
+        return iter;
+    }
+
+    // Accounts for the bytes a stream buffered since it had previous_size bytes
+    void stream_grew(iterator iter, size_t previous_size) {
+        const size_t added_size = iter->second.buffered_bytes() - previous_size;
+        buffered_bytes_ += added_size;
+        source_bytes_[iter->second.source()] += added_size;
+    }
+
+    // Discards datagrams until the buffered bytes are within the caps. The 
+    // given stream is the one that was just updated and may be discarded
+    void enforce_caps(iterator iter) {
+        if (max_buffered_bytes_per_source_ > 0) {
+            typename SourceMap::const_iterator source_iter = 
+                source_bytes_.find(iter->second.source());
+            if (source_iter != source_bytes_.end() &&
+                source_iter->second > max_buffered_bytes_per_source_) {
+                discard(iter);
+                return;
+            }
+        }
+        if (max_buffered_bytes_ > 0 && buffered_bytes_ > max_buffered_bytes_) {
+            discard_oldest();
+        }
+    }
+
+    // Removes a stream, either because it was reassembled or by request
+    void erase(iterator iter) {
+        const size_t size = iter->second.buffered_bytes();
+        typename SourceMap::iterator source_iter = source_bytes_.find(iter->second.source());
+        if (source_iter != source_bytes_.end()) {
+            source_iter->second -= std::min(size, source_iter->second);
+            if (source_iter->second == 0) {
+                source_bytes_.erase(source_iter);
+            }
+        }
+        buffered_bytes_ -= std::min(size, buffered_bytes_);
+        streams_.erase(iter);
+    }
+
+    // Removes a stream whose datagram won't be reassembled
+    void discard(iterator iter) {
+        erase(iter);
+        ++discarded_datagrams_;
+    }
+
+    // Same as discard but for datagrams that could not even be looked up
+    void discard() {
+        ++discarded_datagrams_;
+    }
+
+    void clear() {
+        streams_.clear();
+        source_bytes_.clear();
+        buffered_bytes_ = 0;
+    }
+
+    void timeout(uint64_t value) {
+        timeout_ = value;
+    }
+
+    void max_buffered_bytes(size_t value) {
+        max_buffered_bytes_ = value;
+    }
+
+    void max_buffered_bytes_per_source(size_t value) {
+        max_buffered_bytes_per_source_ = value;
+    }
+
+    size_t buffered_bytes() const {
+        return buffered_bytes_;
+    }
+
+    size_t buffered_datagrams() const {
+        return streams_.size();
+    }
+
+    uint64_t discarded_datagrams() const {
+        return discarded_datagrams_;
+    }
+private:
+    struct older_stream {
+        bool operator()(const iterator& lhs, const iterator& rhs) const {
+            return lhs->second.first_seen() < rhs->second.first_seen();
+        }
+    };
+
+    void discard_oldest() {
+        std::vector<iterator> candidates;
+        candidates.reserve(streams_.size());
+        for (iterator iter = streams_.begin(); iter != streams_.end(); ++iter) {
+            candidates.push_back(iter);
+        }
+        std::sort(candidates.begin(), candidates.end(), older_stream());
+        for (size_t i = 0; i < candidates.size() && buffered_bytes_ > max_buffered_bytes_; ++i) {
+            discard(candidates[i]);
+        }
+    }
+
+    StreamMap streams_;
+    SourceMap source_bytes_;
+    // Both in microseconds
+    uint64_t timeout_;
+    uint64_t last_cleanup_;
+    size_t max_buffered_bytes_;
+    size_t max_buffered_bytes_per_source_;
+    size_t buffered_bytes_;
+    uint64_t discarded_datagrams_;
+};
+
+} // namespace Internals
+} // namespace Tins
+/**
+ * \endcond
+ */
+
+#endif // TINS_REASSEMBLY_HELPERS_H
@@ -38,6 +38,9 @@
 #endif
 
 namespace Tins {
+
+class PDU;
+
 namespace Internals {
 /**
  * \cond
@@ -109,9 +112,16 @@ bool invoke_loop_cb(Functor& f, Packet& p,
     return f(p);
 }
 
+// Handlers taking a const PDU& get it through the const accessor, which never clones a shared PDU
+template <typename Functor, typename Packet>
+bool invoke_loop_cb(Functor& f, Packet& p,
+                    typename std::enable_if<!accepts_type<Functor, Packet>::value && !accepts_type<Functor, Packet&>::value && accepts_type<Functor, const PDU&>::value, bool>::type* = 0) {
+    return f(*static_cast<const Packet&>(p).pdu());
+}
+
 template <typename Functor, typename Packet>
 bool invoke_loop_cb(Functor& f, Packet& p,
-                    typename std::enable_if<!accepts_type<Functor, Packet>::value && !accepts_type<Functor, Packet&>::value, bool>::type* = 0) {
+                    typename std::enable_if<!accepts_type<Functor, Packet>::value && !accepts_type<Functor, Packet&>::value && !accepts_type<Functor, const PDU&>::value, bool>::type* = 0) {
     return f(*p.pdu());
 }
 
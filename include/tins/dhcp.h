@@ -36,6 +36,7 @@
 #include <tins/macros.h>
 #include <tins/pdu_option.h>
 #include <tins/cxxstd.h>
+#include <tins/detail/option_helpers.h>
 
 namespace Tins {
 
@@ -215,7 +216,7 @@ public:
          */
         void add_option(option &&opt) {
             internal_add_option(opt);
-            options_.push_back(std::move(opt));
+            options_.get_mutable().push_back(std::move(opt));
         }
     #endif 
 
@@ -483,7 +484,7 @@ public:
      * \brief Getter for the options list.
      * \return The option list.
      */
-    const options_type options() const { return options_; }
+    const options_type options() const { return options_.get(); }
     
     /**
      * \brief Getter for the PDU's type.
@@ -511,7 +512,8 @@ private:
 
     template <typename T> 
     T search_and_convert(OptionTypes opt) const {
-        const option* option = search_option(opt);
+        option storage;
+        const option* option = options_.search(opt, storage);
         if (!option) {
             throw option_not_found();
         }
@@ -523,7 +525,7 @@ private:
     options_type::const_iterator search_option_iterator(OptionTypes opt) const;
     options_type::iterator search_option_iterator(OptionTypes opt);
     
-    options_type options_;
+    Internals::LazyOptionList<option, Internals::DHCP_OPTION_LAYOUT> options_;
     uint32_t size_;
 };
 
@@ -35,6 +35,10 @@
 #include <cstring>
 #include <string>
 #include <map>
+#include <tins/cxxstd.h>
+#if TINS_IS_CXX11
+    #include <unordered_map>
+#endif // TINS_IS_CXX11
 #include <tins/macros.h>
 #include <tins/pdu.h>
 #include <tins/endianness.h>
@@ -614,6 +618,365 @@ public:
         uint16_t preference_;
     };
 
+    /**
+     * \brief A non-owning view of an encoded domain name.
+     *
+     * The name is only decoded when requested, following any compression
+     * pointers it contains. A name_view points into the buffer it was
+     * read from, so it is only valid for as long as that buffer is.
+     */
+    class TINS_API name_view {
+    public:
+        /**
+         * The size of a buffer big enough to hold any decoded name,
+         * including the null terminator.
+         */
+        static const uint32_t MAX_NAME_SIZE = 256;
+
+        /**
+         * \brief Default constructs an empty name view.
+         */
+        name_view();
+
+        /**
+         * \brief Constructs a name view.
+         *
+         * \param records_start Pointer to the byte right after the DNS 
+         * header, used to resolve compression pointers.
+         * \param end Pointer to the end of the DNS message.
+         * \param ptr Pointer to the encoded name.
+         */
+        name_view(const uint8_t* records_start, const uint8_t* end, const uint8_t* ptr);
+
+        /**
+         * \brief Decodes this name into the provided buffer.
+         *
+         * The output is null terminated. If the buffer is too small or the 
+         * name is malformed, a malformed_packet exception is thrown.
+         *
+         * \param output The buffer in which to store the decoded name.
+         * \param output_size The size of the output buffer.
+         * \return The length of the decoded name, not including the null 
+         * terminator.
+         */
+        uint32_t decode(char* output, uint32_t output_size) const;
+
+        /**
+         * \brief Decodes this name into the provided buffer.
+         *
+         * This behaves like decode(char*, uint32_t) but also reports how 
+         * many bytes the encoded name takes where this view points to, so 
+         * the caller can skip it without walking it again.
+         *
+         * \param output The buffer in which to store the decoded name.
+         * \param output_size The size of the output buffer.
+         * \param encoded_size Set to the size of the encoded name, up to and
+         * including its null label or its first compression pointer.
+         * \return The length of the decoded name, not including the null 
+         * terminator.
+         */
+        uint32_t decode(char* output, uint32_t output_size, uint32_t& encoded_size) const;
+
+        /**
+         * \brief Decodes this name into a string.
+         */
+        std::string to_string() const;
+
+        /**
+         * \brief Compares this name to a dot separated one.
+         *
+         * The comparison is case insensitive and doesn't allocate memory.
+         * A trailing dot in the provided name is ignored, so "example.com."
+         * equals "example.com".
+         *
+         * \param name The null terminated name to compare to.
+         */
+        bool equals(const char* name) const;
+
+        /**
+         * \brief Indicates whether this view points to a name.
+         */
+        bool empty() const {
+            return ptr_ == 0;
+        }
+    private:
+        const uint8_t* follow_pointer(const uint8_t* ptr) const;
+
+        const uint8_t* records_start_;
+        const uint8_t* end_;
+        const uint8_t* ptr_;
+    };
+
+    class record_reader;
+
+    /**
+     * \brief A non-owning view of a record in a DNS message.
+     *
+     * \sa DNS::record_reader
+     */
+    class TINS_API record_view {
+    public:
+        /**
+         * The sections a record can be found in.
+         */
+        enum Section {
+            QUESTION,
+            ANSWER,
+            AUTHORITY,
+            ADDITIONAL
+        };
+
+        /**
+         * \brief Default constructor.
+         */
+        record_view();
+
+        /**
+         * \brief Getter for the section in which this record was found.
+         */
+        Section section() const {
+            return section_;
+        }
+
+        /**
+         * \brief Getter for the domain name field.
+         */
+        const name_view& dname() const {
+            return dname_;
+        }
+
+        /**
+         * \brief Getter for the query type field.
+         */
+        uint16_t query_type() const {
+            return type_;
+        }
+
+        /**
+         * \brief Getter for the query class field.
+         */
+        uint16_t query_class() const {
+            return qclass_;
+        }
+
+        /**
+         * \brief Getter for the time-to-live field.
+         *
+         * This is always 0 for records in the question section.
+         */
+        uint32_t ttl() const {
+            return ttl_;
+        }
+
+        /**
+         * \brief Getter for a pointer to the record's raw data.
+         *
+         * This is always null for records in the question section.
+         */
+        const uint8_t* data_ptr() const {
+            return data_ptr_;
+        }
+
+        /**
+         * \brief Getter for the size of the record's raw data.
+         */
+        uint16_t data_size() const {
+            return data_size_;
+        }
+
+        /**
+         * \brief Getter for the preference field.
+         *
+         * This field is only valid for MX records.
+         */
+        uint16_t preference() const;
+
+        /**
+         * \brief Getter for the domain name contained in the data field.
+         *
+         * This is only valid for NS, CNAME, DNAM, PTR and MX records. For 
+         * any other type, an empty name_view is returned.
+         */
+        name_view data_name() const;
+    private:
+        friend class record_reader;
+
+        name_view dname_;
+        const uint8_t* records_start_;
+        const uint8_t* end_;
+        const uint8_t* data_ptr_;
+        Section section_;
+        uint32_t ttl_;
+        uint16_t type_, qclass_, data_size_;
+    };
+
+    /**
+     * \brief Iterates the records in a DNS message without allocating memory.
+     *
+     * Unlike DNS::queries and DNS::answers, which build a vector and a 
+     * string per record, this class walks a DNS message in place and 
+     * only decodes names when asked to.
+     *
+     * \code
+     * DNS::record_reader reader(payload_ptr, payload_size);
+     * DNS::record_view record;
+     * char name[DNS::name_view::MAX_NAME_SIZE];
+     * while (reader.next(record)) {
+     *     if (record.section() == DNS::record_view::QUESTION) {
+     *         record.dname().decode(name, sizeof(name));
+     *     }
+     * }
+     * \endcode 
+     */
+    class TINS_API record_reader {
+    public:
+        /**
+         * \brief Constructs a reader over a DNS message.
+         *
+         * The buffer must contain the whole message, starting at the DNS 
+         * header. If it's too short to hold the header, a malformed_packet 
+         * exception is thrown.
+         *
+         * \param buffer The buffer holding the message.
+         * \param total_sz The size of the buffer.
+         */
+        record_reader(const uint8_t* buffer, uint32_t total_sz);
+
+        /**
+         * \brief Constructs a reader over the records in a DNS PDU.
+         *
+         * \param dns The PDU to read. It must outlive this reader.
+         */
+        record_reader(const DNS& dns);
+
+        /**
+         * \brief Reads the next record.
+         *
+         * If a record is truncated, a malformed_packet exception is thrown.
+         *
+         * \param record The view in which to store the record.
+         * \return true if a record was read, false if there are no more.
+         */
+        bool next(record_view& record);
+    private:
+        void init(const uint8_t* header, const uint8_t* records_start,
+                  const uint8_t* end);
+
+        const uint8_t* records_start_;
+        const uint8_t* ptr_;
+        const uint8_t* end_;
+        uint16_t counts_[4];
+        uint32_t section_;
+    };
+
+    /**
+     * \brief Builds DNS messages using name compression.
+     *
+     * DNS::add_query and friends write every domain name in full and 
+     * insert each record in the middle of the records buffer. This class
+     * instead appends records in section order and replaces any domain 
+     * name suffix that was already written with a compression pointer, as
+     * described in RFC 1035. Names inside NS, CNAME, PTR and MX records are
+     * compressed as well.
+     *
+     * Records must be added in section order: queries, answers, authority
+     * records and then additional records. Adding a record to a section 
+     * that precedes the last one used throws invalid_section_order.
+     *
+     * \code
+     * DNS::message_builder builder;
+     * builder.add_query(DNS::query("www.example.com", DNS::A, DNS::INTERNET));
+     * builder.add_answer(
+     *     DNS::resource("www.example.com", "127.0.0.1", DNS::A, DNS::INTERNET, 60)
+     * );
+     * DNS dns = builder.build();
+     * dns.id(query_id);
+     * dns.type(DNS::RESPONSE);
+     * \endcode 
+     */
+    class TINS_API message_builder {
+    public:
+        /**
+         * \brief Default constructor.
+         */
+        message_builder();
+
+        /**
+         * \brief Adds a query.
+         *
+         * \param query The query to be added.
+         */
+        void add_query(const query& query);
+
+        /**
+         * \brief Adds an answer.
+         *
+         * \param resource The resource to be added.
+         */
+        void add_answer(const resource& resource);
+
+        /**
+         * \brief Adds an authority record.
+         *
+         * \param resource The resource to be added.
+         */
+        void add_authority(const resource& resource);
+
+        /**
+         * \brief Adds an additional record.
+         *
+         * \param resource The resource to be added.
+         */
+        void add_additional(const resource& resource);
+
+        /**
+         * \brief Constructs a DNS PDU holding the records added so far.
+         *
+         * All header fields other than the record counts are set to 0.
+         */
+        DNS build() const;
+
+        /**
+         * \brief Removes all records added so far.
+         */
+        void clear();
+
+        /**
+         * \brief Retrieves the size of the records added so far.
+         */
+        size_t size() const {
+            return records_data_.size();
+        }
+    private:
+        enum {
+            QUESTIONS_SECTION,
+            ANSWERS_SECTION,
+            AUTHORITY_SECTION,
+            ADDITIONAL_SECTION,
+            SECTIONS_COUNT
+        };
+
+        // Maps the offset of the suffix that follows a label and the label's 
+        // hash to the offsets where that label was written
+        #if TINS_IS_CXX11
+            typedef std::unordered_multimap<uint64_t, uint16_t> suffixes_type;
+        #else
+            typedef std::multimap<uint64_t, uint16_t> suffixes_type;
+        #endif // TINS_IS_CXX11
+
+        void start_section(uint32_t section);
+        void add_record(const resource& resource, uint32_t section);
+        void write_name(const std::string& name);
+        bool find_suffix(uint16_t parent, const std::string& name, size_t label_start,
+                         size_t label_end, uint16_t& offset) const;
+
+        byte_array records_data_;
+        suffixes_type suffixes_;
+        uint32_t section_starts_[SECTIONS_COUNT];
+        uint16_t counts_[SECTIONS_COUNT];
+        uint32_t section_;
+    };
+
     TINS_DEPRECATED(typedef query Query);
     TINS_DEPRECATED(typedef resource Resource);
     
@@ -1037,7 +1400,7 @@ private:
                          resources_type& res) const;
     void skip_to_section_end(Memory::InputMemoryStream& stream, 
                              const uint32_t num_records) const;
-    void skip_to_dname_end(Memory::InputMemoryStream& stream) const;
+    static void skip_to_dname_end(Memory::InputMemoryStream& stream);
     void update_records(uint32_t& section_start, 
                         uint32_t num_records,
                         uint32_t threshold,
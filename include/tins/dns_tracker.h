@@ -0,0 +1,464 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef TINS_DNS_TRACKER_H
+#define TINS_DNS_TRACKER_H
+
+#include <tins/cxxstd.h>
+
+#if TINS_IS_CXX11
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <chrono>
+#include <stdint.h>
+#include <tins/macros.h>
+#include <tins/ip_address.h>
+#include <tins/ipv6_address.h>
+
+namespace Tins {
+
+class PDU;
+class Packet;
+
+/**
+ * \brief Matches DNS queries to their responses and measures their latency.
+ *
+ * Queries and responses are matched using the DNS identifier, the
+ * client and server addresses and ports, and the first question in
+ * the message. Both DNS PDUs and raw UDP payloads are supported, the
+ * latter being read without allocating any PDUs.
+ *
+ * \code
+ * DNSTransactionTracker tracker;
+ * Sniffer sniffer = ...;
+ * sniffer.sniff_loop([&](Packet& packet) {
+ *     tracker.process(packet);
+ *     return true;
+ * });
+ * const DNSTransactionTracker::statistics& stats = tracker.stats();
+ * \endcode 
+ *
+ * Pending queries are kept in a hash table bounded by 
+ * DNSTransactionTracker::max_pending_queries. Queries that don't get a 
+ * response within the configured timeout are expired using a timing 
+ * wheel and accounted as unanswered.
+ *
+ * A tracker is not thread safe. In order to process traffic using several 
+ * threads, create one tracker per thread, dispatch each packet to the 
+ * tracker at index DNSTransactionTracker::shard and combine their 
+ * statistics using DNSTransactionTracker::statistics::merge. Queries and 
+ * their responses are always dispatched to the same shard.
+ */
+class TINS_API DNSTransactionTracker {
+public:
+    /**
+     * The type used to represent timestamps
+     */
+    typedef std::chrono::microseconds timestamp_type;
+
+    /**
+     * The status of each processed packet.
+     */
+    enum PacketStatus {
+        NOT_DNS, ///< The packet doesn't contain a DNS message over UDP
+        QUERY, ///< The packet is a query which is now being tracked
+        DUPLICATE_QUERY, ///< The packet is a query which was already being tracked
+        DROPPED_QUERY, ///< The packet is a query but too many queries are pending
+        RESPONSE, ///< The packet is a response to a tracked query
+        UNMATCHED_RESPONSE ///< The packet is a response to an unknown query
+    };
+
+    /**
+     * \brief A latency histogram using power of two buckets.
+     *
+     * Bucket 0 holds latencies below 2 microseconds, while bucket i holds 
+     * latencies in the range [2^i, 2^(i+1)) microseconds. The last bucket 
+     * also holds any latency above that range.
+     */
+    class TINS_API latency_histogram {
+    public:
+        /**
+         * The number of buckets in the histogram.
+         */
+        static const size_t BUCKET_COUNT = 32;
+
+        /**
+         * \brief Default constructs an empty histogram.
+         */
+        latency_histogram();
+
+        /**
+         * \brief Adds a latency sample.
+         *
+         * \param latency The latency to add.
+         */
+        void add(const timestamp_type& latency);
+
+        /**
+         * \brief Adds all of the samples in another histogram to this one.
+         *
+         * \param other The histogram to merge.
+         */
+        void merge(const latency_histogram& other);
+
+        /**
+         * \brief Getter for the number of samples in the given bucket.
+         *
+         * \param index The index of the bucket, less than BUCKET_COUNT.
+         */
+        uint64_t bucket(size_t index) const {
+            return buckets_[index];
+        }
+
+        /**
+         * \brief Getter for the exclusive upper bound of the given bucket.
+         *
+         * \param index The index of the bucket, less than BUCKET_COUNT.
+         */
+        static timestamp_type bucket_upper_bound(size_t index);
+
+        /**
+         * \brief Getter for the number of samples.
+         */
+        uint64_t count() const {
+            return count_;
+        }
+
+        /**
+         * \brief Getter for the lowest latency, 0 if there are no samples.
+         */
+        timestamp_type min() const;
+
+        /**
+         * \brief Getter for the highest latency, 0 if there are no samples.
+         */
+        timestamp_type max() const;
+
+        /**
+         * \brief Getter for the average latency, 0 if there are no samples.
+         */
+        timestamp_type mean() const;
+
+        /**
+         * \brief Estimates the latency below which the given fraction of
+         * the samples fall.
+         *
+         * The result is the upper bound of the bucket in which the 
+         * percentile lies, capped at the highest latency seen.
+         *
+         * \param fraction The fraction of samples, in the range [0, 1].
+         */
+        timestamp_type percentile(double fraction) const;
+    private:
+        uint64_t buckets_[BUCKET_COUNT];
+        uint64_t count_;
+        uint64_t total_;
+        uint64_t min_;
+        uint64_t max_;
+    };
+
+    /**
+     * \brief The statistics for a group of queries.
+     */
+    struct query_statistics {
+        /**
+         * \brief Default constructor.
+         */
+        query_statistics() : unanswered(0) { }
+
+        /**
+         * \brief Adds the statistics in another group to this one.
+         *
+         * \param other The statistics to merge.
+         */
+        void merge(const query_statistics& other) {
+            latency.merge(other.latency);
+            unanswered += other.unanswered;
+        }
+
+        /**
+         * The latencies of the answered queries.
+         */
+        latency_histogram latency;
+
+        /**
+         * The number of queries that expired without a response.
+         */
+        uint64_t unanswered;
+    };
+
+    /**
+     * \brief The statistics gathered by a tracker.
+     */
+    struct TINS_API statistics {
+        /**
+         * The type used to store the statistics per IPv4 server.
+         */
+        typedef std::unordered_map<IPv4Address, query_statistics> ipv4_servers_type;
+
+        /**
+         * The type used to store the statistics per IPv6 server.
+         */
+        typedef std::unordered_map<IPv6Address, query_statistics> ipv6_servers_type;
+
+        /**
+         * The type used to store the statistics per query type.
+         */
+        typedef std::unordered_map<uint16_t, query_statistics> query_types_type;
+
+        /**
+         * \brief Default constructor.
+         */
+        statistics();
+
+        /**
+         * \brief Adds the statistics in another object to this one.
+         *
+         * This can be used to combine the statistics of several shards.
+         *
+         * \param other The statistics to merge.
+         */
+        void merge(const statistics& other);
+
+        /**
+         * The statistics of all of the queries.
+         */
+        query_statistics total;
+
+        /**
+         * The statistics for each IPv4 server.
+         */
+        ipv4_servers_type ipv4_servers;
+
+        /**
+         * The statistics for each IPv6 server.
+         */
+        ipv6_servers_type ipv6_servers;
+
+        /**
+         * The statistics for each query type.
+         */
+        query_types_type query_types;
+
+        /**
+         * The number of queries processed, including duplicates and 
+         * dropped ones.
+         */
+        uint64_t queries;
+
+        /**
+         * The number of retransmitted queries.
+         */
+        uint64_t duplicate_queries;
+
+        /**
+         * The number of queries dropped because too many were pending.
+         */
+        uint64_t dropped_queries;
+
+        /**
+         * The number of responses that didn't match any pending query.
+         */
+        uint64_t unmatched_responses;
+    };
+
+    /**
+     * The default timeout for pending queries, 5 seconds
+     */
+    static const timestamp_type DEFAULT_TIMEOUT;
+
+    /**
+     * The default maximum number of pending queries
+     */
+    static const size_t DEFAULT_MAX_PENDING_QUERIES;
+
+    /**
+     * The default DNS server port
+     */
+    static const uint16_t DEFAULT_SERVER_PORT;
+
+    /**
+     * \brief Computes the shard a packet should be processed by.
+     *
+     * The result only depends on the addresses and ports in the packet, 
+     * regardless of their direction, so a query and its response are 
+     * assigned the same shard. Packets that don't contain an IP and a UDP 
+     * layer are assigned shard 0.
+     *
+     * \param pdu The PDU to inspect.
+     * \param shard_count The number of shards. Must be greater than 0.
+     * \return The index of the shard, in the range [0, shard_count).
+     */
+    static size_t shard(const PDU& pdu, size_t shard_count);
+
+    /**
+     * Default constructor
+     */
+    DNSTransactionTracker();
+
+    /**
+     * \brief Processes a PDU captured at the current time.
+     *
+     * \param pdu The PDU to process.
+     * \sa DNSTransactionTracker::process(PDU&, const timestamp_type&)
+     */
+    PacketStatus process(const PDU& pdu);
+
+    /**
+     * \brief Processes a packet.
+     *
+     * The packet's timestamp is used both to measure latencies and 
+     * to expire pending queries.
+     * 
+     * \param packet The packet to process.
+     */
+    PacketStatus process(const Packet& packet);
+
+    /**
+     * \brief Processes a PDU captured at the given time.
+     *
+     * Only messages sent to or from the configured server port are 
+     * considered. Malformed messages are ignored.
+     * 
+     * \param pdu The PDU to process.
+     * \param ts The time at which the PDU was captured.
+     * \return The status of the processed packet.
+     */
+    PacketStatus process(const PDU& pdu, const timestamp_type& ts);
+
+    /**
+     * \brief Expires any queries pending for longer than the timeout.
+     *
+     * This is performed automatically while processing packets, but can 
+     * be used to expire queries while there's no traffic.
+     *
+     * \param now The current time.
+     */
+    void advance(const timestamp_type& now);
+
+    /**
+     * \brief Sets the maximum time to wait for a response
+     *
+     * \param value The timeout to use
+     */
+    template <typename Rep, typename Period>
+    void timeout(const std::chrono::duration<Rep, Period>& value) {
+        set_timeout(std::chrono::duration_cast<timestamp_type>(value));
+    }
+
+    /**
+     * \brief Sets the maximum number of pending queries
+     *
+     * Queries processed while this many are pending are dropped. A value 
+     * of 0 disables this cap.
+     *
+     * \param value The maximum number of pending queries
+     */
+    void max_pending_queries(size_t value);
+
+    /**
+     * \brief Sets the UDP port DNS servers listen on
+     *
+     * \param value The port to use
+     */
+    void server_port(uint16_t value);
+
+    /**
+     * \brief Retrieves the number of queries waiting for a response
+     */
+    size_t pending_queries() const;
+
+    /**
+     * \brief Retrieves the statistics gathered so far
+     */
+    const statistics& stats() const;
+
+    /**
+     * \brief Removes all pending queries and resets the statistics.
+     */
+    void clear();
+private:
+    struct key_type {
+        bool operator==(const key_type& rhs) const;
+
+        IPv6Address client;
+        IPv6Address server;
+        std::string name;
+        uint16_t id;
+        uint16_t client_port;
+        uint16_t server_port;
+        uint16_t query_type;
+        uint16_t query_class;
+        bool is_ipv6;
+    };
+
+    struct key_hash {
+        size_t operator()(const key_type& key) const;
+    };
+
+    // Each pending query knows where it's stored in the timing wheel, 
+    // so it can be unscheduled in constant time once it's answered
+    struct pending_query {
+        timestamp_type sent;
+        timestamp_type deadline;
+        size_t slot;
+        size_t position;
+    };
+
+    typedef std::unordered_map<key_type, pending_query, key_hash> queries_type;
+    typedef std::vector<queries_type::value_type*> wheel_slot_type;
+
+    static const size_t WHEEL_SLOTS;
+
+    bool parse_message(const PDU& pdu, key_type& key, bool& is_response) const;
+    void set_timeout(const timestamp_type& value);
+    void schedule(queries_type::value_type& entry);
+    void unschedule(queries_type::value_type& entry);
+    void expire_slot(wheel_slot_type& slot, const timestamp_type& now);
+    query_statistics& server_stats(const key_type& key);
+    int64_t tick_of(const timestamp_type& ts) const;
+
+    queries_type queries_;
+    std::vector<wheel_slot_type> wheel_;
+    key_type lookup_key_;
+    statistics stats_;
+    timestamp_type timeout_;
+    timestamp_type tick_;
+    int64_t current_tick_;
+    size_t max_pending_queries_;
+    uint16_t server_port_;
+    bool started_;
+};
+
+} // Tins
+
+#endif // TINS_IS_CXX11
+
+#endif // TINS_DNS_TRACKER_H
@@ -39,6 +39,7 @@
 #include <tins/endianness.h>
 #include <tins/cxxstd.h>
 #include <tins/macros.h>
+#include <tins/detail/option_helpers.h>
 
 namespace Tins {
 namespace Memory {
@@ -449,7 +450,7 @@ public:
          */
         void add_option(option &&opt) {
             internal_add_option(opt);
-            options_.push_back(std::move(opt));
+            options_.get_mutable().push_back(std::move(opt));
         }
     #endif
 
@@ -504,7 +505,7 @@ public:
      * \return The options list.
      */
     const options_type& options() const {
-        return options_;
+        return options_.get();
     }
 
     /**
@@ -527,6 +528,7 @@ protected:
     virtual void write_fixed_parameters(Memory::OutputMemoryStream& stream);
     void parse_tagged_parameters(Memory::InputMemoryStream& stream);
     void add_tagged_option(OptionTypes opt, uint8_t len, const uint8_t* val);
+    const option* search_option(OptionTypes type, option& storage) const;
 protected:
     /**
      * Struct that represents the 802.11 header
@@ -576,7 +578,7 @@ private:
 
     dot11_header header_;
     uint32_t options_size_;
-    options_type options_;
+    Internals::LazyOptionList<option, Internals::DOT11_OPTION_LAYOUT> options_;
 };
 
 } // Tins
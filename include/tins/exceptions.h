@@ -262,6 +262,14 @@ public:
     invalid_domain_name() : exception_base("Invalid domain name") { }
 };
 
+/**
+ * \brief Exception thrown when DNS records are not added in section order
+ */
+class invalid_section_order : public exception_base {
+public:
+    invalid_section_order() : exception_base("Invalid section order") { }
+};
+
 /**
  * \brief Exception thrown when a stream is not found
  */
@@ -270,6 +278,15 @@ public:
     stream_not_found() : exception_base("Stream not found") { }
 };
 
+/**
+ * \brief Exception thrown when restoring the state of a TCP stream follower
+ * from an invalid snapshot
+ */
+class invalid_stream_snapshot : public exception_base {
+public:
+    invalid_stream_snapshot() : exception_base("Invalid stream snapshot") { }
+};
+
 /**
  * \brief Exception thrown when a required callback for an object is not set
  */
@@ -286,6 +303,23 @@ public:
     invalid_packet() : exception_base("Invalid packet") { }
 };
 
+/**
+ * \brief Exception thrown when writing packets to a file fails
+ */
+class file_write_error : public exception_base {
+public:
+    file_write_error(const std::string& message) : exception_base(message) { }
+};
+
+/**
+ * \brief Exception thrown when a pcap or pcap index file can't be read or
+ * is malformed
+ */
+class invalid_pcap_file : public exception_base {
+public:
+    invalid_pcap_file() : exception_base("Invalid pcap file") { }
+};
+
 namespace Crypto {
 namespace WPA2 {
     /**
@@ -295,6 +329,14 @@ namespace WPA2 {
     public:
         invalid_handshake() : exception_base("Invalid WPA2 handshake") { }
     };
+
+    /**
+     * \brief Exception thrown when a PMK cache file can't be loaded.
+     */
+    class invalid_pmk_cache : public exception_base {
+    public:
+        invalid_pmk_cache() : exception_base("Invalid PMK cache") { }
+    };
 } // WPA2
 } // Crypto
 
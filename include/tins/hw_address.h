@@ -34,6 +34,7 @@
 #include <iosfwd>
 #include <string>
 #include <cstring>
+#include <algorithm>
 #include <tins/cxxstd.h>
 #include <tins/macros.h>
 #if TINS_IS_CXX11
@@ -50,9 +51,15 @@ namespace Internals {
  */
 TINS_API std::string hw_address_to_string(const uint8_t* ptr, size_t count);
 
+TINS_API size_t hw_address_to_chars(const uint8_t* ptr, size_t count,
+                                    char* buffer, size_t size);
+
 TINS_API void string_to_hw_address(const std::string& hw_addr, uint8_t* output,
                                    size_t output_size);
 
+TINS_API void string_to_hw_address(const char* first, const char* last,
+                                   uint8_t* output, size_t output_size);
+
 TINS_API bool hw_address_equal_compare(const uint8_t* start1, const uint8_t* end1,
                                       const uint8_t* start2);
 
@@ -108,6 +115,12 @@ public:
      */
     static const size_t address_size = n;
 
+    /**
+     * \brief The length of the hex-notation representation of an 
+     * address, not including the null terminator.
+     */
+    static const size_t max_string_length = n * 3 - 1;
+
     /**
      * \brief The broadcast address.
      */
@@ -167,7 +180,8 @@ public:
      */
     template<size_t i>
     HWAddress(const char (&address)[i]) {
-        Internals::string_to_hw_address(address, buffer_, n);
+        Internals::string_to_hw_address(address, std::find(address, address + i, '\0'),
+                                        buffer_, n);
     }
     
     /**
@@ -321,6 +335,22 @@ public:
         return Internals::hw_address_to_string(buffer_, size());
     }
 
+    /**
+     * \brief Writes the hex-notation representation of this address
+     * into a buffer.
+     *
+     * No null terminator is written. A buffer of max_string_length 
+     * bytes is always large enough to hold the representation.
+     *
+     * \param buffer The buffer in which to write the address.
+     * \param size The size of the buffer.
+     * \return The number of characters written, or 0 if the buffer
+     * is too small.
+     */
+    size_t to_chars(char* buffer, size_t size) const {
+        return Internals::hw_address_to_chars(buffer_, n, buffer, size);
+    }
+
     /**
      * \brief Retrieves the i-th storage_type in this address.
      *
@@ -41,6 +41,7 @@
 #include <tins/small_uint.h>
 #include <tins/icmp_extension.h>
 #include <tins/cxxstd.h>
+#include <tins/detail/option_helpers.h>
 
 namespace Tins {
 namespace Memory {
@@ -748,7 +749,7 @@ public:
      *  \return The stored options.
      */
     const options_type& options() const {
-        return options_;
+        return options_.get();
     }
 
     /**
@@ -1014,7 +1015,7 @@ public:
          */
         void add_option(option &&option) {
             internal_add_option(option);
-            options_.push_back(std::move(option));
+            options_.get_mutable().push_back(std::move(option));
         }
     #endif
 
@@ -1582,7 +1583,8 @@ private:
 
     template <typename T>
     T search_and_convert(OptionTypes type) const {
-        const option* opt = search_option(type);
+        option storage;
+        const option* opt = options_.search(type, storage);
         if (!opt) {
             throw option_not_found();
         }
@@ -1593,7 +1595,7 @@ private:
     ipaddress_type target_address_;
     ipaddress_type dest_address_;
     ipaddress_type multicast_address_;
-    options_type options_;
+    Internals::LazyOptionList<option, Internals::ICMPV6_OPTION_LAYOUT> options_;
     uint32_t options_size_;
     uint32_t reach_time_, retrans_timer_;
     multicast_address_records_list multicast_records_;
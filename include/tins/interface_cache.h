@@ -0,0 +1,310 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TINS_INTERFACE_CACHE_H
+#define TINS_INTERFACE_CACHE_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <ctime>
+#include <tins/macros.h>
+#include <tins/cxxstd.h>
+#include <tins/network_interface.h>
+#if TINS_IS_CXX11
+    #include <mutex>
+    #include <memory>
+#endif // TINS_IS_CXX11
+
+namespace Tins {
+
+/**
+ * \brief An immutable copy of the metadata of every network interface.
+ *
+ * A snapshot is taken using InterfaceSnapshot::capture, which enumerates 
+ * the system's interfaces only once. Interfaces can then be looked up by 
+ * name or index without performing any system calls.
+ */
+class TINS_API InterfaceSnapshot {
+public:
+    /**
+     * The interface identifier type.
+     */
+    typedef NetworkInterface::id_type id_type;
+
+    /**
+     * The metadata stored for each interface.
+     */
+    struct entry_type {
+        /**
+         * The interface's index.
+         */
+        id_type id;
+
+        /**
+         * The interface's name.
+         */
+        std::string name;
+
+        /**
+         * The interface's friendly name. This is only different from the 
+         * name on Windows.
+         */
+        std::wstring friendly_name;
+
+        /**
+         * The interface's addresses and status.
+         */
+        NetworkInterface::Info info;
+
+        /**
+         * Indicates whether either a hardware or IP address was found for 
+         * this interface.
+         */
+        bool has_addresses;
+    };
+
+    /**
+     * The type used to store the entries.
+     */
+    typedef std::vector<entry_type> entries_type;
+
+    /**
+     * \brief Takes a snapshot of the system's network interfaces.
+     */
+    static InterfaceSnapshot capture();
+
+    /**
+     * \brief Constructs an empty snapshot.
+     */
+    InterfaceSnapshot();
+
+    /**
+     * \brief Constructs a snapshot out of the given entries.
+     *
+     * \param entries The interfaces in this snapshot.
+     */
+    explicit InterfaceSnapshot(const entries_type& entries);
+
+    /**
+     * \brief Finds an interface by index.
+     *
+     * \param id The interface's index.
+     * \return A pointer to the interface's entry or a null pointer if 
+     * it's not found.
+     */
+    const entry_type* find(id_type id) const;
+
+    /**
+     * \brief Finds an interface by name.
+     *
+     * \param name The interface's name.
+     * \return A pointer to the interface's entry or a null pointer if 
+     * it's not found.
+     */
+    const entry_type* find(const std::string& name) const;
+
+    /**
+     * \brief Returns every interface in this snapshot, sorted by name.
+     */
+    const entries_type& interfaces() const;
+
+    /**
+     * \brief Returns the number of interfaces in this snapshot.
+     */
+    size_t size() const;
+private:
+    entries_type entries_;
+    std::map<id_type, size_t> ids_;
+    std::map<std::string, size_t> names_;
+};
+
+/**
+ * \brief Keeps an up to date InterfaceSnapshot.
+ *
+ * NetworkInterface used to enumerate every interface in the system each
+ * time its addresses, status or name were requested. Instead, it now uses
+ * the process wide cache returned by Utils::interface_cache. So do 
+ * NetworkInterface::all and Utils::network_interfaces and, through them, 
+ * PacketSender and the routing utilities.
+ *
+ * The snapshot is taken again whenever it's used after a link or address 
+ * change notification is received. These are only supported on Linux. On 
+ * other platforms, or if notifications can't be received, it is taken 
+ * again once it's older than InterfaceCache::max_age seconds. In that case,
+ * looking up an interface which is not in the snapshot also causes it to be
+ * taken again, at most once every InterfaceCache::MISS_REFRESH_INTERVAL 
+ * seconds, so newly created interfaces are found without every failed 
+ * lookup enumerating the system's interfaces.
+ *
+ * When compiling using C++11, every method in this class is thread safe and
+ * snapshots are shared rather than copied.
+ */
+class TINS_API InterfaceCache {
+public:
+    /**
+     * The interface identifier type.
+     */
+    typedef InterfaceSnapshot::id_type id_type;
+
+    /**
+     * The interface entry type.
+     */
+    typedef InterfaceSnapshot::entry_type entry_type;
+
+    #if TINS_IS_CXX11
+        /**
+         * The type used to hand out snapshots. Snapshots are never modified 
+         * once taken, so they can be shared with the cache.
+         */
+        typedef std::shared_ptr<const InterfaceSnapshot> snapshot_ptr;
+    #else
+        /**
+         * The type used to hand out snapshots. There are no shared pointers
+         * in C++03, so this holds a copy of the snapshot.
+         */
+        class snapshot_ptr {
+        public:
+            snapshot_ptr() { }
+            snapshot_ptr(const InterfaceSnapshot& snapshot) : snapshot_(snapshot) { }
+            const InterfaceSnapshot& operator*() const { return snapshot_; }
+            const InterfaceSnapshot* operator->() const { return &snapshot_; }
+        private:
+            InterfaceSnapshot snapshot_;
+        };
+    #endif // TINS_IS_CXX11
+
+    /**
+     * The default amount of seconds a snapshot is considered valid for when
+     * change notifications are not available.
+     */
+    static const unsigned DEFAULT_MAX_AGE;
+
+    /**
+     * The minimum amount of seconds between snapshots taken because an 
+     * interface wasn't found.
+     */
+    static const unsigned MISS_REFRESH_INTERVAL;
+
+    /**
+     * \brief Constructs an interface cache.
+     *
+     * No snapshot is taken until the cache is first used.
+     */
+    InterfaceCache();
+
+    /**
+     * \brief Destructor.
+     */
+    ~InterfaceCache();
+
+    /**
+     * \brief Starts listening for link and address change notifications.
+     *
+     * \return true iff change notifications are supported and could be 
+     * enabled.
+     */
+    bool watch();
+
+    /**
+     * \brief Returns the current snapshot.
+     *
+     * The snapshot stays valid, and unchanged, after the cache takes a new 
+     * one.
+     */
+    snapshot_ptr snapshot();
+
+    /**
+     * \brief Finds an interface by index.
+     *
+     * \param id The interface's index.
+     * \param entry This parameter will contain the interface's entry if 
+     * it's found.
+     * \return true iff the interface was found.
+     */
+    bool find(id_type id, entry_type& entry);
+
+    /**
+     * \brief Finds an interface by name.
+     *
+     * \param name The interface's name.
+     * \param entry This parameter will contain the interface's entry if 
+     * it's found.
+     * \return true iff the interface was found.
+     */
+    bool find(const std::string& name, entry_type& entry);
+
+    /**
+     * \brief Makes the next use of this cache take a new snapshot.
+     */
+    void invalidate();
+
+    /**
+     * \brief Sets the amount of seconds after which a new snapshot is taken
+     * when change notifications are not available.
+     */
+    void max_age(unsigned value);
+
+    /**
+     * \brief Getter for the maximum age of the snapshot, in seconds.
+     */
+    unsigned max_age() const;
+private:
+    InterfaceCache(const InterfaceCache&);
+    InterfaceCache& operator=(const InterfaceCache&);
+
+    void sync();
+    void refresh();
+    bool refresh_on_miss();
+    bool process_notifications();
+    void close_notifications();
+
+    snapshot_ptr snapshot_;
+    std::time_t taken_at_;
+    unsigned max_age_;
+    int notifications_fd_;
+    bool valid_;
+    #if TINS_IS_CXX11
+        mutable std::mutex mutex_;
+    #endif // TINS_IS_CXX11
+};
+
+namespace Utils {
+
+/**
+ * \brief Returns the process wide InterfaceCache.
+ *
+ * This is the cache used by NetworkInterface.
+ */
+TINS_API InterfaceCache& interface_cache();
+
+} // Utils
+} // Tins
+
+#endif // TINS_INTERFACE_CACHE_H
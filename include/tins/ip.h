@@ -37,6 +37,7 @@
 #include <tins/pdu_option.h>
 #include <tins/macros.h>
 #include <tins/cxxstd.h>
+#include <tins/detail/option_helpers.h>
 
 namespace Tins {
 namespace Memory {
@@ -409,7 +410,7 @@ public:
      * \return The stored options.
      */
     const options_type& options() const {
-        return options_;
+        return options_.get();
     }
 
     /* Setters */
@@ -523,7 +524,7 @@ public:
          * \param opt The option to be added.
          */
         void add_option(option &&opt) {
-            options_.push_back(std::move(opt));
+            options_.get_mutable().push_back(std::move(opt));
         }
 
         /**
@@ -536,7 +537,7 @@ public:
          */
         template<typename... Args>
         void add_option(Args&&... args) {
-            options_.emplace_back(std::forward<Args>(args)...);
+            options_.get_mutable().emplace_back(std::forward<Args>(args)...);
         }
     #endif
 
@@ -765,7 +766,7 @@ private:
     options_type::const_iterator search_option_iterator(option_identifier id) const;
     options_type::iterator search_option_iterator(option_identifier id);
 
-    options_type options_;
+    Internals::LazyOptionList<option, Internals::IP_OPTION_LAYOUT> options_;
     ip_header header_;
 };
 
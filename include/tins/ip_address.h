@@ -49,6 +49,12 @@ public:
      */
     static const size_t address_size = sizeof(uint32_t);
 
+    /**
+     * The maximum length of the dotted-notation representation of an
+     * address, not including the null terminator.
+     */
+    static const size_t max_string_length = 15;
+
     /**
      * The broadcast address.
      */
@@ -61,6 +67,20 @@ public:
      */
     static IPv4Address from_prefix_length(uint32_t prefix_length);
 
+    /**
+     * \brief Parses a dotted-notation address without allocating memory.
+     *
+     * The range [first, last) must contain exactly 4 decimal octets
+     * separated by dots. This accepts the same inputs as inet_pton.
+     *
+     * \param first The beginning of the character range to be parsed.
+     * \param last The end of the character range to be parsed.
+     * \param output The address in which to store the result.
+     * \return true iff the range contained a valid address, in which
+     * case output is modified.
+     */
+    static bool from_chars(const char* first, const char* last, IPv4Address& output);
+
     /**
      * \brief Constructor taking a const char*.
      * 
@@ -103,6 +123,20 @@ public:
      * \return std::string containing the representation of this address.
      */
     std::string to_string() const;
+
+    /**
+     * \brief Writes the dotted-notation representation of this address
+     * into a buffer.
+     *
+     * No null terminator is written. A buffer of max_string_length
+     * bytes is always large enough to hold the representation.
+     *
+     * \param buffer The buffer in which to write the address.
+     * \param size The size of the buffer.
+     * \return The number of characters written, or 0 if the buffer
+     * is too small.
+     */
+    size_t to_chars(char* buffer, size_t size) const;
     
     /**
      * \brief Compare this IPv4Address for equality.
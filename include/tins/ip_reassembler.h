@@ -32,60 +32,40 @@
 
 #include <vector>
 #include <map>
+#include <tins/cxxstd.h>
 #include <tins/pdu.h>
 #include <tins/macros.h>
 #include <tins/ip_address.h>
 #include <tins/ip.h>
+#include <tins/detail/reassembly_helpers.h>
 
 namespace Tins {
 
+class Packet;
+
 /** 
  * \cond
  */
 namespace Internals {
-class IPv4Fragment {
-public:
-    typedef PDU::serialization_type payload_type;
-
-    IPv4Fragment() : offset_() { }
-
-    template<typename T>
-    IPv4Fragment(T* pdu, uint16_t offset)
-    : payload_(pdu->serialize()), offset_(offset) {
-        
-    }
-    
-    const payload_type& payload() const {
-        return payload_;
-    }
-    
-    uint16_t offset() const {
-        return offset_;
-    }
-private:
-    payload_type payload_;
-    uint16_t offset_;
-};
-
 class TINS_API IPv4Stream {
 public:
-    IPv4Stream();
+    // Timestamps are stored as microseconds
+    IPv4Stream(IPv4Address source = IPv4Address(), uint64_t first_seen = 0);
     
-    void add_fragment(IP* ip);
+    bool add_fragment(IP* ip);
     bool is_complete() const;
     PDU* allocate_pdu() const;
     const IP& first_fragment() const;
+    size_t buffered_bytes() const;
+    uint64_t first_seen() const;
+    IPv4Address source() const;
 private:
-    typedef std::vector<IPv4Fragment> fragments_type;
-    
     uint16_t extract_offset(const IP* ip);
-    bool extract_more_frag(const IP* ip);
 
-    fragments_type fragments_;
-    size_t received_size_;
-    size_t total_size_;
+    DatagramBuffer buffer_;
+    uint64_t first_seen_;
+    IPv4Address source_;
     IP first_fragment_;
-    bool received_end_;
 };
 } // namespace Internals
 
@@ -116,6 +96,16 @@ private:
  *     }
  * });
  * \endcode 
+ *
+ * Each fragment's payload is copied once into a buffer holding the whole 
+ * datagram, while the missing ranges are tracked using RFC 815 hole 
+ * descriptors. When fragments overlap, the data that arrived first is kept.
+ *
+ * In order to bound memory usage, incomplete datagrams are discarded after
+ * a timeout (see IPv4Reassembler::timeout) and the amount of bytes buffered
+ * both in total and by each source address is capped. Whenever the global
+ * cap is exceeded, the oldest datagrams are discarded. Fragments that would
+ * make a source exceed its own cap cause that datagram to be discarded.
  */
 class TINS_API IPv4Reassembler {
 public:
@@ -138,6 +128,27 @@ public:
         NONE 
     };
 
+    /**
+     * The type used to represent timestamps. This is std::chrono::microseconds
+     * when C++11 is enabled and Timestamp otherwise.
+     */
+    typedef Internals::reassembly_timestamp_type timestamp_type;
+
+    /**
+     * The default timeout for incomplete datagrams, 30 seconds
+     */
+    static const timestamp_type DEFAULT_TIMEOUT;
+
+    /**
+     * The default maximum amount of buffered bytes, 64MB
+     */
+    static const size_t DEFAULT_MAX_BUFFERED_BYTES;
+
+    /**
+     * The default maximum amount of buffered bytes per source address, 8MB
+     */
+    static const size_t DEFAULT_MAX_BUFFERED_BYTES_PER_SOURCE;
+
     /**
      * Default constructor
      */
@@ -167,6 +178,80 @@ public:
      */
     PacketStatus process(PDU& pdu);
 
+    /**
+     * \brief Processes a packet and tries to reassemble it.
+     *
+     * This is the same as IPv4Reassembler::process(PDU&) but the packet's 
+     * timestamp is used to expire incomplete datagrams rather than the 
+     * current time.
+     * 
+     * \param packet The packet to process.
+     * \sa IPv4Reassembler::process(PDU&)
+     */
+    PacketStatus process(Packet& packet);
+
+    /**
+     * \brief Processes a PDU captured at the given time.
+     * 
+     * \param pdu The PDU to process.
+     * \param ts The time at which the PDU was captured.
+     * \sa IPv4Reassembler::process(PDU&)
+     */
+    PacketStatus process(PDU& pdu, const timestamp_type& ts);
+
+    /**
+     * \brief Sets the maximum time to wait for a datagram's fragments
+     *
+     * Datagrams that are not complete after this time will be discarded.
+     *
+     * \param value The timeout to use
+     */
+    #if TINS_IS_CXX11
+    template <typename Rep, typename Period>
+    void timeout(const std::chrono::duration<Rep, Period>& value) {
+        table_.timeout(std::chrono::duration_cast<timestamp_type>(value).count());
+    }
+    #else
+    void timeout(const timestamp_type& value);
+    #endif // TINS_IS_CXX11
+
+    /**
+     * \brief Sets the maximum amount of bytes buffered for all datagrams
+     *
+     * A value of 0 disables this cap.
+     *
+     * \param value The maximum amount of buffered bytes
+     */
+    void max_buffered_bytes(size_t value);
+
+    /**
+     * \brief Sets the maximum amount of bytes buffered for datagrams sent 
+     * by a single source address
+     *
+     * A value of 0 disables this cap.
+     *
+     * \param value The maximum amount of buffered bytes per source address
+     */
+    void max_buffered_bytes_per_source(size_t value);
+
+    /**
+     * \brief Retrieves the amount of bytes currently buffered
+     */
+    size_t buffered_bytes() const;
+
+    /**
+     * \brief Retrieves the number of incomplete datagrams being buffered
+     */
+    size_t buffered_datagrams() const;
+
+    /**
+     * \brief Retrieves the number of datagrams discarded so far
+     *
+     * This includes datagrams that timed out, that were discarded because
+     * of the memory caps or because they contained invalid fragments.
+     */
+    uint64_t discarded_datagrams() const;
+
     /**
      * Removes all of the packets and data stored.
      */
@@ -187,12 +272,14 @@ private:
     typedef std::pair<IPv4Address, IPv4Address> address_pair;
     typedef std::pair<uint16_t, address_pair> key_type;
     typedef std::map<key_type, Internals::IPv4Stream> streams_type;
+    typedef std::map<IPv4Address, size_t> source_bytes_type;
+    typedef Internals::ReassemblyTable<streams_type, source_bytes_type> table_type;
 
     key_type make_key(const IP* ip) const;
     address_pair make_address_pair(IPv4Address addr1, IPv4Address addr2) const;
     
-    streams_type streams_;
     OverlappingTechnique technique_;
+    table_type table_;
 };
 
 /**
@@ -45,6 +45,12 @@ class OutputMemoryStream;
 
 } // Memory
 
+namespace Internals {
+
+class IPv6Stream;
+
+} // Internals
+
 class PacketSender;
     
 /**
@@ -182,6 +188,17 @@ public:
         return header_.next_header;
     }
 
+    /**
+     * \brief Getter for the protocol of the payload.
+     *
+     * This is the next header value that follows the extension headers,
+     * or the next_header field if there are none.
+     *  \return The stored upper layer protocol.
+     */
+    uint8_t upper_layer_protocol() const {
+        return next_header_;
+    }
+
     /**
      * \brief Getter for the hop_limit field.
      *  \return The stored hop_limit field value.
@@ -351,6 +368,8 @@ public:
      */
     const ext_header* search_header(ExtensionHeader id) const;
 private:
+    friend class Internals::IPv6Stream;
+
     void write_serialization(uint8_t* buffer, uint32_t total_sz);
     void set_last_next_header(uint8_t value);
     uint32_t calculate_headers_size() const;
@@ -45,6 +45,12 @@ namespace Tins {
 class TINS_API IPv6Address {
 public:
     static const size_t address_size = 16;
+
+    /**
+     * The maximum length of the text representation of an address, not
+     * including the null terminator.
+     */
+    static const size_t max_string_length = 45;
     
     /**
      * The iterator type.
@@ -63,6 +69,21 @@ public:
      */
     static IPv6Address from_prefix_length(uint32_t prefix_length);
 
+    /**
+     * \brief Parses a text representation address without allocating
+     * memory.
+     *
+     * Both "::" compression and trailing dotted-notation IPv4 addresses
+     * are supported. This accepts the same inputs as inet_pton.
+     *
+     * \param first The beginning of the character range to be parsed.
+     * \param last The end of the character range to be parsed.
+     * \param output The address in which to store the result.
+     * \return true iff the range contained a valid address, in which
+     * case output is modified.
+     */
+    static bool from_chars(const char* first, const char* last, IPv6Address& output);
+
     /**
      * \brief Default constructor.
      * Initializes this IPv6 address to "::"
@@ -98,6 +119,21 @@ public:
      * \return std::string containing the representation of this address.
      */
     std::string to_string() const;
+
+    /**
+     * \brief Writes the text representation of this address into a
+     * buffer.
+     *
+     * The output follows RFC 5952 and matches inet_ntop's. No null
+     * terminator is written. A buffer of max_string_length bytes is
+     * always large enough to hold the representation.
+     *
+     * \param buffer The buffer in which to write the address.
+     * \param size The size of the buffer.
+     * \return The number of characters written, or 0 if the buffer
+     * is too small.
+     */
+    size_t to_chars(char* buffer, size_t size) const;
     
     /**
      * Returns an iterator to the beginning of this address.
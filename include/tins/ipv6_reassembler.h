@@ -0,0 +1,282 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TINS_IPV6_REASSEMBLER_H
+#define TINS_IPV6_REASSEMBLER_H
+
+#include <vector>
+#include <tins/cxxstd.h>
+#if TINS_IS_CXX11
+    #include <unordered_map>
+#else
+    #include <map>
+#endif // TINS_IS_CXX11
+#include <tins/pdu.h>
+#include <tins/macros.h>
+#include <tins/ipv6_address.h>
+#include <tins/ipv6.h>
+#include <tins/detail/reassembly_helpers.h>
+
+namespace Tins {
+
+class Packet;
+
+/** 
+ * \cond
+ */
+namespace Internals {
+class TINS_API IPv6Stream {
+public:
+    // Timestamps are stored as microseconds
+    IPv6Stream(const IPv6Address& source = IPv6Address(), uint64_t first_seen = 0);
+    
+    bool add_fragment(IPv6* ipv6, uint16_t offset, bool more_fragments);
+    bool is_complete() const;
+    PDU* allocate_pdu() const;
+    const IPv6& first_fragment() const;
+    size_t buffered_bytes() const;
+    uint64_t first_seen() const;
+    const IPv6Address& source() const;
+private:
+    DatagramBuffer buffer_;
+    uint64_t first_seen_;
+    IPv6Address source_;
+    IPv6 first_fragment_;
+    uint8_t next_header_;
+};
+} // namespace Internals
+
+/** 
+ * \endcond
+ */
+
+/**
+ * \brief Reassembles fragmented IPv6 packets.
+ *
+ * This is the IPv6 counterpart of IPv4Reassembler and is used in the
+ * same way: feed packets into IPv6Reassembler::process and process them
+ * normally unless the return value is IPv6Reassembler::FRAGMENTED.
+ *
+ * \code
+ * IPv6Reassembler reassembler;
+ * Sniffer sniffer = ...;
+ * sniffer.sniff_loop([&](PDU& pdu) {
+ *     if (reassembler.process(pdu) != IPv6Reassembler::FRAGMENTED) {
+ *         process_packet(pdu);
+ *     }
+ *     return true;
+ * });
+ * \endcode 
+ *
+ * Datagrams are identified by their source address, destination address 
+ * and the identification field in the Fragment extension header. Once a 
+ * datagram is reassembled, the IPv6 PDU takes the header and extension 
+ * headers of the first fragment, minus the Fragment header itself.
+ *
+ * Only packets in which the Fragment header is the last extension header 
+ * are supported. Datagrams that contain fragments having extension headers 
+ * after the Fragment header are discarded.
+ *
+ * Incomplete datagrams expire and buffered bytes are capped, both globally 
+ * and per source address, just like IPv4Reassembler does.
+ */
+class TINS_API IPv6Reassembler {
+public:
+    /**
+     * The status of each processed packet.
+     */
+    enum PacketStatus {
+        NOT_FRAGMENTED, ///< The given packet is not fragmented
+        FRAGMENTED, ///< The given packet is fragmented and can't be reassembled yet
+        REASSEMBLED ///< The given packet was fragmented but is now reassembled
+    };
+
+    /**
+     * The type used to represent timestamps
+     */
+    typedef Internals::reassembly_timestamp_type timestamp_type;
+
+    /**
+     * The default timeout for incomplete datagrams, 60 seconds
+     */
+    static const timestamp_type DEFAULT_TIMEOUT;
+
+    /**
+     * The default maximum amount of buffered bytes, 64MB
+     */
+    static const size_t DEFAULT_MAX_BUFFERED_BYTES;
+
+    /**
+     * The default maximum amount of buffered bytes per source address, 8MB
+     */
+    static const size_t DEFAULT_MAX_BUFFERED_BYTES_PER_SOURCE;
+
+    /**
+     * Default constructor
+     */
+    IPv6Reassembler();
+
+    /**
+     * \brief Processes a PDU and tries to reassemble it.
+     *
+     * If the packet is successfully reassembled using previously
+     * processed packets, its contents will be modified so that
+     * it contains the whole payload and not just a fragment.
+     * 
+     * \param pdu The PDU to process.
+     * \return NOT_FRAGMENTED if the PDU does not contain an IPv6
+     * layer or is not fragmented, FRAGMENTED if the packet is 
+     * fragmented or REASSEMBLED if the packet was fragmented 
+     * but has now been reassembled.
+     */
+    PacketStatus process(PDU& pdu);
+
+    /**
+     * \brief Processes a packet and tries to reassemble it.
+     *
+     * The packet's timestamp is used to expire incomplete datagrams 
+     * rather than the current time.
+     * 
+     * \param packet The packet to process.
+     * \sa IPv6Reassembler::process(PDU&)
+     */
+    PacketStatus process(Packet& packet);
+
+    /**
+     * \brief Processes a PDU captured at the given time.
+     * 
+     * \param pdu The PDU to process.
+     * \param ts The time at which the PDU was captured.
+     * \sa IPv6Reassembler::process(PDU&)
+     */
+    PacketStatus process(PDU& pdu, const timestamp_type& ts);
+
+    /**
+     * \brief Sets the maximum time to wait for a datagram's fragments
+     *
+     * \param value The timeout to use
+     */
+    #if TINS_IS_CXX11
+    template <typename Rep, typename Period>
+    void timeout(const std::chrono::duration<Rep, Period>& value) {
+        table_.timeout(std::chrono::duration_cast<timestamp_type>(value).count());
+    }
+    #else
+    void timeout(const timestamp_type& value);
+    #endif // TINS_IS_CXX11
+
+    /**
+     * \brief Sets the maximum amount of bytes buffered for all datagrams
+     *
+     * A value of 0 disables this cap.
+     *
+     * \param value The maximum amount of buffered bytes
+     */
+    void max_buffered_bytes(size_t value);
+
+    /**
+     * \brief Sets the maximum amount of bytes buffered for datagrams sent 
+     * by a single source address
+     *
+     * A value of 0 disables this cap.
+     *
+     * \param value The maximum amount of buffered bytes per source address
+     */
+    void max_buffered_bytes_per_source(size_t value);
+
+    /**
+     * \brief Retrieves the amount of bytes currently buffered
+     */
+    size_t buffered_bytes() const;
+
+    /**
+     * \brief Retrieves the number of incomplete datagrams being buffered
+     */
+    size_t buffered_datagrams() const;
+
+    /**
+     * \brief Retrieves the number of datagrams discarded so far
+     */
+    uint64_t discarded_datagrams() const;
+
+    /**
+     * Removes all of the packets and data stored.
+     */
+    void clear_streams();
+
+    /**
+     * \brief Removes the datagram identified by the given fragment 
+     * identifier, source and destination addresses.
+     * 
+     * \param id The fragment identifier.
+     * \param src The source address.
+     * \param dst The destination address.
+     */
+    void remove_stream(uint32_t id, const IPv6Address& src, const IPv6Address& dst);
+private:
+    struct key_type {
+        key_type(uint32_t id, const IPv6Address& src, const IPv6Address& dst)
+        : id(id), src(src), dst(dst) { }
+
+        bool operator==(const key_type& rhs) const {
+            return id == rhs.id && src == rhs.src && dst == rhs.dst;
+        }
+
+        bool operator<(const key_type& rhs) const {
+            if (id != rhs.id) {
+                return id < rhs.id;
+            }
+            return (src != rhs.src) ? (src < rhs.src) : (dst < rhs.dst);
+        }
+
+        uint32_t id;
+        IPv6Address src;
+        IPv6Address dst;
+    };
+
+    #if TINS_IS_CXX11
+    struct key_hash {
+        size_t operator()(const key_type& key) const;
+    };
+
+    typedef std::unordered_map<key_type, Internals::IPv6Stream, key_hash> streams_type;
+    typedef std::unordered_map<IPv6Address, size_t> source_bytes_type;
+    #else
+    typedef std::map<key_type, Internals::IPv6Stream> streams_type;
+    typedef std::map<IPv6Address, size_t> source_bytes_type;
+    #endif // TINS_IS_CXX11
+
+    typedef Internals::ReassemblyTable<streams_type, source_bytes_type> table_type;
+    
+    table_type table_;
+};
+
+} // Tins
+
+#endif // TINS_IPV6_REASSEMBLER_H
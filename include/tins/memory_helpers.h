@@ -225,6 +225,45 @@ private:
     size_t size_;
 };
 
+// Appends data at the end of a vector, growing it as needed
+class OutputBufferStream {
+public:
+    OutputBufferStream(std::vector<uint8_t>& buffer)
+    : buffer_(buffer) {
+    }
+
+    template <typename T>
+    void write(const T& value) {
+        const uint8_t* ptr = (const uint8_t*)&value;
+        buffer_.insert(buffer_.end(), ptr, ptr + sizeof(value));
+    }
+
+    template <typename T>
+    void write_be(const T& value) {
+        write(Endian::host_to_be(value));
+    }
+
+    template <typename T>
+    void write_le(const T& value) {
+        write(Endian::host_to_le(value));
+    }
+
+    template <typename ForwardIterator>
+    void write(ForwardIterator start, ForwardIterator end) {
+        buffer_.insert(buffer_.end(), start, end);
+    }
+
+    void write(const uint8_t* ptr, size_t length) {
+        write(ptr, ptr + length);
+    }
+
+    size_t size() const {
+        return buffer_.size();
+    }
+private:
+    std::vector<uint8_t>& buffer_;
+};
+
 /** 
  * \endcond
  */
@@ -0,0 +1,344 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TINS_NEIGHBOR_CACHE_H
+#define TINS_NEIGHBOR_CACHE_H
+
+#include <map>
+#include <set>
+#include <vector>
+#include <utility>
+#include <ctime>
+#include <stdint.h>
+#include <tins/macros.h>
+#include <tins/cxxstd.h>
+#include <tins/ip_address.h>
+#include <tins/ipv6_address.h>
+#include <tins/hw_address.h>
+#if TINS_IS_CXX11
+    #include <mutex>
+    #include <thread>
+    #include <condition_variable>
+#endif // TINS_IS_CXX11
+
+namespace Tins {
+
+class PacketSender;
+class NetworkInterface;
+
+/**
+ * \brief Caches the hardware addresses of neighboring hosts.
+ *
+ * Utils::resolve_hwaddr sends an ARP request and blocks until a response 
+ * arrives or the sender's timeout expires, every time it's called. This 
+ * class keeps the addresses it has resolved, so only misses hit the 
+ * network.
+ *
+ * Entries are kept per interface, so the same address can map to different 
+ * hardware addresses on different links.
+ *
+ * The cache can be seeded from the kernel's neighbor table (both ARP and 
+ * NDP entries) using NeighborCache::load. This is only supported on Linux.
+ * A miss first looks at the kernel's table and then falls back to sending 
+ * ARP requests. When resolving several addresses at once, a request is sent 
+ * for each of them and all responses are collected by a single receive 
+ * loop, so resolving N addresses costs at most one timeout rather than N.
+ *
+ * Entries older than NeighborCache::max_age seconds are stale. Stale entries
+ * are still returned by NeighborCache::find, but NeighborCache::resolve 
+ * resolves them again. NeighborCache::refresh resolves every stale entry. 
+ * When compiling using C++11, NeighborCache::start_refresh does so 
+ * periodically on a background thread, so senders don't block on them.
+ *
+ * When compiling using C++11, every method in this class is thread safe,
+ * and no lock is held while waiting for the network. If several threads 
+ * resolve the same address at once, only one of them hits the network and 
+ * the others wait for its result.
+ *
+ * \code
+ * PacketSender sender;
+ * NeighborCache& cache = Utils::neighbor_cache();
+ * std::vector<IPv4Address> next_hops = ...;
+ * NetworkInterface iface = sender.default_interface();
+ * cache.resolve(iface, next_hops, sender);
+ * NeighborCache::hwaddress_type hw_addr;
+ * if (cache.find(iface, next_hops[0], hw_addr)) {
+ *     // send using hw_addr
+ * }
+ * \endcode
+ */
+class TINS_API NeighborCache {
+public:
+    /**
+     * The hardware address type.
+     */
+    typedef HWAddress<6> hwaddress_type;
+
+    /**
+     * The default amount of seconds after which entries become stale.
+     */
+    static const unsigned DEFAULT_MAX_AGE;
+
+    /**
+     * \brief Constructs an empty cache.
+     */
+    NeighborCache();
+
+    /**
+     * \brief Destructor.
+     *
+     * Stops the background refresh, if it was started.
+     */
+    ~NeighborCache();
+
+    /**
+     * \brief Adds the entries in the kernel's neighbor table to this cache.
+     *
+     * Reachable and permanent entries are added as fresh ones. The ones the
+     * kernel considers stale or is probing are added as stale entries, so 
+     * NeighborCache::resolve confirms them before using them. These never 
+     * replace a fresher entry.
+     *
+     * \return true iff the kernel's table could be read.
+     */
+    bool load();
+
+    /**
+     * \brief Adds the entries in the kernel's neighbor table for the given
+     * interface to this cache.
+     *
+     * \sa NeighborCache::load()
+     */
+    bool load(const NetworkInterface& iface);
+
+    /**
+     * \brief Adds or updates an IPv4 entry.
+     *
+     * \param iface The interface in which the neighbor is found.
+     * \param addr The IPv4 address.
+     * \param hw_addr The hardware address for it.
+     */
+    void add(const NetworkInterface& iface, IPv4Address addr, const hwaddress_type& hw_addr);
+
+    /**
+     * \brief Adds or updates an IPv6 entry.
+     *
+     * \param iface The interface in which the neighbor is found.
+     * \param addr The IPv6 address.
+     * \param hw_addr The hardware address for it.
+     */
+    void add(const NetworkInterface& iface, const IPv6Address& addr,
+             const hwaddress_type& hw_addr);
+
+    /**
+     * \brief Removes an IPv4 entry.
+     *
+     * \return true iff there was an entry for this address in the given 
+     * interface.
+     */
+    bool remove(const NetworkInterface& iface, IPv4Address addr);
+
+    /**
+     * \brief Removes an IPv6 entry.
+     *
+     * \return true iff there was an entry for this address in the given 
+     * interface.
+     */
+    bool remove(const NetworkInterface& iface, const IPv6Address& addr);
+
+    /**
+     * \brief Looks up the hardware address for an IPv4 address.
+     *
+     * This never hits the network. Stale entries are returned as well.
+     *
+     * \param iface The interface in which the neighbor is found.
+     * \param addr The address to be looked up.
+     * \param hw_addr This parameter will contain the hardware address if
+     * it's found.
+     * \return true iff the address is in the cache.
+     */
+    bool find(const NetworkInterface& iface, IPv4Address addr, hwaddress_type& hw_addr) const;
+
+    /**
+     * \brief Looks up the hardware address for an IPv6 address.
+     *
+     * \sa NeighborCache::find(const NetworkInterface&, IPv4Address, hwaddress_type&)
+     */
+    bool find(const NetworkInterface& iface, const IPv6Address& addr,
+              hwaddress_type& hw_addr) const;
+
+    /**
+     * \brief Resolves the hardware address for an IPv4 address.
+     *
+     * The cache is looked up first. On a miss or if the entry is stale, the 
+     * kernel's neighbor table for this interface is loaded and, if that 
+     * doesn't contain the address either, an ARP request is sent.
+     *
+     * If the address can't be resolved, an exception_base is thrown.
+     *
+     * \param iface The interface in which the ARP request will be sent.
+     * \param addr The address to be resolved.
+     * \param sender The sender to use to send and receive ARP packets.
+     * \return The resolved hardware address.
+     */
+    hwaddress_type resolve(const NetworkInterface& iface, IPv4Address addr,
+                           PacketSender& sender);
+
+    /**
+     * \brief Resolves the hardware address of several IPv4 addresses.
+     *
+     * Every address missing from the cache, or whose entry is stale, is 
+     * requested at once and the responses are collected by a single receive
+     * loop, which stops when every address is resolved or no reply arrives 
+     * within the sender's timeout. Stale entries which can't be resolved are
+     * removed. Use NeighborCache::find to retrieve the results.
+     *
+     * \param iface The interface in which the ARP requests will be sent.
+     * \param addresses The addresses to be resolved.
+     * \param sender The sender to use to send and receive ARP packets.
+     * \return The number of given addresses which are now in the cache.
+     */
+    size_t resolve(const NetworkInterface& iface,
+                   const std::vector<IPv4Address>& addresses,
+                   PacketSender& sender);
+
+    /**
+     * \brief Resolves every stale IPv4 entry in the given interface again.
+     *
+     * The kernel's neighbor table is looked at first, and ARP requests are 
+     * sent for the entries it doesn't confirm. Entries which can't be 
+     * resolved are removed.
+     *
+     * \param iface The interface in which the ARP requests will be sent.
+     * \param sender The sender to use to send and receive ARP packets.
+     * \return The number of entries which were refreshed.
+     */
+    size_t refresh(const NetworkInterface& iface, PacketSender& sender);
+
+    #if TINS_IS_CXX11
+    /**
+     * \brief Starts refreshing stale entries on a background thread.
+     *
+     * Every interval seconds, NeighborCache::refresh is called for every 
+     * interface with IPv4 entries in the cache, using a PacketSender owned 
+     * by the background thread. If the background refresh was already 
+     * running, it's restarted using the new interval.
+     *
+     * \param interval The amount of seconds between refreshes.
+     */
+    void start_refresh(unsigned interval);
+
+    /**
+     * \brief Stops the background refresh.
+     *
+     * This waits for a refresh in progress to finish.
+     */
+    void stop_refresh();
+    #endif // TINS_IS_CXX11
+
+    /**
+     * \brief Sets the amount of seconds after which entries become stale.
+     */
+    void max_age(unsigned value);
+
+    /**
+     * \brief Getter for the amount of seconds after which entries become 
+     * stale.
+     */
+    unsigned max_age() const;
+
+    /**
+     * \brief Returns the number of entries in the cache.
+     */
+    size_t size() const;
+
+    /**
+     * \brief Removes every entry in the cache.
+     */
+    void clear();
+private:
+    struct entry_type {
+        hwaddress_type hw_addr;
+        std::time_t updated_at;
+    };
+
+    // Entries are keyed by interface index and address
+    typedef std::map<std::pair<uint32_t, IPv4Address>, entry_type> ipv4_entries;
+    typedef std::map<std::pair<uint32_t, IPv6Address>, entry_type> ipv6_entries;
+
+    NeighborCache(const NeighborCache&);
+    NeighborCache& operator=(const NeighborCache&);
+
+    bool load(uint32_t iface_index);
+    void add(uint32_t iface_index, IPv4Address addr, const hwaddress_type& hw_addr,
+             std::time_t updated_at);
+    void add(uint32_t iface_index, const IPv6Address& addr, const hwaddress_type& hw_addr,
+             std::time_t updated_at);
+    bool is_stale(const entry_type& entry, std::time_t now) const;
+    void resolve_pending(const NetworkInterface& iface,
+                         const std::vector<IPv4Address>& pending,
+                         PacketSender& sender);
+    void release_pending(uint32_t iface_index, const std::vector<IPv4Address>& pending);
+    #if TINS_IS_CXX11
+    void run_refresh(unsigned interval);
+    #endif // TINS_IS_CXX11
+    std::vector<IPv4Address> missing(uint32_t iface_index, 
+                                     const std::vector<IPv4Address>& addresses) const;
+    size_t count_present(uint32_t iface_index,
+                         const std::vector<IPv4Address>& addresses) const;
+
+    ipv4_entries ipv4_entries_;
+    ipv6_entries ipv6_entries_;
+    // Addresses being resolved, keyed like the entries
+    std::set<std::pair<uint32_t, IPv4Address> > pending_;
+    unsigned max_age_;
+    #if TINS_IS_CXX11
+        mutable std::mutex mutex_;
+        std::condition_variable pending_resolved_;
+        // Serializes starting and stopping the background refresh
+        std::mutex refresh_mutex_;
+        std::condition_variable refresh_stopped_;
+        std::thread refresh_thread_;
+        bool refresh_stopping_;
+    #endif // TINS_IS_CXX11
+};
+
+namespace Utils {
+
+/**
+ * \brief Returns the process wide NeighborCache.
+ *
+ * This is the cache used by Utils::resolve_hwaddr.
+ */
+TINS_API NeighborCache& neighbor_cache();
+
+} // Utils
+} // Tins
+
+#endif // TINS_NEIGHBOR_CACHE_H
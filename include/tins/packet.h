@@ -33,6 +33,9 @@
 #include <tins/cxxstd.h>
 #include <tins/pdu.h>
 #include <tins/timestamp.h>
+#if TINS_IS_CXX11
+    #include <atomic>
+#endif // TINS_IS_CXX11
 
 /**
  * \namespace Tins
@@ -126,6 +129,18 @@ private:
  * A Packet contains a PDU pointer and a Timestamp object. Packets
  * <b>will delete</b> the stored PDU* unless you call release_pdu at 
  * some point before destruction. 
+ *
+ * Copying a Packet doesn't clone its PDU. Instead, every copy shares 
+ * the same PDU and a reference count is kept. This makes it cheap to 
+ * hand the same packet to several consumers. The shared PDU is only 
+ * cloned once one of the copies needs to modify it, that is, when the
+ * non-const version of Packet::pdu, Packet::release_pdu or 
+ * Packet::operator/= are called on a Packet whose PDU is shared.
+ * Consumers which only read packets should use a const Packet so 
+ * that they never trigger a copy.
+ *
+ * Note that the reference count is only thread safe when compiling 
+ * using C++11.
  */
 class Packet {
 public:
@@ -142,7 +157,7 @@ public:
      * The PDU* will be set to a null pointer.
      */
     Packet() 
-    : pdu_(0) { }
+    : shared_(0) { }
     
     /**
      * \brief Constructs a Packet from a PDU* and a Timestamp.
@@ -150,7 +165,7 @@ public:
      * The PDU is cloned using PDU::clone.
      */
     Packet(const PDU* apdu, const Timestamp& tstamp) 
-    : pdu_(apdu->clone()), ts_(tstamp) { }
+    : shared_(make_shared(apdu->clone())), ts_(tstamp) { }
 
     /**
      * \brief Constructs a Packet from a PDU& and a Timestamp.
@@ -158,7 +173,7 @@ public:
      * The PDU is cloned using PDU::clone.
      */
     Packet(const PDU& apdu, const Timestamp& tstamp) 
-    : pdu_(apdu.clone()), ts_(tstamp) { }
+    : shared_(make_shared(apdu.clone())), ts_(tstamp) { }
 
     /**
      * \brief Constructs a Packet from a PDU* and a Timestamp.
@@ -169,7 +184,7 @@ public:
      * of scope.
      */
     Packet(PDU* apdu, const Timestamp& tstamp, own_pdu) 
-    : pdu_(apdu), ts_(tstamp) { }
+    : shared_(make_shared(apdu)), ts_(tstamp) { }
     
     /**
      * \brief Constructs a Packet from a const PDU&.
@@ -180,7 +195,7 @@ public:
      * 
      */
     Packet(const PDU& rhs) 
-    : pdu_(rhs.clone()), ts_(Timestamp::current_time()) { }
+    : shared_(make_shared(rhs.clone())), ts_(Timestamp::current_time()) { }
     
     /**
      * \brief Constructs a Packet from a RefPacket.
@@ -189,34 +204,40 @@ public:
      * 
      */
     Packet(const RefPacket& pck) 
-    : pdu_(pck.pdu().clone()), ts_(pck.timestamp()) { }
+    : shared_(make_shared(pck.pdu().clone())), ts_(pck.timestamp()) { }
 
     /**
      * \brief Constructs a Packet from a PtrPacket object.
      */
     Packet(const PtrPacket& pck)
-    : pdu_(pck.pdu()), ts_(pck.timestamp()) { }
+    : shared_(make_shared(pck.pdu())), ts_(pck.timestamp()) { }
     
     /**
      * \brief Copy constructor.
      * 
-     * This calls PDU::clone on the rhs's PDU* member.
+     * The PDU is shared with rhs, rather than cloned. 
      */
-    Packet(const Packet& rhs) : ts_(rhs.timestamp()) {
-        pdu_ = rhs.pdu() ? rhs.pdu()->clone() : 0;
+    Packet(const Packet& rhs) 
+    : shared_(rhs.shared_), ts_(rhs.timestamp()) {
+        if (shared_) {
+            ++shared_->references;
+        }
     }
     
     /**
      * \brief Copy assignment operator.
      * 
-     * This calls PDU::clone on the rhs's PDU* member.
+     * The PDU is shared with rhs, rather than cloned. 
      */
     Packet& operator=(const Packet& rhs) {
-        if (this != &rhs) {
-            delete pdu_;
-            ts_ = rhs.timestamp();
-            pdu_ = rhs.pdu() ? rhs.pdu()->clone() : 0;
+        if (shared_ != rhs.shared_) {
+            if (rhs.shared_) {
+                ++rhs.shared_->references;
+            }
+            release_shared();
+            shared_ = rhs.shared_;
         }
+        ts_ = rhs.timestamp();
         return* this;
     }
     
@@ -224,8 +245,8 @@ public:
     /**
      * Move constructor.
      */
-    Packet(Packet &&rhs) TINS_NOEXCEPT : pdu_(rhs.pdu()), ts_(rhs.timestamp()) {
-        rhs.pdu_ = nullptr;
+    Packet(Packet &&rhs) TINS_NOEXCEPT : shared_(rhs.shared_), ts_(rhs.timestamp()) {
+        rhs.shared_ = nullptr;
     }
     
     /**
@@ -233,9 +254,9 @@ public:
      */
     Packet& operator=(Packet &&rhs) TINS_NOEXCEPT { 
         if (this != &rhs) {
-            PDU* tmp = std::move(pdu_);
-            pdu_ = std::move(rhs.pdu_);
-            rhs.pdu_ = std::move(tmp);
+            shared_pdu* tmp = shared_;
+            shared_ = rhs.shared_;
+            rhs.shared_ = tmp;
             ts_ = rhs.timestamp();
         }
         return* this;
@@ -245,10 +266,11 @@ public:
     /**
      * \brief Packet destructor.
      * 
-     * This calls operator delete on the stored PDU*.
+     * This deletes the stored PDU* unless it's still shared with some 
+     * other Packet.
      */
     ~Packet() {
-        delete pdu_;
+        release_shared();
     }
     
     /**
@@ -261,19 +283,29 @@ public:
     /**
      * \brief Returns the stored PDU*. 
      * 
+     * If the PDU is shared with other Packets, it will be cloned first
+     * so the caller can safely modify it. In that case, pointers to the 
+     * PDU or to any of its inner PDUs previously obtained from this 
+     * Packet still point to the shared PDU, not to this Packet's one.
+     *
      * Caller <b>must not</b> delete the pointer. \sa Packet::release_pdu
      */
     PDU* pdu() {
-        return pdu_;
+        return unshare();
     }
     
     /**
      * \brief Returns the stored PDU*. 
      * 
+     * This never clones the PDU, even if it is shared. The pointer can 
+     * be invalidated by destroying or assigning to this Packet, by 
+     * releasing its PDU or by calling the non-const Packet::pdu while the
+     * PDU is shared.
+     *
      * Caller <b>must not</b> delete the pointer. \sa Packet::release_pdu
      */
     const PDU* pdu() const {
-        return pdu_;
+        return shared_ ? shared_->pdu : 0;
     }
     
     /**
@@ -284,12 +316,29 @@ public:
      * method if you want to keep the internal PDU* somewhere. Otherwise,
      * when Packet's destructor is called, the stored pointer will be 
      * deleted.
+     *
+     * If the PDU is shared with other Packets, a clone of it is returned.
+     * Either way, pointers previously obtained through Packet::pdu no 
+     * longer refer to this Packet's PDU.
      */
     PDU* release_pdu() {
-        PDU* some_pdu = pdu_;
-        pdu_ = 0;
+        PDU* some_pdu = unshare();
+        if (shared_) {
+            shared_->pdu = 0;
+            release_shared();
+            shared_ = 0;
+        }
         return some_pdu;
     }
+
+    /**
+     * \brief Returns the number of Packets sharing this Packet's PDU.
+     *
+     * If this Packet holds no PDU, 0 is returned.
+     */
+    size_t use_count() const {
+        return shared_ ? static_cast<size_t>(shared_->references) : 0;
+    }
     
     /**
      * \brief Tests whether this is Packet contains a valid PDU.
@@ -297,7 +346,7 @@ public:
      * \return true if pdu() == nullptr, false otherwise.
      */
     operator bool() const {
-        return pdu_ ? true : false;
+        return pdu() ? true : false;
     }
     
     /**
@@ -309,11 +358,47 @@ public:
      * \param rhs The PDU to be appended.
      */
     Packet& operator/=(const PDU& rhs) {
-        pdu_ /= rhs;
+        PDU* some_pdu = unshare();
+        some_pdu /= rhs;
         return* this;
     }
 private:
-    PDU* pdu_;
+    struct shared_pdu {
+        shared_pdu(PDU* pdu) 
+        : pdu(pdu), references(1) { }
+
+        PDU* pdu;
+        #if TINS_IS_CXX11
+            std::atomic<size_t> references;
+        #else
+            size_t references;
+        #endif
+    };
+
+    static shared_pdu* make_shared(PDU* pdu) {
+        return pdu ? new shared_pdu(pdu) : 0;
+    }
+
+    void release_shared() {
+        if (shared_ && --shared_->references == 0) {
+            delete shared_->pdu;
+            delete shared_;
+        }
+    }
+
+    PDU* unshare() {
+        if (!shared_) {
+            return 0;
+        }
+        if (shared_->references != 1) {
+            shared_pdu* copy = make_shared(shared_->pdu->clone());
+            release_shared();
+            shared_ = copy;
+        }
+        return shared_->pdu;
+    }
+
+    shared_pdu* shared_;
     Timestamp ts_;
 };
 }
@@ -34,6 +34,7 @@
 #include <tins/macros.h>
 #include <tins/cxxstd.h>
 #include <tins/utils/pdu_utils.h>
+#include <tins/pcap_index.h>
 
 #ifdef TINS_HAVE_PCAP
 #include <pcap.h>
@@ -76,6 +77,9 @@ class Packet;
  * writer.write(smart_ptr);
  * writer.write(vt.begin(), vt.end());
  * \endcode
+ *
+ * Packets are written synchronously on the calling thread. When writing
+ * at high packet rates, consider using BufferedPacketWriter instead.
  */
 class TINS_API PacketWriter {
 public:
@@ -141,7 +145,8 @@ public:
          * 
          * \param rhs The PacketWriter to be moved.
          */
-        PacketWriter(PacketWriter &&rhs) TINS_NOEXCEPT {
+        PacketWriter(PacketWriter &&rhs) TINS_NOEXCEPT
+        : handle_(0), dumper_(0), index_(0), index_saved_(false) {
             *this = std::move(rhs);
         }
         
@@ -158,6 +163,9 @@ public:
             dumper_ = 0;
             std::swap(handle_, rhs.handle_);
             std::swap(dumper_, rhs.dumper_);
+            std::swap(index_, rhs.index_);
+            std::swap(index_saved_, rhs.index_saved_);
+            std::swap(file_name_, rhs.file_name_);
             return* this;
         }
     #endif
@@ -168,6 +176,28 @@ public:
      * Gracefully closes the output file.
      */
     ~PacketWriter();
+
+    /**
+     * \brief Builds a PcapIndex for this file while writing it.
+     *
+     * The index is stored next to the file, named after 
+     * PcapIndex::index_file_name, when PacketWriter::save_index is called.
+     * If packets were written after that, the destructor tries to save it
+     * again, but errors can't be reported from there. This must be called
+     * before writing any packets.
+     *
+     * \param block_size The amount of records per time block.
+     */
+    void enable_index(uint32_t block_size = PcapIndex::DEFAULT_BLOCK_SIZE);
+
+    /**
+     * \brief Flushes the file and stores its index.
+     *
+     * This does nothing unless PacketWriter::enable_index was called.
+     *
+     * \throw file_write_error If the file or its index can't be written.
+     */
+    void save_index();
     
     /**
      * \brief Writes a PDU to this file. 
@@ -220,6 +250,9 @@ private:
 
     pcap_t* handle_;
     pcap_dumper_t* dumper_; 
+    PcapIndex* index_;
+    bool index_saved_;
+    std::string file_name_;
 };
 
 } // Tins
@@ -0,0 +1,389 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <tins/config.h>
+#include <tins/cxxstd.h>
+
+#if !defined(TINS_PARALLEL_DECRYPTER_H) && defined(TINS_HAVE_DOT11) && TINS_IS_CXX11
+#define TINS_PARALLEL_DECRYPTER_H
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <tins/crypto.h>
+#include <tins/packet.h>
+#include <tins/pdu.h>
+
+namespace Tins {
+namespace Crypto {
+
+/**
+ * \brief Decrypts packets on several threads, forwarding them to a
+ * functor in capture order.
+ *
+ * This works like DecrypterProxy, except that only the decrypter's
+ * bookkeeping, like tracking EAPOL handshakes, is done on the thread
+ * that feeds packets into this object. The frames themselves are
+ * decrypted by a pool of worker threads, and are then forwarded to the
+ * functor, on the feeding thread, in the order they were captured.
+ *
+ * As with DecrypterProxy, packets that can't be decrypted are not 
+ * forwarded to the functor. Neither are the ones whose decryption throws,
+ * which are counted by failures instead. Decrypted packets are forwarded 
+ * as soon as the ones before them have been, so the last packets fed into this
+ * object may still be pending when the sniffing loop ends. Use flush to
+ * wait for and forward them. Pending packets are discarded when this
+ * object is destroyed.
+ *
+ * The decrypter can be any class providing find_frame_keys, a
+ * frame_keys_type and a frame_decrypter, like WEPDecrypter and
+ * WPA2Decrypter. It must only be used from the feeding thread.
+ *
+ * Since this object can't be copied, use std::ref to give it to
+ * BaseSniffer::sniff_loop:
+ *
+ * \code
+ * ParallelDecrypterProxy<handler_type, WPA2Decrypter> proxy(handler);
+ * proxy.decrypter().add_ap_data("password", "SSID");
+ * sniffer.sniff_loop(std::ref(proxy));
+ * proxy.flush();
+ * \endcode
+ */
+template<typename Functor, typename Decrypter>
+class ParallelDecrypterProxy {
+public:
+    /**
+     * The type of the functor object.
+     */
+    typedef Functor functor_type;
+
+    /**
+     * The type of the decrypter object.
+     */
+    typedef Decrypter decrypter_type;
+
+    /**
+     * The default maximum number of packets being decrypted or waiting
+     * to be forwarded.
+     */
+    static const size_t DEFAULT_MAX_PENDING = 1024;
+
+    /**
+     * \brief Constructs an object from a functor and a decrypter.
+     *
+     * \param func The functor to be used to forward decrypted packets.
+     * \param thread_count The number of worker threads to use. If 0, the
+     * number of hardware threads is used.
+     * \param max_pending The maximum number of packets being decrypted or
+     * waiting to be forwarded. Once this is reached, feeding a packet
+     * blocks until the oldest one is forwarded.
+     * \param decr The decrypter which will be used to decrypt packets.
+     */
+    ParallelDecrypterProxy(const functor_type& func, size_t thread_count = 0,
+                           size_t max_pending = DEFAULT_MAX_PENDING,
+                           const decrypter_type& decr = decrypter_type());
+
+    /**
+     * \brief Destructor.
+     *
+     * Stops the worker threads, discarding any pending packets.
+     */
+    ~ParallelDecrypterProxy();
+
+    /**
+     * \brief Retrieves a reference to the decrypter object.
+     */
+    decrypter_type& decrypter();
+
+    /**
+     * \brief Retrieves a const reference to the decrypter object.
+     */
+    const decrypter_type& decrypter() const;
+
+    /**
+     * \brief Feeds a packet, forwarding any packets that are ready.
+     *
+     * The packet is cloned if it has to be decrypted.
+     *
+     * \param pdu The packet to process.
+     * \return false iff the functor returned false, true otherwise.
+     */
+    bool operator()(const PDU& pdu);
+
+    /**
+     * \brief Feeds a packet, forwarding any packets that are ready.
+     *
+     * The packet is only inspected through its const accessors. If it 
+     * has to be decrypted, its PDU is taken out of it, which only clones 
+     * the PDU if it's shared with other Packets.
+     *
+     * \param packet The packet to process.
+     * \return false iff the functor returned false, true otherwise.
+     */
+    bool operator()(Packet& packet);
+
+    /**
+     * \brief Waits for all pending packets and forwards them.
+     *
+     * \return false iff the functor returned false, true otherwise.
+     */
+    bool flush();
+
+    /**
+     * \brief Returns the number of packets whose decryption threw an 
+     * exception.
+     *
+     * These packets are not forwarded to the functor.
+     */
+    size_t failures() const;
+private:
+    typedef typename decrypter_type::frame_keys_type frame_keys_type;
+    typedef typename decrypter_type::frame_decrypter frame_decrypter_type;
+
+    struct job {
+        job(std::unique_ptr<PDU>&& pdu, frame_keys_type&& keys)
+        : pdu(std::move(pdu)), keys(std::move(keys)), done(false), decrypted(false) {
+
+        }
+
+        std::unique_ptr<PDU> pdu;
+        frame_keys_type keys;
+        bool done;
+        bool decrypted;
+    };
+
+    ParallelDecrypterProxy(const ParallelDecrypterProxy&);
+    ParallelDecrypterProxy& operator=(const ParallelDecrypterProxy&);
+
+    void submit(std::unique_ptr<PDU> pdu, frame_keys_type& keys);
+    bool forward(size_t max_pending);
+    void discard();
+    void stop();
+    void run();
+
+    functor_type functor_;
+    decrypter_type decrypter_;
+    size_t max_pending_;
+    // Packets in capture order. Only used by the feeding thread
+    std::deque<std::unique_ptr<job> > pending_;
+    // Packets waiting for a worker
+    std::deque<job*> queue_;
+    size_t jobs_running_;
+    size_t failures_;
+    bool forwarding_;
+    bool stopping_;
+    mutable std::mutex mutex_;
+    std::condition_variable job_available_;
+    std::condition_variable job_done_;
+    std::vector<std::thread> workers_;
+};
+
+// Implementation section
+
+template<typename Functor, typename Decrypter>
+ParallelDecrypterProxy<Functor, Decrypter>::ParallelDecrypterProxy(const functor_type& func,
+                                                                   size_t thread_count,
+                                                                   size_t max_pending,
+                                                                   const decrypter_type& decr)
+: functor_(func), decrypter_(decr), max_pending_(max_pending > 0 ? max_pending : 1),
+  jobs_running_(0), failures_(0), forwarding_(true), stopping_(false) {
+    if (thread_count == 0) {
+        thread_count = std::thread::hardware_concurrency();
+        if (thread_count == 0) {
+            thread_count = 1;
+        }
+    }
+    try {
+        for (size_t i = 0; i < thread_count; ++i) {
+            workers_.emplace_back(&ParallelDecrypterProxy::run, this);
+        }
+    }
+    catch (...) {
+        stop();
+        throw;
+    }
+}
+
+template<typename Functor, typename Decrypter>
+ParallelDecrypterProxy<Functor, Decrypter>::~ParallelDecrypterProxy() {
+    stop();
+}
+
+template<typename Functor, typename Decrypter>
+typename ParallelDecrypterProxy<Functor, Decrypter>::decrypter_type&
+  ParallelDecrypterProxy<Functor, Decrypter>::decrypter() {
+    return decrypter_;
+}
+
+template<typename Functor, typename Decrypter>
+const typename ParallelDecrypterProxy<Functor, Decrypter>::decrypter_type&
+  ParallelDecrypterProxy<Functor, Decrypter>::decrypter() const {
+    return decrypter_;
+}
+
+template<typename Functor, typename Decrypter>
+bool ParallelDecrypterProxy<Functor, Decrypter>::operator()(const PDU& pdu) {
+    if (!forwarding_) {
+        return false;
+    }
+    frame_keys_type keys;
+    if (decrypter_.find_frame_keys(pdu, keys)) {
+        submit(std::unique_ptr<PDU>(pdu.clone()), keys);
+    }
+    return forward(max_pending_);
+}
+
+template<typename Functor, typename Decrypter>
+bool ParallelDecrypterProxy<Functor, Decrypter>::operator()(Packet& packet) {
+    if (!forwarding_) {
+        return false;
+    }
+    frame_keys_type keys;
+    const PDU* pdu = static_cast<const Packet&>(packet).pdu();
+    if (pdu && decrypter_.find_frame_keys(*pdu, keys)) {
+        submit(std::unique_ptr<PDU>(packet.release_pdu()), keys);
+    }
+    return forward(max_pending_);
+}
+
+template<typename Functor, typename Decrypter>
+bool ParallelDecrypterProxy<Functor, Decrypter>::flush() {
+    return forwarding_ && forward(0);
+}
+
+template<typename Functor, typename Decrypter>
+size_t ParallelDecrypterProxy<Functor, Decrypter>::failures() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return failures_;
+}
+
+template<typename Functor, typename Decrypter>
+void ParallelDecrypterProxy<Functor, Decrypter>::submit(std::unique_ptr<PDU> pdu,
+                                                        frame_keys_type& keys) {
+    std::unique_ptr<job> new_job(new job(std::move(pdu), std::move(keys)));
+    pending_.push_back(std::move(new_job));
+    try {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back(pending_.back().get());
+    }
+    catch (...) {
+        // Otherwise forward would wait for a job no worker will ever see
+        pending_.pop_back();
+        throw;
+    }
+    job_available_.notify_one();
+}
+
+template<typename Functor, typename Decrypter>
+bool ParallelDecrypterProxy<Functor, Decrypter>::forward(size_t max_pending) {
+    while (!pending_.empty()) {
+        const job* oldest = pending_.front().get();
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (pending_.size() > max_pending) {
+                job_done_.wait(lock, [&] { return oldest->done; });
+            }
+            else if (!oldest->done) {
+                break;
+            }
+        }
+        std::unique_ptr<job> current = std::move(pending_.front());
+        pending_.pop_front();
+        if (current->decrypted && !functor_(*current->pdu)) {
+            forwarding_ = false;
+            discard();
+            return false;
+        }
+    }
+    return true;
+}
+
+template<typename Functor, typename Decrypter>
+void ParallelDecrypterProxy<Functor, Decrypter>::discard() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    queue_.clear();
+    // Workers may still be using some of them
+    job_done_.wait(lock, [&] { return jobs_running_ == 0; });
+    pending_.clear();
+}
+
+template<typename Functor, typename Decrypter>
+void ParallelDecrypterProxy<Functor, Decrypter>::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    job_available_.notify_all();
+    for (size_t i = 0; i < workers_.size(); ++i) {
+        workers_[i].join();
+    }
+    workers_.clear();
+}
+
+template<typename Functor, typename Decrypter>
+void ParallelDecrypterProxy<Functor, Decrypter>::run() {
+    frame_decrypter_type frame_decrypter;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        job_available_.wait(lock, [&] { return stopping_ || !queue_.empty(); });
+        if (stopping_) {
+            return;
+        }
+        job* current = queue_.front();
+        queue_.pop_front();
+        ++jobs_running_;
+        lock.unlock();
+        bool decrypted = false;
+        bool failed = false;
+        try {
+            decrypted = frame_decrypter.decrypt(*current->pdu, current->keys);
+        }
+        catch (...) {
+            // Anything escaping would terminate the program, and the job 
+            // would never be done
+            failed = true;
+        }
+        lock.lock();
+        if (failed) {
+            ++failures_;
+        }
+        current->decrypted = decrypted;
+        current->done = true;
+        --jobs_running_;
+        job_done_.notify_one();
+    }
+}
+
+} // Crypto
+} // Tins
+
+#endif // TINS_PARALLEL_DECRYPTER_H
@@ -0,0 +1,405 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TINS_PCAP_INDEX_H
+#define TINS_PCAP_INDEX_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <stdint.h>
+#include <tins/macros.h>
+#include <tins/timestamp.h>
+
+namespace Tins {
+
+class PDU;
+class IPv4Address;
+class IPv6Address;
+
+/**
+ * \class PcapIndex
+ * \brief Indexes the records in a pcap file by time and by flow.
+ *
+ * Finding the packets in some time window or belonging to some flow in a 
+ * pcap file normally requires reading it from the start. A PcapIndex keeps
+ * the offset of every block of PcapIndex::block_size records along with 
+ * the lowest and highest timestamps in it, and the offset of every IPv4 or 
+ * IPv6 record, keyed by a hash of its 5-tuple. The hash doesn't depend on
+ * the direction, so both sides of a connection map to the same flow.
+ *
+ * Indexes can be built from an existing file using PcapIndex::build, or 
+ * incrementally while writing one by feeding every record to 
+ * PcapIndex::add_record. PacketWriter::enable_index and 
+ * BufferedPacketWriter::options::write_index do the latter. They can be 
+ * stored in a sidecar file, which IndexedPcapReader uses to read just the 
+ * records that were asked for.
+ *
+ * \code
+ * // Index a file once
+ * PcapIndex index = PcapIndex::build("capture.pcap");
+ * index.save(PcapIndex::index_file_name("capture.pcap"));
+ *
+ * // Later on, read the packets in a 10 seconds window
+ * IndexedPcapReader reader("capture.pcap");
+ * std::vector<IndexedPcapReader::record> records = reader.read_window(start, end);
+ * \endcode
+ */
+class TINS_API PcapIndex {
+public:
+    /**
+     * \brief A block of consecutive records in the indexed file.
+     */
+    struct time_block {
+        /**
+         * The offset of the first record in the block.
+         */
+        uint64_t offset;
+
+        /**
+         * The lowest timestamp in the block, in microseconds.
+         */
+        uint64_t first_timestamp;
+
+        /**
+         * The highest timestamp in the block, in microseconds.
+         */
+        uint64_t last_timestamp;
+
+        /**
+         * The amount of records in the block.
+         */
+        uint32_t record_count;
+    };
+
+    /**
+     * \brief An indexed record belonging to a flow.
+     */
+    struct flow_entry {
+        uint64_t flow_hash;
+        uint64_t offset;
+
+        bool operator<(const flow_entry& rhs) const {
+            return flow_hash < rhs.flow_hash || 
+                   (flow_hash == rhs.flow_hash && offset < rhs.offset);
+        }
+    };
+
+    /**
+     * The default amount of records per time block.
+     */
+    static const uint32_t DEFAULT_BLOCK_SIZE = 1024;
+
+    /**
+     * \brief Returns the name of the sidecar index file for a pcap file.
+     *
+     * \param pcap_file The pcap file's name.
+     */
+    static std::string index_file_name(const std::string& pcap_file);
+
+    /**
+     * \brief Builds the index for a pcap file by reading it.
+     *
+     * \param pcap_file The pcap file to be indexed.
+     * \param block_size The amount of records per time block.
+     * \throw invalid_pcap_file If the file can't be read or is malformed.
+     */
+    static PcapIndex build(const std::string& pcap_file, 
+                           uint32_t block_size = DEFAULT_BLOCK_SIZE);
+
+    /**
+     * \brief Loads an index from a file created using PcapIndex::save.
+     *
+     * \param index_file The index file's name.
+     * \throw invalid_pcap_file If the file can't be read or is malformed.
+     */
+    static PcapIndex load(const std::string& index_file);
+
+    /**
+     * \brief Computes the hash of a packet's flow.
+     *
+     * The packet is parsed just enough to find its IPv4 or IPv6 addresses 
+     * and, if it's TCP, UDP or SCTP, its ports. Ethernet (including VLAN 
+     * tags), Linux cooked, BSD loopback and raw IP link types are supported.
+     *
+     * \param link_type The pcap link type identifier (DLT_*).
+     * \param data The packet's contents.
+     * \param size The amount of bytes in data.
+     * \return The flow hash, or 0 if this is not an IP packet.
+     */
+    static uint64_t flow_hash(int link_type, const uint8_t* data, uint32_t size);
+
+    /**
+     * \brief Computes the hash of the flow a PDU belongs to.
+     *
+     * This returns the same hash as the raw packet version does for the 
+     * PDU's serialization: the outermost IPv4 or IPv6 layer and the upper 
+     * layer protocol that follows it are used.
+     *
+     * \param pdu The packet. It must contain either an IP or IPv6 layer.
+     * \return The flow hash, or 0 if it doesn't contain an IP layer.
+     */
+    static uint64_t flow_hash(const PDU& pdu);
+
+    /**
+     * \brief Computes the hash of an IPv4 flow.
+     *
+     * The endpoints can be provided in any order.
+     *
+     * \param address1 The first endpoint's address.
+     * \param port1 The first endpoint's port, 0 if the protocol has no ports.
+     * \param address2 The second endpoint's address.
+     * \param port2 The second endpoint's port, 0 if the protocol has no ports.
+     * \param protocol The IP protocol number.
+     */
+    static uint64_t flow_hash(const IPv4Address& address1, uint16_t port1,
+                              const IPv4Address& address2, uint16_t port2,
+                              uint8_t protocol);
+
+    /**
+     * \brief Computes the hash of an IPv6 flow.
+     *
+     * \sa PcapIndex::flow_hash(const IPv4Address&, uint16_t, const IPv4Address&, uint16_t, uint8_t)
+     */
+    static uint64_t flow_hash(const IPv6Address& address1, uint16_t port1,
+                              const IPv6Address& address2, uint16_t port2,
+                              uint8_t protocol);
+
+    /**
+     * \brief Constructs an empty index.
+     *
+     * \param link_type The pcap link type identifier of the indexed file.
+     * \param block_size The amount of records per time block.
+     */
+    PcapIndex(int link_type = 0, uint32_t block_size = DEFAULT_BLOCK_SIZE);
+
+    /**
+     * \brief Adds a record to this index.
+     *
+     * Records must be added in the same order as they're stored in the file.
+     *
+     * \param offset The offset of the record's header in the file.
+     * \param ts The record's timestamp.
+     * \param data The record's contents.
+     * \param size The amount of bytes in data.
+     */
+    void add_record(uint64_t offset, const Timestamp& ts, const uint8_t* data,
+                    uint32_t size);
+
+    /**
+     * \brief Stores this index in a file.
+     *
+     * \param index_file The index file's name.
+     * \throw file_write_error If the file can't be written.
+     */
+    void save(const std::string& index_file) const;
+
+    /**
+     * \brief Finds the blocks containing records in the window [start, end).
+     *
+     * Records in a pcap file aren't necessarily sorted by timestamp, so the
+     * blocks returned may contain records outside of this window.
+     *
+     * \param start The beginning of the window.
+     * \param end The end of the window.
+     */
+    std::vector<time_block> find_window(const Timestamp& start, const Timestamp& end) const;
+
+    /**
+     * \brief Finds the offsets of all records belonging to a flow.
+     *
+     * Indexes created using PcapIndex::build or PcapIndex::load are sorted
+     * by flow, so this is a binary search. Records added through 
+     * PcapIndex::add_record aren't sorted, so finding them takes a scan 
+     * over every indexed record.
+     *
+     * \param flow_hash The flow's hash, as returned by PcapIndex::flow_hash.
+     * \return The offsets, in ascending order.
+     */
+    std::vector<uint64_t> find_flow(uint64_t flow_hash) const;
+
+    /**
+     * The pcap link type identifier of the indexed file.
+     */
+    int link_type() const;
+
+    /**
+     * The amount of records per time block.
+     */
+    uint32_t block_size() const;
+
+    /**
+     * The amount of records indexed.
+     */
+    uint64_t record_count() const;
+
+    /**
+     * \brief The size of the indexed file.
+     *
+     * This is the offset right after the last indexed record. It's used to 
+     * detect stale indexes.
+     */
+    uint64_t file_size() const;
+
+    /**
+     * The time blocks in this index.
+     */
+    const std::vector<time_block>& blocks() const;
+private:
+    void sort_flows();
+
+    std::vector<time_block> blocks_;
+    std::vector<flow_entry> flows_;
+    bool flows_sorted_;
+    uint64_t record_count_;
+    uint64_t file_size_;
+    uint32_t block_size_;
+    int link_type_;
+};
+
+/**
+ * \class IndexedPcapReader
+ * \brief Reads the records in a time window or flow from a pcap file using
+ * a PcapIndex.
+ *
+ * Records are returned as raw bytes. They can be parsed using the 
+ * appropriate link layer PDU, e.g. EthernetII(&data[0], data.size()).
+ */
+class TINS_API IndexedPcapReader {
+public:
+    /**
+     * \brief A record read from the pcap file.
+     */
+    struct record {
+        /**
+         * The offset of this record in the file.
+         */
+        uint64_t offset;
+
+        /**
+         * The record's timestamp.
+         */
+        Timestamp timestamp;
+
+        /**
+         * The packet's size on the wire, which may be larger than data's.
+         */
+        uint32_t original_size;
+
+        /**
+         * The captured bytes.
+         */
+        std::vector<uint8_t> data;
+    };
+
+    /**
+     * \brief Opens a pcap file along with its index.
+     *
+     * If the sidecar index file exists and matches the pcap file, it's 
+     * loaded. Otherwise, the index is built by reading the whole file.
+     *
+     * \param pcap_file The pcap file to be read.
+     * \throw invalid_pcap_file If the file can't be read or is malformed.
+     */
+    explicit IndexedPcapReader(const std::string& pcap_file);
+
+    /**
+     * \brief Opens a pcap file using the index provided.
+     *
+     * \param pcap_file The pcap file to be read.
+     * \param index The index for this file.
+     * \throw invalid_pcap_file If the file can't be read or is malformed.
+     */
+    IndexedPcapReader(const std::string& pcap_file, const PcapIndex& index);
+
+    /**
+     * \brief Reads the records in the window [start, end).
+     *
+     * \param start The beginning of the window.
+     * \param end The end of the window.
+     * \return The records, in the same order as they're stored in the file.
+     */
+    std::vector<record> read_window(const Timestamp& start, const Timestamp& end);
+
+    /**
+     * \brief Reads the records belonging to a flow.
+     *
+     * \param flow_hash The flow's hash, as returned by PcapIndex::flow_hash.
+     * \return The records, in the same order as they're stored in the file.
+     */
+    std::vector<record> read_flow(uint64_t flow_hash);
+
+    /**
+     * \brief Reads the records belonging to a flow in the window [start, end).
+     *
+     * \param flow_hash The flow's hash, as returned by PcapIndex::flow_hash.
+     * \param start The beginning of the window.
+     * \param end The end of the window.
+     * \return The records, in the same order as they're stored in the file.
+     */
+    std::vector<record> read_flow(uint64_t flow_hash, const Timestamp& start,
+                                  const Timestamp& end);
+
+    /**
+     * \brief Reads the record at some offset.
+     *
+     * \param offset The offset of the record's header.
+     * \param output The record in which to store the result.
+     * \return false if there's no record at that offset.
+     */
+    bool read_record(uint64_t offset, record& output);
+
+    /**
+     * The index used by this reader.
+     */
+    const PcapIndex& index() const;
+
+    /**
+     * Indicates whether the index was loaded from its sidecar file.
+     */
+    bool index_loaded() const;
+
+    /**
+     * The pcap link type identifier of the file.
+     */
+    int link_type() const;
+private:
+    void open(const std::string& pcap_file);
+
+    std::ifstream input_;
+    PcapIndex index_;
+    int link_type_;
+    bool swapped_;
+    bool nanoseconds_;
+    bool index_loaded_;
+};
+
+} // Tins
+
+#endif // TINS_PCAP_INDEX_H
@@ -36,6 +36,9 @@
 #include <tins/macros.h>
 #include <tins/cxxstd.h>
 #include <tins/exceptions.h>
+#if TINS_IS_CXX11
+    #include <atomic>
+#endif // TINS_IS_CXX11
 
 /** \brief The Tins namespace.
  */
@@ -43,6 +46,7 @@ namespace Tins {
 
 class PacketSender;
 class NetworkInterface;
+class BufferedPacketWriter;
 
 /**
  * The type used to store several PDU option values.
@@ -231,7 +235,8 @@ public:
          * \param rhs The PDU to be moved.
          */
         PDU(PDU &&rhs) TINS_NOEXCEPT 
-        : inner_pdu_(0), parent_pdu_(0) {
+        : inner_pdu_(0), parent_pdu_(0), layer_index_(0) {
+            rhs.invalidate_layer_index();
             std::swap(inner_pdu_, rhs.inner_pdu_);
             if (inner_pdu_) {
                 inner_pdu_->parent_pdu(this);
@@ -244,6 +249,8 @@ public:
          * \param rhs The PDU to be moved.
          */
         PDU& operator=(PDU &&rhs) TINS_NOEXCEPT {
+            invalidate_layer_index();
+            rhs.invalidate_layer_index();
             delete inner_pdu_;
             inner_pdu_ = 0;
             std::swap(inner_pdu_, rhs.inner_pdu_);
@@ -347,18 +354,17 @@ public:
      * This method searches for the first PDU which has the same type flag as
      * the given one. If the first PDU matches that flag, it is returned.
      * If no PDU matches, 0 is returned.
+     *
+     * The first lookup builds an index of the layers in the chain, which
+     * is kept by the outermost PDU and shared by every PDU in it, so 
+     * following lookups don't need to walk the whole chain. The index is 
+     * discarded whenever the chain is modified.
+     *
      * \param flag The flag which being searched.
      */
     template<typename T> 
     T* find_pdu(PDUType type = T::pdu_flag) {
-        PDU* pdu = this;
-        while (pdu) {
-            if (pdu->matches_flag(type)) {
-                return static_cast<T*>(pdu);
-            }
-            pdu = pdu->inner_pdu();
-        }
-        return 0;
+        return static_cast<T*>(find_layer(type));
     }
     
     /**
@@ -469,6 +475,9 @@ public:
      */
     virtual PDUType pdu_type() const = 0;
 protected:
+    // Serializes straight into its record buffers
+    friend class BufferedPacketWriter;
+
     /**
      * \brief Copy constructor.
      */
@@ -516,10 +525,24 @@ protected:
      */
     virtual void write_serialization(uint8_t* buffer, uint32_t total_sz) = 0;
 private:
+    struct layer_index;
+
+    #if TINS_IS_CXX11
+        typedef std::atomic<layer_index*> layer_index_ptr;
+    #else
+        typedef layer_index* layer_index_ptr;
+    #endif // TINS_IS_CXX11
+
     void parent_pdu(PDU* parent);
+    PDU* find_layer(PDUType type);
+    const layer_index& get_layer_index();
+    void invalidate_layer_index();
 
     PDU* inner_pdu_;
     PDU* parent_pdu_;
+    // Built on demand by find_pdu on the outermost PDU of the chain, so
+    // it's not copied along with the PDU
+    layer_index_ptr layer_index_;
 };
 
 /**
@@ -0,0 +1,242 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TINS_ROUTING_TABLE_H
+#define TINS_ROUTING_TABLE_H
+
+#include <map>
+#include <vector>
+#include <ctime>
+#include <stdint.h>
+#include <tins/macros.h>
+#include <tins/ip_address.h>
+#include <tins/ipv6_address.h>
+#include <tins/utils/routing_utils.h>
+
+namespace Tins {
+
+/**
+ * \brief Caches the system's routing table and performs longest prefix 
+ * match lookups on it.
+ *
+ * Looking up the route for an address using Utils::route_entries requires 
+ * reading and parsing the whole routing table every time. This class keeps
+ * a copy of both the IPv4 and IPv6 tables, indexed by prefix length, so 
+ * finding the most specific route for an address only takes a lookup for
+ * each distinct prefix length in the table. When several routes share the 
+ * same prefix, the one with the lowest metric is used.
+ *
+ * The table can be filled manually using RoutingTable::add or loaded from
+ * the system using RoutingTable::load. In order to keep it up to date, 
+ * call RoutingTable::watch once and RoutingTable::sync before performing
+ * lookups. On Linux, this subscribes to rtnetlink route notifications and
+ * applies every added or removed route incrementally. On other platforms,
+ * or if the notifications can't be received, the table is reloaded once
+ * it's older than RoutingTable::max_age seconds. RoutingTable::invalidate
+ * forces the next RoutingTable::sync to reload it.
+ *
+ * \code
+ * RoutingTable table;
+ * table.watch();
+ * ...
+ * table.sync();
+ * if (const Utils::RouteEntry* route = table.find("8.8.8.8")) {
+ *     std::cout << route->interface << " via " << route->gateway << std::endl;
+ * }
+ * \endcode
+ *
+ * This class is not thread safe. Utils::route_from_ip and 
+ * Utils::gateway_from_ip use a synchronized, process wide, instance.
+ */
+class TINS_API RoutingTable {
+public:
+    /**
+     * The default amount of seconds a table is considered valid for when
+     * route change notifications are not available.
+     */
+    static const unsigned DEFAULT_MAX_AGE;
+
+    /**
+     * \brief Constructs an empty routing table.
+     */
+    RoutingTable();
+
+    /**
+     * \brief Destructor.
+     *
+     * Stops watching for route changes, if this was enabled.
+     */
+    ~RoutingTable();
+
+    /**
+     * \brief Replaces this table's contents with the system's routing table.
+     *
+     * This uses Utils::route_entries and Utils::route6_entries.
+     */
+    void load();
+
+    /**
+     * \brief Starts listening for route change notifications.
+     *
+     * If this is not called, RoutingTable::sync will reload the table 
+     * whenever it's older than RoutingTable::max_age seconds.
+     *
+     * \return true iff route change notifications are supported and 
+     * could be enabled.
+     */
+    bool watch();
+
+    /**
+     * \brief Brings this table up to date with the system's routing table.
+     *
+     * Pending route change notifications are applied. The table is reloaded 
+     * if it was never loaded, it was invalidated, notifications were lost 
+     * or, when not watching for them, it is older than max_age seconds.
+     */
+    void sync();
+
+    /**
+     * \brief Makes the next call to RoutingTable::sync reload the table.
+     */
+    void invalidate();
+
+    /**
+     * \brief Sets the amount of seconds after which RoutingTable::sync 
+     * reloads the table when route change notifications are not available.
+     *
+     * \param value The maximum age, in seconds.
+     */
+    void max_age(unsigned value);
+
+    /**
+     * \brief Getter for the maximum age of the table, in seconds.
+     */
+    unsigned max_age() const;
+
+    /**
+     * \brief Adds an IPv4 route.
+     *
+     * \param entry The route to be added.
+     */
+    void add(const Utils::RouteEntry& entry);
+
+    /**
+     * \brief Adds an IPv6 route.
+     *
+     * \param entry The route to be added.
+     */
+    void add(const Utils::Route6Entry& entry);
+
+    /**
+     * \brief Removes an IPv4 route.
+     *
+     * Every field in the given entry has to match the stored one.
+     *
+     * \param entry The route to be removed.
+     * \return true iff the route was found.
+     */
+    bool remove(const Utils::RouteEntry& entry);
+
+    /**
+     * \brief Removes an IPv6 route.
+     *
+     * Every field in the given entry has to match the stored one.
+     *
+     * \param entry The route to be removed.
+     * \return true iff the route was found.
+     */
+    bool remove(const Utils::Route6Entry& entry);
+
+    /**
+     * \brief Finds the most specific route for an IPv4 address.
+     *
+     * \param addr The address to be looked up.
+     * \return A pointer to the route or a null pointer if there's no route 
+     * for this address. The pointer is invalidated when the table is 
+     * modified.
+     */
+    const Utils::RouteEntry* find(IPv4Address addr) const;
+
+    /**
+     * \brief Finds the most specific route for an IPv6 address.
+     *
+     * \param addr The address to be looked up.
+     * \return A pointer to the route or a null pointer if there's no route 
+     * for this address. The pointer is invalidated when the table is 
+     * modified.
+     */
+    const Utils::Route6Entry* find(const IPv6Address& addr) const;
+
+    /**
+     * \brief Returns the number of IPv4 routes in this table.
+     */
+    size_t ipv4_size() const;
+
+    /**
+     * \brief Returns the number of IPv6 routes in this table.
+     */
+    size_t ipv6_size() const;
+
+    /**
+     * \brief Removes every route in this table.
+     */
+    void clear();
+private:
+    // Routes sharing a prefix, sorted by metric
+    typedef std::vector<Utils::RouteEntry> ipv4_routes;
+    typedef std::vector<Utils::Route6Entry> ipv6_routes;
+    typedef std::map<uint32_t, ipv4_routes> ipv4_prefix_map;
+    typedef std::map<IPv6Address, ipv6_routes> ipv6_prefix_map;
+
+    static const int IPV4_PREFIX_LENGTHS = 33;
+    static const int IPV6_PREFIX_LENGTHS = 129;
+
+    RoutingTable(const RoutingTable&);
+    RoutingTable& operator=(const RoutingTable&);
+
+    bool process_notifications();
+    void close_notifications();
+
+    // Indexed by prefix length
+    ipv4_prefix_map ipv4_prefixes_[IPV4_PREFIX_LENGTHS];
+    ipv6_prefix_map ipv6_prefixes_[IPV6_PREFIX_LENGTHS];
+    // The prefix lengths in use, longest first
+    std::vector<int> ipv4_lengths_;
+    std::vector<int> ipv6_lengths_;
+    size_t ipv4_size_;
+    size_t ipv6_size_;
+    std::time_t loaded_at_;
+    unsigned max_age_;
+    int notifications_fd_;
+    bool loaded_;
+};
+
+} // Tins
+
+#endif // TINS_ROUTING_TABLE_H
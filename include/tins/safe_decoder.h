@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef TINS_SAFE_DECODER_H
+#define TINS_SAFE_DECODER_H
+
+#include <map>
+#include <stdint.h>
+#include <tins/pdu.h>
+#include <tins/macros.h>
+#include <tins/detail/pdu_helpers.h>
+
+namespace Tins {
+
+/**
+ * \brief Decodes packets without throwing on malformed data.
+ *
+ * Constructing a PDU from a buffer throws malformed_packet as soon as any 
+ * of its layers can't be decoded, discarding the whole packet. Decoding 
+ * through this class instead reports the outcome as a status code. Inner 
+ * layers that can't be decoded are replaced by a RawPDU holding their 
+ * bytes, so the layers below them are still available.
+ *
+ * Truncated headers, which is what truncated captures and scans mostly 
+ * produce, are detected before constructing each layer, so no exception 
+ * is thrown for them at all.
+ *
+ * The number of malformed layers found is kept for each PDU type.
+ *
+ * \code
+ * SafeDecoder decoder;
+ * EthernetII* eth;
+ * if (decoder.decode(buffer, size, eth) != SafeDecoder::NOT_DECODED) {
+ *     // A truncated TCP header would be kept in a RawPDU after the IP PDU
+ *     process(*eth);
+ *     delete eth;
+ * }
+ * \endcode
+ */
+class TINS_API SafeDecoder {
+public:
+    /**
+     * The outcome of decoding a packet.
+     */
+    enum Status {
+        DECODED, ///< Every layer was decoded
+        PARTIALLY_DECODED, ///< Some inner layer was kept as a RawPDU
+        NOT_DECODED ///< The outermost layer couldn't be decoded
+    };
+
+    /**
+     * The type used to store the number of malformed layers per PDU type.
+     */
+    typedef Internals::decode_context::counters_type counters_type;
+
+    /**
+     * The type of the functions used to construct the outermost layer.
+     */
+    typedef Internals::pdu_factory factory_type;
+
+    /**
+     * \brief Default constructor.
+     */
+    SafeDecoder();
+
+    /**
+     * \brief Decodes a packet whose outermost layer is of type T.
+     *
+     * \param buffer The buffer holding the packet.
+     * \param total_sz The size of the buffer.
+     * \param output The decoded PDU, which the caller takes ownership of, 
+     * or null if the status is NOT_DECODED.
+     * \return The outcome of decoding the packet.
+     */
+    template <typename T>
+    Status decode(const uint8_t* buffer, uint32_t total_sz, T*& output) {
+        PDU* pdu = 0;
+        const Status status = decode(T::pdu_flag, &Internals::create_pdu<T>,
+                                     buffer, total_sz, pdu);
+        output = static_cast<T*>(pdu);
+        return status;
+    }
+
+    /**
+     * \brief Decodes a packet using the given function to construct 
+     * its outermost layer.
+     *
+     * This is useful for PDUs constructed through functions such as 
+     * Dot11::from_bytes.
+     *
+     * \param type The type of the outermost layer.
+     * \param factory The function which constructs the outermost layer.
+     * \param buffer The buffer holding the packet.
+     * \param total_sz The size of the buffer.
+     * \param output The decoded PDU, which the caller takes ownership of,
+     * or null if the status is NOT_DECODED.
+     * \return The outcome of decoding the packet.
+     */
+    Status decode(PDU::PDUType type, factory_type factory, const uint8_t* buffer,
+                  uint32_t total_sz, PDU*& output);
+
+    /**
+     * \brief Retrieves the number of packets decoded with the given status.
+     *
+     * \param status The status to look up.
+     */
+    uint64_t packet_count(Status status) const;
+
+    /**
+     * \brief Retrieves the number of malformed layers of the given type.
+     *
+     * \param type The PDU type to look up.
+     */
+    uint64_t malformed_count(PDU::PDUType type) const;
+
+    /**
+     * \brief Retrieves the number of malformed layers for each PDU type.
+     */
+    const counters_type& malformed_layers() const;
+
+    /**
+     * \brief Resets every counter.
+     */
+    void reset_counters();
+private:
+    counters_type malformed_layers_;
+    uint64_t packet_counts_[NOT_DECODED + 1];
+};
+
+} // Tins
+
+#endif // TINS_SAFE_DECODER_H
@@ -49,6 +49,12 @@
 namespace Tins {
 class SnifferIterator;
 class SnifferConfiguration;
+class SafeDecoder;
+#ifdef TINS_HAVE_TCPIP
+namespace TCPIP {
+class FlowBypassTable;
+} // TCPIP
+#endif // TINS_HAVE_TCPIP
 
 /**
  * \class BaseSniffer
@@ -74,7 +80,7 @@ public:
          */
         BaseSniffer(BaseSniffer &&rhs) TINS_NOEXCEPT
         : handle_(0), mask_(), extract_raw_(false),
-          pcap_sniffing_method_(pcap_loop) {
+          pcap_sniffing_method_(pcap_loop), bypass_table_(0), decoder_(0) {
             *this = std::move(rhs);
         }
 
@@ -88,6 +94,8 @@ public:
             swap(mask_, rhs.mask_);
             swap(extract_raw_, rhs.extract_raw_);
             swap(pcap_sniffing_method_, rhs.pcap_sniffing_method_);
+            swap(bypass_table_, rhs.bypass_table_);
+            swap(decoder_, rhs.decoder_);
             return* this;
         }
     #endif
@@ -269,6 +277,39 @@ public:
      */
     void set_pcap_sniffing_method(PcapSniffingMethod method);
 
+    #ifdef TINS_HAVE_TCPIP
+    /**
+     * \brief Sets the table used to drop packets before decoding them
+     *
+     * Every captured packet will be checked against this table before any
+     * PDU is constructed. Packets that belong to flows that are being
+     * bypassed will be silently skipped.
+     *
+     * The table is not owned by this sniffer, so it must outlive it or be
+     * unset by using a null pointer.
+     *
+     * \param table The table to be used or null to disable this feature
+     * \sa TCPIP::StreamFollower::flow_bypass_table
+     */
+    void set_flow_bypass_table(TCPIP::FlowBypassTable* table);
+    #endif // TINS_HAVE_TCPIP
+
+    /**
+     * \brief Sets the decoder used to construct the captured packets
+     *
+     * By default, packets containing any malformed layer are skipped. When 
+     * a decoder is set, malformed inner layers are kept as RawPDUs instead
+     * and no exceptions are thrown for truncated headers. Packets whose 
+     * outermost layer is malformed are still skipped. The decoder keeps 
+     * count of the malformed layers found.
+     *
+     * The decoder is not owned by this sniffer, so it must outlive it or be
+     * unset by using a null pointer.
+     *
+     * \param decoder The decoder to be used or null to disable this feature
+     */
+    void set_safe_decoder(SafeDecoder* decoder);
+
     /**
      * \brief Retrieves this sniffer's link type.
      *
@@ -315,6 +356,12 @@ private:
     bpf_u_int32 mask_;
     bool extract_raw_;
     PcapSniffingMethod pcap_sniffing_method_;
+    #ifdef TINS_HAVE_TCPIP
+    TCPIP::FlowBypassTable* bypass_table_;
+    #else
+    void* bypass_table_;
+    #endif // TINS_HAVE_TCPIP
+    SafeDecoder* decoder_;
 };
 
 /**
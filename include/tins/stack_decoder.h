@@ -0,0 +1,406 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef TINS_STACK_DECODER_H
+#define TINS_STACK_DECODER_H
+
+#include <tins/cxxstd.h>
+
+#if TINS_IS_CXX11
+
+#include <memory>
+#include <tuple>
+#include <stdint.h>
+#include <tins/constants.h>
+#include <tins/ethernetII.h>
+#include <tins/dot1q.h>
+#include <tins/arp.h>
+#include <tins/ip.h>
+#include <tins/ipv6.h>
+#include <tins/tcp.h>
+#include <tins/udp.h>
+#include <tins/icmp.h>
+#include <tins/icmpv6.h>
+
+namespace Tins {
+
+/**
+ * \cond
+ */
+namespace Internals {
+
+inline uint16_t read_be16(const uint8_t* ptr) {
+    return static_cast<uint16_t>((ptr[0] << 8) | ptr[1]);
+}
+
+// Describes how to find the size of each layer's header. parse stores 
+// the size of the header and the size of whatever follows it, returning
+// false if the buffer doesn't hold a header that can be decoded
+template <typename T>
+struct stack_layer;
+
+template <uint32_t Size>
+struct fixed_size_layer {
+    static constexpr uint32_t header_size = Size;
+
+    static bool parse(const uint8_t*, uint32_t total_sz, uint32_t& header_sz,
+                      uint32_t& payload_sz) {
+        header_sz = Size;
+        payload_sz = total_sz - Size;
+        return total_sz >= Size;
+    }
+};
+
+template <>
+struct stack_layer<EthernetII> : fixed_size_layer<14> { };
+
+template <>
+struct stack_layer<Dot1Q> : fixed_size_layer<4> { };
+
+template <>
+struct stack_layer<UDP> : fixed_size_layer<8> { };
+
+template <>
+struct stack_layer<ICMP> : fixed_size_layer<8> { };
+
+template <>
+struct stack_layer<ICMPv6> : fixed_size_layer<8> { };
+
+template <>
+struct stack_layer<ARP> : fixed_size_layer<28> { };
+
+template <>
+struct stack_layer<IP> {
+    static bool parse(const uint8_t* buffer, uint32_t total_sz, uint32_t& header_sz,
+                      uint32_t& payload_sz) {
+        if (total_sz < 20 || (buffer[0] >> 4) != 4) {
+            return false;
+        }
+        header_sz = (buffer[0] & 0x0f) * 4;
+        // Fragments are never decoded past the IP layer
+        const uint16_t fragment_field = read_be16(buffer + 6);
+        if (header_sz < 20 || header_sz > total_sz || (fragment_field & 0x3fff) != 0) {
+            return false;
+        }
+        // Same as IP's constructor: a total length of 0 means the whole 
+        // buffer is used, as happens with TCP segmentation offload
+        const uint32_t tot_len = read_be16(buffer + 2);
+        payload_sz = total_sz - header_sz;
+        if (tot_len != 0 && tot_len - header_sz < payload_sz) {
+            payload_sz = tot_len - header_sz;
+        }
+        return true;
+    }
+};
+
+template <>
+struct stack_layer<IPv6> {
+    static bool parse(const uint8_t* buffer, uint32_t total_sz, uint32_t& header_sz,
+                      uint32_t& payload_sz) {
+        if (total_sz < 40 || (buffer[0] >> 4) != 6) {
+            return false;
+        }
+        header_sz = 40;
+        // Jumbograms and extension headers are left to the generic path
+        payload_sz = read_be16(buffer + 4);
+        return payload_sz != 0 && payload_sz <= total_sz - header_sz;
+    }
+};
+
+template <>
+struct stack_layer<TCP> {
+    static bool parse(const uint8_t* buffer, uint32_t total_sz, uint32_t& header_sz,
+                      uint32_t& payload_sz) {
+        if (total_sz < 20) {
+            return false;
+        }
+        header_sz = (buffer[12] >> 4) * 4;
+        payload_sz = total_sz - header_sz;
+        return header_sz >= 20 && header_sz <= total_sz;
+    }
+};
+
+// Checks whether the header of Outer says the next layer is an Inner
+template <typename Outer, typename Inner>
+struct stack_link;
+
+// Checks whether an EtherType identifies the given layer
+template <typename T>
+struct ethertype_of;
+
+template <>
+struct ethertype_of<IP> {
+    static bool matches(uint16_t type) {
+        return type == Constants::Ethernet::IP;
+    }
+};
+
+template <>
+struct ethertype_of<IPv6> {
+    static bool matches(uint16_t type) {
+        return type == Constants::Ethernet::IPV6;
+    }
+};
+
+template <>
+struct ethertype_of<ARP> {
+    static bool matches(uint16_t type) {
+        return type == Constants::Ethernet::ARP;
+    }
+};
+
+template <>
+struct ethertype_of<Dot1Q> {
+    static bool matches(uint16_t type) {
+        return type == Constants::Ethernet::VLAN || type == Constants::Ethernet::QINQ ||
+               type == Constants::Ethernet::OLD_QINQ;
+    }
+};
+
+template <typename Inner>
+struct stack_link<EthernetII, Inner> {
+    static bool matches(const uint8_t* buffer) {
+        return ethertype_of<Inner>::matches(read_be16(buffer + 12));
+    }
+};
+
+template <typename Inner>
+struct stack_link<Dot1Q, Inner> {
+    static bool matches(const uint8_t* buffer) {
+        // The payload type follows the tag control information
+        return ethertype_of<Inner>::matches(read_be16(buffer + 2));
+    }
+};
+
+template <uint8_t Protocol, uint32_t Offset>
+struct protocol_link {
+    static bool matches(const uint8_t* buffer) {
+        return buffer[Offset] == Protocol;
+    }
+};
+
+template <>
+struct stack_link<IP, TCP> : protocol_link<Constants::IP::PROTO_TCP, 9> { };
+
+template <>
+struct stack_link<IP, UDP> : protocol_link<Constants::IP::PROTO_UDP, 9> { };
+
+template <>
+struct stack_link<IP, ICMP> : protocol_link<Constants::IP::PROTO_ICMP, 9> { };
+
+template <>
+struct stack_link<IPv6, TCP> : protocol_link<Constants::IP::PROTO_TCP, 6> { };
+
+template <>
+struct stack_link<IPv6, UDP> : protocol_link<Constants::IP::PROTO_UDP, 6> { };
+
+template <>
+struct stack_link<IPv6, ICMPv6> : protocol_link<Constants::IP::PROTO_ICMPV6, 6> { };
+
+template <typename... Layers>
+struct stack_walker;
+
+template <typename Last>
+struct stack_walker<Last> {
+    static bool validate(const uint8_t* buffer, uint32_t total_sz, uint32_t* header_sizes,
+                         uint32_t* sizes) {
+        uint32_t payload_sz;
+        sizes[0] = total_sz;
+        return stack_layer<Last>::parse(buffer, total_sz, header_sizes[0], payload_sz);
+    }
+
+    static PDU* build(const uint8_t* buffer, const uint32_t*, const uint32_t* sizes) {
+        // The innermost layer decodes its payload as usual
+        return new Last(buffer, sizes[0]);
+    }
+};
+
+template <typename First, typename Second, typename... Rest>
+struct stack_walker<First, Second, Rest...> {
+    static bool validate(const uint8_t* buffer, uint32_t total_sz, uint32_t* header_sizes,
+                         uint32_t* sizes) {
+        uint32_t payload_sz;
+        sizes[0] = total_sz;
+        return stack_layer<First>::parse(buffer, total_sz, header_sizes[0], payload_sz) &&
+               stack_link<First, Second>::matches(buffer) &&
+               stack_walker<Second, Rest...>::validate(buffer + header_sizes[0], payload_sz,
+                                                       header_sizes + 1, sizes + 1);
+    }
+
+    static PDU* build(const uint8_t* buffer, const uint32_t* header_sizes,
+                      const uint32_t* sizes) {
+        std::unique_ptr<PDU> inner(
+            stack_walker<Second, Rest...>::build(buffer + header_sizes[0], header_sizes + 1,
+                                                 sizes + 1)
+        );
+        // Only give it its header, so it doesn't decode the inner layers itself
+        std::unique_ptr<First> output(new First(buffer, header_sizes[0]));
+        output->inner_pdu(inner.release());
+        return output.release();
+    }
+};
+
+} // Internals
+
+/**
+ * \endcond
+ */
+
+/**
+ * \brief Decodes packets known to contain a specific stack of protocols.
+ *
+ * The template parameters are the PDU types in the stack, from the 
+ * outermost to the innermost one, such as 
+ * <tt>StackDecoder<EthernetII, IP, TCP></tt> or
+ * <tt>StackDecoder<EthernetII, Dot1Q, IP, UDP></tt>.
+ *
+ * Constructing a PDU from a buffer dispatches each layer through 
+ * Internals::pdu_from_flag. This instead checks the whole stack upfront 
+ * using inlined checks on the raw headers, with the offsets of fixed size
+ * headers known at compile time, and then constructs each layer directly.
+ * The result is an ordinary PDU chain, identical to the one the outermost 
+ * PDU's constructor would create.
+ *
+ * Packets that don't contain exactly that stack, such as IP fragments, 
+ * packets carrying IPv6 extension headers, or truncated ones, can either 
+ * be rejected using StackDecoder::try_decode or fall back to the generic 
+ * path using StackDecoder::decode.
+ *
+ * \code
+ * typedef StackDecoder<EthernetII, IP, TCP> decoder_type;
+ * if (EthernetII* eth = decoder_type::try_decode(buffer, size)) {
+ *     // No need to use find_pdu, the layers are known to be there
+ *     const TCP& tcp = decoder_type::layer<2>(*eth);
+ *     ...
+ * }
+ * \endcode
+ */
+template <typename... Layers>
+class StackDecoder {
+public:
+    /**
+     * The type of the layer at the given index in the stack.
+     */
+    template <size_t Index>
+    struct layer_type {
+        typedef typename std::tuple_element<Index, std::tuple<Layers...> >::type type;
+    };
+
+    /**
+     * The type of the outermost layer.
+     */
+    typedef typename layer_type<0>::type pdu_type;
+
+    /**
+     * The number of layers in the stack.
+     */
+    static constexpr size_t layer_count = sizeof...(Layers);
+
+    /**
+     * \brief Indicates whether a buffer contains this stack of protocols.
+     *
+     * \param buffer The buffer to check.
+     * \param total_sz The size of the buffer.
+     */
+    static bool matches(const uint8_t* buffer, uint32_t total_sz) {
+        uint32_t header_sizes[layer_count];
+        uint32_t sizes[layer_count];
+        return Internals::stack_walker<Layers...>::validate(buffer, total_sz,
+                                                            header_sizes, sizes);
+    }
+
+    /**
+     * \brief Decodes a buffer if it contains this stack of protocols.
+     *
+     * If the buffer matches but the innermost layer or the options of any
+     * header are malformed, malformed_packet is thrown, just like the PDU 
+     * constructors do.
+     *
+     * \param buffer The buffer to decode.
+     * \param total_sz The size of the buffer.
+     * \return The decoded PDU, which the caller takes ownership of, or null
+     * if the buffer doesn't contain this stack.
+     */
+    static pdu_type* try_decode(const uint8_t* buffer, uint32_t total_sz) {
+        uint32_t header_sizes[layer_count];
+        uint32_t sizes[layer_count];
+        if (!Internals::stack_walker<Layers...>::validate(buffer, total_sz,
+                                                          header_sizes, sizes)) {
+            return 0;
+        }
+        return static_cast<pdu_type*>(
+            Internals::stack_walker<Layers...>::build(buffer, header_sizes, sizes)
+        );
+    }
+
+    /**
+     * \brief Decodes a buffer, falling back to the generic path if it 
+     * doesn't contain this stack of protocols.
+     *
+     * \param buffer The buffer to decode.
+     * \param total_sz The size of the buffer.
+     * \return The decoded PDU, which the caller takes ownership of.
+     */
+    static pdu_type* decode(const uint8_t* buffer, uint32_t total_sz) {
+        pdu_type* output = try_decode(buffer, total_sz);
+        return output ? output : new pdu_type(buffer, total_sz);
+    }
+
+    /**
+     * \brief Retrieves the layer at the given index.
+     *
+     * The PDU must have been created by StackDecoder::try_decode, or at 
+     * least contain this stack. Otherwise, the behaviour is undefined.
+     *
+     * \param pdu The outermost layer.
+     */
+    template <size_t Index>
+    static typename layer_type<Index>::type& layer(pdu_type& pdu) {
+        PDU* output = &pdu;
+        for (size_t i = 0; i < Index; ++i) {
+            output = output->inner_pdu();
+        }
+        return *static_cast<typename layer_type<Index>::type*>(output);
+    }
+
+    /**
+     * \brief Retrieves the layer at the given index.
+     *
+     * \sa StackDecoder::layer
+     */
+    template <size_t Index>
+    static const typename layer_type<Index>::type& layer(const pdu_type& pdu) {
+        return layer<Index>(const_cast<pdu_type&>(pdu));
+    }
+};
+
+} // Tins
+
+#endif // TINS_IS_CXX11
+
+#endif // TINS_STACK_DECODER_H
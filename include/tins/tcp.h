@@ -39,6 +39,7 @@
 #include <tins/small_uint.h>
 #include <tins/pdu_option.h>
 #include <tins/cxxstd.h>
+#include <tins/detail/option_helpers.h>
 
 namespace Tins {
 namespace Memory {
@@ -249,7 +250,7 @@ public:
      * \return The options list.
      */
     const options_type& options() const {
-        return options_;
+        return options_.get();
     }
 
     /**
@@ -477,7 +478,7 @@ public:
          * \param option The option to be added.
          */
         void add_option(option &&opt) {
-            options_.push_back(std::move(opt));
+            options_.get_mutable().push_back(std::move(opt));
         }
 
         /**
@@ -490,7 +491,7 @@ public:
          */
         template <typename... Args>
         void add_option(Args&&... args) {
-            options_.emplace_back(std::forward<Args>(args)...);
+            options_.get_mutable().emplace_back(std::forward<Args>(args)...);
         }
     #endif
 
@@ -599,7 +600,8 @@ private:
     
     template <typename T> 
     T generic_search(OptionTypes opt_type) const {
-        const option* opt = search_option(opt_type);
+        option storage;
+        const option* opt = options_.search(opt_type, storage);
         if (!opt) {
             throw option_not_found();
         }
@@ -615,7 +617,7 @@ private:
     
     void write_option(const option& opt, Memory::OutputMemoryStream& stream);
 
-    options_type options_;
+    Internals::LazyOptionList<option, Internals::TCP_OPTION_LAYOUT> options_;
     tcp_header header_;
 };
 
@@ -35,15 +35,70 @@
 #ifdef TINS_HAVE_ACK_TRACKER
 
 #include <vector>
-#include <boost/icl/interval_set.hpp>
+#include <stdint.h>
 #include <tins/macros.h>
 
 namespace Tins {
 
 class PDU;
 
+namespace Memory {
+class InputMemoryStream;
+class OutputBufferStream;
+} // Memory
+
 namespace TCPIP {
 
+/**
+ * \brief Represents a closed interval of sequence numbers [first, last]
+ *
+ * The interval can wrap around the sequence number space, in which case
+ * last will be numerically lower than first.
+ */
+class TINS_API SequenceInterval {
+public:
+    /**
+     * Default constructs an interval containing only sequence number 0
+     */
+    SequenceInterval();
+
+    /**
+     * \brief Constructs an interval
+     *
+     * \param first The first sequence number in the interval
+     * \param last The last sequence number in the interval (inclusive)
+     */
+    SequenceInterval(uint32_t first, uint32_t last);
+
+    /**
+     * Gets the first sequence number in this interval
+     */
+    uint32_t first() const;
+
+    /**
+     * Gets the last sequence number in this interval
+     */
+    uint32_t last() const;
+
+    /**
+     * Gets the amount of sequence numbers contained in this interval
+     */
+    uint32_t size() const;
+
+    /**
+     * Compares two intervals for equality
+     */
+    bool operator==(const SequenceInterval& rhs) const;
+
+    /**
+     * Compares two intervals for inequality
+     */
+    bool operator!=(const SequenceInterval& rhs) const;
+private:
+    uint32_t first_;
+    uint32_t last_;
+};
+
 /**
  * \brief Represents an acknowledged segment range
  *
@@ -51,7 +106,7 @@ namespace TCPIP {
  */
 class TINS_API AckedRange {
 public:
-    typedef boost::icl::discrete_interval<uint32_t> interval_type;
+    typedef SequenceInterval interval_type;
 
     /**
      * \brief Constructs an acked range
@@ -64,7 +119,9 @@ public:
     /**
      * \brief Gets the next acked interval in this range
      *
-     * If has_next() == false, then this returns an empty interval
+     * Intervals returned by this method never wrap around the sequence
+     * number space. If has_next() == false, the returned interval is
+     * meaningless.
      */
     interval_type next();
 
@@ -88,6 +145,101 @@ private:
     uint32_t last_;
 };
 
+/**
+ * \brief Stores a set of disjoint sequence number intervals
+ *
+ * Intervals are kept sorted using sequence number arithmetic, so all of them
+ * must lie within a 2^31 window (which is always the case for SACKed data
+ * within a TCP window). Overlapping and adjacent intervals are merged.
+ *
+ * Since a TCP segment can only carry a few SACK blocks, a small amount of
+ * intervals is stored inline and the heap is only used when there are more
+ * holes than that.
+ */
+class TINS_API SackIntervalSet {
+public:
+    /**
+     * The type of the stored intervals
+     */
+    typedef SequenceInterval value_type;
+
+    /**
+     * The type used to iterate the stored intervals
+     */
+    typedef const value_type* const_iterator;
+
+    /**
+     * The amount of intervals that can be stored without allocating
+     */
+    static const size_t INLINE_CAPACITY = 4;
+
+    /**
+     * Default constructs an empty set
+     */
+    SackIntervalSet();
+
+    /**
+     * \brief Adds the given interval to this set
+     *
+     * \param interval The interval to be added
+     */
+    void insert(const value_type& interval);
+
+    /**
+     * \brief Removes the given interval from this set
+     *
+     * \param interval The interval to be removed
+     */
+    void erase(const value_type& interval);
+
+    /**
+     * \brief Removes every interval from this set
+     */
+    void clear();
+
+    /**
+     * \brief Indicates whether the given interval is fully contained in this set
+     *
+     * \param interval The interval to be checked
+     */
+    bool contains(const value_type& interval) const;
+
+    /**
+     * Indicates whether this set is empty
+     */
+    bool empty() const;
+
+    /**
+     * \brief Retrieves the amount of sequence numbers contained in this set
+     */
+    size_t size() const;
+
+    /**
+     * \brief Retrieves the amount of disjoint intervals in this set
+     */
+    size_t iterative_size() const;
+
+    /**
+     * Retrieves an iterator to the first interval in this set
+     */
+    const_iterator begin() const;
+
+    /**
+     * Retrieves an iterator past the last interval in this set
+     */
+    const_iterator end() const;
+private:
+    bool is_inline() const;
+    value_type* intervals();
+    const value_type* intervals() const;
+    void replace(size_t index, size_t count, const value_type* values,
+                 size_t values_count);
+
+    value_type inline_intervals_[INLINE_CAPACITY];
+    std::vector<value_type> heap_intervals_;
+    uint32_t inline_size_;
+};
+
 /**
  * \brief Allows tracking acknowledged intervals in a TCP stream
  */
@@ -96,7 +248,7 @@ public:
     /**
      * The type used to store ACKed intervals
      */
-    typedef boost::icl::interval_set<uint32_t> interval_set_type;
+    typedef SackIntervalSet interval_set_type;
 
     /**
      * Default constructor
@@ -138,6 +290,22 @@ public:
      * \param length The segment's length
      */
     bool is_segment_acked(uint32_t sequence_number, uint32_t length) const;
+
+    /**
+     * \brief Writes this tracker's state into the given stream
+     *
+     * \param output The stream in which to write the state
+     * \sa StreamFollower::serialize_state
+     */
+    void serialize_state(Memory::OutputBufferStream& output) const;
+
+    /**
+     * \brief Restores this tracker's state from the given stream
+     *
+     * \param input The stream from which to read the state
+     * \sa StreamFollower::restore_state
+     */
+    void restore_state(Memory::InputMemoryStream& input);
 private:
     void process_sack(const std::vector<uint32_t>& sack);
     void cleanup_sacked_intervals(uint32_t old_ack, uint32_t new_ack);
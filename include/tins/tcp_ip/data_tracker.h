@@ -32,6 +32,7 @@
 
 #include <vector>
 #include <map>
+#include <memory>
 #include <stdint.h>
 #include <tins/config.h>
 #include <tins/macros.h>
@@ -39,13 +40,26 @@
 #ifdef TINS_HAVE_TCPIP
 
 namespace Tins {
+
+namespace Memory {
+class InputMemoryStream;
+class OutputBufferStream;
+} // Memory
+
 namespace TCPIP {
 
+class SpillFile;
+
 /**
  * \class DataTracker
  *
  * Stores and tracks data in a TCP stream, reassembling segments, handling 
  * out of order packets, etc.
+ *
+ * Optionally, out of order payload can be spilled to a memory-mapped 
+ * temporary file whenever the buffered data exceeds a threshold. Spilled
+ * chunks are transparently read back once the hole before them is filled.
+ * See DataTracker::enable_spilling.
  */
 class TINS_API DataTracker {
 public:
@@ -141,17 +155,98 @@ public:
     buffered_payload_type& buffered_payload();
 
     /**
-     * Retrieves the total amount of buffered bytes
+     * \brief Retrieves the total amount of buffered bytes
+     *
+     * This doesn't include the bytes that were spilled to disk.
      */
     uint32_t total_buffered_bytes() const;
+
+    /**
+     * \brief Enables spilling buffered payload to disk
+     *
+     * Once enabled, whenever the amount of bytes kept in memory for out of
+     * order chunks exceeds the given threshold, the chunks that are the 
+     * furthest away from the current sequence number are moved to a temporary
+     * memory-mapped file. These chunks are read back into memory as soon as
+     * the current sequence number reaches them.
+     *
+     * If the file reaches its maximum size, data is kept in memory as if
+     * spilling was disabled.
+     *
+     * Spilled chunks are not part of the buffered payload and are not 
+     * accounted for by DataTracker::total_buffered_bytes.
+     *
+     * Copies of a DataTracker share the same file.
+     *
+     * If spilling is not supported in this platform, then this method
+     * will throw feature_disabled.
+     *
+     * \param memory_threshold The maximum amount of buffered bytes kept in memory
+     * \param max_spilled_bytes The maximum size of the temporary file
+     */
+    void enable_spilling(uint32_t memory_threshold, uint64_t max_spilled_bytes);
+
+    /**
+     * \brief Indicates whether spilling buffered payload to disk is enabled
+     */
+    bool spilling_enabled() const;
+
+    /**
+     * \brief Retrieves the amount of buffered bytes currently spilled to disk
+     */
+    uint64_t total_spilled_bytes() const;
+
+    /**
+     * \brief Retrieves the amount of chunks currently spilled to disk
+     */
+    size_t spilled_chunks() const;
+
+    /**
+     * \brief Writes this tracker's state into the given stream
+     *
+     * This includes the available payload, every buffered chunk (including
+     * spilled ones) and the spilling settings.
+     *
+     * \param output The stream in which to write the state
+     * \sa StreamFollower::serialize_state
+     */
+    void serialize_state(Memory::OutputBufferStream& output) const;
+
+    /**
+     * \brief Restores this tracker's state from the given stream
+     *
+     * \param input The stream from which to read the state
+     * \sa StreamFollower::restore_state
+     */
+    void restore_state(Memory::InputMemoryStream& input);
 private:
+    struct spilled_chunk {
+        spilled_chunk(uint64_t offset = 0, uint32_t size = 0)
+        : offset(offset), size(size) {
+
+        }
+
+        uint64_t offset;
+        uint32_t size;
+    };
+
+    typedef std::map<uint32_t, spilled_chunk> spilled_payload_type;
+
     void store_payload(uint32_t seq, payload_type payload);
     buffered_payload_type::iterator erase_iterator(buffered_payload_type::iterator iter);
+    bool consume_buffered_payload();
+    void spill_payload();
+    bool read_spilled_payload();
+    void clear_spill_file();
 
     payload_type payload_;
     buffered_payload_type buffered_payload_;
+    spilled_payload_type spilled_payload_;
+    std::shared_ptr<SpillFile> spill_file_;
     uint32_t seq_number_;
     uint32_t total_buffered_bytes_;
+    uint32_t spill_threshold_;
+    uint64_t total_spilled_bytes_;
 };
 
 } // TCPIP
@@ -40,6 +40,7 @@
 #include <tins/macros.h>
 #include <tins/tcp_ip/ack_tracker.h>
 #include <tins/tcp_ip/data_tracker.h>
+#include <tins/tcp_ip/spill_file.h>
 
 namespace Tins {
 
@@ -156,12 +157,25 @@ public:
      * If this packet contains out-of-order data, it will be buffered and the
      * buffering_callback will be executed.
      *
+     * The payload is moved out of the packet's RawPDU, so it's empty
+     * after this call.
+     *
      * \param pdu The packet to be processed
      * \sa Flow::data_callback
      * \sa Flow::buffering_callback
      */
     void process_packet(PDU& pdu);
 
+    /**
+     * \brief Processes a packet without modifying it.
+     *
+     * This is the same as Flow::process_packet(PDU&), except that the 
+     * payload is copied rather than moved out of the packet.
+     *
+     * \param pdu The packet to be processed
+     */
+    void process_packet(const PDU& pdu);
+
     /**
      * \brief Skip forward to a sequence number
      *
@@ -257,6 +271,37 @@ public:
      */
     uint32_t total_buffered_bytes() const;
 
+    /**
+     * \brief Enables spilling buffered payload to a temporary file
+     *
+     * Once the out of order data kept in memory exceeds the given threshold,
+     * the chunks that are the furthest away from this flow's sequence number
+     * will be moved to a memory-mapped temporary file and read back once
+     * the hole before them is filled. 
+     *
+     * Spilled bytes are not part of Flow::buffered_payload nor are they
+     * accounted for in Flow::total_buffered_bytes.
+     *
+     * If spilling is not supported in this platform, then this method
+     * will throw feature_disabled.
+     *
+     * \param memory_threshold The maximum amount of buffered bytes kept in memory
+     * \param max_spilled_bytes The maximum amount of bytes stored in the file
+     * \sa DataTracker::enable_spilling
+     */
+    void enable_spilling(uint32_t memory_threshold,
+                         uint64_t max_spilled_bytes = SpillFile::DEFAULT_MAX_SIZE);
+
+    /**
+     * \brief Indicates whether spilling buffered payload is enabled
+     */
+    bool spilling_enabled() const;
+
+    /**
+     * Retrieves this flow's amount of buffered bytes spilled to disk
+     */
+    uint64_t total_spilled_bytes() const;
+
     /**
      * Sets the state of this flow
      *
@@ -272,6 +317,13 @@ public:
      */
     void ignore_data_packets();
 
+    /**
+     * \brief Indicates whether this flow is ignoring data packets
+     *
+     * \sa Flow::ignore_data_packets
+     */
+    bool data_packets_ignored() const;
+
     /**
      * \brief Returns the MSS for this Flow.
      *
@@ -287,8 +339,7 @@ public:
     /** 
      * \brief Enables tracking of ACK numbers
      *
-     * This requires having the boost.icl library. If the library is not installed
-     * or ACK tracking was disabled when compiling the library, then this method
+     * If ACK tracking was disabled when compiling the library, then this method
      * will throw an exception.
      */
     void enable_ack_tracking();
@@ -309,6 +360,24 @@ public:
      */
     AckTracker& ack_tracker();
     #endif // TINS_HAVE_ACK_TRACKER
+
+    /**
+     * \brief Writes this flow's state into the given stream
+     *
+     * Callbacks are not part of the state.
+     *
+     * \param output The stream in which to write the state
+     * \sa StreamFollower::serialize_state
+     */
+    void serialize_state(Memory::OutputBufferStream& output) const;
+
+    /**
+     * \brief Restores this flow's state from the given stream
+     *
+     * \param input The stream from which to read the state
+     * \sa StreamFollower::restore_state
+     */
+    void restore_state(Memory::InputMemoryStream& input);
 private:
     // Compress all flags into just one struct using bitfields 
     struct flags {
@@ -323,6 +392,7 @@ private:
     };
 
     void update_state(const TCP& tcp);
+    void process_packet(const PDU& pdu, payload_type* movable_payload);
     void initialize();
 
     DataTracker data_tracker_;
@@ -0,0 +1,202 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TINS_TCP_IP_FLOW_BYPASS_TABLE_H
+#define TINS_TCP_IP_FLOW_BYPASS_TABLE_H
+
+#include <tins/config.h>
+
+#ifdef TINS_HAVE_TCPIP
+
+#include <unordered_map>
+#include <stdint.h>
+#include <tins/macros.h>
+#include <tins/pdu.h>
+#include <tins/tcp_ip/stream_identifier.h>
+
+namespace Tins {
+namespace TCPIP {
+
+class Stream;
+
+/**
+ * \brief Allows dropping packets that belong to uninteresting flows before decoding them
+ *
+ * This class keeps track of the flows whose packets don't need to be processed
+ * anymore. These are either streams for which one or both directions' data is
+ * being ignored or streams that were terminated by a StreamFollower.
+ *
+ * Lookups are done on the raw packet bytes so they can be performed before
+ * building any PDU. Packets carrying the SYN, FIN or RST flags are never
+ * bypassed for streams that are still being followed, so their state keeps
+ * being tracked. For terminated streams, only SYN packets without the ACK flag
+ * are let through so a new connection reusing the same endpoints can be
+ * followed.
+ *
+ * A StreamFollower keeps an instance of this class updated. This can then be
+ * given to a sniffer via BaseSniffer::set_flow_bypass_table or checked
+ * manually:
+ *
+ * \code
+ * StreamFollower follower;
+ * FlowBypassTable& bypass_table = follower.flow_bypass_table();
+ *
+ * // Somewhere in the capture path
+ * if (!bypass_table.should_bypass(buffer, size, PDU::ETHERNET_II)) {
+ *     EthernetII packet(buffer, size);
+ *     follower.process_packet(packet);
+ * }
+ * \endcode
+ */
+class TINS_API FlowBypassTable {
+public:
+    /**
+     * The type used to identify streams
+     */
+    typedef StreamIdentifier stream_id;
+
+    /**
+     * Default constructs an empty table
+     */
+    FlowBypassTable();
+
+    /**
+     * \brief Updates the entry for the given stream
+     *
+     * The data sent by the client or the server will be bypassed if the
+     * corresponding Flow is ignoring data packets and isn't tracking ACKs,
+     * since the ACK tracker needs every packet in its direction. If neither 
+     * direction can be bypassed, then the entry is removed.
+     *
+     * \param stream The stream to be updated
+     * \sa Flow::ignore_data_packets
+     * \sa Flow::enable_ack_tracking
+     */
+    void update(const Stream& stream);
+
+    /**
+     * \brief Bypasses every packet in a stream
+     *
+     * This is meant to be used for streams that are no longer followed.
+     * Entries created this way expire if no packet is bypassed in between
+     * two calls to FlowBypassTable::expire_inactive.
+     *
+     * \param id The identifier of the stream to be bypassed
+     */
+    void bypass(const stream_id& id);
+
+    /**
+     * \brief Removes the entry for a stream, if any
+     *
+     * \param id The identifier of the stream to be removed
+     */
+    void remove(const stream_id& id);
+
+    /**
+     * \brief Indicates whether a raw packet should be bypassed
+     *
+     * Only TCP over IPv4 and IPv6 is inspected, using either EthernetII
+     * (including 802.1Q tags), SLL, Loopback or no link layer at all.
+     * Packets that can't be parsed are never bypassed.
+     *
+     * \param buffer The packet's buffer
+     * \param total_sz The packet's size
+     * \param link_layer The type of the first layer in the packet. This should
+     * be PDU::IP or PDU::IPv6 if the packet starts at the network layer.
+     */
+    bool should_bypass(const uint8_t* buffer, uint32_t total_sz,
+                       PDU::PDUType link_layer);
+
+    /**
+     * \brief Indicates whether any packet in a stream was bypassed since
+     * the last call to FlowBypassTable::expire_inactive
+     *
+     * \param id The stream identifier
+     */
+    bool is_active(const stream_id& id) const;
+
+    /**
+     * \brief Removes inactive bypassed streams
+     *
+     * This removes every entry added using FlowBypassTable::bypass that hasn't
+     * been used since the previous call to this method and resets the activity
+     * of the rest of them.
+     */
+    void expire_inactive();
+
+    /**
+     * Retrieves the amount of entries in this table
+     */
+    size_t size() const;
+
+    /**
+     * Indicates whether this table is empty
+     */
+    bool empty() const;
+
+    /**
+     * Retrieves the number of packets bypassed so far
+     */
+    uint64_t bypassed_packets() const;
+private:
+    struct entry {
+        entry() : client_port(0), bypass_client(false), bypass_server(false),
+                  bypass_all(false), active(false) {
+
+        }
+
+        stream_id::address_type client_addr;
+        uint16_t client_port;
+        bool bypass_client;
+        bool bypass_server;
+        bool bypass_all;
+        bool active;
+    };
+
+    struct stream_id_hash {
+        size_t operator()(const stream_id& id) const;
+    };
+
+    typedef std::unordered_map<stream_id, entry, stream_id_hash> entries_type;
+
+    bool should_bypass_ip(const uint8_t* buffer, uint32_t total_sz);
+    bool should_bypass_tcp(const stream_id::address_type& src_addr,
+                           const stream_id::address_type& dst_addr,
+                           const uint8_t* buffer, uint32_t total_sz);
+
+    entries_type entries_;
+    uint64_t bypassed_packets_;
+};
+
+} // TCPIP
+} // Tins
+
+#endif // TINS_HAVE_TCPIP
+
+#endif // TINS_TCP_IP_FLOW_BYPASS_TABLE_H
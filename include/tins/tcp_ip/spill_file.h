@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TINS_TCP_IP_SPILL_FILE_H
+#define TINS_TCP_IP_SPILL_FILE_H
+
+#include <stdint.h>
+#include <tins/config.h>
+#include <tins/macros.h>
+
+#ifdef TINS_HAVE_TCPIP
+
+namespace Tins {
+namespace TCPIP {
+
+/**
+ * \class SpillFile
+ *
+ * \brief Append-only, memory-mapped temporary file used to store payload
+ * that doesn't fit in memory
+ *
+ * The underlying file is created lazily on the first write and is removed
+ * from the file system as soon as it's created, so it's released when
+ * this object is destroyed.
+ *
+ * Data is always appended at the end of the file. Once every chunk written
+ * to the file has been read back, SpillFile::clear can be used to reclaim
+ * the space used.
+ *
+ * Spilling is only supported on POSIX systems. On any other platform, 
+ * SpillFile::write will always fail.
+ */
+class TINS_API SpillFile {
+public:
+    /**
+     * The default maximum size of the file, 256MB
+     */
+    static const uint64_t DEFAULT_MAX_SIZE;
+
+    /**
+     * \brief Constructs a spill file
+     *
+     * \param max_size The maximum amount of bytes that can be stored in the file
+     */
+    SpillFile(uint64_t max_size = DEFAULT_MAX_SIZE);
+
+    /**
+     * Destructor. Unmaps and closes the underlying file
+     */
+    ~SpillFile();
+
+    /**
+     * \brief Appends data to the file
+     *
+     * \param data The data to be written
+     * \param size The size of the data
+     * \param offset The offset at which the data was written
+     * \return true iff the data was written. Writing fails if the file can't
+     * be created, if the maximum size would be exceeded or if there's no 
+     * disk space left to grow the file
+     */
+    bool write(const uint8_t* data, uint32_t size, uint64_t& offset);
+
+    /**
+     * \brief Reads data previously written to the file
+     *
+     * \param offset The offset returned by SpillFile::write
+     * \param size The size of the data to read
+     * \param output The buffer in which to copy the data
+     */
+    void read(uint64_t offset, uint32_t size, uint8_t* output) const;
+
+    /**
+     * \brief Discards everything written to the file
+     *
+     * Any offset previously returned by SpillFile::write becomes invalid.
+     */
+    void clear();
+
+    /**
+     * Retrieves the amount of bytes written to the file
+     */
+    uint64_t size() const;
+
+    /**
+     * Retrieves the maximum amount of bytes that can be written to the file
+     */
+    uint64_t max_size() const;
+private:
+    SpillFile(const SpillFile&);
+    SpillFile& operator=(const SpillFile&);
+
+    bool open();
+    bool reserve(uint64_t size);
+    void unmap();
+
+    int fd_;
+    uint8_t* mapping_;
+    uint64_t capacity_;
+    uint64_t size_;
+    uint64_t max_size_;
+};
+
+} // TCPIP
+} // Tins
+
+#endif // TINS_HAVE_TCPIP
+
+#endif // TINS_TCP_IP_SPILL_FILE_H
@@ -105,13 +105,22 @@ public:
     typedef HWAddress<6> hwaddress_type;
 
 
+    /**
+     * \brief Default constructs an empty stream
+     *
+     * This is only useful to restore a stream's state afterwards. 
+     *
+     * \sa Stream::restore_state
+     */
+    Stream();
+
     /**
      * \brief Constructs a TCP stream using the provided packet.
      * 
      * \param initial_packet The first packet of the stream
      * \param ts The first packet's timestamp
      */
-    Stream(PDU& initial_packet, const timestamp_type& ts = timestamp_type());
+    Stream(const PDU& initial_packet, const timestamp_type& ts = timestamp_type());
 
     /**
      * \brief Processes this packet.
@@ -134,6 +143,17 @@ public:
      */
     void process_packet(PDU& packet);
 
+    /**
+     * \brief Processes this packet without modifying it.
+     *
+     * The payload is copied rather than moved out of the packet.
+     *
+     * \param packet The packet to be processed
+     * \param ts The packet's timestamp
+     * \sa Flow::process_packet(const PDU&)
+     */
+    void process_packet(const PDU& packet, const timestamp_type& ts);
+
     /**
      * Getter for the client flow
      */
@@ -369,6 +389,20 @@ public:
      */
     bool ack_tracking_enabled() const;
 
+    /**
+     * \brief Enables spilling buffered payload to disk on both flows
+     *
+     * Each flow uses its own temporary file.
+     *
+     * \param memory_threshold The maximum amount of buffered bytes each flow 
+     * keeps in memory
+     * \param max_spilled_bytes The maximum amount of bytes each flow stores
+     * in its file
+     * \sa Flow::enable_spilling
+     */
+    void enable_spilling(uint32_t memory_threshold,
+                         uint64_t max_spilled_bytes = SpillFile::DEFAULT_MAX_SIZE);
+
     #ifdef TINS_HAVE_TCP_STREAM_CUSTOM_DATA
     /**
      * \brief Create or retrieve an application-specific payload for this stream.
@@ -423,10 +457,34 @@ public:
      * packet that is outside of the recovery window.
      */
     bool is_recovery_mode_enabled() const;
+
+    /**
+     * \brief Writes this stream's state into the given stream
+     *
+     * This includes both flows' state, the hardware addresses, timestamps 
+     * and the auto cleanup settings. Callbacks, recovery mode and custom 
+     * user data are not part of the state.
+     *
+     * \param output The stream in which to write the state
+     * \sa StreamFollower::serialize_state
+     */
+    void serialize_state(Memory::OutputBufferStream& output) const;
+
+    /**
+     * \brief Restores this stream's state from the given stream
+     *
+     * Callbacks have to be set again after calling this method.
+     *
+     * \param input The stream from which to read the state
+     * \sa StreamFollower::restore_state
+     */
+    void restore_state(Memory::InputMemoryStream& input);
 private:
     static Flow extract_client_flow(const PDU& packet);
     static Flow extract_server_flow(const PDU& packet);
 
+    void process_packet(const PDU& packet, PDU* mutable_packet, const timestamp_type& ts);
+
     void on_client_flow_data(const Flow& flow);
     void on_server_flow_data(const Flow& flow);
     void on_client_out_of_order(const Flow& flow,
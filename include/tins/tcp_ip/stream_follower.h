@@ -35,8 +35,10 @@
 #ifdef TINS_HAVE_TCPIP
 
 #include <map>
+#include <vector>
 #include <tins/tcp_ip/stream.h>
 #include <tins/tcp_ip/stream_identifier.h>
+#include <tins/tcp_ip/flow_bypass_table.h>
 
 namespace Tins {
 
@@ -93,7 +95,8 @@ public:
     enum TerminationReason {
         TIMEOUT, ///< The stream was terminated due to a timeout
         BUFFERED_DATA, ///< The stream was terminated because it had too much buffered data
-        SACKED_SEGMENTS ///< The stream was terminated because it had too many SACKed segments
+        SACKED_SEGMENTS, ///< The stream was terminated because it had too many SACKed segments
+        MEMORY_BUDGET ///< The stream was evicted because the follower exceeded its memory budget
     };
 
     /**
@@ -126,10 +129,31 @@ public:
      * and process it, or if it belongs to a new one, in which case it
      * starts tracking it.
      *
+     * If the packet's PDU is shared with other Packets, it's processed
+     * without being modified, which avoids cloning it.
+     *
      * \param packet The packet to be processed
      */
     void process_packet(Packet& packet);
 
+    /** 
+     * \brief Processes a packet without modifying it
+     *
+     * This is the same as StreamFollower::process_packet(PDU&), except that
+     * the payload is copied rather than moved out of the packet.
+     *
+     * \param packet The packet to be processed
+     */
+    void process_packet(const PDU& packet);
+
+    /** 
+     * \brief Processes a packet without modifying it
+     *
+     * \param packet The packet to be processed
+     * \sa StreamFollower::process_packet(const PDU&)
+     */
+    void process_packet(const Packet& packet);
+
     /**
      * \brief Sets the callback to be executed when a new stream is captured.
      *
@@ -147,6 +171,7 @@ public:
      *
      * * It contains too much buffered data.
      * * No packets have been seen for some time interval.
+     * * It was evicted to keep the follower within its memory budget.
      *
      * \param callback The callback to be executed on stream termination
      * \sa StreamFollower::stream_keep_alive
@@ -205,6 +230,100 @@ public:
      * \sa Stream::enable_recovery_mode
      */
     void follow_partial_streams(bool value);
+
+    /**
+     * \brief Sets the maximum amount of buffered bytes across all streams.
+     *
+     * Each stream is already bounded by its own buffered data limits. This
+     * sets a budget on the out of order data buffered by all streams tracked
+     * by this follower.
+     *
+     * Whenever the budget is exceeded, the least recently seen streams that
+     * have buffered data will be terminated, using MEMORY_BUDGET as the
+     * termination reason, until the buffered bytes go down to 3/4 of the
+     * budget.
+     *
+     * A budget of 0, which is the default value, means no budget is enforced.
+     *
+     * \param value The maximum amount of buffered bytes
+     */
+    void max_total_buffered_bytes(uint64_t value);
+
+    /**
+     * \brief Retrieves the maximum amount of buffered bytes across all streams
+     *
+     * \sa StreamFollower::max_total_buffered_bytes
+     */
+    uint64_t max_total_buffered_bytes() const;
+
+    /**
+     * \brief Retrieves the amount of out of order bytes buffered by all streams
+     *
+     * This value is updated every time a packet is processed. Changes done
+     * to a stream's buffered payload outside of packet processing will only
+     * be accounted for the next time the memory budget is checked.
+     */
+    uint64_t total_buffered_bytes() const;
+
+    /**
+     * \brief Retrieves the number of streams evicted due to the memory budget
+     */
+    uint64_t memory_budget_evictions() const;
+
+    /**
+     * \brief Retrieves the table of flows whose packets can be skipped
+     *
+     * This table contains the streams for which either the client or server
+     * data is being ignored, as well as streams terminated due to too much
+     * buffered data. Checking it on the capture path allows dropping packets
+     * that would be discarded anyway before decoding them.
+     *
+     * Streams for which packets keep being bypassed won't time out.
+     *
+     * \sa BaseSniffer::set_flow_bypass_table
+     */
+    FlowBypassTable& flow_bypass_table();
+
+    /**
+     * \brief Serializes the state of every stream being followed
+     *
+     * The snapshot contains, for each stream, the state, sequence numbers,
+     * available and buffered payload, ACK tracking intervals and timestamps 
+     * of both of its flows. This allows restarting an application without
+     * losing track of the streams that were active.
+     *
+     * Callbacks, recovery mode and custom user data are not part of the 
+     * snapshot. The snapshot is meant to be restored on the same host, as
+     * it's not portable across library versions.
+     *
+     * \sa StreamFollower::restore_state
+     */
+    std::vector<uint8_t> serialize_state() const;
+
+    /**
+     * \brief Restores the streams stored in a snapshot
+     *
+     * Every stream currently being followed is discarded and replaced by the
+     * ones in the snapshot. The new stream callback is executed for each 
+     * restored stream so callbacks can be set on them again. This means the
+     * new stream callback has to be set before calling this method.
+     *
+     * If the snapshot is invalid, an invalid_stream_snapshot exception is
+     * thrown and the current streams are left untouched.
+     *
+     * \param buffer The buffer containing the snapshot
+     * \param total_sz The size of the buffer
+     * \sa StreamFollower::serialize_state
+     */
+    void restore_state(const uint8_t* buffer, uint32_t total_sz);
+
+    /**
+     * \brief Restores the streams stored in a snapshot
+     *
+     * \param snapshot The snapshot to restore
+     * \sa StreamFollower::restore_state(const uint8_t*, uint32_t)
+     */
+    void restore_state(const std::vector<uint8_t>& snapshot);
 private:
     typedef Stream::timestamp_type timestamp_type;
 
@@ -216,16 +335,24 @@ private:
     typedef std::map<stream_id, Stream> streams_type;
 
     Stream& find_stream(const stream_id& id);
-    void process_packet(PDU& packet, const timestamp_type& ts);
+    static timestamp_type current_time();
+
+    void process_packet(const PDU& packet, PDU* mutable_packet, const timestamp_type& ts);
     void cleanup_streams(const timestamp_type& now);
+    void enforce_memory_budget();
+    void erase_stream(streams_type::iterator iter);
 
     streams_type streams_;
+    FlowBypassTable bypass_table_;
     stream_callback_type on_new_connection_;
     stream_termination_callback_type on_stream_termination_;
     size_t max_buffered_chunks_;
     uint32_t max_buffered_bytes_;
     timestamp_type last_cleanup_;
     timestamp_type stream_keep_alive_;
+    uint64_t max_total_buffered_bytes_;
+    uint64_t total_buffered_bytes_;
+    uint64_t memory_budget_evictions_;
     bool attach_to_flows_;
 };
 
@@ -75,6 +75,17 @@
 #include <tins/pdu_allocator.h>
 #include <tins/ipsec.h>
 #include <tins/ip_reassembler.h>
+#include <tins/ipv6_reassembler.h>
+#include <tins/dns_tracker.h>
+#include <tins/safe_decoder.h>
+#include <tins/stack_decoder.h>
+#include <tins/routing_table.h>
+#include <tins/neighbor_cache.h>
+#include <tins/interface_cache.h>
+#include <tins/address_set.h>
+#include <tins/buffered_packet_writer.h>
+#include <tins/pcap_index.h>
+#include <tins/parallel_decrypter.h>
 #include <tins/ppi.h>
 #include <tins/pdu_iterator.h>
 
@@ -70,6 +70,10 @@ TINS_API IPv6Address resolve_domain6(const std::string& to_resolve);
  * If the address can't be resolved, a std::runtime_error
  * exception is thrown.
  * 
+ * Resolved addresses are kept in the process wide NeighborCache
+ * returned by Utils::neighbor_cache, so only the first lookup for
+ * each address hits the network.
+ *
  * \param iface The interface in which the packet will be sent.
  * \param ip The ip to resolve, in integer format.
  * \param sender The sender to use to send and receive the ARP requests.
@@ -137,6 +137,9 @@ TINS_API std::set<std::string> network_interfaces();
  * \brief Finds the gateway's IP address for the given IP 
  * address.
  * 
+ * The gateway is taken from the most specific route for this address,
+ * as found by Utils::route_from_ip.
+ *
  * \param ip The IP address for which the default gateway will
  * be searched.
  * \param gw_addr This parameter will contain the gateway's IP
@@ -146,6 +149,36 @@ TINS_API std::set<std::string> network_interfaces();
  */
 TINS_API bool gateway_from_ip(IPv4Address ip, IPv4Address& gw_addr);
 
+/**
+ * \brief Finds the most specific route for the given IPv4 address.
+ *
+ * This uses a process wide RoutingTable, so the system's routing table
+ * is not read again on every call. The cached table is kept up to date
+ * automatically.
+ *
+ * \param ip The address to be looked up.
+ * \param route This parameter will contain the route in case it's found.
+ * \return bool indicating whether the lookup was successful.
+ */
+TINS_API bool route_from_ip(IPv4Address ip, RouteEntry& route);
+
+/**
+ * \brief Finds the most specific route for the given IPv6 address.
+ *
+ * \sa Utils::route_from_ip(IPv4Address, RouteEntry&)
+ *
+ * \param ip The address to be looked up.
+ * \param route This parameter will contain the route in case it's found.
+ * \return bool indicating whether the lookup was successful.
+ */
+TINS_API bool route_from_ip(const IPv6Address& ip, Route6Entry& route);
+
+/**
+ * \brief Forces the routing table used by Utils::route_from_ip to be 
+ * reloaded the next time it's used.
+ */
+TINS_API void invalidate_route_cache();
+
 } // Utils
 } // Tins
 
@@ -0,0 +1,487 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <tins/buffered_packet_writer.h>
+
+#if TINS_IS_CXX11
+
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+#include <algorithm>
+#ifndef _WIN32
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/uio.h>
+#endif // _WIN32
+#include <tins/pdu.h>
+#include <tins/packet.h>
+#include <tins/exceptions.h>
+
+using std::string;
+using std::vector;
+using std::min;
+using std::max;
+using std::mutex;
+using std::unique_lock;
+using std::lock_guard;
+using std::thread;
+using std::memcpy;
+using std::strerror;
+
+namespace Tins {
+
+namespace {
+
+// The pcap file and record headers, as described in 
+// https://wiki.wireshark.org/Development/LibpcapFileFormat
+const uint32_t PCAP_MAGIC = 0xa1b2c3d4;
+const uint16_t PCAP_VERSION_MAJOR = 2;
+const uint16_t PCAP_VERSION_MINOR = 4;
+const size_t FILE_HEADER_SIZE = 24;
+const size_t RECORD_HEADER_SIZE = 16;
+const size_t BUFFER_ALIGNMENT = 4096;
+// The minimum IOV_MAX allowed by POSIX
+const size_t MAX_IOVECS = 16;
+
+void write_uint16(uint8_t* buffer, uint16_t value) {
+    memcpy(buffer, &value, sizeof(value));
+}
+
+void write_uint32(uint8_t* buffer, uint32_t value) {
+    memcpy(buffer, &value, sizeof(value));
+}
+
+string error_message(const string& prefix, const string& file_name) {
+    return prefix + " " + file_name + ": " + strerror(errno);
+}
+
+} // anonymous namespace
+
+BufferedPacketWriter::options::options()
+: buffer_size(1024 * 1024), buffer_count(8), snap_length(65535), rotate_size(0), 
+  rotate_interval(0), max_files(0), drop_when_full(false), write_index(false) {
+
+}
+
+BufferedPacketWriter::BufferedPacketWriter(const string& file_name, int link_type,
+                                           const options& opts) {
+    init(file_name, link_type, opts);
+}
+
+BufferedPacketWriter::~BufferedPacketWriter() {
+    stop();
+}
+
+void BufferedPacketWriter::init(const string& file_name, int link_type,
+                                const options& opts) {
+    #ifdef _WIN32
+        throw feature_disabled();
+    #else
+        options_ = opts;
+        options_.buffer_count = max<size_t>(options_.buffer_count, 1);
+        // Any record, along with a file header, must fit in a single buffer
+        const size_t min_size = FILE_HEADER_SIZE + RECORD_HEADER_SIZE + options_.snap_length;
+        size_t buffer_size = max(options_.buffer_size, min_size);
+        buffer_size = (buffer_size + BUFFER_ALIGNMENT - 1) / BUFFER_ALIGNMENT * BUFFER_ALIGNMENT;
+        options_.buffer_size = buffer_size;
+
+        base_name_ = file_name;
+        link_type_ = link_type;
+        active_ = 0;
+        file_size_ = FILE_HEADER_SIZE;
+        file_start_ = 0;
+        file_index_ = 0;
+        file_started_ = false;
+        packets_written_ = 0;
+        packets_dropped_ = 0;
+        index_ = PcapIndex(link_type);
+        record_offset_ = 0;
+        buffers_in_flight_ = 0;
+        stopping_ = false;
+        closed_ = false;
+        fd_ = -1;
+
+        // The first file is created right away so errors are reported here
+        current_file_name_ = make_file_name(Timestamp::current_time());
+        if (!open_file(current_file_name_)) {
+            throw file_write_error(error_message("Failed to create", current_file_name_));
+        }
+        uint8_t header[FILE_HEADER_SIZE];
+        write_file_header(header);
+        if (::write(fd_, header, sizeof(header)) != static_cast<ssize_t>(sizeof(header))) {
+            const string message = error_message("Failed to write to", current_file_name_);
+            ::close(fd_);
+            throw file_write_error(message);
+        }
+
+        buffers_.resize(options_.buffer_count);
+        for (size_t i = 0; i < buffers_.size(); ++i) {
+            buffers_[i].data.resize(buffer_size);
+            buffers_[i].size = 0;
+            free_buffers_.push_back(&buffers_[i]);
+        }
+        active_ = free_buffers_.back();
+        free_buffers_.pop_back();
+        thread_ = thread(&BufferedPacketWriter::run, this);
+    #endif // _WIN32
+}
+
+void BufferedPacketWriter::write(PDU& pdu) {
+    write(pdu, Timestamp::current_time());
+}
+
+void BufferedPacketWriter::write(Packet& packet) {
+    write(*packet.pdu(), packet.timestamp());
+}
+
+void BufferedPacketWriter::write(PDU& pdu, const Timestamp& ts) {
+    const uint32_t size = pdu.size();
+    if (size <= options_.snap_length) {
+        uint8_t* buffer = reserve(size, size, ts);
+        if (buffer) {
+            pdu.serialize(buffer, size);
+            if (options_.write_index) {
+                index_.add_record(record_offset_, ts, buffer, size);
+            }
+        }
+    }
+    else {
+        // Only the first snap_length bytes are kept, so this one can't be 
+        // serialized in place
+        const PDU::serialization_type data = pdu.serialize();
+        write(&data[0], size, ts);
+    }
+}
+
+void BufferedPacketWriter::write(const uint8_t* data, uint32_t size, const Timestamp& ts,
+                                 uint32_t original_size) {
+    const uint32_t captured_size = min(size, options_.snap_length);
+    uint8_t* buffer = reserve(captured_size, max(size, original_size), ts);
+    if (buffer) {
+        memcpy(buffer, data, captured_size);
+        if (options_.write_index) {
+            index_.add_record(record_offset_, ts, buffer, captured_size);
+        }
+    }
+}
+
+uint8_t* BufferedPacketWriter::reserve(uint32_t captured_size, uint32_t original_size,
+                                       const Timestamp& ts) {
+    if (closed_) {
+        throw file_write_error("Writer is closed");
+    }
+    check_error();
+    const size_t record_size = RECORD_HEADER_SIZE + captured_size;
+    if (!file_started_) {
+        file_started_ = true;
+        file_start_ = ts.seconds();
+    }
+    else if (rotation_needed(record_size, ts)) {
+        // Files always start at the beginning of a buffer
+        if (active_ && active_->size != 0) {
+            submit_active_buffer();
+        }
+        if (options_.write_index) {
+            save_index();
+        }
+        ++file_index_;
+        current_file_name_ = make_file_name(ts);
+        pending_file_name_ = current_file_name_;
+        file_size_ = FILE_HEADER_SIZE;
+        file_start_ = ts.seconds();
+    }
+    if (active_ && active_->size + record_size > active_->data.size()) {
+        submit_active_buffer();
+    }
+    if (!active_) {
+        active_ = acquire_buffer();
+        if (!active_) {
+            ++packets_dropped_;
+            return 0;
+        }
+    }
+    if (!pending_file_name_.empty()) {
+        active_->file_name.swap(pending_file_name_);
+        pending_file_name_.clear();
+        write_file_header(&active_->data[active_->size]);
+        active_->size += FILE_HEADER_SIZE;
+    }
+    uint8_t* record = &active_->data[active_->size];
+    write_uint32(record, static_cast<uint32_t>(ts.seconds()));
+    write_uint32(record + 4, static_cast<uint32_t>(ts.microseconds()));
+    write_uint32(record + 8, captured_size);
+    write_uint32(record + 12, original_size);
+    active_->size += record_size;
+    record_offset_ = file_size_;
+    file_size_ += record_size;
+    ++packets_written_;
+    return record + RECORD_HEADER_SIZE;
+}
+
+bool BufferedPacketWriter::rotation_needed(size_t record_size, const Timestamp& ts) const {
+    if (options_.rotate_size && file_size_ > FILE_HEADER_SIZE && 
+        file_size_ + record_size > options_.rotate_size) {
+        return true;
+    }
+    // Timestamps could go backwards, hence the signed comparison
+    const int64_t elapsed = static_cast<int64_t>(ts.seconds()) - 
+                            static_cast<int64_t>(file_start_);
+    return options_.rotate_interval && elapsed >= options_.rotate_interval;
+}
+
+string BufferedPacketWriter::make_file_name(const Timestamp& ts) const {
+    string output = base_name_;
+    if (options_.rotate_interval) {
+        const time_t seconds = static_cast<time_t>(ts.seconds());
+        tm local_time;
+        #ifndef _WIN32
+            localtime_r(&seconds, &local_time);
+        #else
+            localtime_s(&local_time, &seconds);
+        #endif // _WIN32
+        char buffer[1024];
+        const size_t length = strftime(buffer, sizeof(buffer), base_name_.c_str(), &local_time);
+        if (length != 0) {
+            output.assign(buffer, length);
+        }
+    }
+    if (options_.rotate_size) {
+        if (options_.max_files) {
+            output += std::to_string(file_index_ % options_.max_files);
+        }
+        else if (file_index_ != 0) {
+            output += std::to_string(file_index_);
+        }
+    }
+    return output;
+}
+
+void BufferedPacketWriter::write_file_header(uint8_t* buffer) const {
+    write_uint32(buffer, PCAP_MAGIC);
+    write_uint16(buffer + 4, PCAP_VERSION_MAJOR);
+    write_uint16(buffer + 6, PCAP_VERSION_MINOR);
+    // Time zone offset and timestamp accuracy
+    write_uint32(buffer + 8, 0);
+    write_uint32(buffer + 12, 0);
+    write_uint32(buffer + 16, options_.snap_length);
+    write_uint32(buffer + 20, static_cast<uint32_t>(link_type_));
+}
+
+void BufferedPacketWriter::submit_active_buffer() {
+    {
+        lock_guard<mutex> _(mutex_);
+        queued_buffers_.push_back(active_);
+        ++buffers_in_flight_;
+    }
+    active_ = 0;
+    work_available_.notify_one();
+}
+
+BufferedPacketWriter::buffer_type* BufferedPacketWriter::acquire_buffer() {
+    unique_lock<mutex> lock(mutex_);
+    if (free_buffers_.empty()) {
+        if (options_.drop_when_full) {
+            return 0;
+        }
+        buffer_available_.wait(lock, [&]() { return !free_buffers_.empty(); });
+    }
+    buffer_type* output = free_buffers_.back();
+    free_buffers_.pop_back();
+    return output;
+}
+
+void BufferedPacketWriter::flush() {
+    if (closed_) {
+        return;
+    }
+    if (active_ && active_->size != 0) {
+        submit_active_buffer();
+    }
+    {
+        unique_lock<mutex> lock(mutex_);
+        buffer_available_.wait(lock, [&]() { return buffers_in_flight_ == 0; });
+    }
+    check_error();
+}
+
+void BufferedPacketWriter::close() {
+    stop();
+    check_error();
+}
+
+void BufferedPacketWriter::stop() {
+    if (closed_) {
+        return;
+    }
+    closed_ = true;
+    if (active_ && active_->size != 0) {
+        submit_active_buffer();
+    }
+    {
+        lock_guard<mutex> _(mutex_);
+        stopping_ = true;
+    }
+    work_available_.notify_one();
+    thread_.join();
+    #ifndef _WIN32
+        if (fd_ != -1) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+    #endif // _WIN32
+    if (options_.write_index) {
+        save_index();
+    }
+}
+
+void BufferedPacketWriter::save_index() {
+    try {
+        index_.save(PcapIndex::index_file_name(current_file_name_));
+    }
+    catch (const file_write_error&) {
+        lock_guard<mutex> _(mutex_);
+        error_ = "Failed to write index for " + current_file_name_;
+    }
+    index_ = PcapIndex(link_type_);
+}
+
+void BufferedPacketWriter::check_error() {
+    lock_guard<mutex> _(mutex_);
+    if (!error_.empty()) {
+        string message;
+        message.swap(error_);
+        throw file_write_error(message);
+    }
+}
+
+const string& BufferedPacketWriter::current_file_name() const {
+    return current_file_name_;
+}
+
+uint64_t BufferedPacketWriter::packets_written() const {
+    return packets_written_;
+}
+
+uint64_t BufferedPacketWriter::packets_dropped() const {
+    return packets_dropped_;
+}
+
+void BufferedPacketWriter::run() {
+    vector<buffer_type*> buffers;
+    unique_lock<mutex> lock(mutex_);
+    while (true) {
+        work_available_.wait(lock, [&]() { 
+            return !queued_buffers_.empty() || stopping_; 
+        });
+        if (queued_buffers_.empty()) {
+            break;
+        }
+        buffers.assign(queued_buffers_.begin(), queued_buffers_.end());
+        queued_buffers_.clear();
+        lock.unlock();
+        write_buffers(buffers);
+        lock.lock();
+        for (size_t i = 0; i < buffers.size(); ++i) {
+            buffers[i]->size = 0;
+            buffers[i]->file_name.clear();
+            free_buffers_.push_back(buffers[i]);
+        }
+        buffers_in_flight_ -= buffers.size();
+        buffer_available_.notify_all();
+    }
+}
+
+void BufferedPacketWriter::write_buffers(const vector<buffer_type*>& buffers) {
+    #ifndef _WIN32
+        size_t index = 0;
+        while (index < buffers.size()) {
+            if (!buffers[index]->file_name.empty()) {
+                if (fd_ != -1) {
+                    ::close(fd_);
+                    fd_ = -1;
+                }
+                if (!open_file(buffers[index]->file_name)) {
+                    lock_guard<mutex> _(mutex_);
+                    error_ = error_message("Failed to create", buffers[index]->file_name);
+                }
+            }
+            // Gather every buffer up to the next file change into a single writev
+            iovec iovecs[MAX_IOVECS];
+            size_t count = 0;
+            do {
+                iovecs[count].iov_base = &buffers[index]->data[0];
+                iovecs[count].iov_len = buffers[index]->size;
+                ++count;
+                ++index;
+            } while (index < buffers.size() && count < MAX_IOVECS && 
+                     buffers[index]->file_name.empty());
+            if (fd_ == -1) {
+                continue;
+            }
+            iovec* current = iovecs;
+            while (count > 0) {
+                const ssize_t result = ::writev(fd_, current, static_cast<int>(count));
+                if (result < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    lock_guard<mutex> _(mutex_);
+                    error_ = error_message("Failed to write to", open_file_name_);
+                    break;
+                }
+                // Skip whatever was written, as writev may stop half way
+                size_t written = static_cast<size_t>(result);
+                while (count > 0 && written >= current->iov_len) {
+                    written -= current->iov_len;
+                    ++current;
+                    --count;
+                }
+                if (count > 0) {
+                    current->iov_base = static_cast<uint8_t*>(current->iov_base) + written;
+                    current->iov_len -= written;
+                }
+            }
+        }
+    #endif // _WIN32
+}
+
+bool BufferedPacketWriter::open_file(const string& file_name) {
+    #ifndef _WIN32
+        fd_ = ::open(file_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        open_file_name_ = file_name;
+        return fd_ != -1;
+    #else
+        return false;
+    #endif // _WIN32
+}
+
+} // Tins
+
+#endif // TINS_IS_CXX11
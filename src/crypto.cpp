@@ -32,10 +32,27 @@
 #ifdef TINS_HAVE_DOT11
 
 #include <algorithm>
+#include <fstream>
+#include <set>
+#include <cstring>
+#include <cstdio>
+#ifndef _WIN32
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/stat.h>
+#else
+    #include <windows.h>
+#endif // _WIN32
 #ifdef TINS_HAVE_WPA2_DECRYPTION
     #include <openssl/evp.h>
     #include <openssl/hmac.h>
-    #include <openssl/aes.h>
+    #include <openssl/rand.h>
+    #if TINS_IS_CXX11
+        #include <thread>
+        #include <atomic>
+        #include <system_error>
+    #endif // TINS_IS_CXX11
 #endif // TINS_HAVE_WPA2_DECRYPTION
 #include <tins/snap.h>
 #include <tins/rawpdu.h>
@@ -55,6 +72,9 @@ using std::max;
 using std::lexicographical_compare;
 using std::fill;
 using std::runtime_error;
+using std::ifstream;
+using std::ofstream;
+using std::ios;
 
 namespace Tins {
 namespace Internals {
@@ -106,13 +126,6 @@ namespace Crypto {
 
 // Helper stuff
 
-template<typename InputIterator1, typename InputIterator2, typename OutputIterator>
-void xor_range(InputIterator1 src1, InputIterator2 src2, OutputIterator dst, size_t sz) {
-    for (size_t i = 0; i < sz; ++i) {
-        *dst++ = *src1++ ^ *src2++;
-    }
-}
-
 const uint16_t sbox_table[2][256]= {
     {
         0xC6A5, 0xF884, 0xEE99, 0xF68D, 0xFF0D, 0xD6BD, 0xDEB1, 0x9154,
@@ -306,14 +319,12 @@ void rc4(ForwardIterator start, ForwardIterator end, RC4Key& key, OutputIterator
 
 // WEPDecrypter
 
-WEPDecrypter::WEPDecrypter() 
-: key_buffer_(4) {
+WEPDecrypter::WEPDecrypter() {
 
 }
 
 void WEPDecrypter::add_password(const address_type& addr, const string& password) {
     passwords_[addr] = password;
-    key_buffer_.resize(max(3 + password.size(), key_buffer_.size()));
 }
 
 void WEPDecrypter::remove_password(const address_type& addr) {
@@ -321,45 +332,69 @@ void WEPDecrypter::remove_password(const address_type& addr) {
 }
 
 bool WEPDecrypter::decrypt(PDU& pdu) {
-    Dot11Data* dot11 = pdu.find_pdu<Dot11Data>();
-    if (dot11) {
-        RawPDU* raw = dot11->find_pdu<RawPDU>();
-        if (raw) {
-            address_type addr;
-            if (!dot11->from_ds() && !dot11->to_ds()) {
-                addr = dot11->addr3();
-            }
-            else if (!dot11->from_ds() && dot11->to_ds()) {
-                addr = dot11->addr1();
-            }
-            else if (dot11->from_ds() && !dot11->to_ds()) {
-                addr = dot11->addr2();
-            }
-            else {
-                // ????
-                addr = dot11->addr3();
-            }
-            passwords_type::iterator it = passwords_.find(addr);
-            if (it != passwords_.end()) {
-                dot11->inner_pdu(decrypt(*raw, it->second));
-                // If its valid, then return true
-                if (dot11->inner_pdu()) {
-                    // it's no longer encrypted.
-                    dot11->wep(0);
-                    return true;
-                }
-            }
+    const string* password = find_password(pdu);
+    return password && frame_decrypter_.decrypt(pdu, *password);
+}
+
+bool WEPDecrypter::find_frame_keys(const PDU& pdu, frame_keys_type& keys) const {
+    const string* password = find_password(pdu);
+    if (!password) {
+        return false;
+    }
+    keys = *password;
+    return true;
+}
+
+const string* WEPDecrypter::find_password(const PDU& pdu) const {
+    const Dot11Data* dot11 = pdu.find_pdu<Dot11Data>();
+    if (dot11 && dot11->find_pdu<RawPDU>()) {
+        address_type addr;
+        if (!dot11->from_ds() && !dot11->to_ds()) {
+            addr = dot11->addr3();
+        }
+        else if (!dot11->from_ds() && dot11->to_ds()) {
+            addr = dot11->addr1();
+        }
+        else if (dot11->from_ds() && !dot11->to_ds()) {
+            addr = dot11->addr2();
+        }
+        else {
+            // ????
+            addr = dot11->addr3();
+        }
+        passwords_type::const_iterator it = passwords_.find(addr);
+        if (it != passwords_.end()) {
+            return &it->second;
         }
     }
+    return 0;
+}
+
+// WEPDecrypter::frame_decrypter
+
+bool WEPDecrypter::frame_decrypter::decrypt(PDU& pdu, const frame_keys_type& keys) {
+    Dot11Data* dot11 = pdu.find_pdu<Dot11Data>();
+    RawPDU* raw = dot11 ? dot11->find_pdu<RawPDU>() : 0;
+    if (!raw) {
+        return false;
+    }
+    dot11->inner_pdu(decrypt(*raw, keys));
+    // If its valid, then return true
+    if (dot11->inner_pdu()) {
+        // it's no longer encrypted.
+        dot11->wep(0);
+        return true;
+    }
     return false;
 }
 
-PDU* WEPDecrypter::decrypt(RawPDU& raw, const string& password) {
+PDU* WEPDecrypter::frame_decrypter::decrypt(RawPDU& raw, const string& password) {
     RawPDU::payload_type& pload = raw.payload();
     // We require at least the IV, the encrypted checksum and something to decrypt
     if (pload.size() <= 8) {
         return 0;
     }
+    key_buffer_.resize(max(3 + password.size(), key_buffer_.size()));
     copy(pload.begin(), pload.begin() + 3, key_buffer_.begin());
     copy(password.begin(), password.end(), key_buffer_.begin() + 3);
 
@@ -387,6 +422,7 @@ PDU* WEPDecrypter::decrypt(RawPDU& raw, const string& password) {
 // WPA2Decrypter
 
 using WPA2::SessionKeys;
+using WPA2::PMKCache;
 
 const HWAddress<6>& min(const HWAddress<6>& lhs, const HWAddress<6>& rhs) {
     return lhs < rhs ? lhs : rhs;
@@ -466,89 +502,8 @@ SessionKeys::SessionKeys(const RSNHandshake& hs, const pmk_type& pmk)
 }
 
 SNAP* SessionKeys::ccmp_decrypt_unicast(const Dot11Data& dot11, RawPDU& raw) const {
-    RawPDU::payload_type& pload = raw.payload();
-    uint8_t MIC[16] = {0};
-    uint8_t PN[6] = {
-        pload[7],
-        pload[6],
-        pload[5],
-        pload[4],
-        pload[1],
-        pload[0]
-    };
-    
-    uint8_t AAD[32] = {0};
-    AAD[0] = 0;
-    AAD[1] = 22 + 6 * int(dot11.from_ds() && dot11.to_ds());
-    if (dot11.subtype() == Dot11::QOS_DATA_DATA)  {
-        AAD[1] += 2;
-    }
-    AAD[2] = dot11.protocol() | (dot11.type() << 2) | ((dot11.subtype() << 4) & 0x80);
-    AAD[3] = 0x40 | dot11.to_ds() | (dot11.from_ds() << 1) |
-            (dot11.more_frag() << 2) | (dot11.order() << 7);
-    dot11.addr1().copy(AAD + 4);
-    dot11.addr2().copy(AAD + 10);
-    dot11.addr3().copy(AAD + 16);
-    
-    AAD[22] = dot11.frag_num();
-    AAD[23] = 0;
-    
-    if (dot11.from_ds() && dot11.to_ds()) {
-        dot11.addr4().copy(AAD + 24);
-    }
-    
-    AES_KEY ctx;
-    AES_set_encrypt_key(&ptk_[0] + 32, 128, &ctx);
-    uint8_t crypted_block[16];
-    size_t total_sz = raw.payload_size() - 16, offset = 8, blocks = (total_sz + 15) / 16;
-    
-    uint8_t counter[16];
-    counter[0] = 0x59;
-    counter[1] = 0;
-    dot11.addr2().copy(counter + 2);
-    copy(PN, PN + 6, counter + 8);
-    counter[14] = (total_sz >> 8) & 0xff;
-    counter[15] = total_sz & 0xff;
-    
-    if (dot11.subtype() == Dot11::QOS_DATA_DATA) {
-        const uint32_t offset = (dot11.from_ds() && dot11.to_ds()) ? 30 : 24;
-        AAD[offset] = static_cast<const Dot11QoSData&>(dot11).qos_control() & 0x0f;
-        counter[1] = AAD[offset];
-    }
-
-    AES_encrypt(counter, MIC, &ctx);
-    xor_range(MIC, AAD, MIC, 16);
-    AES_encrypt(MIC, MIC, &ctx);
-    xor_range(MIC, AAD + 16, MIC, 16);
-    AES_encrypt(MIC, MIC, &ctx);
-    
-    counter[0] = 1;
-    counter[14] = counter[15] = 0;
-    AES_encrypt(counter, crypted_block, &ctx);
-    uint8_t nice_MIC[8];
-    copy(pload.begin() + pload.size() - 8, pload.end(), nice_MIC);
-    xor_range(crypted_block, nice_MIC, nice_MIC, 8);
-    for (size_t i = 1; i <= blocks; ++i) {
-        size_t block_sz = (i == blocks) ? (total_sz % 16) : 16;
-        if (block_sz == 0) {
-            block_sz = 16;
-        }
-        counter[14] = (i >> 8) & 0xff;
-        counter[15] = i & 0xff;
-        AES_encrypt(counter, crypted_block, &ctx );
-
-        xor_range(crypted_block, &pload[offset], &pload[(i - 1) * 16], block_sz);
-        
-        xor_range(MIC, &pload[(i - 1) * 16], MIC, block_sz);
-        AES_encrypt(MIC, MIC, &ctx);   
-        offset += block_sz;
-    }
-    if (equal(nice_MIC, nice_MIC + sizeof(nice_MIC), MIC)) {
-        return new SNAP(&pload[0], total_sz);
-    }
-    else {
-        return 0;
-    }
+    CCMPDecrypter decrypter;
+    return decrypter.decrypt(*this, dot11, raw);
 }
 
 SNAP* SessionKeys::tkip_decrypt_unicast(const Dot11Data& dot11, RawPDU& raw) const {
@@ -585,33 +540,472 @@ bool SessionKeys::uses_ccmp() const {
     return is_ccmp_;
 }
 
+// ccmp_decrypter
+
+namespace {
+
+const size_t CCMP_NONCE_SIZE = 13;
+const size_t CCMP_TK_OFFSET = 32;
+const size_t CCMP_TK_SIZE = 16;
+
+// Builds the CCM nonce and the additional authenticated data for a frame,
+// as described in IEEE 802.11-2016, 12.5.3.3. Returns the AAD's size.
+size_t build_ccmp_parameters(const Dot11Data& dot11, const uint8_t* buffer,
+                             uint8_t* nonce, uint8_t* aad) {
+    const bool has_addr4 = dot11.from_ds() && dot11.to_ds();
+    size_t aad_size = 22;
+    std::memset(aad, 0, 30);
+    aad[0] = dot11.protocol() | (dot11.type() << 2) | ((dot11.subtype() << 4) & 0x80);
+    aad[1] = 0x40 | dot11.to_ds() | (dot11.from_ds() << 1) |
+             (dot11.more_frag() << 2) | (dot11.order() << 7);
+    dot11.addr1().copy(aad + 2);
+    dot11.addr2().copy(aad + 8);
+    dot11.addr3().copy(aad + 14);
+    aad[20] = dot11.frag_num();
+    if (has_addr4) {
+        dot11.addr4().copy(aad + 22);
+        aad_size += 6;
+    }
+    nonce[0] = 0;
+    if (dot11.subtype() == Dot11::QOS_DATA_DATA) {
+        nonce[0] = static_cast<const Dot11QoSData&>(dot11).qos_control() & 0x0f;
+        aad[aad_size] = nonce[0];
+        aad_size += 2;
+    }
+    dot11.addr2().copy(nonce + 1);
+    // The PN, most significant byte first
+    nonce[7] = buffer[7];
+    nonce[8] = buffer[6];
+    nonce[9] = buffer[5];
+    nonce[10] = buffer[4];
+    nonce[11] = buffer[1];
+    nonce[12] = buffer[0];
+    return aad_size;
+}
+
+} // anonymous namespace
+
+const size_t CCMPDecrypter::HEADER_SIZE = 8;
+const size_t CCMPDecrypter::MIC_SIZE = 8;
+const size_t CCMPDecrypter::MAX_CONTEXTS = 4096;
+
+CCMPDecrypter::CCMPDecrypter() {
+
+}
+
+CCMPDecrypter::CCMPDecrypter(const CCMPDecrypter&) {
+
+}
+
+CCMPDecrypter& CCMPDecrypter::operator=(const CCMPDecrypter&) {
+    clear();
+    return *this;
+}
+
+CCMPDecrypter::~CCMPDecrypter() {
+    clear();
+}
+
+void CCMPDecrypter::clear() {
+    for (contexts_type::iterator it = contexts_.begin(); it != contexts_.end(); ++it) {
+        EVP_CIPHER_CTX_free(it->second);
+    }
+    contexts_.clear();
+}
+
+EVP_CIPHER_CTX* CCMPDecrypter::find_context(const SessionKeys& keys) {
+    const SessionKeys::ptk_type& ptk = keys.get_ptk();
+    if (ptk.size() < CCMP_TK_OFFSET + CCMP_TK_SIZE) {
+        return 0;
+    }
+    context_key key;
+    std::memcpy(&key.first, &ptk[CCMP_TK_OFFSET], sizeof(key.first));
+    std::memcpy(&key.second, &ptk[CCMP_TK_OFFSET + sizeof(key.first)], sizeof(key.second));
+    contexts_type::iterator it = contexts_.find(key);
+    if (it != contexts_.end()) {
+        return it->second;
+    }
+    if (contexts_.size() >= MAX_CONTEXTS) {
+        clear();
+    }
+    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+    if (!ctx) {
+        return 0;
+    }
+    // Set the key once, each frame only sets its own nonce and MIC
+    if (EVP_DecryptInit_ex(ctx, EVP_aes_128_ccm(), 0, 0, 0) != 1 ||
+        EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_CCM_SET_IVLEN, CCMP_NONCE_SIZE, 0) != 1 ||
+        EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_CCM_SET_TAG, MIC_SIZE, 0) != 1 ||
+        EVP_DecryptInit_ex(ctx, 0, 0, &ptk[CCMP_TK_OFFSET], 0) != 1) {
+        EVP_CIPHER_CTX_free(ctx);
+        return 0;
+    }
+    contexts_.insert(make_pair(key, ctx));
+    return ctx;
+}
+
+bool CCMPDecrypter::decrypt(EVP_CIPHER_CTX* ctx, const Dot11Data& dot11, uint8_t* buffer,
+                            uint32_t size) {
+    if (!ctx || size < HEADER_SIZE + MIC_SIZE) {
+        return false;
+    }
+    uint8_t nonce[CCMP_NONCE_SIZE];
+    uint8_t aad[30];
+    const size_t aad_size = build_ccmp_parameters(dot11, buffer, nonce, aad);
+    const int data_size = static_cast<int>(size - HEADER_SIZE - MIC_SIZE);
+    uint8_t* data = buffer + HEADER_SIZE;
+    int output_size = 0;
+    return EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_CCM_SET_TAG, MIC_SIZE, data + data_size) == 1 &&
+           EVP_DecryptInit_ex(ctx, 0, 0, 0, nonce) == 1 &&
+           EVP_DecryptUpdate(ctx, 0, &output_size, 0, data_size) == 1 &&
+           EVP_DecryptUpdate(ctx, 0, &output_size, aad, aad_size) == 1 &&
+           // This fails if the MIC doesn't match
+           EVP_DecryptUpdate(ctx, data, &output_size, data, data_size) == 1;
+}
+
+bool CCMPDecrypter::decrypt(const SessionKeys& keys, const Dot11Data& dot11,
+                            uint8_t* buffer, uint32_t size) {
+    return decrypt(find_context(keys), dot11, buffer, size);
+}
+
+SNAP* CCMPDecrypter::decrypt(const SessionKeys& keys, const Dot11Data& dot11, RawPDU& raw) {
+    RawPDU::payload_type& pload = raw.payload();
+    if (pload.size() < HEADER_SIZE + MIC_SIZE ||
+        !decrypt(keys, dot11, &pload[0], pload.size())) {
+        return 0;
+    }
+    return new SNAP(&pload[HEADER_SIZE], pload.size() - HEADER_SIZE - MIC_SIZE);
+}
+
+size_t CCMPDecrypter::decrypt(vector<frame>& frames) {
+    size_t decrypted = 0;
+    const SessionKeys* last_keys = 0;
+    EVP_CIPHER_CTX* ctx = 0;
+    for (size_t i = 0; i < frames.size(); ++i) {
+        frame& current = frames[i];
+        if (current.keys != last_keys) {
+            last_keys = current.keys;
+            ctx = find_context(*last_keys);
+        }
+        current.decrypted = decrypt(ctx, *current.dot11, current.buffer, current.size);
+        if (current.decrypted) {
+            ++decrypted;
+        }
+    }
+    return decrypted;
+}
+
 // supplicant_data
 
 SupplicantData::SupplicantData(const string& psk, const string& ssid)
-: pmk_(SessionKeys::PMK_SIZE), ssid_(ssid) {
+: pmk_(PMKCache::derive_pmk(psk, ssid)), ssid_(ssid) {
+
+}
+
+SupplicantData::SupplicantData(const pmk_type& pmk, const string& ssid)
+: pmk_(pmk), ssid_(ssid) {
+    if (pmk_.size() != SessionKeys::PMK_SIZE) {
+        throw runtime_error("Invalid PMK size");
+    }
+}
+
+const SupplicantData::pmk_type& SupplicantData::pmk() const {
+    return pmk_;
+}
+
+const string& SupplicantData::ssid() const {
+    return ssid_;
+}
+
+// pmk_cache
+
+namespace {
+
+// File layout: magic, version, entry count and salt, followed by the entries.
+// Each entry is the SSID's length and contents, the PSK's HMAC and the PMK.
+// Integers are stored in little endian.
+const char PMK_CACHE_MAGIC[8] = { 'T', 'I', 'N', 'S', 'P', 'M', 'K', 'C' };
+const uint32_t PMK_CACHE_VERSION = 2;
+const size_t PMK_CACHE_SALT_SIZE = 32;
+const size_t PMK_CACHE_HEADER_SIZE = 16 + PMK_CACHE_SALT_SIZE;
+const size_t PSK_HASH_SIZE = 32;
+// Way more than 802.11's 32 bytes, only used to reject garbage
+const uint32_t PMK_CACHE_MAX_SSID_SIZE = 1024;
+
+void write_le32(string& buffer, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        buffer.push_back(static_cast<char>((value >> (i * 8)) & 0xff));
+    }
+}
+
+uint32_t read_le32(const char* ptr) {
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(ptr);
+    return data[0] | (data[1] << 8) | (data[2] << 16) | (static_cast<uint32_t>(data[3]) << 24);
+}
+
+// Writes the contents into a temporary file only readable by its owner 
+// and then moves it into place, so a failure never leaves a truncated file
+bool replace_file(const string& file_name, const string& contents) {
+    #ifndef _WIN32
+        string path_template = file_name + ".XXXXXX";
+        vector<char> path(path_template.begin(), path_template.end());
+        path.push_back(0);
+        const int fd = ::mkstemp(&path[0]);
+        if (fd == -1) {
+            return false;
+        }
+        bool success = ::fchmod(fd, S_IRUSR | S_IWUSR) == 0;
+        size_t written = 0;
+        while (success && written < contents.size()) {
+            const ssize_t result = ::write(fd, contents.data() + written, 
+                                           contents.size() - written);
+            if (result == -1) {
+                success = (errno == EINTR);
+            }
+            else {
+                written += static_cast<size_t>(result);
+            }
+        }
+        // The contents have to be on disk before they replace the old ones
+        success = success && ::fsync(fd) == 0;
+        success = (::close(fd) == 0) && success;
+        success = success && ::rename(&path[0], file_name.c_str()) == 0;
+        if (!success) {
+            ::unlink(&path[0]);
+        }
+        return success;
+    #else
+        const string temp_name = file_name + ".tmp";
+        ofstream output(temp_name.c_str(), ios::binary | ios::trunc);
+        bool success = output && output.write(contents.data(), contents.size());
+        output.close();
+        success = success && !output.fail() &&
+                  ::MoveFileExA(temp_name.c_str(), file_name.c_str(), 
+                                MOVEFILE_REPLACE_EXISTING) != 0;
+        if (!success) {
+            std::remove(temp_name.c_str());
+        }
+        return success;
+    #endif // _WIN32
+}
+
+} // anonymous namespace
+
+PMKCache::PMKCache() {
+
+}
+
+PMKCache::pmk_type PMKCache::derive_pmk(const string& psk, const string& ssid) {
+    pmk_type pmk(SessionKeys::PMK_SIZE);
     PKCS5_PBKDF2_HMAC_SHA1(
         psk.c_str(), 
         psk.size(), 
         (unsigned char *)ssid.c_str(), 
         ssid.size(), 
         4096, 
-        pmk_.size(), 
-        &pmk_[0]
+        pmk.size(), 
+        &pmk[0]
     );
+    return pmk;
 }
 
-const SupplicantData::pmk_type& SupplicantData::pmk() const {
-    return pmk_;
+// The salt must have been generated or loaded
+PMKCache::key_type PMKCache::make_key(const string& psk, const string& ssid) const {
+    unsigned char hash[EVP_MAX_MD_SIZE];
+    unsigned int hash_size = 0;
+    HMAC(EVP_sha256(), salt_.data(), static_cast<int>(salt_.size()),
+         reinterpret_cast<const unsigned char*>(psk.data()), psk.size(),
+         hash, &hash_size);
+    return make_pair(ssid, string(hash, hash + hash_size));
 }
 
-const string& SupplicantData::ssid() const {
-    return ssid_;
+void PMKCache::generate_salt() {
+    if (!salt_.empty()) {
+        return;
+    }
+    unsigned char salt[PMK_CACHE_SALT_SIZE];
+    if (RAND_bytes(salt, sizeof(salt)) != 1) {
+        throw runtime_error("Failed to generate PMK cache salt");
+    }
+    salt_.assign(salt, salt + sizeof(salt));
+}
+
+void PMKCache::load(const string& file_name) {
+    ifstream input(file_name.c_str(), ios::binary);
+    char header[PMK_CACHE_HEADER_SIZE];
+    if (!input || !input.read(header, sizeof(header)) ||
+        std::memcmp(header, PMK_CACHE_MAGIC, sizeof(PMK_CACHE_MAGIC)) != 0 ||
+        read_le32(header + 8) != PMK_CACHE_VERSION) {
+        throw invalid_pmk_cache();
+    }
+    const uint32_t entry_count = read_le32(header + 12);
+    const string salt(header + 16, PMK_CACHE_SALT_SIZE);
+    if (!pmks_.empty() && entry_count > 0 && salt != salt_) {
+        throw invalid_pmk_cache();
+    }
+    // Parse everything before touching the current entries
+    pmks_type entries;
+    char buffer[PSK_HASH_SIZE + SessionKeys::PMK_SIZE];
+    string ssid;
+    for (uint32_t i = 0; i < entry_count; ++i) {
+        if (!input.read(buffer, 4)) {
+            throw invalid_pmk_cache();
+        }
+        const uint32_t ssid_size = read_le32(buffer);
+        if (ssid_size > PMK_CACHE_MAX_SSID_SIZE) {
+            throw invalid_pmk_cache();
+        }
+        ssid.resize(ssid_size);
+        if ((ssid_size > 0 && !input.read(&ssid[0], ssid_size)) ||
+            !input.read(buffer, sizeof(buffer))) {
+            throw invalid_pmk_cache();
+        }
+        const uint8_t* pmk_ptr = reinterpret_cast<const uint8_t*>(buffer + PSK_HASH_SIZE);
+        entries[make_pair(ssid, string(buffer, PSK_HASH_SIZE))].assign(
+            pmk_ptr,
+            pmk_ptr + SessionKeys::PMK_SIZE
+        );
+    }
+    if (!entries.empty()) {
+        salt_ = salt;
+    }
+    for (pmks_type::iterator it = entries.begin(); it != entries.end(); ++it) {
+        pmks_[it->first].swap(it->second);
+    }
+}
+
+void PMKCache::save(const string& file_name) const {
+    string buffer(PMK_CACHE_MAGIC, sizeof(PMK_CACHE_MAGIC));
+    write_le32(buffer, PMK_CACHE_VERSION);
+    write_le32(buffer, static_cast<uint32_t>(pmks_.size()));
+    // An empty cache may not have a salt yet
+    if (salt_.empty()) {
+        buffer.append(PMK_CACHE_SALT_SIZE, '\0');
+    }
+    else {
+        buffer += salt_;
+    }
+    for (pmks_type::const_iterator it = pmks_.begin(); it != pmks_.end(); ++it) {
+        write_le32(buffer, static_cast<uint32_t>(it->first.first.size()));
+        buffer += it->first.first;
+        buffer += it->first.second;
+        buffer.append(it->second.begin(), it->second.end());
+    }
+    if (!replace_file(file_name, buffer)) {
+        throw file_write_error("Failed to write PMK cache " + file_name);
+    }
+}
+
+bool PMKCache::find(const string& psk, const string& ssid, pmk_type& pmk) const {
+    // Without entries, there may not be a salt either
+    if (pmks_.empty()) {
+        return false;
+    }
+    pmks_type::const_iterator it = pmks_.find(make_key(psk, ssid));
+    if (it == pmks_.end()) {
+        return false;
+    }
+    pmk = it->second;
+    return true;
+}
+
+void PMKCache::insert(const string& psk, const string& ssid, const pmk_type& pmk) {
+    if (pmk.size() != SessionKeys::PMK_SIZE) {
+        throw runtime_error("Invalid PMK size");
+    }
+    if (ssid.size() > PMK_CACHE_MAX_SSID_SIZE) {
+        throw runtime_error("SSID too long");
+    }
+    generate_salt();
+    pmks_[make_key(psk, ssid)] = pmk;
+}
+
+const PMKCache::pmk_type& PMKCache::get(const string& psk, const string& ssid) {
+    generate_salt();
+    const key_type key = make_key(psk, ssid);
+    pmks_type::iterator it = pmks_.find(key);
+    if (it == pmks_.end()) {
+        if (ssid.size() > PMK_CACHE_MAX_SSID_SIZE) {
+            throw runtime_error("SSID too long");
+        }
+        it = pmks_.insert(make_pair(key, derive_pmk(psk, ssid))).first;
+    }
+    return it->second;
+}
+
+size_t PMKCache::size() const {
+    return pmks_.size();
+}
+
+bool PMKCache::empty() const {
+    return pmks_.empty();
+}
+
+void PMKCache::clear() {
+    pmks_.clear();
 }
 
 } // namespace WPA2
 
+namespace {
+
+// Derives the PMKs for the entries in ap_data pointed to by indexes
+void derive_pmks(const vector<WPA2Decrypter::ap_data_type>& ap_data,
+                 const vector<size_t>& indexes,
+                 vector<PMKCache::pmk_type>& pmks,
+                 size_t thread_count) {
+    #if TINS_IS_CXX11
+        if (thread_count == 0) {
+            thread_count = std::thread::hardware_concurrency();
+        }
+        thread_count = std::min(thread_count, indexes.size());
+        if (thread_count > 1) {
+            // Each PMK takes a while to compute, so handing out a single
+            // index at a time keeps every thread busy until the end
+            std::atomic<size_t> next_index(0);
+            auto worker = [&]() {
+                for (size_t i = next_index++; i < indexes.size(); i = next_index++) {
+                    const WPA2Decrypter::ap_data_type& entry = ap_data[indexes[i]];
+                    pmks[indexes[i]] = PMKCache::derive_pmk(entry.first, entry.second);
+                }
+            };
+            vector<std::thread> threads;
+            try {
+                for (size_t i = 1; i < thread_count; ++i) {
+                    threads.emplace_back(worker);
+                }
+            }
+            catch (std::system_error&) {
+                // Just use the threads we managed to start
+            }
+            worker();
+            for (size_t i = 0; i < threads.size(); ++i) {
+                threads[i].join();
+            }
+            return;
+        }
+    #endif // TINS_IS_CXX11
+    for (size_t i = 0; i < indexes.size(); ++i) {
+        const WPA2Decrypter::ap_data_type& entry = ap_data[indexes[i]];
+        pmks[indexes[i]] = PMKCache::derive_pmk(entry.first, entry.second);
+    }
+}
+
+} // anonymous namespace
+
+WPA2Decrypter::WPA2Decrypter()
+: pmk_cache_(0) {
+
+}
+
 void WPA2Decrypter::add_ap_data(const string& psk, const string& ssid) {
-    pmks_.insert(make_pair(ssid, WPA2::SupplicantData(psk, ssid)));
+    if (pmk_cache_) {
+        const WPA2::SupplicantData::pmk_type& pmk = pmk_cache_->get(psk, ssid);
+        pmks_.insert(make_pair(ssid, WPA2::SupplicantData(pmk, ssid)));
+    }
+    else {
+        pmks_.insert(make_pair(ssid, WPA2::SupplicantData(psk, ssid)));
+    }
 }
 
 void WPA2Decrypter::add_ap_data(const string& psk, 
@@ -621,6 +1015,42 @@ void WPA2Decrypter::add_ap_data(const string& psk,
     add_access_point(ssid, addr);
 }
 
+void WPA2Decrypter::add_ap_data(const vector<ap_data_type>& ap_data, size_t thread_count) {
+    typedef WPA2::SupplicantData::pmk_type pmk_type;
+    vector<pmk_type> pmks(ap_data.size());
+    // The entries that will actually be added, and those among them whose
+    // PMKs have to be derived. As with the single entry overload, an SSID
+    // that's already registered is left alone.
+    vector<size_t> added;
+    vector<size_t> pending;
+    std::set<string> ssids;
+    for (size_t i = 0; i < ap_data.size(); ++i) {
+        const string& ssid = ap_data[i].second;
+        if (pmks_.count(ssid) || !ssids.insert(ssid).second) {
+            continue;
+        }
+        added.push_back(i);
+        if (!pmk_cache_ || !pmk_cache_->find(ap_data[i].first, ssid, pmks[i])) {
+            pending.push_back(i);
+        }
+    }
+    derive_pmks(ap_data, pending, pmks, thread_count);
+    if (pmk_cache_) {
+        for (size_t i = 0; i < pending.size(); ++i) {
+            const ap_data_type& entry = ap_data[pending[i]];
+            pmk_cache_->insert(entry.first, entry.second, pmks[pending[i]]);
+        }
+    }
+    for (size_t i = 0; i < added.size(); ++i) {
+        const string& ssid = ap_data[added[i]].second;
+        pmks_.insert(make_pair(ssid, WPA2::SupplicantData(pmks[added[i]], ssid)));
+    }
+}
+
+void WPA2Decrypter::pmk_cache(WPA2::PMKCache* cache) {
+    pmk_cache_ = cache;
+}
+
 void WPA2Decrypter::add_access_point(const string& ssid, const address_type& addr) {
     pmks_map::const_iterator it = pmks_.find(ssid);
     if (it == pmks_.end()) {
@@ -638,7 +1068,15 @@ void WPA2Decrypter::add_access_point(const string& ssid, const address_type& add
 void WPA2Decrypter::add_decryption_keys(const addr_pair& addresses, 
                                         const SessionKeys& session_keys) {
     addr_pair sorted_pair = make_addr_pair(addresses.first, addresses.second);
-    keys_[sorted_pair] = session_keys;
+    store_keys(sorted_pair, session_keys);
+}
+
+void WPA2Decrypter::store_keys(const addr_pair& addresses, const SessionKeys& session_keys) {
+    keys_[addresses] = session_keys;
+    #if TINS_IS_CXX11
+        // Frames still being decrypted keep using the previous keys
+        frame_keys_[addresses] = std::make_shared<const SessionKeys>(session_keys);
+    #endif // TINS_IS_CXX11
 }
 
 void WPA2Decrypter::try_add_keys(const Dot11Data& dot11, const RSNHandshake& hs) {
@@ -647,7 +1085,7 @@ void WPA2Decrypter::try_add_keys(const Dot11Data& dot11, const RSNHandshake& hs)
         addr_pair addr_p = extract_addr_pair(dot11);
         try {
             SessionKeys session(hs, it->second.pmk());
-            keys_[addr_p] = session;
+            store_keys(addr_p, session);
             #ifdef TINS_HAVE_WPA2_CALLBACKS
                 if (handshake_captured_callback_) {
                     address_type bssid = dot11.bssid_addr();
@@ -704,6 +1142,24 @@ WPA2Decrypter::bssids_map::const_iterator WPA2Decrypter::find_ap(const Dot11Data
 }
 
 bool WPA2Decrypter::decrypt(PDU& pdu) {
+    keys_map::const_iterator it = process_packet(pdu);
+    return it != keys_.end() && frame_decrypter_.decrypt(pdu, it->second);
+}
+
+bool WPA2Decrypter::find_frame_keys(const PDU& pdu, frame_keys_type& keys) {
+    keys_map::const_iterator it = process_packet(pdu);
+    if (it == keys_.end()) {
+        return false;
+    }
+    #if TINS_IS_CXX11
+        keys = frame_keys_.find(it->first)->second;
+    #else
+        keys = it->second;
+    #endif // TINS_IS_CXX11
+    return true;
+}
+
+WPA2Decrypter::keys_map::const_iterator WPA2Decrypter::process_packet(const PDU& pdu) {
     if (capturer_.process_packet(pdu)) {
         try_add_keys(pdu.rfind_pdu<Dot11Data>(), capturer_.handshakes().front());
         capturer_.clear_handshakes();
@@ -722,9 +1178,8 @@ bool WPA2Decrypter::decrypt(PDU& pdu) {
         }
     }
     else {
-        Dot11Data* data = pdu.find_pdu<Dot11Data>();
-        RawPDU* raw = pdu.find_pdu<RawPDU>();
-        if (data && raw && data->wep()) {
+        const Dot11Data* data = pdu.find_pdu<Dot11Data>();
+        if (data && data->wep() && data->find_pdu<RawPDU>()) {
             // search for the tuple (bssid, src_addr)
             keys_map::const_iterator it = keys_.find(extract_addr_pair(*data));
             
@@ -732,16 +1187,36 @@ bool WPA2Decrypter::decrypt(PDU& pdu) {
             if (it == keys_.end()) {
                 it = keys_.find(extract_addr_pair_dst(*data));
             }
-            if (it != keys_.end()) {
-                SNAP* snap = it->second.decrypt_unicast(*data, *raw);
-                if (snap) {
-                    data->inner_pdu(snap);
-                    data->wep(0);
-                    return true;
-                }
-            }
+            return it;
         }
     }
+    return keys_.end();
+}
+
+// WPA2Decrypter::frame_decrypter
+
+#if TINS_IS_CXX11
+
+bool WPA2Decrypter::frame_decrypter::decrypt(PDU& pdu, const frame_keys_type& keys) {
+    return keys && decrypt(pdu, *keys);
+}
+
+#endif // TINS_IS_CXX11
+
+bool WPA2Decrypter::frame_decrypter::decrypt(PDU& pdu, const SessionKeys& keys) {
+    Dot11Data* data = pdu.find_pdu<Dot11Data>();
+    RawPDU* raw = data ? data->find_pdu<RawPDU>() : 0;
+    if (!raw) {
+        return false;
+    }
+    SNAP* snap = keys.uses_ccmp() ?
+                 ccmp_.decrypt(keys, *data, *raw) :
+                 keys.decrypt_unicast(*data, *raw);
+    if (snap) {
+        data->inner_pdu(snap);
+        data->wep(0);
+        return true;
+    }
     return false;
 }
 
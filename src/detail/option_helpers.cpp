@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <tins/detail/option_helpers.h>
+#include <tins/exceptions.h>
+
+namespace Tins {
+namespace Internals {
+
+RawOptionIterator::RawOptionIterator()
+: layout_(TCP_OPTION_LAYOUT), position_(0), next_(0), last_(0) {
+
+}
+
+RawOptionIterator::RawOptionIterator(OptionLayout layout, const uint8_t* first,
+                                     const uint8_t* last)
+: layout_(layout), position_(0), next_(first), last_(last) {
+    read_option();
+}
+
+void RawOptionIterator::read_option() {
+    position_ = 0;
+    if (next_ >= last_) {
+        return;
+    }
+    const uint8_t type = *next_;
+    bool single_byte = false;
+    switch (layout_) {
+        case TCP_OPTION_LAYOUT:
+            if (type == 0) {
+                return;
+            }
+            single_byte = type == 1;
+            break;
+        case IP_OPTION_LAYOUT:
+            if (type == 0) {
+                // The end of list option can only be found at the end
+                if (TINS_UNLIKELY(next_ + 1 != last_)) {
+                    throw malformed_packet();
+                }
+                return;
+            }
+            single_byte = (type & 0x1f) <= 1;
+            break;
+        case DOT11_OPTION_LAYOUT:
+            if (last_ - next_ < 2) {
+                return;
+            }
+            break;
+        case DHCP_OPTION_LAYOUT:
+            single_byte = type == 0 || type == 255;
+            break;
+        case ICMPV6_OPTION_LAYOUT:
+            break;
+    }
+    current_.type = type;
+    current_.data = next_ + 1;
+    if (single_byte) {
+        current_.data_size = 0;
+    }
+    else {
+        if (TINS_UNLIKELY(last_ - next_ < 2)) {
+            throw malformed_packet();
+        }
+        uint32_t length = next_[1];
+        if (layout_ == ICMPV6_OPTION_LAYOUT) {
+            length *= 8;
+        }
+        if (layout_ != DOT11_OPTION_LAYOUT && layout_ != DHCP_OPTION_LAYOUT) {
+            // The length includes the type and length fields
+            if (TINS_UNLIKELY(length < 2)) {
+                throw malformed_packet();
+            }
+            length -= 2;
+        }
+        current_.data = next_ + 2;
+        if (TINS_UNLIKELY(static_cast<uint32_t>(last_ - current_.data) < length)) {
+            throw malformed_packet();
+        }
+        current_.data_size = length;
+    }
+    position_ = next_;
+    next_ = current_.data + current_.data_size;
+}
+
+void validate_options(OptionLayout layout, const uint8_t* first, const uint8_t* last) {
+    const RawOptionIterator end;
+    RawOptionIterator iter(layout, first, last);
+    while (iter != end) {
+        ++iter;
+    }
+}
+
+} // namespace Internals
+} // namespace Tins
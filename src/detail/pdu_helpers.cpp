@@ -56,28 +56,102 @@
 namespace Tins {
 namespace Internals {
 
+#if TINS_IS_CXX11
+    static thread_local decode_context* current_context = 0;
+#else
+    static decode_context* current_context = 0;
+#endif // TINS_IS_CXX11
+
+decode_context::decode_context(counters_type& malformed_layers)
+: malformed_layers_(malformed_layers), previous_(current_context), failed_layers_(0) {
+    current_context = this;
+}
+
+decode_context::~decode_context() {
+    current_context = previous_;
+}
+
+void decode_context::layer_failed(PDU::PDUType type) {
+    malformed_layers_[type]++;
+    failed_layers_++;
+}
+
+uint32_t decode_context::failed_layers() const {
+    return failed_layers_;
+}
+
+bool header_fits(PDU::PDUType type, const uint8_t* buffer, uint32_t size) {
+    // These only cover the size checks each constructor performs first,
+    // which are the ones truncated captures fail
+    switch (type) {
+        case PDU::ETHERNET_II:
+            return size >= 14;
+        case PDU::IP:
+            // Internet header length has to be within [20, size]
+            return size >= 20 && (buffer[0] & 0x0f) >= 5 && 
+                   (buffer[0] & 0x0f) * 4U <= size;
+        case PDU::IPv6:
+            return size >= 40;
+        case PDU::TCP:
+            // Data offset has to be within [20, size]
+            return size >= 20 && (buffer[12] >> 4) >= 5 && 
+                   (buffer[12] >> 4) * 4U <= size;
+        case PDU::UDP:
+        case PDU::ICMP:
+            return size >= 8;
+        case PDU::ARP:
+            return size >= 28;
+        case PDU::DOT1Q:
+            return size >= 4;
+        default:
+            return true;
+    }
+}
+
+PDU* decode_layer(PDU::PDUType type, pdu_factory factory,
+                  const uint8_t* buffer, uint32_t size) {
+    decode_context* context = current_context;
+    if (!context) {
+        return factory(buffer, size);
+    }
+    if (header_fits(type, buffer, size)) {
+        try {
+            return factory(buffer, size);
+        }
+        catch (const malformed_packet&) {
+        }
+    }
+    // Keep the undecodable bytes as they are
+    context->layer_failed(type);
+    return new RawPDU(buffer, size);
+}
+
+static PDU* create_eapol(const uint8_t* buffer, uint32_t size) {
+    return EAPOL::from_bytes(buffer, size);
+}
+
 Tins::PDU* pdu_from_flag(Constants::Ethernet::e flag,
                          const uint8_t* buffer,
                          uint32_t size,
                          bool rawpdu_on_no_match) {
     switch (flag) {
         case Tins::Constants::Ethernet::IP:
-            return new IP(buffer, size);
+            return decode_layer(PDU::IP, &create_pdu<IP>, buffer, size);
         case Constants::Ethernet::IPV6:
-            return new IPv6(buffer, size);
+            return decode_layer(PDU::IPv6, &create_pdu<IPv6>, buffer, size);
         case Tins::Constants::Ethernet::ARP:
-            return new ARP(buffer, size);
+            return decode_layer(PDU::ARP, &create_pdu<ARP>, buffer, size);
         case Tins::Constants::Ethernet::PPPOED:
         case Tins::Constants::Ethernet::PPPOES:
-            return new PPPoE(buffer, size);
+            return decode_layer(PDU::PPPOE, &create_pdu<PPPoE>, buffer, size);
         case Tins::Constants::Ethernet::EAPOL:
-            return EAPOL::from_bytes(buffer, size);
+            return decode_layer(PDU::EAPOL, &create_eapol, buffer, size);
         case Tins::Constants::Ethernet::VLAN:
         case Tins::Constants::Ethernet::QINQ:
         case Tins::Constants::Ethernet::OLD_QINQ:
-            return new Dot1Q(buffer, size);
+            return decode_layer(PDU::DOT1Q, &create_pdu<Dot1Q>, buffer, size);
         case Tins::Constants::Ethernet::MPLS:
-            return new MPLS(buffer, size);
+            return decode_layer(PDU::MPLS, &create_pdu<MPLS>, buffer, size);
         default:
             {
                 PDU* pdu = Internals::allocate<EthernetII>(
@@ -99,21 +173,21 @@ Tins::PDU* pdu_from_flag(Constants::IP::e flag,
                          bool rawpdu_on_no_match) {
     switch (flag) {
         case Constants::IP::PROTO_IPIP:
-            return new Tins::IP(buffer, size);
+            return decode_layer(PDU::IP, &create_pdu<Tins::IP>, buffer, size);
         case Constants::IP::PROTO_TCP:
-            return new Tins::TCP(buffer, size);
+            return decode_layer(PDU::TCP, &create_pdu<Tins::TCP>, buffer, size);
         case Constants::IP::PROTO_UDP:
-            return new Tins::UDP(buffer, size);
+            return decode_layer(PDU::UDP, &create_pdu<Tins::UDP>, buffer, size);
         case Constants::IP::PROTO_ICMP:
-            return new Tins::ICMP(buffer, size);
+            return decode_layer(PDU::ICMP, &create_pdu<Tins::ICMP>, buffer, size);
         case Constants::IP::PROTO_ICMPV6:
-            return new Tins::ICMPv6(buffer, size);
+            return decode_layer(PDU::ICMPv6, &create_pdu<Tins::ICMPv6>, buffer, size);
         case Constants::IP::PROTO_IPV6:
-            return new Tins::IPv6(buffer, size);
+            return decode_layer(PDU::IPv6, &create_pdu<Tins::IPv6>, buffer, size);
         case Constants::IP::PROTO_AH:
-            return new Tins::IPSecAH(buffer, size);
+            return decode_layer(PDU::IPSEC_AH, &create_pdu<Tins::IPSecAH>, buffer, size);
         case Constants::IP::PROTO_ESP:
-            return new Tins::IPSecESP(buffer, size);
+            return decode_layer(PDU::IPSEC_ESP, &create_pdu<Tins::IPSecESP>, buffer, size);
         default:
             break;
     }
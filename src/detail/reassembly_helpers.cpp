@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifdef _WIN32
+    #include <winsock2.h>
+#else
+    #include <sys/time.h>
+#endif
+#include <algorithm>
+#include <tins/detail/reassembly_helpers.h>
+#include <tins/pdu.h>
+#include <tins/rawpdu.h>
+
+using std::min;
+using std::max;
+
+namespace Tins {
+namespace Internals {
+
+static const uint32_t HOLE_END = 0xffffffff;
+
+uint64_t reassembly_timestamp_value(const reassembly_timestamp_type& ts) {
+    #if TINS_IS_CXX11
+        return static_cast<uint64_t>(ts.count());
+    #else
+        return static_cast<uint64_t>(ts.seconds()) * 1000000 + ts.microseconds();
+    #endif // TINS_IS_CXX11
+}
+
+reassembly_timestamp_type make_reassembly_timestamp(uint32_t seconds) {
+    #if TINS_IS_CXX11
+        return std::chrono::seconds(seconds);
+    #else
+        timeval value;
+        value.tv_sec = seconds;
+        value.tv_usec = 0;
+        return Timestamp(value);
+    #endif // TINS_IS_CXX11
+}
+
+DatagramBuffer::DatagramBuffer() 
+: received_end_(false) {
+    holes_.push_back(hole(0, HOLE_END));
+}
+
+bool DatagramBuffer::add_fragment(uint32_t offset, PDU& data, bool more_fragments,
+                                  uint32_t max_size) {
+    // Avoid serializing raw payloads, which is what captured fragments carry
+    if (data.pdu_type() == PDU::RAW && !data.inner_pdu()) {
+        const RawPDU::payload_type& payload = static_cast<const RawPDU&>(data).payload();
+        return add_fragment(offset, payload.empty() ? 0 : &payload[0],
+                            static_cast<uint32_t>(payload.size()), more_fragments, max_size);
+    }
+    const PDU::serialization_type buffer = data.serialize();
+    return add_fragment(offset, buffer.empty() ? 0 : &buffer[0],
+                        static_cast<uint32_t>(buffer.size()), more_fragments, max_size);
+}
+
+bool DatagramBuffer::add_fragment(uint32_t first, const uint8_t* data, uint32_t size,
+                                  bool more_fragments, uint32_t max_size) {
+    const uint32_t end = first + size;
+    if (end > max_size) {
+        return false;
+    }
+    if (received_end_) {
+        // Nothing can go after the last fragment nor can there be 2 last fragments
+        if (end > payload_.size() || (!more_fragments && end != payload_.size())) {
+            return false;
+        }
+    }
+    else if (!more_fragments) {
+        if (end < payload_.size()) {
+            return false;
+        }
+        received_end_ = true;
+        // Anything after the end of the datagram is not a hole anymore
+        while (!holes_.empty() && holes_.back().first >= end) {
+            holes_.pop_back();
+        }
+        if (!holes_.empty() && holes_.back().last >= end) {
+            holes_.back().last = end - 1;
+        }
+    }
+    if (payload_.size() < end) {
+        payload_.resize(end);
+    }
+    if (size == 0) {
+        return true;
+    }
+    // Copy the parts of this fragment that fill holes, splitting them as needed
+    const uint32_t last = end - 1;
+    holes_type::iterator iter = holes_.begin();
+    while (iter != holes_.end() && iter->first <= last) {
+        if (iter->last < first) {
+            ++iter;
+            continue;
+        }
+        const hole current = *iter;
+        const uint32_t copy_first = max(current.first, first);
+        const uint32_t copy_last = min(current.last, last);
+        std::copy(
+            data + (copy_first - first),
+            data + (copy_last - first) + 1,
+            payload_.begin() + copy_first
+        );
+        iter = holes_.erase(iter);
+        if (current.first < first) {
+            iter = holes_.insert(iter, hole(current.first, first - 1)) + 1;
+        }
+        if (current.last > last) {
+            iter = holes_.insert(iter, hole(last + 1, current.last)) + 1;
+        }
+    }
+    return true;
+}
+
+bool DatagramBuffer::is_complete() const {
+    return received_end_ && holes_.empty();
+}
+
+const DatagramBuffer::payload_type& DatagramBuffer::payload() const {
+    return payload_;
+}
+
+size_t DatagramBuffer::size() const {
+    return payload_.size();
+}
+
+} // Internals
+} // Tins
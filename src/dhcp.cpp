@@ -65,27 +65,20 @@ DHCP::DHCP(const uint8_t* buffer, uint32_t total_sz)
     if (magic_number != Endian::host_to_be<uint32_t>(0x63825363)) {
         throw malformed_packet();
     }
-    // While there's data left
-    while (stream) {
-        OptionTypes option_type;
-        uint8_t option_length = 0;
-        option_type = (OptionTypes)stream.read<uint8_t>();
-        // We should only read the length if it's not END nor PAD
-        if (option_type != END && option_type != PAD) {
-            option_length = stream.read<uint8_t>();
-        }
-        // Make sure we can read the payload size
-        if (!stream.can_read(option_length)) {
-            throw malformed_packet();
-        }
-        add_option(option(option_type, option_length, stream.pointer()));
-        stream.skip(option_length);
+    // Options are only parsed when they're needed
+    const uint8_t* first = stream.pointer();
+    const uint8_t* last = first + stream.size();
+    const Internals::RawOptionIterator end;
+    for (Internals::RawOptionIterator iter(Internals::DHCP_OPTION_LAYOUT, first, last);
+         iter != end; ++iter) {
+        size_ += iter->data_size + (sizeof(uint8_t) << 1);
     }
+    options_.assign(first, last);
 }
 
 void DHCP::add_option(const option& opt) {
     internal_add_option(opt);
-    options_.push_back(opt);
+    options_.get_mutable().push_back(opt);
 }
 
 void DHCP::internal_add_option(const option& opt) {
@@ -94,26 +87,27 @@ void DHCP::internal_add_option(const option& opt) {
 
 bool DHCP::remove_option(OptionTypes type) {
     options_type::iterator iter = search_option_iterator(type);
-    if (iter == options_.end()) {
+    options_type& options = options_.get_mutable();
+    if (iter == options.end()) {
         return false;
     }
     size_ -= static_cast<uint32_t>(iter->data_size() + (sizeof(uint8_t) << 1));
-    options_.erase(iter);
+    options.erase(iter);
     return true;
 }
 
 const DHCP::option* DHCP::search_option(OptionTypes opt) const {
     // Search for the iterator. If we found something, return it, otherwise return nullptr.
     options_type::const_iterator iter = search_option_iterator(opt);
-    return (iter != options_.end()) ? &*iter : 0;
+    return (iter != options_.get().end()) ? &*iter : 0;
 }
 
 DHCP::options_type::const_iterator DHCP::search_option_iterator(OptionTypes opt) const {
-    return Internals::find_option_const<option>(options_, opt);
+    return Internals::find_option_const<option>(options_.get(), opt);
 }
 
 DHCP::options_type::iterator DHCP::search_option_iterator(OptionTypes opt) {
-    return Internals::find_option<option>(options_, opt);
+    return Internals::find_option<option>(options_.get_mutable(), opt);
 }
 
 void DHCP::type(Flags type) {
@@ -248,7 +242,8 @@ void DHCP::write_serialization(uint8_t* buffer, uint32_t total_sz) {
         OutputMemoryStream stream(&result[0], result.size());
         // Magic cookie
         stream.write(Endian::host_to_be<uint32_t>(0x63825363));
-        for (options_type::const_iterator it = options_.begin(); it != options_.end(); ++it) {
+        const options_type& options = options_.get();
+        for (options_type::const_iterator it = options.begin(); it != options.end(); ++it) {
             stream.write(it->option());
             stream.write<uint8_t>(it->length_field());
             stream.write(it->data_ptr(), it->data_size());
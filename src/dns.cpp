@@ -42,6 +42,7 @@ using std::make_pair;
 
 using Tins::Memory::InputMemoryStream;
 using Tins::Memory::OutputMemoryStream;
+using Tins::Memory::OutputBufferStream;
 
 namespace Tins {
 
@@ -78,7 +79,7 @@ DNS::DNS(const uint8_t* buffer, uint32_t total_sz)
     }
 }
 
-void DNS::skip_to_dname_end(InputMemoryStream& stream) const {
+void DNS::skip_to_dname_end(InputMemoryStream& stream) {
     while (stream) {
         uint8_t value = stream.read<uint8_t>();
         if (value == 0) {
@@ -332,52 +333,12 @@ string DNS::decode_domain_name(const string& domain_name) {
 // a std::string but it worked about 50% slower, so this is somehow 
 // unsafe but a lot faster.
 uint32_t DNS::compose_name(const uint8_t* ptr, char* out_ptr) const {
-    const uint8_t* start_ptr = ptr;
-    const uint8_t* end = &records_data_[0] + records_data_.size();
-    const uint8_t* end_ptr = 0;
-    char* current_out_ptr = out_ptr;
-    while (*ptr) {
-        // It's an offset
-        if ((*ptr & 0xc0)) {
-            if (TINS_UNLIKELY(ptr + sizeof(uint16_t) > end)) {
-                throw malformed_packet();
-            }
-            uint16_t index;
-            memcpy(&index, ptr, sizeof(uint16_t));
-            index = Endian::be_to_host(index) & 0x3fff;
-            // Check that the offset is neither too low or too high
-            if (index < 0x0c || (&records_data_[0] + (index - 0x0c)) >= end) {
-                throw malformed_packet();
-            }
-            // We've probably found the end of the original domain name. Save it.
-            if (end_ptr == 0) {
-                end_ptr = ptr + sizeof(uint16_t);
-            }
-            // Now this is our pointer
-            ptr = &records_data_[index - 0x0c];
-        }
-        else {
-            // It's a label, grab its size.
-            uint8_t size = *ptr;
-            ptr++;
-            if (TINS_UNLIKELY(ptr + size > end || current_out_ptr - out_ptr + size + 1 > 255)) {
-                throw malformed_packet();
-            }
-            // Append a dot if it's not the first one.
-            if (current_out_ptr != out_ptr) {
-                *current_out_ptr++ = '.';
-            }
-            memcpy(current_out_ptr, ptr, size);
-            current_out_ptr += size;
-            ptr += size;
-        }
-    }
-    // Add the null terminator.
-    *current_out_ptr = 0;
-    if (!end_ptr) {
-        end_ptr = ptr + 1;
-    }
-    return end_ptr - start_ptr;
+    const uint8_t* records_start = &records_data_[0];
+    const uint8_t* end = records_start + records_data_.size();
+    uint32_t encoded_size;
+    name_view(records_start, end, ptr).decode(out_ptr, name_view::MAX_NAME_SIZE,
+                                              encoded_size);
+    return encoded_size;
 }
 
 void DNS::write_serialization(uint8_t* buffer, uint32_t total_sz) {
@@ -603,6 +564,484 @@ DNS::resources_type DNS::additional() const {
     return res;
 }
 
+// Name view
+
+// A name can't be longer than 255 bytes, so there can't be more pointers than this
+static const uint32_t MAX_NAME_POINTERS = 128;
+
+static char to_lower(char value) {
+    return (value >= 'A' && value <= 'Z') ? value - 'A' + 'a' : value;
+}
+
+DNS::name_view::name_view() 
+: records_start_(0), end_(0), ptr_(0) {
+
+}
+
+DNS::name_view::name_view(const uint8_t* records_start, const uint8_t* end,
+                          const uint8_t* ptr)
+: records_start_(records_start), end_(end), ptr_(ptr) {
+
+}
+
+const uint8_t* DNS::name_view::follow_pointer(const uint8_t* ptr) const {
+    if (TINS_UNLIKELY(ptr + sizeof(uint16_t) > end_)) {
+        throw malformed_packet();
+    }
+    const uint16_t index = ((ptr[0] & 0x3f) << 8) | ptr[1];
+    // Check that the offset is neither too low or too high
+    if (index < sizeof(dns_header) || records_start_ + (index - sizeof(dns_header)) >= end_) {
+        throw malformed_packet();
+    }
+    return records_start_ + (index - sizeof(dns_header));
+}
+
+uint32_t DNS::name_view::decode(char* output, uint32_t output_size) const {
+    uint32_t encoded_size;
+    return decode(output, output_size, encoded_size);
+}
+
+uint32_t DNS::name_view::decode(char* output, uint32_t output_size,
+                                uint32_t& encoded_size) const {
+    if (TINS_UNLIKELY(output_size == 0)) {
+        throw malformed_packet();
+    }
+    uint32_t length = 0;
+    uint32_t pointers_followed = 0;
+    const uint8_t* ptr = ptr_;
+    // Where the name ends in place, known once the null label or the first 
+    // pointer is found
+    const uint8_t* name_end = 0;
+    while (ptr) {
+        if (TINS_UNLIKELY(ptr >= end_)) {
+            throw malformed_packet();
+        }
+        const uint8_t size = *ptr;
+        if (size == 0) {
+            if (!name_end) {
+                name_end = ptr + 1;
+            }
+            break;
+        }
+        else if ((size & 0xc0)) {
+            if (TINS_UNLIKELY(++pointers_followed > MAX_NAME_POINTERS)) {
+                throw malformed_packet();
+            }
+            if (!name_end) {
+                name_end = ptr + sizeof(uint16_t);
+            }
+            ptr = follow_pointer(ptr);
+        }
+        else {
+            ptr++;
+            const uint32_t new_length = length + size + (length ? 1 : 0);
+            if (TINS_UNLIKELY(ptr + size > end_ || new_length > 255 ||
+                              new_length >= output_size)) {
+                throw malformed_packet();
+            }
+            // Append a dot if it's not the first one.
+            if (length) {
+                output[length++] = '.';
+            }
+            memcpy(output + length, ptr, size);
+            length += size;
+            ptr += size;
+        }
+    }
+    output[length] = 0;
+    encoded_size = static_cast<uint32_t>(name_end - ptr_);
+    return length;
+}
+
+string DNS::name_view::to_string() const {
+    char buffer[MAX_NAME_SIZE];
+    const uint32_t length = decode(buffer, sizeof(buffer));
+    return string(buffer, buffer + length);
+}
+
+bool DNS::name_view::equals(const char* name) const {
+    const char* current = name;
+    uint32_t pointers_followed = 0;
+    const uint8_t* ptr = ptr_;
+    while (ptr) {
+        if (TINS_UNLIKELY(ptr >= end_)) {
+            throw malformed_packet();
+        }
+        const uint8_t size = *ptr;
+        if (size == 0) {
+            break;
+        }
+        else if ((size & 0xc0)) {
+            if (TINS_UNLIKELY(++pointers_followed > MAX_NAME_POINTERS)) {
+                throw malformed_packet();
+            }
+            ptr = follow_pointer(ptr);
+        }
+        else {
+            ptr++;
+            if (TINS_UNLIKELY(ptr + size > end_)) {
+                throw malformed_packet();
+            }
+            // Labels other than the first one must be preceded by a dot
+            if (current != name && *current++ != '.') {
+                return false;
+            }
+            for (uint8_t i = 0; i < size; ++i, ++current) {
+                if (*current == 0 || to_lower(*current) != to_lower(ptr[i])) {
+                    return false;
+                }
+            }
+            ptr += size;
+        }
+    }
+    // Fully qualified names end with a dot
+    if (*current == '.') {
+        ++current;
+    }
+    return *current == 0;
+}
+
+// Record view
+
+DNS::record_view::record_view()
+: records_start_(0), end_(0), data_ptr_(0), section_(QUESTION), ttl_(0), type_(0),
+  qclass_(0), data_size_(0) {
+
+}
+
+uint16_t DNS::record_view::preference() const {
+    if (type_ != MX || data_size_ < sizeof(uint16_t)) {
+        return 0;
+    }
+    return (data_ptr_[0] << 8) | data_ptr_[1];
+}
+
+DNS::name_view DNS::record_view::data_name() const {
+    switch (type_) {
+        case NS:
+        case CNAME:
+        case DNAM:
+        case PTR:
+            return name_view(records_start_, end_, data_ptr_);
+        case MX:
+            if (data_size_ > sizeof(uint16_t)) {
+                return name_view(records_start_, end_, data_ptr_ + sizeof(uint16_t));
+            }
+            break;
+        default:
+            break;
+    }
+    return name_view();
+}
+
+// Record reader
+
+DNS::record_reader::record_reader(const uint8_t* buffer, uint32_t total_sz) {
+    if (TINS_UNLIKELY(total_sz < sizeof(dns_header))) {
+        throw malformed_packet();
+    }
+    init(buffer, buffer + sizeof(dns_header), buffer + total_sz);
+}
+
+DNS::record_reader::record_reader(const DNS& dns) {
+    const uint8_t* records_start = dns.records_data_.empty() ? 0 : &dns.records_data_[0];
+    init(
+        reinterpret_cast<const uint8_t*>(&dns.header_),
+        records_start,
+        records_start + dns.records_data_.size()
+    );
+}
+
+void DNS::record_reader::init(const uint8_t* header, const uint8_t* records_start,
+                              const uint8_t* end) {
+    InputMemoryStream stream(header, sizeof(dns_header));
+    stream.skip(sizeof(uint16_t) * 2);
+    for (size_t i = 0; i < sizeof(counts_) / sizeof(counts_[0]); ++i) {
+        counts_[i] = stream.read_be<uint16_t>();
+    }
+    records_start_ = records_start;
+    ptr_ = records_start;
+    end_ = end;
+    section_ = record_view::QUESTION;
+}
+
+bool DNS::record_reader::next(record_view& record) {
+    while (section_ <= record_view::ADDITIONAL && counts_[section_] == 0) {
+        ++section_;
+    }
+    if (section_ > record_view::ADDITIONAL) {
+        return false;
+    }
+    --counts_[section_];
+    InputMemoryStream stream(ptr_, end_ - ptr_);
+    record.dname_ = name_view(records_start_, end_, ptr_);
+    skip_to_dname_end(stream);
+    record.records_start_ = records_start_;
+    record.end_ = end_;
+    record.section_ = static_cast<record_view::Section>(section_);
+    record.type_ = stream.read_be<uint16_t>();
+    record.qclass_ = stream.read_be<uint16_t>();
+    if (section_ == record_view::QUESTION) {
+        record.ttl_ = 0;
+        record.data_ptr_ = 0;
+        record.data_size_ = 0;
+    }
+    else {
+        record.ttl_ = stream.read_be<uint32_t>();
+        record.data_size_ = stream.read_be<uint16_t>();
+        if (TINS_UNLIKELY(!stream.can_read(record.data_size_))) {
+            throw malformed_packet();
+        }
+        record.data_ptr_ = stream.pointer();
+        stream.skip(record.data_size_);
+    }
+    ptr_ = stream.pointer();
+    return true;
+}
+
+// Message builder
+
+// Compression pointers can only hold 14 bit offsets
+static const uint32_t MAX_POINTER_OFFSET = 0x3fff;
+static const uint32_t MAX_LABEL_SIZE = 63;
+// Wire size of a name, including every length byte and the root label
+static const uint32_t MAX_NAME_SIZE = 255;
+
+// Throws invalid_domain_name if the name has an empty label or one that's too 
+// long, or if the whole name doesn't fit in 255 bytes once encoded
+static void validate_name(const string& name) {
+    size_t name_end = name.size();
+    // Ignore the trailing dot of fully qualified names
+    if (name_end > 0 && name[name_end - 1] == '.') {
+        --name_end;
+    }
+    size_t label_start = 0;
+    while (label_start < name_end) {
+        size_t label_end = name.find('.', label_start);
+        if (label_end == string::npos || label_end > name_end) {
+            label_end = name_end;
+        }
+        const size_t label_size = label_end - label_start;
+        if (label_size == 0 || label_size > MAX_LABEL_SIZE) {
+            throw invalid_domain_name();
+        }
+        label_start = label_end + 1;
+    }
+    // Every label is preceded by its length and the name ends with the root label
+    size_t wire_size = 1;
+    if (name_end > 0) {
+        wire_size += name_end + 1;
+    }
+    if (wire_size > MAX_NAME_SIZE) {
+        throw invalid_domain_name();
+    }
+}
+
+// Case insensitive FNV-1a hash of a label
+static uint32_t label_hash(const string& name, size_t label_start, size_t label_end) {
+    uint32_t output = 2166136261U;
+    for (size_t i = label_start; i < label_end; ++i) {
+        output ^= static_cast<uint8_t>(to_lower(name[i]));
+        output *= 16777619U;
+    }
+    return output;
+}
+
+static uint64_t suffix_key(uint16_t parent, uint32_t hash) {
+    return (static_cast<uint64_t>(parent) << 32) | hash;
+}
+
+DNS::message_builder::message_builder() {
+    clear();
+}
+
+void DNS::message_builder::add_query(const query& query) {
+    // Validate everything before writing so a failure leaves the builder untouched
+    validate_name(query.dname());
+    start_section(QUESTIONS_SECTION);
+    write_name(query.dname());
+    OutputBufferStream stream(records_data_);
+    stream.write_be<uint16_t>(query.query_type());
+    stream.write_be<uint16_t>(query.query_class());
+    ++counts_[QUESTIONS_SECTION];
+}
+
+void DNS::message_builder::add_answer(const resource& resource) {
+    add_record(resource, ANSWERS_SECTION);
+}
+
+void DNS::message_builder::add_authority(const resource& resource) {
+    add_record(resource, AUTHORITY_SECTION);
+}
+
+void DNS::message_builder::add_additional(const resource& resource) {
+    add_record(resource, ADDITIONAL_SECTION);
+}
+
+DNS DNS::message_builder::build() const {
+    uint32_t section_starts[SECTIONS_COUNT];
+    for (uint32_t i = 0; i < SECTIONS_COUNT; ++i) {
+        // Sections after the last one used start at the end of the buffer
+        section_starts[i] = (i <= section_) ? section_starts_[i] : 
+                            static_cast<uint32_t>(records_data_.size());
+    }
+    DNS output;
+    output.records_data_ = records_data_;
+    output.answers_idx_ = section_starts[ANSWERS_SECTION];
+    output.authority_idx_ = section_starts[AUTHORITY_SECTION];
+    output.additional_idx_ = section_starts[ADDITIONAL_SECTION];
+    output.header_.questions = Endian::host_to_be(counts_[QUESTIONS_SECTION]);
+    output.header_.answers = Endian::host_to_be(counts_[ANSWERS_SECTION]);
+    output.header_.authority = Endian::host_to_be(counts_[AUTHORITY_SECTION]);
+    output.header_.additional = Endian::host_to_be(counts_[ADDITIONAL_SECTION]);
+    return output;
+}
+
+void DNS::message_builder::clear() {
+    records_data_.clear();
+    suffixes_.clear();
+    for (uint32_t i = 0; i < SECTIONS_COUNT; ++i) {
+        section_starts_[i] = 0;
+        counts_[i] = 0;
+    }
+    section_ = QUESTIONS_SECTION;
+}
+
+void DNS::message_builder::start_section(uint32_t section) {
+    if (section < section_) {
+        throw invalid_section_order();
+    }
+    while (section_ < section) {
+        section_starts_[++section_] = static_cast<uint32_t>(records_data_.size());
+    }
+}
+
+void DNS::message_builder::add_record(const resource& resource, uint32_t section) {
+    const uint16_t type = resource.query_type();
+    // Validate and parse everything before writing so a failure leaves the 
+    // builder untouched
+    validate_name(resource.dname());
+    IPv4Address ipv4_address;
+    IPv6Address ipv6_address;
+    if (type == A) {
+        ipv4_address = IPv4Address(resource.data());
+    }
+    else if (type == AAAA) {
+        ipv6_address = IPv6Address(resource.data());
+    }
+    else if (contains_dname(type)) {
+        validate_name(resource.data());
+    }
+    start_section(section);
+    write_name(resource.dname());
+    OutputBufferStream stream(records_data_);
+    stream.write_be(type);
+    stream.write_be(resource.query_class());
+    stream.write_be(resource.ttl());
+    // The data length is filled once the data is written
+    const size_t data_length_index = records_data_.size();
+    stream.write<uint16_t>(0);
+    if (type == MX) {
+        stream.write_be(resource.preference());
+    }
+    if (type == A) {
+        stream.write(static_cast<uint32_t>(ipv4_address));
+    }
+    else if (type == AAAA) {
+        stream.write(ipv6_address.begin(), ipv6_address.end());
+    }
+    else if (contains_dname(type)) {
+        write_name(resource.data());
+    }
+    else {
+        stream.write(resource.data().begin(), resource.data().end());
+    }
+    const uint16_t data_length = Endian::host_to_be<uint16_t>(
+        records_data_.size() - data_length_index - sizeof(uint16_t)
+    );
+    memcpy(&records_data_[data_length_index], &data_length, sizeof(data_length));
+    ++counts_[section];
+}
+
+// Finds a label that was written followed by the suffix at the parent offset 
+// (0 being the root label). The label is compared against the written bytes so 
+// no string is built for each suffix
+bool DNS::message_builder::find_suffix(uint16_t parent, const string& name,
+                                       size_t label_start, size_t label_end,
+                                       uint16_t& offset) const {
+    const size_t label_size = label_end - label_start;
+    const uint64_t key = suffix_key(parent, label_hash(name, label_start, label_end));
+    typedef suffixes_type::const_iterator iterator;
+    std::pair<iterator, iterator> range = suffixes_.equal_range(key);
+    for (iterator iter = range.first; iter != range.second; ++iter) {
+        const uint8_t* label = &records_data_[iter->second - sizeof(dns_header)];
+        if (*label++ != label_size) {
+            continue;
+        }
+        size_t i = 0;
+        while (i < label_size && to_lower(label[i]) == to_lower(name[label_start + i])) {
+            ++i;
+        }
+        if (i == label_size) {
+            offset = iter->second;
+            return true;
+        }
+    }
+    return false;
+}
+
+// The name must have been checked using validate_name
+void DNS::message_builder::write_name(const string& name) {
+    OutputBufferStream stream(records_data_);
+    size_t name_end = name.size();
+    // Ignore the trailing dot of fully qualified names
+    if (name_end > 0 && name[name_end - 1] == '.') {
+        --name_end;
+    }
+    // Find the longest suffix that was already written, one label at a time 
+    // starting from the root. The name's labels before prefix_end aren't written
+    uint16_t parent = 0;
+    size_t prefix_end = name_end;
+    while (prefix_end > 0) {
+        size_t label_start = name.rfind('.', prefix_end - 1);
+        label_start = (label_start == string::npos) ? 0 : label_start + 1;
+        uint16_t offset;
+        if (!find_suffix(parent, name, label_start, prefix_end, offset)) {
+            break;
+        }
+        parent = offset;
+        prefix_end = (label_start == 0) ? 0 : label_start - 1;
+    }
+    size_t label_start = 0;
+    while (label_start < prefix_end) {
+        size_t label_end = name.find('.', label_start);
+        if (label_end == string::npos || label_end > prefix_end) {
+            label_end = prefix_end;
+        }
+        const size_t label_size = label_end - label_start;
+        const uint32_t offset = static_cast<uint32_t>(sizeof(dns_header) + records_data_.size());
+        // The next label is written right after this one
+        const uint32_t next_offset = (label_end < prefix_end) ? 
+                                     offset + 1 + static_cast<uint32_t>(label_size) :
+                                     parent;
+        if (offset <= MAX_POINTER_OFFSET && next_offset <= MAX_POINTER_OFFSET) {
+            const uint64_t key = suffix_key(static_cast<uint16_t>(next_offset),
+                                            label_hash(name, label_start, label_end));
+            suffixes_.insert(make_pair(key, static_cast<uint16_t>(offset)));
+        }
+        stream.write<uint8_t>(static_cast<uint8_t>(label_size));
+        stream.write(name.begin() + label_start, name.begin() + label_end);
+        label_start = label_end + 1;
+    }
+    if (parent != 0) {
+        // The rest of the name was already written, just point to it
+        stream.write_be<uint16_t>(0xc000 | parent);
+    }
+    else {
+        stream.write<uint8_t>(0);
+    }
+}
+
 bool DNS::matches_response(const uint8_t* ptr, uint32_t total_sz) const {
     if (total_sz < sizeof(header_)) {
         return false;
@@ -0,0 +1,466 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <tins/dns_tracker.h>
+
+#if TINS_IS_CXX11
+
+#include <algorithm>
+#include <cstring>
+#include <cctype>
+#include <tins/dns.h>
+#include <tins/ip.h>
+#include <tins/ipv6.h>
+#include <tins/udp.h>
+#include <tins/rawpdu.h>
+#include <tins/packet.h>
+#include <tins/exceptions.h>
+
+using std::min;
+using std::max;
+using std::chrono::system_clock;
+using std::chrono::seconds;
+using std::chrono::duration_cast;
+
+namespace Tins {
+
+// IPv4 addresses are stored as IPv4-mapped IPv6 addresses in keys
+static IPv6Address to_key_address(const IPv4Address& address) {
+    uint8_t buffer[IPv6Address::address_size] = { 0 };
+    buffer[10] = buffer[11] = 0xff;
+    const uint32_t value = address;
+    std::memcpy(buffer + 12, &value, sizeof(value));
+    return IPv6Address(buffer);
+}
+
+static IPv4Address from_key_address(const IPv6Address& address) {
+    uint32_t value;
+    std::memcpy(&value, address.begin() + 12, sizeof(value));
+    return IPv4Address(value);
+}
+
+static size_t hash_combine(size_t seed, size_t value) {
+    return seed ^ (value + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+}
+
+// latency_histogram
+
+DNSTransactionTracker::latency_histogram::latency_histogram()
+: count_(0), total_(0), min_(0), max_(0) {
+    std::fill(buckets_, buckets_ + BUCKET_COUNT, 0);
+}
+
+void DNSTransactionTracker::latency_histogram::add(const timestamp_type& latency) {
+    const uint64_t value = latency.count() > 0 ? latency.count() : 0;
+    size_t index = 0;
+    for (uint64_t i = value; i >= 2 && index < BUCKET_COUNT - 1; i >>= 1) {
+        ++index;
+    }
+    buckets_[index]++;
+    min_ = count_ == 0 ? value : std::min(min_, value);
+    max_ = std::max(max_, value);
+    total_ += value;
+    ++count_;
+}
+
+void DNSTransactionTracker::latency_histogram::merge(const latency_histogram& other) {
+    if (other.count_ == 0) {
+        return;
+    }
+    for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+        buckets_[i] += other.buckets_[i];
+    }
+    min_ = count_ == 0 ? other.min_ : std::min(min_, other.min_);
+    max_ = std::max(max_, other.max_);
+    total_ += other.total_;
+    count_ += other.count_;
+}
+
+DNSTransactionTracker::timestamp_type 
+DNSTransactionTracker::latency_histogram::bucket_upper_bound(size_t index) {
+    return timestamp_type(static_cast<int64_t>(2) << index);
+}
+
+DNSTransactionTracker::timestamp_type DNSTransactionTracker::latency_histogram::min() const {
+    return timestamp_type(min_);
+}
+
+DNSTransactionTracker::timestamp_type DNSTransactionTracker::latency_histogram::max() const {
+    return timestamp_type(max_);
+}
+
+DNSTransactionTracker::timestamp_type DNSTransactionTracker::latency_histogram::mean() const {
+    return timestamp_type(count_ == 0 ? 0 : total_ / count_);
+}
+
+DNSTransactionTracker::timestamp_type 
+DNSTransactionTracker::latency_histogram::percentile(double fraction) const {
+    if (count_ == 0) {
+        return timestamp_type(0);
+    }
+    fraction = std::min(std::max(fraction, 0.0), 1.0);
+    const uint64_t target = std::max<uint64_t>(static_cast<uint64_t>(fraction * count_ + 0.5), 1);
+    uint64_t accumulated = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+        accumulated += buckets_[i];
+        if (accumulated >= target) {
+            return timestamp_type(std::min<uint64_t>(bucket_upper_bound(i).count(), max_));
+        }
+    }
+    return timestamp_type(max_);
+}
+
+// statistics
+
+DNSTransactionTracker::statistics::statistics()
+: queries(0), duplicate_queries(0), dropped_queries(0), unmatched_responses(0) {
+
+}
+
+void DNSTransactionTracker::statistics::merge(const statistics& other) {
+    total.merge(other.total);
+    for (ipv4_servers_type::const_iterator iter = other.ipv4_servers.begin();
+         iter != other.ipv4_servers.end(); ++iter) {
+        ipv4_servers[iter->first].merge(iter->second);
+    }
+    for (ipv6_servers_type::const_iterator iter = other.ipv6_servers.begin();
+         iter != other.ipv6_servers.end(); ++iter) {
+        ipv6_servers[iter->first].merge(iter->second);
+    }
+    for (query_types_type::const_iterator iter = other.query_types.begin();
+         iter != other.query_types.end(); ++iter) {
+        query_types[iter->first].merge(iter->second);
+    }
+    queries += other.queries;
+    duplicate_queries += other.duplicate_queries;
+    dropped_queries += other.dropped_queries;
+    unmatched_responses += other.unmatched_responses;
+}
+
+// DNSTransactionTracker
+
+const DNSTransactionTracker::timestamp_type DNSTransactionTracker::DEFAULT_TIMEOUT = seconds(5);
+const size_t DNSTransactionTracker::DEFAULT_MAX_PENDING_QUERIES = 256 * 1024;
+const uint16_t DNSTransactionTracker::DEFAULT_SERVER_PORT = 53;
+// Deadlines are always at most half a turn ahead of the current tick
+const size_t DNSTransactionTracker::WHEEL_SLOTS = 64;
+
+bool DNSTransactionTracker::key_type::operator==(const key_type& rhs) const {
+    return id == rhs.id && client_port == rhs.client_port && 
+           server_port == rhs.server_port && query_type == rhs.query_type &&
+           query_class == rhs.query_class && is_ipv6 == rhs.is_ipv6 &&
+           client == rhs.client && server == rhs.server && name == rhs.name;
+}
+
+size_t DNSTransactionTracker::key_hash::operator()(const key_type& key) const {
+    size_t output = std::hash<uint16_t>()(key.id);
+    output = hash_combine(output, std::hash<IPv6Address>()(key.client));
+    output = hash_combine(output, std::hash<IPv6Address>()(key.server));
+    output = hash_combine(output, (key.client_port << 16) | key.server_port);
+    output = hash_combine(output, (key.query_type << 16) | key.query_class);
+    return hash_combine(output, std::hash<std::string>()(key.name));
+}
+
+size_t DNSTransactionTracker::shard(const PDU& pdu, size_t shard_count) {
+    const UDP* udp = pdu.find_pdu<UDP>();
+    if (!udp) {
+        return 0;
+    }
+    size_t first;
+    size_t second;
+    if (const IP* ip = pdu.find_pdu<IP>()) {
+        first = std::hash<IPv4Address>()(ip->src_addr());
+        second = std::hash<IPv4Address>()(ip->dst_addr());
+    }
+    else if (const IPv6* ipv6 = pdu.find_pdu<IPv6>()) {
+        first = std::hash<IPv6Address>()(ipv6->src_addr());
+        second = std::hash<IPv6Address>()(ipv6->dst_addr());
+    }
+    else {
+        return 0;
+    }
+    // XOR the hash of both endpoints so that the result is the same 
+    // in both directions
+    const size_t output = hash_combine(first, udp->sport()) ^ 
+                          hash_combine(second, udp->dport());
+    return hash_combine(0, output) % shard_count;
+}
+
+DNSTransactionTracker::DNSTransactionTracker()
+: wheel_(WHEEL_SLOTS), timeout_(DEFAULT_TIMEOUT), tick_(DEFAULT_TIMEOUT / static_cast<int64_t>(WHEEL_SLOTS / 2)),
+  current_tick_(0), max_pending_queries_(DEFAULT_MAX_PENDING_QUERIES),
+  server_port_(DEFAULT_SERVER_PORT), started_(false) {
+
+}
+
+DNSTransactionTracker::PacketStatus DNSTransactionTracker::process(const PDU& pdu) {
+    // Use current time
+    const system_clock::duration ts = system_clock::now().time_since_epoch();
+    return process(pdu, duration_cast<timestamp_type>(ts));
+}
+
+DNSTransactionTracker::PacketStatus DNSTransactionTracker::process(const Packet& packet) {
+    if (!packet.pdu()) {
+        return NOT_DNS;
+    }
+    return process(*packet.pdu(), packet.timestamp());
+}
+
+DNSTransactionTracker::PacketStatus DNSTransactionTracker::process(const PDU& pdu,
+                                                                   const timestamp_type& ts) {
+    advance(ts);
+    bool is_response;
+    if (!parse_message(pdu, lookup_key_, is_response)) {
+        return NOT_DNS;
+    }
+    if (is_response) {
+        queries_type::iterator iter = queries_.find(lookup_key_);
+        if (iter == queries_.end()) {
+            ++stats_.unmatched_responses;
+            return UNMATCHED_RESPONSE;
+        }
+        const timestamp_type latency = ts - iter->second.sent;
+        stats_.total.latency.add(latency);
+        server_stats(iter->first).latency.add(latency);
+        stats_.query_types[iter->first.query_type].latency.add(latency);
+        unschedule(*iter);
+        queries_.erase(iter);
+        return RESPONSE;
+    }
+    ++stats_.queries;
+    queries_type::iterator iter = queries_.find(lookup_key_);
+    if (iter != queries_.end()) {
+        // A retransmission, latency is measured from the first query
+        ++stats_.duplicate_queries;
+        return DUPLICATE_QUERY;
+    }
+    if (max_pending_queries_ > 0 && queries_.size() >= max_pending_queries_) {
+        ++stats_.dropped_queries;
+        return DROPPED_QUERY;
+    }
+    pending_query query;
+    query.sent = ts;
+    query.deadline = ts + timeout_;
+    query.slot = 0;
+    query.position = 0;
+    iter = queries_.insert(std::make_pair(lookup_key_, query)).first;
+    schedule(*iter);
+    return QUERY;
+}
+
+void DNSTransactionTracker::advance(const timestamp_type& now) {
+    const int64_t target_tick = tick_of(now);
+    if (!started_) {
+        current_tick_ = target_tick;
+        started_ = true;
+        return;
+    }
+    if (target_tick <= current_tick_) {
+        return;
+    }
+    // If a full turn has passed, every slot needs to be looked at once
+    const int64_t ticks = min<int64_t>(target_tick - current_tick_, WHEEL_SLOTS);
+    for (int64_t i = 1; i <= ticks; ++i) {
+        expire_slot(wheel_[(current_tick_ + i) % WHEEL_SLOTS], now);
+    }
+    current_tick_ = target_tick;
+}
+
+void DNSTransactionTracker::set_timeout(const timestamp_type& value) {
+    timeout_ = value;
+    tick_ = max(timeout_ / static_cast<int64_t>(WHEEL_SLOTS / 2), timestamp_type(1));
+    // Ticks are measured in a different unit now, so reschedule everything
+    started_ = false;
+    for (size_t i = 0; i < wheel_.size(); ++i) {
+        wheel_[i].clear();
+    }
+    timestamp_type latest(0);
+    for (queries_type::iterator iter = queries_.begin(); iter != queries_.end(); ++iter) {
+        latest = max(latest, iter->second.sent);
+    }
+    if (!queries_.empty()) {
+        current_tick_ = tick_of(latest);
+        started_ = true;
+    }
+    for (queries_type::iterator iter = queries_.begin(); iter != queries_.end(); ++iter) {
+        iter->second.deadline = iter->second.sent + timeout_;
+        schedule(*iter);
+    }
+}
+
+void DNSTransactionTracker::max_pending_queries(size_t value) {
+    max_pending_queries_ = value;
+}
+
+void DNSTransactionTracker::server_port(uint16_t value) {
+    server_port_ = value;
+}
+
+size_t DNSTransactionTracker::pending_queries() const {
+    return queries_.size();
+}
+
+const DNSTransactionTracker::statistics& DNSTransactionTracker::stats() const {
+    return stats_;
+}
+
+void DNSTransactionTracker::clear() {
+    queries_.clear();
+    for (size_t i = 0; i < wheel_.size(); ++i) {
+        wheel_[i].clear();
+    }
+    stats_ = statistics();
+    started_ = false;
+}
+
+bool DNSTransactionTracker::parse_message(const PDU& pdu, key_type& key,
+                                          bool& is_response) const {
+    const UDP* udp = pdu.find_pdu<UDP>();
+    if (!udp || !udp->inner_pdu()) {
+        return false;
+    }
+    if (udp->dport() != server_port_ && udp->sport() != server_port_) {
+        return false;
+    }
+    try {
+        DNS::record_view question;
+        if (const DNS* dns = udp->find_pdu<DNS>()) {
+            key.id = dns->id();
+            is_response = dns->type() == DNS::RESPONSE;
+            DNS::record_reader reader(*dns);
+            if (!reader.next(question)) {
+                return false;
+            }
+        }
+        else if (const RawPDU* raw = udp->find_pdu<RawPDU>()) {
+            const RawPDU::payload_type& payload = raw->payload();
+            // The reader validates the size
+            DNS::record_reader reader(payload.empty() ? 0 : &payload[0],
+                                      static_cast<uint32_t>(payload.size()));
+            key.id = (payload[0] << 8) | payload[1];
+            is_response = (payload[2] & 0x80) != 0;
+            if (!reader.next(question)) {
+                return false;
+            }
+        }
+        else {
+            return false;
+        }
+        if (question.section() != DNS::record_view::QUESTION) {
+            return false;
+        }
+        char name[DNS::name_view::MAX_NAME_SIZE];
+        const uint32_t length = question.dname().decode(name, sizeof(name));
+        // Names are case insensitive
+        for (uint32_t i = 0; i < length; ++i) {
+            name[i] = static_cast<char>(std::tolower(static_cast<unsigned char>(name[i])));
+        }
+        // Reuses the key's buffer
+        key.name.assign(name, length);
+        key.query_type = question.query_type();
+        key.query_class = question.query_class();
+    }
+    catch (const malformed_packet&) {
+        return false;
+    }
+    const bool from_server = is_response;
+    if (from_server ? udp->sport() != server_port_ : udp->dport() != server_port_) {
+        return false;
+    }
+    key.client_port = from_server ? udp->dport() : udp->sport();
+    key.server_port = from_server ? udp->sport() : udp->dport();
+    if (const IP* ip = pdu.find_pdu<IP>()) {
+        key.is_ipv6 = false;
+        key.client = to_key_address(from_server ? ip->dst_addr() : ip->src_addr());
+        key.server = to_key_address(from_server ? ip->src_addr() : ip->dst_addr());
+    }
+    else if (const IPv6* ipv6 = pdu.find_pdu<IPv6>()) {
+        key.is_ipv6 = true;
+        key.client = from_server ? ipv6->dst_addr() : ipv6->src_addr();
+        key.server = from_server ? ipv6->src_addr() : ipv6->dst_addr();
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+void DNSTransactionTracker::schedule(queries_type::value_type& entry) {
+    // Queries are due in the first tick at or after their deadline
+    const timestamp_type& deadline = entry.second.deadline;
+    const int64_t deadline_tick = max(tick_of(deadline - timestamp_type(1)) + 1, 
+                                      current_tick_ + 1);
+    wheel_slot_type& slot = wheel_[deadline_tick % WHEEL_SLOTS];
+    entry.second.slot = deadline_tick % WHEEL_SLOTS;
+    entry.second.position = slot.size();
+    slot.push_back(&entry);
+}
+
+void DNSTransactionTracker::unschedule(queries_type::value_type& entry) {
+    wheel_slot_type& slot = wheel_[entry.second.slot];
+    queries_type::value_type* last = slot.back();
+    slot[entry.second.position] = last;
+    last->second.position = entry.second.position;
+    slot.pop_back();
+}
+
+void DNSTransactionTracker::expire_slot(wheel_slot_type& slot, const timestamp_type& now) {
+    size_t i = 0;
+    while (i < slot.size()) {
+        queries_type::value_type& entry = *slot[i];
+        // After a long gap, a slot can hold queries due in a later turn
+        if (entry.second.deadline > now) {
+            ++i;
+            continue;
+        }
+        stats_.total.unanswered++;
+        server_stats(entry.first).unanswered++;
+        stats_.query_types[entry.first.query_type].unanswered++;
+        unschedule(entry);
+        queries_.erase(queries_.find(entry.first));
+    }
+}
+
+DNSTransactionTracker::query_statistics& 
+DNSTransactionTracker::server_stats(const key_type& key) {
+    if (key.is_ipv6) {
+        return stats_.ipv6_servers[key.server];
+    }
+    return stats_.ipv4_servers[from_key_address(key.server)];
+}
+
+int64_t DNSTransactionTracker::tick_of(const timestamp_type& ts) const {
+    // Floor division, timestamps could be negative
+    const int64_t value = ts.count();
+    const int64_t tick = tick_.count();
+    return value >= 0 ? value / tick : -((-value + tick - 1) / tick);
+}
+
+} // Tins
+
+#endif // TINS_IS_CXX11
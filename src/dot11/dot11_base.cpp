@@ -49,8 +49,6 @@
 #include <tins/packet_sender.h>
 #include <tins/memory_helpers.h>
 
-using std::vector;
-
 using Tins::Memory::InputMemoryStream;
 using Tins::Memory::OutputMemoryStream;
 
@@ -81,21 +79,22 @@ void Dot11::write_fixed_parameters(Memory::OutputMemoryStream& /*stream*/) {
 
 void Dot11::parse_tagged_parameters(InputMemoryStream& stream) {
     if (stream) {
-        while (stream.size() >= 2) {
-            OptionTypes opcode = static_cast<OptionTypes>(stream.read<uint8_t>());
-            uint8_t length = stream.read<uint8_t>();
-            if (!stream.can_read(length)) {
-                throw malformed_packet();
-            }
-            add_tagged_option(opcode, length, stream.pointer());
-            stream.skip(length);
+        const uint8_t* first = stream.pointer();
+        const uint8_t* last = first + stream.size();
+        // Options are only parsed when they're needed
+        const Internals::RawOptionIterator end;
+        for (Internals::RawOptionIterator iter(Internals::DOT11_OPTION_LAYOUT, first, last);
+             iter != end; ++iter) {
+            options_size_ += iter->data_size + sizeof(uint8_t) * 2;
         }
+        options_.assign(first, last);
+        stream.skip(stream.size());
     }
 }
 
 void Dot11::add_tagged_option(OptionTypes opt, uint8_t len, const uint8_t* val) {
     uint32_t opt_size = len + sizeof(uint8_t) * 2;
-    options_.push_back(option((uint8_t)opt, val, val + len));
+    options_.get_mutable().push_back(option((uint8_t)opt, val, val + len));
     options_size_ += opt_size;
 }
 
@@ -105,31 +104,36 @@ void Dot11::internal_add_option(const option& opt) {
 
 bool Dot11::remove_option(OptionTypes type) {
     options_type::iterator iter = search_option_iterator(type);
-    if (iter == options_.end()) {
+    options_type& options = options_.get_mutable();
+    if (iter == options.end()) {
         return false;
     }
     options_size_ -= static_cast<uint32_t>(iter->data_size() + sizeof(uint8_t) * 2);
-    options_.erase(iter);
+    options.erase(iter);
     return true;
 }
 
 void Dot11::add_option(const option& opt) {
     internal_add_option(opt);
-    options_.push_back(opt);
+    options_.get_mutable().push_back(opt);
 }
 
 const Dot11::option* Dot11::search_option(OptionTypes type) const {
     // Search for the iterator. If we found something, return it, otherwise return nullptr.
     options_type::const_iterator iter = search_option_iterator(type);
-    return (iter != options_.end()) ? &*iter : 0;
+    return (iter != options_.get().end()) ? &*iter : 0;
+}
+
+const Dot11::option* Dot11::search_option(OptionTypes type, option& storage) const {
+    return options_.search(type, storage);
 }
 
 Dot11::options_type::const_iterator Dot11::search_option_iterator(OptionTypes type) const {
-    return Internals::find_option_const<option>(options_, type);
+    return Internals::find_option_const<option>(options_.get(), type);
 }
 
 Dot11::options_type::iterator Dot11::search_option_iterator(OptionTypes type) {
-    return Internals::find_option<option>(options_, type);
+    return Internals::find_option<option>(options_.get_mutable(), type);
 }
 
 void Dot11::protocol(small_uint<2> new_proto) {
@@ -216,7 +220,8 @@ void Dot11::write_serialization(uint8_t* buffer, uint32_t total_sz) {
     stream.write(header_);
     write_ext_header(stream);
     write_fixed_parameters(stream);
-    for (vector<option>::const_iterator it = options_.begin(); it != options_.end(); ++it) {
+    const options_type& options = options_.get();
+    for (options_type::const_iterator it = options.begin(); it != options.end(); ++it) {
         stream.write<uint8_t>(it->option());
         stream.write<uint8_t>(it->length_field());
         stream.write(it->data_ptr(), it->data_size());
@@ -27,71 +27,84 @@
  *
  */
 
-#include <sstream>
-#include <iomanip>
 #include <algorithm>
 #include <tins/hw_address.h>
 #include <tins/exceptions.h>
 
 using std::string;
-using std::ostream;
-using std::hex;
-using std::ostringstream;
 using std::lexicographical_compare;
 using std::equal;
 
 namespace Tins {
 namespace Internals {
 
-void storage_to_string(ostream& output, uint8_t value) {
-    output << hex;
-    if (value < 0x10) {
-        output << '0';
+size_t hw_address_to_chars(const uint8_t* ptr, size_t count, char* buffer, size_t size) {
+    static const char hex_digits[] = "0123456789abcdef";
+    if (count == 0) {
+        return 0;
+    }
+    const size_t length = count * 3 - 1;
+    if (length > size) {
+        return 0;
     }
-    output << (unsigned)value;
-}
-
-string hw_address_to_string(const uint8_t* ptr, size_t count) {
-    ostringstream output;
     for (size_t i = 0; i < count; ++i) {
         if (i != 0) {
-            output << ":";
+            *buffer++ = ':';
         }
-        storage_to_string(output, ptr[i]);
+        *buffer++ = hex_digits[ptr[i] >> 4];
+        *buffer++ = hex_digits[ptr[i] & 0xf];
+    }
+    return length;
+}
+
+string hw_address_to_string(const uint8_t* ptr, size_t count) {
+    if (count == 0) {
+        return string();
     }
-    return output.str();
+    string output(count * 3 - 1, ':');
+    hw_address_to_chars(ptr, count, &output[0], output.size());
+    return output;
 }
 
 void string_to_hw_address(const string& hw_addr, uint8_t* output, size_t output_size)  {
-    unsigned i = 0;
+    const char* data = hw_addr.data();
+    string_to_hw_address(data, data + hw_addr.size(), output, output_size);
+}
+
+void string_to_hw_address(const char* first, const char* last, uint8_t* output,
+                          size_t output_size)  {
     size_t count = 0;
     uint8_t tmp;
-    while (i < hw_addr.size() && count < output_size) {
-        const unsigned end = i+2;
+    while (first != last && count < output_size) {
+        const char* end = first + 2;
         tmp = 0;
-        while (i < end) {
-            if (hw_addr[i] >= 'a' && hw_addr[i] <= 'f') {
-                tmp = (tmp << 4) | (hw_addr[i] - 'a' + 10);
+        while (first != end) {
+            if (first == last) {
+                throw invalid_address();
+            }
+            const char c = *first;
+            if (c >= 'a' && c <= 'f') {
+                tmp = (tmp << 4) | (c - 'a' + 10);
             }
-            else if (hw_addr[i] >= 'A' && hw_addr[i] <= 'F') {
-                tmp = (tmp << 4) | (hw_addr[i] - 'A' + 10);
+            else if (c >= 'A' && c <= 'F') {
+                tmp = (tmp << 4) | (c - 'A' + 10);
             }
-            else if (hw_addr[i] >= '0' && hw_addr[i] <= '9') {
-                tmp = (tmp << 4) | (hw_addr[i] - '0');
+            else if (c >= '0' && c <= '9') {
+                tmp = (tmp << 4) | (c - '0');
             }
-            else if (hw_addr[i] == ':') {
+            else if (c == ':') {
                 break;
             }
             else {
                 throw invalid_address();
             }
-            i++;
+            ++first;
         }
         *(output++) = tmp;
         count++;
-        if (i < hw_addr.size()) {
-            if (hw_addr[i] == ':') {
-                i++;
+        if (first != last) {
+            if (*first == ':') {
+                ++first;
             }
             else {
                 throw invalid_address();
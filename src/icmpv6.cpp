@@ -101,26 +101,16 @@ ICMPv6::ICMPv6(const uint8_t* buffer, uint32_t total_sz)
 }
 
 void ICMPv6::parse_options(InputMemoryStream& stream) {
-    while (stream) {
-        const uint8_t opt_type = stream.read<uint8_t>();
-        const uint32_t opt_size = static_cast<uint32_t>(stream.read<uint8_t>()) * 8;
-        if (opt_size < sizeof(uint8_t) << 1) {
-            throw malformed_packet();
-        }
-        // size(option) = option_size - identifier_size - length_identifier_size
-        const uint32_t payload_size = opt_size - (sizeof(uint8_t) << 1);
-        if (!stream.can_read(payload_size)) { 
-            throw malformed_packet();
-        }
-        add_option(
-            option(
-                opt_type, 
-                payload_size, 
-                stream.pointer()
-            )
-        );
-        stream.skip(payload_size);
+    // Options are only parsed when they're needed
+    const uint8_t* first = stream.pointer();
+    const uint8_t* last = first + stream.size();
+    const Internals::RawOptionIterator end;
+    for (Internals::RawOptionIterator iter(Internals::ICMPV6_OPTION_LAYOUT, first, last);
+         iter != end; ++iter) {
+        options_size_ += iter->data_size + sizeof(uint8_t) * 2;
     }
+    options_.assign(first, last);
+    stream.skip(stream.size());
 }
 
 void ICMPv6::type(Types new_type) {
@@ -339,7 +329,8 @@ void ICMPv6::write_serialization(uint8_t* buffer, uint32_t total_sz) {
             } 
         }
     }
-    for (options_type::const_iterator it = options_.begin(); it != options_.end(); ++it) {
+    const options_type& options = options_.get();
+    for (options_type::const_iterator it = options.begin(); it != options.end(); ++it) {
         write_option(*it, stream);
     }
 
@@ -408,7 +399,7 @@ bool ICMPv6::has_options() const {
 
 void ICMPv6::add_option(const option& option) {
     internal_add_option(option);
-    options_.push_back(option);
+    options_.get_mutable().push_back(option);
 }
 
 void ICMPv6::internal_add_option(const option& option) {
@@ -417,11 +408,12 @@ void ICMPv6::internal_add_option(const option& option) {
 
 bool ICMPv6::remove_option(OptionTypes type) {
     options_type::iterator iter = search_option_iterator(type);
-    if (iter == options_.end()) {
+    options_type& options = options_.get_mutable();
+    if (iter == options.end()) {
         return false;
     }
     options_size_ -= static_cast<uint32_t>(iter->data_size() + sizeof(uint8_t) * 2);
-    options_.erase(iter);
+    options.erase(iter);
     return true;
 }
 
@@ -438,15 +430,15 @@ void ICMPv6::use_mldv2(bool value) {
 const ICMPv6::option* ICMPv6::search_option(OptionTypes type) const {
     // Search for the iterator. If we found something, return it, otherwise return nullptr.
     options_type::const_iterator iter = search_option_iterator(type);
-    return (iter != options_.end()) ? &*iter : 0;
+    return (iter != options_.get().end()) ? &*iter : 0;
 }
 
 ICMPv6::options_type::const_iterator ICMPv6::search_option_iterator(OptionTypes type) const {
-    return Internals::find_option_const<option>(options_, type);
+    return Internals::find_option_const<option>(options_.get(), type);
 }
 
 ICMPv6::options_type::iterator ICMPv6::search_option_iterator(OptionTypes type) {
-    return Internals::find_option<option>(options_, type);
+    return Internals::find_option<option>(options_.get_mutable(), type);
 }
 
 // ********************************************************************
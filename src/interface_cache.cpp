@@ -0,0 +1,471 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <set>
+#include <cstring>
+#include <algorithm>
+#include <tins/macros.h>
+#ifndef _WIN32
+    #include <netinet/in.h>
+    #if defined(BSD) || defined(__FreeBSD_kernel__)
+        #include <ifaddrs.h>
+        #include <net/if_dl.h>
+        #include <sys/socket.h>
+    #else
+        #include <linux/if_packet.h>
+    #endif
+    #include <ifaddrs.h>
+    #include <net/if.h>
+#else
+    #include <winsock2.h>
+    #include <ws2tcpip.h>
+    #include <iphlpapi.h>
+    #undef interface
+#endif
+#ifdef __linux__
+    #include <sys/socket.h>
+    #include <unistd.h>
+    #include <errno.h>
+    #include <linux/netlink.h>
+    #include <linux/rtnetlink.h>
+#endif // __linux__
+#include <tins/interface_cache.h>
+#include <tins/endianness.h>
+
+using std::set;
+using std::string;
+using std::wstring;
+using std::vector;
+using std::copy;
+using std::time;
+
+/** \cond */
+struct InterfaceInfoCollector {
+    typedef Tins::NetworkInterface::Info info_type;
+    info_type* info;
+    int iface_id;
+    const char* iface_name;
+    bool found_hw;
+    bool found_ip;
+
+    InterfaceInfoCollector(info_type* res, int id, const char* if_name) 
+    : info(res), iface_id(id), iface_name(if_name), found_hw(false), found_ip(false) { }
+    
+    #ifndef _WIN32
+    bool operator() (const struct ifaddrs* addr) {
+        using Tins::Endian::host_to_be;
+        using Tins::IPv4Address;
+        #if defined(BSD) || defined(__FreeBSD_kernel__)
+            #define TINS_BROADCAST_ADDR(addr) (addr->ifa_dstaddr)
+            #define TINS_BROADCAST_FLAGS (IFF_BROADCAST | IFF_POINTOPOINT)
+            const struct sockaddr_dl* addr_ptr = ((struct sockaddr_dl*)addr->ifa_addr);
+            
+            if (addr->ifa_addr->sa_family == AF_LINK && addr_ptr->sdl_index == iface_id) {
+                info->hw_addr = (const uint8_t*)LLADDR(addr_ptr);
+                found_hw = true;
+                info->is_up = info->is_up || (addr->ifa_flags & IFF_UP);
+            }
+        #else
+            #define TINS_BROADCAST_ADDR(addr) (addr->ifa_broadaddr)
+            #define TINS_BROADCAST_FLAGS (IFF_BROADCAST)
+            const struct sockaddr_ll* addr_ptr = ((struct sockaddr_ll*)addr->ifa_addr);
+            
+            if (!addr->ifa_addr) {
+                return false;
+            }
+            if (addr->ifa_addr->sa_family == AF_PACKET && addr_ptr->sll_ifindex == iface_id) {
+                info->hw_addr = addr_ptr->sll_addr;
+                found_hw = true;
+                info->is_up = info->is_up || (addr->ifa_flags & IFF_UP);
+            }
+        #endif
+            else if (!std::strcmp(addr->ifa_name, iface_name)) {
+                if (addr->ifa_addr->sa_family == AF_INET) {
+                    info->ip_addr = IPv4Address(((struct sockaddr_in *)addr->ifa_addr)->sin_addr.s_addr);
+                    info->netmask = IPv4Address(((struct sockaddr_in *)addr->ifa_netmask)->sin_addr.s_addr);
+                    if ((addr->ifa_flags & (TINS_BROADCAST_FLAGS))) {
+                        info->bcast_addr = IPv4Address(
+                            ((struct sockaddr_in *)TINS_BROADCAST_ADDR(addr))->sin_addr.s_addr);
+                    }
+                    else {
+                        info->bcast_addr = 0;
+                    }
+                    found_ip = true;
+                }
+                else if (addr->ifa_addr->sa_family == AF_INET6) {
+                    Tins::NetworkInterface::IPv6Prefix prefix;
+                    prefix.address = ((struct sockaddr_in6 *)addr->ifa_addr)->sin6_addr.s6_addr;
+                    Tins::IPv6Address mask = ((struct sockaddr_in6 *)addr->ifa_netmask)->sin6_addr.s6_addr;
+                    prefix.prefix_length = 0;
+                    for (Tins::IPv6Address::iterator iter = mask.begin(); iter != mask.end(); ++iter) {
+                        if (*iter == 255) {
+                            prefix.prefix_length += 8;
+                        }
+                        else {
+                            uint8_t current_value = 128;
+                            while (*iter > 0) {
+                                prefix.prefix_length += 1;
+                                *iter &= ~current_value;
+                                current_value /= 2;
+                            }
+                            break;
+                        }
+                    }
+                    info->ipv6_addrs.push_back(prefix);
+                }
+            }
+        #undef TINS_BROADCAST_ADDR
+        #undef TINS_BROADCAST_FLAGS
+        return found_ip && found_hw;
+    }
+    #else // _WIN32
+    bool operator() (const IP_ADAPTER_ADDRESSES* iface) {
+        using Tins::IPv4Address;
+        using Tins::Endian::host_to_be;
+        if (iface_id == uint32_t(iface->IfIndex)) {
+            copy(iface->PhysicalAddress, iface->PhysicalAddress + 6, info->hw_addr.begin());
+            found_hw = true;
+            info->is_up = (iface->OperStatus == IfOperStatusUp);
+            IP_ADAPTER_UNICAST_ADDRESS* unicast = iface->FirstUnicastAddress;
+            while (unicast) {
+                int family = ((const struct sockaddr*)unicast->Address.lpSockaddr)->sa_family;
+                if (family == AF_INET) {
+                    info->ip_addr = IPv4Address(((const struct sockaddr_in *)unicast->Address.lpSockaddr)->sin_addr.s_addr);
+                    info->netmask = IPv4Address(host_to_be<uint32_t>(0xffffffff << (32 - unicast->OnLinkPrefixLength)));
+                    info->bcast_addr = IPv4Address((info->ip_addr & info->netmask) | ~info->netmask);
+                    found_ip = true;
+                }
+                else if (family == AF_INET6) {
+                    Tins::NetworkInterface::IPv6Prefix prefix;
+                    prefix.address = ((const struct sockaddr_in6 *)unicast->Address.lpSockaddr)->sin6_addr.s6_addr;
+                    prefix.prefix_length = unicast->OnLinkPrefixLength;
+                    info->ipv6_addrs.push_back(prefix);
+                    found_ip = true;
+                }
+                unicast = unicast->Next;
+            }
+        }
+        return found_ip && found_hw;
+    }
+    #endif // _WIN32
+};
+
+/** \endcond */
+
+namespace Tins {
+
+// InterfaceSnapshot
+
+#ifndef _WIN32
+
+InterfaceSnapshot InterfaceSnapshot::capture() {
+    entries_type entries;
+    struct ifaddrs* ifaddrs = 0;
+    if (getifaddrs(&ifaddrs) == -1) {
+        return InterfaceSnapshot();
+    }
+    set<string> names;
+    for (struct ifaddrs* if_it = ifaddrs; if_it; if_it = if_it->ifa_next) {
+        names.insert(if_it->ifa_name);
+    }
+    for (set<string>::const_iterator it = names.begin(); it != names.end(); ++it) {
+        entry_type entry;
+        entry.id = if_nametoindex(it->c_str());
+        if (entry.id == 0) {
+            continue;
+        }
+        entry.name = *it;
+        entry.friendly_name = wstring(it->begin(), it->end());
+        entry.info.is_up = false;
+        InterfaceInfoCollector collector(&entry.info, entry.id, it->c_str());
+        for (struct ifaddrs* if_it = ifaddrs; if_it; if_it = if_it->ifa_next) {
+            collector(if_it);
+        }
+        entry.has_addresses = collector.found_hw || collector.found_ip;
+        entries.push_back(entry);
+    }
+    freeifaddrs(ifaddrs);
+    return InterfaceSnapshot(entries);
+}
+
+#else // _WIN32
+
+InterfaceSnapshot InterfaceSnapshot::capture() {
+    entries_type entries;
+    ULONG size;
+    ::GetAdaptersAddresses(AF_INET, 0, 0, 0, &size);
+    vector<uint8_t> buffer(size);
+    if (::GetAdaptersAddresses(AF_INET, 0, 0, (IP_ADAPTER_ADDRESSES *)&buffer[0], &size) == ERROR_SUCCESS) {
+        PIP_ADAPTER_ADDRESSES adapters = (IP_ADAPTER_ADDRESSES *)&buffer[0];
+        for (PIP_ADAPTER_ADDRESSES iface = adapters; iface; iface = iface->Next) {
+            entry_type entry;
+            entry.id = iface->IfIndex;
+            entry.name = iface->AdapterName;
+            entry.friendly_name = iface->FriendlyName;
+            entry.info.is_up = false;
+            InterfaceInfoCollector collector(&entry.info, entry.id, iface->AdapterName);
+            for (PIP_ADAPTER_ADDRESSES other = adapters; other; other = other->Next) {
+                collector(other);
+            }
+            entry.has_addresses = collector.found_hw || collector.found_ip;
+            entries.push_back(entry);
+        }
+    }
+    return InterfaceSnapshot(entries);
+}
+
+#endif // _WIN32
+
+InterfaceSnapshot::InterfaceSnapshot() {
+
+}
+
+InterfaceSnapshot::InterfaceSnapshot(const entries_type& entries)
+: entries_(entries) {
+    for (size_t i = 0; i < entries_.size(); ++i) {
+        ids_.insert(std::make_pair(entries_[i].id, i));
+        names_.insert(std::make_pair(entries_[i].name, i));
+    }
+}
+
+const InterfaceSnapshot::entry_type* InterfaceSnapshot::find(id_type id) const {
+    std::map<id_type, size_t>::const_iterator it = ids_.find(id);
+    return it != ids_.end() ? &entries_[it->second] : 0;
+}
+
+const InterfaceSnapshot::entry_type* InterfaceSnapshot::find(const string& name) const {
+    std::map<string, size_t>::const_iterator it = names_.find(name);
+    return it != names_.end() ? &entries_[it->second] : 0;
+}
+
+const InterfaceSnapshot::entries_type& InterfaceSnapshot::interfaces() const {
+    return entries_;
+}
+
+size_t InterfaceSnapshot::size() const {
+    return entries_.size();
+}
+
+// InterfaceCache
+
+const unsigned InterfaceCache::DEFAULT_MAX_AGE = 5;
+const unsigned InterfaceCache::MISS_REFRESH_INTERVAL = 1;
+
+InterfaceCache::InterfaceCache()
+: taken_at_(0), max_age_(DEFAULT_MAX_AGE), notifications_fd_(-1), valid_(false) {
+
+}
+
+InterfaceCache::~InterfaceCache() {
+    close_notifications();
+}
+
+InterfaceCache::snapshot_ptr InterfaceCache::snapshot() {
+    #if TINS_IS_CXX11
+    std::lock_guard<std::mutex> lock(mutex_);
+    #endif // TINS_IS_CXX11
+    sync();
+    return snapshot_;
+}
+
+bool InterfaceCache::find(id_type id, entry_type& entry) {
+    #if TINS_IS_CXX11
+    std::lock_guard<std::mutex> lock(mutex_);
+    #endif // TINS_IS_CXX11
+    sync();
+    const entry_type* found = snapshot_->find(id);
+    if (!found && refresh_on_miss()) {
+        // The interface may have just been created
+        found = snapshot_->find(id);
+    }
+    if (!found) {
+        return false;
+    }
+    entry = *found;
+    return true;
+}
+
+bool InterfaceCache::find(const string& name, entry_type& entry) {
+    #if TINS_IS_CXX11
+    std::lock_guard<std::mutex> lock(mutex_);
+    #endif // TINS_IS_CXX11
+    sync();
+    const entry_type* found = snapshot_->find(name);
+    if (!found && refresh_on_miss()) {
+        found = snapshot_->find(name);
+    }
+    if (!found) {
+        return false;
+    }
+    entry = *found;
+    return true;
+}
+
+void InterfaceCache::invalidate() {
+    #if TINS_IS_CXX11
+    std::lock_guard<std::mutex> lock(mutex_);
+    #endif // TINS_IS_CXX11
+    valid_ = false;
+}
+
+void InterfaceCache::max_age(unsigned value) {
+    #if TINS_IS_CXX11
+    std::lock_guard<std::mutex> lock(mutex_);
+    #endif // TINS_IS_CXX11
+    max_age_ = value;
+}
+
+unsigned InterfaceCache::max_age() const {
+    #if TINS_IS_CXX11
+    std::lock_guard<std::mutex> lock(mutex_);
+    #endif // TINS_IS_CXX11
+    return max_age_;
+}
+
+void InterfaceCache::sync() {
+    if (notifications_fd_ != -1) {
+        if (process_notifications()) {
+            valid_ = false;
+        }
+    }
+    if (notifications_fd_ == -1 && valid_ && 
+        time(0) - taken_at_ >= static_cast<std::time_t>(max_age_)) {
+        valid_ = false;
+    }
+    if (!valid_) {
+        refresh();
+    }
+}
+
+void InterfaceCache::refresh() {
+    #if TINS_IS_CXX11
+    snapshot_ = std::make_shared<const InterfaceSnapshot>(InterfaceSnapshot::capture());
+    #else
+    snapshot_ = InterfaceSnapshot::capture();
+    #endif // TINS_IS_CXX11
+    taken_at_ = time(0);
+    valid_ = true;
+}
+
+// Takes a new snapshot after a failed lookup unless notifications would have 
+// reported the interface or a snapshot was taken too recently
+bool InterfaceCache::refresh_on_miss() {
+    if (notifications_fd_ != -1 ||
+        time(0) - taken_at_ < static_cast<std::time_t>(MISS_REFRESH_INTERVAL)) {
+        return false;
+    }
+    refresh();
+    return true;
+}
+
+#ifdef __linux__
+
+bool InterfaceCache::watch() {
+    #if TINS_IS_CXX11
+    std::lock_guard<std::mutex> lock(mutex_);
+    #endif // TINS_IS_CXX11
+    if (notifications_fd_ != -1) {
+        return true;
+    }
+    int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC | SOCK_NONBLOCK, NETLINK_ROUTE);
+    if (fd == -1) {
+        return false;
+    }
+    sockaddr_nl addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR;
+    if (bind(fd, (const sockaddr*)&addr, sizeof(addr)) == -1) {
+        ::close(fd);
+        return false;
+    }
+    notifications_fd_ = fd;
+    valid_ = false;
+    return true;
+}
+
+void InterfaceCache::close_notifications() {
+    if (notifications_fd_ != -1) {
+        ::close(notifications_fd_);
+        notifications_fd_ = -1;
+    }
+}
+
+// Drains every pending notification. Since they're only received when 
+// something changes, the snapshot has to be taken again if there were any
+bool InterfaceCache::process_notifications() {
+    bool changed = false;
+    uint8_t buffer[8192];
+    while (true) {
+        ssize_t size = recv(notifications_fd_, buffer, sizeof(buffer), 0);
+        if (size < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return changed;
+            }
+            if (errno == ENOBUFS) {
+                changed = true;
+                continue;
+            }
+            close_notifications();
+            return true;
+        }
+        changed = true;
+    }
+}
+
+#else
+
+bool InterfaceCache::watch() {
+    return false;
+}
+
+void InterfaceCache::close_notifications() {
+
+}
+
+bool InterfaceCache::process_notifications() {
+    return false;
+}
+
+#endif // __linux__
+
+namespace Utils {
+
+InterfaceCache& interface_cache() {
+    static InterfaceCache cache;
+    static bool watching = cache.watch();
+    (void)watching;
+    return cache;
+}
+
+} // Utils
+} // Tins
@@ -84,42 +84,10 @@ IP::IP(const uint8_t* buffer, uint32_t total_sz) {
     }
     const uint8_t* options_end = buffer + head_len() * sizeof(uint32_t);
     
-    // While the end of the options is not reached read an option
-    while (stream.pointer() < options_end) {
-        option_identifier opt_type = (option_identifier)stream.read<uint8_t>();
-        if (opt_type.number > NOOP) {
-            // Multibyte options with length as second byte
-            const uint32_t option_size = stream.read<uint8_t>();
-            if (TINS_UNLIKELY(option_size < (sizeof(uint8_t) << 1))) {
-                throw malformed_packet();
-            }
-            // The data size is the option size - the identifier and size fields
-            const uint32_t data_size = option_size - (sizeof(uint8_t) << 1);
-            if (data_size > 0) {
-                if (stream.pointer() + data_size > options_end) {
-                    throw malformed_packet();
-                }
-                options_.push_back(
-                    option(opt_type, stream.pointer(), stream.pointer() + data_size)
-                );
-                stream.skip(data_size);
-            }
-            else {
-                options_.push_back(option(opt_type));
-            }
-        }
-        else if (opt_type == END) {
-            // If the end option found, we're done
-            if (TINS_UNLIKELY(stream.pointer() != options_end)) {
-                // Make sure we found the END option at the end of the options list
-                throw malformed_packet();
-            }
-            break;
-        }
-        else {
-            options_.push_back(option(opt_type));
-        }
-    }
+    // Options are only parsed when they're needed
+    Internals::validate_options(Internals::IP_OPTION_LAYOUT, stream.pointer(), options_end);
+    options_.assign(stream.pointer(), options_end);
+    stream.skip(options_end - stream.pointer());
     if (stream) {
         // Don't avoid consuming more than we should if tot_len is 0,
         // since this is the case when using TCP segmentation offload
@@ -291,7 +259,8 @@ void IP::add_route_option(option_identifier id, const generic_route_option_type&
 }
 
 IP::generic_route_option_type IP::search_route_option(option_identifier id) const {
-    const option* opt = search_option(id);
+    option storage;
+    const option* opt = options_.search(id, storage);
     if (!opt) {
         throw option_not_found();
     }
@@ -299,7 +268,8 @@ IP::generic_route_option_type IP::search_route_option(option_identifier id) cons
 }
 
 IP::security_type IP::security() const {
-    const option* opt = search_option(130);
+    option storage;
+    const option* opt = options_.search(130, storage);
     if (!opt) {
         throw option_not_found();
     }
@@ -307,7 +277,8 @@ IP::security_type IP::security() const {
 }
 
 uint16_t IP::stream_identifier() const {
-    const option* opt = search_option(136);
+    option storage;
+    const option* opt = options_.search(136, storage);
     if (!opt) {
         throw option_not_found();
     }
@@ -315,13 +286,19 @@ uint16_t IP::stream_identifier() const {
 }
 
 void IP::add_option(const option& opt) {
-    options_.push_back(opt);
+    options_.get_mutable().push_back(opt);
 }
 
 uint32_t IP::calculate_options_size() const {
     uint32_t options_size = 0;
-    for (options_type::const_iterator iter = options_.begin(); iter != options_.end(); ++iter) {
-        options_size += 1 + iter->data_size();
+    const options_type& options = options_.get();
+    for (options_type::const_iterator iter = options.begin(); iter != options.end(); ++iter) {
+        options_size += sizeof(uint8_t);
+        // Only options other than END and NOOP have a length field and data, 
+        // see IP::write_option
+        if (iter->option().number > NOOP) {
+            options_size += static_cast<uint32_t>(sizeof(uint8_t) + iter->data_size());
+        }
     }
     return options_size;    
 }
@@ -333,24 +310,25 @@ uint32_t IP::pad_options_size(uint32_t size) const {
 
 bool IP::remove_option(option_identifier id) {
     options_type::iterator iter = search_option_iterator(id);
-    if (iter == options_.end()) {
+    options_type& options = options_.get_mutable();
+    if (iter == options.end()) {
         return false;
     }
-    options_.erase(iter);
+    options.erase(iter);
     return true;
 }
 
 const IP::option* IP::search_option(option_identifier id) const {
     options_type::const_iterator iter = search_option_iterator(id);
-    return (iter != options_.end()) ? &*iter : 0;
+    return (iter != options_.get().end()) ? &*iter : 0;
 }
 
 IP::options_type::const_iterator IP::search_option_iterator(option_identifier id) const {
-    return Internals::find_option_const<option>(options_, id);
+    return Internals::find_option_const<option>(options_.get(), id);
 }
 
 IP::options_type::iterator IP::search_option_iterator(option_identifier id) {
-    return Internals::find_option<option>(options_, id);
+    return Internals::find_option<option>(options_.get_mutable(), id);
 }
 
 void IP::write_option(const option& opt, OutputMemoryStream& stream) {
@@ -450,7 +428,8 @@ void IP::write_serialization(uint8_t* buffer, uint32_t total_sz) {
     // Restore the fragment offset field in case we flipped it
     header_.frag_off = original_frag_off;
 
-    for (options_type::const_iterator it = options_.begin(); it != options_.end(); ++it) {
+    const options_type& options = options_.get();
+    for (options_type::const_iterator it = options.begin(); it != options.end(); ++it) {
         write_option(*it, stream);
     }
     const uint32_t options_size = calculate_options_size();
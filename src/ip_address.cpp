@@ -27,17 +27,11 @@
  *
  */
 
-#ifdef _WIN32
-    #include <ws2tcpip.h>
-#else // _WIN32
-    #include <sys/socket.h>
-    #include <arpa/inet.h>
-#endif // _WIN32
 #if TINS_IS_CXX11
     // std::hash
     #include <memory>
 #endif // TINS_IS_CXX11
-#include <sstream>
+#include <cstring>
 #include <iostream>
 #include <tins/ip_address.h>
 #include <tins/endianness.h>
@@ -46,8 +40,9 @@
 
 
 using std::string;
-using std::ostringstream;
 using std::ostream;
+using std::memcpy;
+using std::strlen;
 
 namespace Tins{
 const IPv4Address IPv4Address::broadcast("255.255.255.255");
@@ -62,6 +57,10 @@ const AddressRange<IPv4Address> loopback_range = IPv4Address("127.0.0.0") / 8;
 const AddressRange<IPv4Address> multicast_range = IPv4Address("224.0.0.0") / 4;
 
 IPv4Address IPv4Address::from_prefix_length(uint32_t prefix_length) {
+    // Shifting a 32 bit value by 32 bits is undefined
+    if (prefix_length == 0) {
+        return IPv4Address(uint32_t(0));
+    }
     return IPv4Address(Endian::host_to_be(0xffffffff << (32 - prefix_length)));
 }
 
@@ -83,43 +82,88 @@ IPv4Address::operator uint32_t() const {
     return Endian::host_to_be(ip_addr_); 
 }
 
+bool IPv4Address::from_chars(const char* first, const char* last, IPv4Address& output) {
+    uint32_t result = 0;
+    uint32_t octet = 0;
+    unsigned octets = 0;
+    bool saw_digit = false;
+    for (; first != last; ++first) {
+        const char c = *first;
+        if (c >= '0' && c <= '9') {
+            // Leading zeros aren't allowed, same as inet_pton
+            if (saw_digit && octet == 0) {
+                return false;
+            }
+            octet = octet * 10 + (c - '0');
+            if (octet > 255) {
+                return false;
+            }
+            if (!saw_digit) {
+                if (++octets > 4) {
+                    return false;
+                }
+                saw_digit = true;
+            }
+        }
+        else if (c == '.' && saw_digit) {
+            if (octets == 4) {
+                return false;
+            }
+            result = (result << 8) | octet;
+            octet = 0;
+            saw_digit = false;
+        }
+        else {
+            return false;
+        }
+    }
+    if (octets != 4 || !saw_digit) {
+        return false;
+    }
+    output.ip_addr_ = (result << 8) | octet;
+    return true;
+}
+
 string IPv4Address::to_string() const {
-    ostringstream oss;
-    oss <<* this;
-    return oss.str();
+    char buffer[max_string_length];
+    return string(buffer, to_chars(buffer, sizeof(buffer)));
 }
 
-uint32_t IPv4Address::ip_to_int(const char* ip) {
-    #ifdef _WIN32
-        in_addr addr;
-        if (InetPtonA(AF_INET, ip, &addr)) {
-            return Endian::be_to_host(addr.s_addr);
+size_t IPv4Address::to_chars(char* buffer, size_t size) const {
+    char output[max_string_length];
+    char* ptr = output;
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        const uint32_t octet = (ip_addr_ >> shift) & 0xff;
+        if (octet >= 100) {
+            *ptr++ = static_cast<char>('0' + octet / 100);
         }
-        else {
-            throw invalid_address();
+        if (octet >= 10) {
+            *ptr++ = static_cast<char>('0' + (octet / 10) % 10);
         }
-    #else // _WIN32
-        in_addr addr;
-        if (inet_pton(AF_INET, ip, &addr) == 1) {
-            return Endian::be_to_host(addr.s_addr);
+        *ptr++ = static_cast<char>('0' + octet % 10);
+        if (shift) {
+            *ptr++ = '.';
         }
-        else {
-            throw invalid_address();
-        }
-    #endif // _WIN32
+    }
+    const size_t length = ptr - output;
+    if (length > size) {
+        return 0;
+    }
+    memcpy(buffer, output, length);
+    return length;
 }
 
-ostream& operator<<(ostream& output, const IPv4Address& addr) {
-    int mask(24);
-    uint32_t ip_addr_ = addr.ip_addr_;
-    while (mask >=0) {
-        output << ((ip_addr_ >> mask) & 0xff);
-        if (mask) {
-            output <<  '.';
-        }
-        mask -= 8;
+uint32_t IPv4Address::ip_to_int(const char* ip) {
+    IPv4Address output;
+    if (!from_chars(ip, ip + strlen(ip), output)) {
+        throw invalid_address();
     }
-    return output;
+    return output.ip_addr_;
+}
+
+ostream& operator<<(ostream& output, const IPv4Address& addr) {
+    char buffer[IPv4Address::max_string_length];
+    return output.write(buffer, addr.to_chars(buffer, sizeof(buffer)));
 }
 
 bool IPv4Address::is_private() const {
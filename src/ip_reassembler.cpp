@@ -29,6 +29,8 @@
 
 #include <tins/ip.h>
 #include <tins/constants.h>
+#include <tins/rawpdu.h>
+#include <tins/packet.h>
 #include <tins/ip_reassembler.h>
 #include <tins/detail/pdu_helpers.h>
 
@@ -37,62 +39,51 @@ using std::make_pair;
 namespace Tins {
 namespace Internals {
 
-IPv4Stream::IPv4Stream() 
-: received_size_(), total_size_(), received_end_(false) {
+// A datagram can't carry more than this many bytes of payload
+static const uint32_t MAX_DATAGRAM_PAYLOAD = 65535;
+// Kept as a plain constant so constructors never depend on static initialization order
+static const uint32_t DEFAULT_TIMEOUT_SECONDS = 30;
+static const uint64_t DEFAULT_TIMEOUT_MICROSECONDS = DEFAULT_TIMEOUT_SECONDS * 1000000ULL;
+
+IPv4Stream::IPv4Stream(IPv4Address source, uint64_t first_seen) 
+: first_seen_(first_seen), source_(source) {
 
 }
 
-void IPv4Stream::add_fragment(IP* ip) {
-    const uint16_t offset = extract_offset(ip);
-    fragments_type::iterator it = fragments_.begin();
-    while (it != fragments_.end() && offset > it->offset()) {
-        ++it;
-    }
-    // No duplicates plx
-    if (it != fragments_.end() && it->offset() == offset) {
-        return;
+bool IPv4Stream::add_fragment(IP* ip) {
+    PDU* payload = ip->inner_pdu();
+    if (!payload) {
+        return false;
     }
-    fragments_.insert(it, IPv4Fragment(ip->inner_pdu(), offset));
-    received_size_ += ip->inner_pdu()->size();
-    // If the MF flag is off
-    if ((ip->flags() & IP::MORE_FRAGMENTS) == 0) {
-        total_size_ = offset + ip->inner_pdu()->size();
-        received_end_ = true;
+    const uint32_t first = extract_offset(ip);
+    const bool more_fragments = (ip->flags() & IP::MORE_FRAGMENTS) != 0;
+    if (!buffer_.add_fragment(first, *payload, more_fragments, MAX_DATAGRAM_PAYLOAD)) {
+        return false;
     }
-    if (offset == 0) {
+    if (first == 0) {
         // Release the inner PDU, store this first fragment and restore the inner PDU
         PDU* inner_pdu = ip->release_inner_pdu();
         first_fragment_ = *ip;
         ip->inner_pdu(inner_pdu);
+        // A constructed fragment only gets its protocol set on serialization
+        const Constants::IP::e protocol = pdu_flag_to_ip_type(payload->pdu_type());
+        if (protocol != 0xff) {
+            first_fragment_.protocol(protocol);
+        }
     }
+    return true;
 }
 
 bool IPv4Stream::is_complete() const {
-    // If we haven't received the last chunk of we haven't received all the data,
-    // then we're not complete
-    if (!received_end_ || received_size_ != total_size_) {
-        return false;
-    }
-    // Make sure the first fragment has offset 0
-    return fragments_.begin()->offset() == 0;
+    return buffer_.is_complete();
 }
 
 PDU* IPv4Stream::allocate_pdu() const {
-    PDU::serialization_type buffer;
-    buffer.reserve(total_size_);
-    // Check if we actually have all the data we need. Otherwise return nullptr;
-    size_t expected = 0;
-    for (fragments_type::const_iterator it = fragments_.begin(); it != fragments_.end(); ++it) {
-        if (expected != it->offset()) {
-            return 0;
-        }
-        expected = it->offset() + it->payload().size();
-        buffer.insert(buffer.end(), it->payload().begin(), it->payload().end());
-    }
+    const DatagramBuffer::payload_type& payload = buffer_.payload();
     return Internals::pdu_from_flag(
         static_cast<Constants::IP::e>(first_fragment_.protocol()),
-        buffer.empty() ? 0 :& buffer[0],
-        static_cast<uint32_t>(buffer.size())
+        payload.empty() ? 0 : &payload[0],
+        static_cast<uint32_t>(payload.size())
     );
 }
 
@@ -100,38 +91,75 @@ const IP& IPv4Stream::first_fragment() const {
     return first_fragment_;
 }
 
+size_t IPv4Stream::buffered_bytes() const {
+    return buffer_.size();
+}
+
+uint64_t IPv4Stream::first_seen() const {
+    return first_seen_;
+}
+
+IPv4Address IPv4Stream::source() const {
+    return source_;
+}
+
 uint16_t IPv4Stream::extract_offset(const IP* ip) {
     return ip->fragment_offset() * 8;
 }
 
 } // Internals
 
+const IPv4Reassembler::timestamp_type IPv4Reassembler::DEFAULT_TIMEOUT =
+    Internals::make_reassembly_timestamp(Internals::DEFAULT_TIMEOUT_SECONDS);
+const size_t IPv4Reassembler::DEFAULT_MAX_BUFFERED_BYTES = 64 * 1024 * 1024;
+const size_t IPv4Reassembler::DEFAULT_MAX_BUFFERED_BYTES_PER_SOURCE = 8 * 1024 * 1024;
+
 IPv4Reassembler::IPv4Reassembler()
-: technique_(NONE) {
+: technique_(NONE), table_(Internals::DEFAULT_TIMEOUT_MICROSECONDS, DEFAULT_MAX_BUFFERED_BYTES,
+         DEFAULT_MAX_BUFFERED_BYTES_PER_SOURCE) {
 
 }
 
 IPv4Reassembler::IPv4Reassembler(OverlappingTechnique technique)
-: technique_(technique) {
+: technique_(technique), table_(Internals::DEFAULT_TIMEOUT_MICROSECONDS, DEFAULT_MAX_BUFFERED_BYTES,
+         DEFAULT_MAX_BUFFERED_BYTES_PER_SOURCE) {
 
 }
 
 IPv4Reassembler::PacketStatus IPv4Reassembler::process(PDU& pdu) {
+    // Use current time
+    return process(pdu, Timestamp::current_time());
+}
+
+IPv4Reassembler::PacketStatus IPv4Reassembler::process(Packet& packet) {
+    return process(*packet.pdu(), packet.timestamp());
+}
+
+IPv4Reassembler::PacketStatus IPv4Reassembler::process(PDU& pdu, const timestamp_type& timestamp) {
+    const uint64_t ts = Internals::reassembly_timestamp_value(timestamp);
+    table_.expire(ts);
     IP* ip = pdu.find_pdu<IP>();
     if (ip && ip->inner_pdu()) {
         // There's fragmentation
         if (ip->is_fragmented()) {
             key_type key = make_key(ip);
             // Create it or look it up, it's the same
-            Internals::IPv4Stream& stream = streams_[key];
-            stream.add_fragment(ip);
+            table_type::iterator iter = table_.find_or_insert(key, ip->src_addr(), ts);
+            Internals::IPv4Stream& stream = iter->second;
+            const size_t previous_size = stream.buffered_bytes();
+            if (!stream.add_fragment(ip)) {
+                // Invalid fragment, this datagram can't be reassembled
+                table_.discard(iter);
+                return FRAGMENTED;
+            }
+            table_.stream_grew(iter, previous_size);
             if (stream.is_complete()) {
                 PDU* pdu = stream.allocate_pdu();
                 // Use all field values from the first fragment
                 *ip = stream.first_fragment();
 
                 // Erase this stream, since it's already assembled
-                streams_.erase(key);
+                table_.erase(iter);
                 // The packet is corrupt
                 if (!pdu) {
                     return FRAGMENTED;
@@ -141,14 +169,39 @@ IPv4Reassembler::PacketStatus IPv4Reassembler::process(PDU& pdu) {
                 ip->flags(static_cast<IP::Flags>(0));
                 return REASSEMBLED;
             }
-            else {
-                return FRAGMENTED;
-            }
+            table_.enforce_caps(iter);
+            return FRAGMENTED;
         }
     }
     return NOT_FRAGMENTED;
 }
 
+#if !TINS_IS_CXX11
+void IPv4Reassembler::timeout(const timestamp_type& value) {
+    table_.timeout(Internals::reassembly_timestamp_value(value));
+}
+#endif // TINS_IS_CXX11
+
+void IPv4Reassembler::max_buffered_bytes(size_t value) {
+    table_.max_buffered_bytes(value);
+}
+
+void IPv4Reassembler::max_buffered_bytes_per_source(size_t value) {
+    table_.max_buffered_bytes_per_source(value);
+}
+
+size_t IPv4Reassembler::buffered_bytes() const {
+    return table_.buffered_bytes();
+}
+
+size_t IPv4Reassembler::buffered_datagrams() const {
+    return table_.buffered_datagrams();
+}
+
+uint64_t IPv4Reassembler::discarded_datagrams() const {
+    return table_.discarded_datagrams();
+}
+
 IPv4Reassembler::key_type IPv4Reassembler::make_key(const IP* ip) const {
     return make_pair(
         ip->id(),
@@ -166,16 +219,19 @@ IPv4Reassembler::address_pair IPv4Reassembler::make_address_pair(IPv4Address add
 }
 
 void IPv4Reassembler::clear_streams() {
-    streams_.clear();
+    table_.clear();
 }
 
 void IPv4Reassembler::remove_stream(uint16_t id, IPv4Address addr1, IPv4Address addr2) {
-    streams_.erase(
+    table_type::iterator iter = table_.find(
         make_pair(
             id, 
             make_address_pair(addr1, addr2)
         )
     );
+    if (iter != table_.end()) {
+        table_.erase(iter);
+    }
 }
 
 } // Tins
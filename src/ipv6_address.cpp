@@ -28,33 +28,48 @@
  */
 
 #include <tins/macros.h>
-#ifndef _WIN32
-    #include <arpa/inet.h>
-    #ifdef BSD
-        #include <sys/socket.h>
-    #endif
-#else
-    #include <ws2tcpip.h>
-    #include <mstcpip.h>
-#endif
 #if TINS_IS_CXX11
     // std::hash
     #include <memory>
 #endif // TINS_IS_CXX11
 #include <limits>
-#include <sstream>
+#include <cstring>
 #include <iostream>
 #include <tins/ipv6_address.h>
+#include <tins/ip_address.h>
+#include <tins/endianness.h>
 #include <tins/address_range.h>
 #include <tins/exceptions.h>
 
 using std::memset;
 using std::memcpy;
+using std::memmove;
+using std::strlen;
 using std::string;
 using std::ostream;
 
 namespace Tins {
 
+// Maps every character to its hex value, or -1 if it's not a hex digit
+const int8_t hex_values[256] = {
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+     0,  1,  2,  3,  4,  5,  6,  7,  8,  9, -1, -1, -1, -1, -1, -1,
+    -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+};
+
 const IPv6Address loopback_address = "::1";
 const AddressRange<IPv6Address> multicast_range = IPv6Address("ff00::") / 8;
 
@@ -87,47 +102,171 @@ IPv6Address::IPv6Address(const std::string& addr) {
 }
 
 void IPv6Address::init(const char* addr) {
-    #ifdef _WIN32
-        // mingw on linux somehow doesn't have InetPton
-        #ifdef _MSC_VER
-            if (InetPtonA(AF_INET6, addr, address_) != 1) {
-                throw invalid_address();
+    if (!from_chars(addr, addr + strlen(addr), *this)) {
+        throw invalid_address();
+    }
+}
+
+bool IPv6Address::from_chars(const char* first, const char* last, IPv6Address& output) {
+    uint8_t buffer[address_size] = { 0 };
+    uint8_t* const buffer_end = buffer + address_size;
+    uint8_t* ptr = buffer;
+    uint8_t* compressed = 0;
+    const char* token = first;
+    uint32_t value = 0;
+    unsigned digits = 0;
+    bool embedded_ipv4 = false;
+
+    // A leading ':' is only valid as part of "::"
+    if (first != last && *first == ':') {
+        if (++first == last || *first != ':') {
+            return false;
+        }
+    }
+    while (first != last) {
+        const char c = *first++;
+        const int nibble = hex_values[static_cast<uint8_t>(c)];
+        if (nibble >= 0) {
+            if (++digits > 4) {
+                return false;
+            }
+            value = (value << 4) | nibble;
+            continue;
+        }
+        if (c == ':') {
+            token = first;
+            if (digits == 0) {
+                if (compressed) {
+                    return false;
+                }
+                compressed = ptr;
+                continue;
             }
-        #else
-            ULONG dummy1;
-            USHORT dummy2;
-            // Maybe change this, mingw doesn't have any other conversion function
-            if (RtlIpv6StringToAddressExA(addr, (IN6_ADDR*)address_, &dummy1, &dummy2) != NO_ERROR) {
-                throw invalid_address();
+            // A group can't be followed by a trailing ':'
+            if (first == last || ptr + 2 > buffer_end) {
+                return false;
             }
-        #endif
-    #else
-        if (inet_pton(AF_INET6, addr, address_) == 0) {
-            throw invalid_address();
+            *ptr++ = static_cast<uint8_t>(value >> 8);
+            *ptr++ = static_cast<uint8_t>(value);
+            value = 0;
+            digits = 0;
+            continue;
         }
-    #endif            
+        if (c == '.' && ptr + IPv4Address::address_size <= buffer_end) {
+            IPv4Address ipv4;
+            if (!IPv4Address::from_chars(token, last, ipv4)) {
+                return false;
+            }
+            const uint32_t ipv4_value = Endian::be_to_host<uint32_t>(ipv4);
+            *ptr++ = static_cast<uint8_t>(ipv4_value >> 24);
+            *ptr++ = static_cast<uint8_t>(ipv4_value >> 16);
+            *ptr++ = static_cast<uint8_t>(ipv4_value >> 8);
+            *ptr++ = static_cast<uint8_t>(ipv4_value);
+            embedded_ipv4 = true;
+            break;
+        }
+        return false;
+    }
+    if (digits != 0 && !embedded_ipv4) {
+        if (ptr + 2 > buffer_end) {
+            return false;
+        }
+        *ptr++ = static_cast<uint8_t>(value >> 8);
+        *ptr++ = static_cast<uint8_t>(value);
+    }
+    if (compressed) {
+        // "::" must stand for at least one group
+        if (ptr == buffer_end) {
+            return false;
+        }
+        const size_t length = ptr - compressed;
+        memmove(buffer_end - length, compressed, length);
+        memset(compressed, 0, buffer_end - length - compressed);
+        ptr = buffer_end;
+    }
+    if (ptr != buffer_end) {
+        return false;
+    }
+    memcpy(output.address_, buffer, address_size);
+    return true;
 }
 
 string IPv6Address::to_string() const {
-    char buffer[INET6_ADDRSTRLEN];
-    #ifdef _WIN32
-        // mingw on linux somehow doesn't have InetNtop
-        #ifdef _MSC_VER
-            if (InetNtopA(AF_INET6, (PVOID)address_, buffer, sizeof(buffer)) == 0) {
-                throw invalid_address();
+    char buffer[max_string_length];
+    return string(buffer, to_chars(buffer, sizeof(buffer)));
+}
+
+size_t IPv6Address::to_chars(char* buffer, size_t size) const {
+    static const char hex_digits[] = "0123456789abcdef";
+    const size_t group_count = address_size / 2;
+    uint16_t groups[group_count];
+    for (size_t i = 0; i < group_count; ++i) {
+        groups[i] = (address_[i * 2] << 8) | address_[i * 2 + 1];
+    }
+    // Find the longest run of at least 2 zero groups, the first one wins ties
+    int best_start = -1, best_length = 0;
+    int current_start = -1, current_length = 0;
+    for (size_t i = 0; i < group_count; ++i) {
+        if (groups[i] == 0) {
+            if (current_start == -1) {
+                current_start = static_cast<int>(i);
+                current_length = 0;
             }
-        #else
-            ULONG sz = sizeof(buffer);
-            if (RtlIpv6AddressToStringExA((const IN6_ADDR*)address_, 0, 0, buffer, &sz) != NO_ERROR) {
-                throw invalid_address();
+            if (++current_length > best_length) {
+                best_start = current_start;
+                best_length = current_length;
+            }
+        }
+        else {
+            current_start = -1;
+        }
+    }
+    if (best_length < 2) {
+        best_start = -1;
+    }
+
+    char output[max_string_length];
+    char* ptr = output;
+    for (int i = 0; i < static_cast<int>(group_count); ++i) {
+        if (best_start != -1 && i >= best_start && i < best_start + best_length) {
+            if (i == best_start) {
+                *ptr++ = ':';
             }
-        #endif
-    #else
-        if (inet_ntop(AF_INET6, address_, buffer, sizeof(buffer)) == 0) {
-            throw invalid_address();
+            continue;
         }
-    #endif
-    return buffer;
+        if (i != 0) {
+            *ptr++ = ':';
+        }
+        // IPv4 compatible and IPv4 mapped addresses use dotted notation
+        if (i == 6 && best_start == 0 &&
+            (best_length == 6 || (best_length == 7 && groups[7] != 0x0001) ||
+             (best_length == 5 && groups[5] == 0xffff))) {
+            const IPv4Address ipv4(Endian::host_to_be<uint32_t>(
+                (groups[6] << 16) | groups[7]));
+            ptr += ipv4.to_chars(ptr, output + sizeof(output) - ptr);
+            break;
+        }
+        const uint16_t group = groups[i];
+        if (group >= 0x1000) {
+            *ptr++ = hex_digits[group >> 12];
+        }
+        if (group >= 0x100) {
+            *ptr++ = hex_digits[(group >> 8) & 0xf];
+        }
+        if (group >= 0x10) {
+            *ptr++ = hex_digits[(group >> 4) & 0xf];
+        }
+        *ptr++ = hex_digits[group & 0xf];
+    }
+    if (best_start != -1 && best_start + best_length == static_cast<int>(group_count)) {
+        *ptr++ = ':';
+    }
+    const size_t length = ptr - output;
+    if (length > size) {
+        return 0;
+    }
+    memcpy(buffer, output, length);
+    return length;
 }
 
 bool IPv6Address::is_loopback() const {
@@ -139,7 +278,8 @@ bool IPv6Address::is_multicast() const {
 }
 
 ostream& operator<<(ostream& os, const IPv6Address& addr) {
-    return os << addr.to_string();
+    char buffer[IPv6Address::max_string_length];
+    return os.write(buffer, addr.to_chars(buffer, sizeof(buffer)));
 }
 
 IPv6Address operator&(const IPv6Address& lhs, const IPv6Address& rhs) {
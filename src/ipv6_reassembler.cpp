@@ -0,0 +1,243 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <tins/ipv6.h>
+#include <tins/constants.h>
+#include <tins/rawpdu.h>
+#include <tins/packet.h>
+#include <tins/pdu_allocator.h>
+#include <tins/exceptions.h>
+#include <tins/ipv6_reassembler.h>
+#include <tins/memory_helpers.h>
+#include <tins/detail/pdu_helpers.h>
+
+using Tins::Memory::InputMemoryStream;
+
+namespace Tins {
+namespace Internals {
+
+// A datagram can't carry more than this many bytes of payload
+static const uint32_t MAX_DATAGRAM_PAYLOAD = 65535;
+// Kept as a plain constant so constructors never depend on static initialization order
+static const uint32_t DEFAULT_TIMEOUT_SECONDS = 60;
+static const uint64_t DEFAULT_TIMEOUT_MICROSECONDS = DEFAULT_TIMEOUT_SECONDS * 1000000ULL;
+
+IPv6Stream::IPv6Stream(const IPv6Address& source, uint64_t first_seen) 
+: first_seen_(first_seen), source_(source), next_header_(0) {
+
+}
+
+bool IPv6Stream::add_fragment(IPv6* ipv6, uint16_t offset, bool more_fragments) {
+    PDU* payload = ipv6->inner_pdu();
+    // The Fragment header has to be the last one, otherwise the headers 
+    // after it were parsed as if they weren't part of the fragmented payload
+    if (!payload || ipv6->headers().back().option() != IPv6::FRAGMENT) {
+        return false;
+    }
+    if (!buffer_.add_fragment(offset, *payload, more_fragments, MAX_DATAGRAM_PAYLOAD)) {
+        return false;
+    }
+    if (offset == 0) {
+        // Release the inner PDU, store this first fragment and restore the inner PDU
+        PDU* inner_pdu = ipv6->release_inner_pdu();
+        first_fragment_ = *ipv6;
+        ipv6->inner_pdu(inner_pdu);
+        next_header_ = ipv6->next_header_;
+        // A constructed fragment only gets its next header set on serialization
+        const Constants::IP::e protocol = pdu_flag_to_ip_type(payload->pdu_type());
+        if (protocol != 0xff) {
+            next_header_ = protocol;
+        }
+        // The reassembled datagram is not fragmented anymore
+        first_fragment_.ext_headers_.pop_back();
+        if (first_fragment_.ext_headers_.empty()) {
+            first_fragment_.header_.next_header = next_header_;
+        }
+    }
+    return true;
+}
+
+bool IPv6Stream::is_complete() const {
+    return buffer_.is_complete();
+}
+
+PDU* IPv6Stream::allocate_pdu() const {
+    const DatagramBuffer::payload_type& payload = buffer_.payload();
+    const uint8_t* buffer = payload.empty() ? 0 : &payload[0];
+    const uint32_t size = static_cast<uint32_t>(payload.size());
+    PDU* pdu = Internals::pdu_from_flag(
+        static_cast<Constants::IP::e>(next_header_),
+        buffer,
+        size,
+        false
+    );
+    if (!pdu) {
+        pdu = Internals::allocate<IPv6>(next_header_, buffer, size);
+        if (!pdu) {
+            pdu = new RawPDU(buffer, size);
+        }
+    }
+    return pdu;
+}
+
+const IPv6& IPv6Stream::first_fragment() const {
+    return first_fragment_;
+}
+
+size_t IPv6Stream::buffered_bytes() const {
+    return buffer_.size();
+}
+
+uint64_t IPv6Stream::first_seen() const {
+    return first_seen_;
+}
+
+const IPv6Address& IPv6Stream::source() const {
+    return source_;
+}
+
+} // Internals
+
+const IPv6Reassembler::timestamp_type IPv6Reassembler::DEFAULT_TIMEOUT =
+    Internals::make_reassembly_timestamp(Internals::DEFAULT_TIMEOUT_SECONDS);
+const size_t IPv6Reassembler::DEFAULT_MAX_BUFFERED_BYTES = 64 * 1024 * 1024;
+const size_t IPv6Reassembler::DEFAULT_MAX_BUFFERED_BYTES_PER_SOURCE = 8 * 1024 * 1024;
+
+#if TINS_IS_CXX11
+size_t IPv6Reassembler::key_hash::operator()(const key_type& key) const {
+    size_t output = std::hash<uint32_t>()(key.id);
+    output ^= std::hash<IPv6Address>()(key.src) + 0x9e3779b9 + (output << 6) + (output >> 2);
+    output ^= std::hash<IPv6Address>()(key.dst) + 0x9e3779b9 + (output << 6) + (output >> 2);
+    return output;
+}
+#endif // TINS_IS_CXX11
+
+IPv6Reassembler::IPv6Reassembler()
+: table_(Internals::DEFAULT_TIMEOUT_MICROSECONDS, DEFAULT_MAX_BUFFERED_BYTES,
+         DEFAULT_MAX_BUFFERED_BYTES_PER_SOURCE) {
+
+}
+
+IPv6Reassembler::PacketStatus IPv6Reassembler::process(PDU& pdu) {
+    // Use current time
+    return process(pdu, Timestamp::current_time());
+}
+
+IPv6Reassembler::PacketStatus IPv6Reassembler::process(Packet& packet) {
+    return process(*packet.pdu(), packet.timestamp());
+}
+
+IPv6Reassembler::PacketStatus IPv6Reassembler::process(PDU& pdu, const timestamp_type& timestamp) {
+    const uint64_t ts = Internals::reassembly_timestamp_value(timestamp);
+    table_.expire(ts);
+    IPv6* ipv6 = pdu.find_pdu<IPv6>();
+    if (!ipv6 || !ipv6->inner_pdu()) {
+        return NOT_FRAGMENTED;
+    }
+    const IPv6::ext_header* fragment_header = ipv6->search_header(IPv6::FRAGMENT);
+    if (!fragment_header) {
+        return NOT_FRAGMENTED;
+    }
+    uint16_t offset;
+    bool more_fragments;
+    uint32_t id;
+    try {
+        InputMemoryStream stream(fragment_header->data_ptr(), fragment_header->data_size());
+        const uint16_t offset_field = stream.read_be<uint16_t>();
+        offset = offset_field & 0xfff8;
+        more_fragments = (offset_field & 1) != 0;
+        id = stream.read_be<uint32_t>();
+    }
+    catch (const malformed_packet&) {
+        table_.discard();
+        return FRAGMENTED;
+    }
+    const key_type key(id, ipv6->src_addr(), ipv6->dst_addr());
+    // Create it or look it up, it's the same
+    table_type::iterator iter = table_.find_or_insert(key, key.src, ts);
+    Internals::IPv6Stream& stream = iter->second;
+    const size_t previous_size = stream.buffered_bytes();
+    if (!stream.add_fragment(ipv6, offset, more_fragments)) {
+        // Invalid fragment, this datagram can't be reassembled
+        table_.discard(iter);
+        return FRAGMENTED;
+    }
+    table_.stream_grew(iter, previous_size);
+    if (stream.is_complete()) {
+        PDU* inner_pdu = stream.allocate_pdu();
+        // Use all field values from the first fragment
+        *ipv6 = stream.first_fragment();
+        ipv6->inner_pdu(inner_pdu);
+        // Erase this stream, since it's already assembled
+        table_.erase(iter);
+        return REASSEMBLED;
+    }
+    table_.enforce_caps(iter);
+    return FRAGMENTED;
+}
+
+#if !TINS_IS_CXX11
+void IPv6Reassembler::timeout(const timestamp_type& value) {
+    table_.timeout(Internals::reassembly_timestamp_value(value));
+}
+#endif // TINS_IS_CXX11
+
+void IPv6Reassembler::max_buffered_bytes(size_t value) {
+    table_.max_buffered_bytes(value);
+}
+
+void IPv6Reassembler::max_buffered_bytes_per_source(size_t value) {
+    table_.max_buffered_bytes_per_source(value);
+}
+
+size_t IPv6Reassembler::buffered_bytes() const {
+    return table_.buffered_bytes();
+}
+
+size_t IPv6Reassembler::buffered_datagrams() const {
+    return table_.buffered_datagrams();
+}
+
+uint64_t IPv6Reassembler::discarded_datagrams() const {
+    return table_.discarded_datagrams();
+}
+
+void IPv6Reassembler::clear_streams() {
+    table_.clear();
+}
+
+void IPv6Reassembler::remove_stream(uint32_t id, const IPv6Address& src,
+                                    const IPv6Address& dst) {
+    table_type::iterator iter = table_.find(key_type(id, src, dst));
+    if (iter != table_.end()) {
+        table_.erase(iter);
+    }
+}
+
+} // Tins
@@ -0,0 +1,676 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <set>
+#include <cstring>
+#include <stdexcept>
+#include <tins/neighbor_cache.h>
+#include <tins/exceptions.h>
+#include <tins/endianness.h>
+#include <tins/constants.h>
+#include <tins/ethernetII.h>
+#include <tins/arp.h>
+#include <tins/packet_sender.h>
+#include <tins/network_interface.h>
+#include <tins/detail/smart_ptr.h>
+#if TINS_IS_CXX11
+    #include <chrono>
+#endif // TINS_IS_CXX11
+#ifdef _WIN32
+    #include <winsock2.h>
+    #include <iphlpapi.h>
+    #undef interface
+#endif // _WIN32
+#ifdef __linux__
+    #include <sys/socket.h>
+    #include <unistd.h>
+    #include <errno.h>
+    #include <linux/netlink.h>
+    #include <linux/rtnetlink.h>
+    #include <linux/neighbour.h>
+#endif // __linux__
+
+using std::set;
+using std::pair;
+using std::vector;
+using std::make_pair;
+using std::time;
+using std::runtime_error;
+
+namespace Tins {
+
+const unsigned NeighborCache::DEFAULT_MAX_AGE = 60;
+
+namespace {
+
+typedef pair<IPv4Address, NeighborCache::hwaddress_type> ipv4_neighbor;
+
+// An entry in the kernel's neighbor table
+template <typename Address>
+struct kernel_neighbor {
+    kernel_neighbor(uint32_t iface_index, const Address& addr, 
+                    const NeighborCache::hwaddress_type& hw_addr, bool reachable)
+    : iface_index(iface_index), addr(addr), hw_addr(hw_addr), reachable(reachable) {
+
+    }
+
+    uint32_t iface_index;
+    Address addr;
+    NeighborCache::hwaddress_type hw_addr;
+    // Whether the kernel recently confirmed this entry
+    bool reachable;
+};
+
+typedef vector<kernel_neighbor<IPv4Address> > ipv4_kernel_neighbors;
+typedef vector<kernel_neighbor<IPv6Address> > ipv6_kernel_neighbors;
+
+// Interface indexes start at 1, so this means any interface
+const uint32_t ANY_INTERFACE = 0;
+
+#ifndef _WIN32
+
+// An ARP request which matches the replies for any of a set of addresses
+class BatchARPRequest : public EthernetII {
+public:
+    BatchARPRequest(const set<IPv4Address>& pending)
+    : pending_(pending) {
+
+    }
+
+    bool matches_response(const uint8_t* ptr, uint32_t total_sz) const {
+        // Ethernet header + ARP header
+        const uint32_t min_size = 14 + 28;
+        if (total_sz < min_size) {
+            return false;
+        }
+        uint16_t ether_type, opcode;
+        uint32_t sender_ip;
+        memcpy(&ether_type, ptr + 12, sizeof(ether_type));
+        memcpy(&opcode, ptr + 14 + 6, sizeof(opcode));
+        memcpy(&sender_ip, ptr + 14 + 14, sizeof(sender_ip));
+        return Endian::be_to_host(ether_type) == Constants::Ethernet::ARP &&
+               Endian::be_to_host(opcode) == ARP::REPLY &&
+               pending_.count(IPv4Address(sender_ip)) != 0;
+    }
+private:
+    const set<IPv4Address>& pending_;
+};
+
+vector<ipv4_neighbor> request_hw_addresses(const NetworkInterface& iface,
+                                           const vector<IPv4Address>& addresses,
+                                           PacketSender& sender) {
+    vector<ipv4_neighbor> output;
+    const NetworkInterface::Info info = iface.addresses();
+    set<IPv4Address> pending;
+    for (size_t i = 0; i < addresses.size(); ++i) {
+        if (!pending.insert(addresses[i]).second) {
+            continue;
+        }
+        EthernetII request = ARP::make_arp_request(addresses[i], info.ip_addr, info.hw_addr);
+        try {
+            sender.send(request, iface);
+        }
+        catch (runtime_error&) {
+            pending.erase(addresses[i]);
+        }
+    }
+    // Keep receiving until every address is resolved or no more replies arrive
+    BatchARPRequest matcher(pending);
+    while (!pending.empty()) {
+        Internals::smart_ptr<PDU>::type response(matcher.recv_response(sender, iface));
+        const ARP* arp = response.get() ? response->find_pdu<ARP>() : 0;
+        if (!arp) {
+            break;
+        }
+        if (pending.erase(arp->sender_ip_addr()) != 0) {
+            output.push_back(make_pair(arp->sender_ip_addr(), arp->sender_hw_addr()));
+        }
+    }
+    return output;
+}
+
+#else
+
+vector<ipv4_neighbor> request_hw_addresses(const NetworkInterface& iface,
+                                           const vector<IPv4Address>& addresses,
+                                           PacketSender&) {
+    vector<ipv4_neighbor> output;
+    const NetworkInterface::Info info = iface.addresses();
+    for (size_t i = 0; i < addresses.size(); ++i) {
+        ULONG hw_address[2];
+        ULONG address_length = 6;
+        IPAddr source = static_cast<uint32_t>(info.ip_addr);
+        IPAddr dest = static_cast<uint32_t>(addresses[i]);
+        if (SendARP(dest, source, &hw_address, &address_length) == NO_ERROR && 
+            address_length == 6) {
+            output.push_back(make_pair(
+                addresses[i], 
+                NeighborCache::hwaddress_type((const uint8_t*)hw_address)
+            ));
+        }
+    }
+    return output;
+}
+
+#endif // _WIN32
+
+#ifdef __linux__
+
+// Dumps the kernel's neighbor table using rtnetlink, keeping only the entries 
+// in the given interface
+bool read_kernel_neighbors(uint32_t iface_index,
+                           ipv4_kernel_neighbors& ipv4_neighbors,
+                           ipv6_kernel_neighbors& ipv6_neighbors) {
+    int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (fd == -1) {
+        return false;
+    }
+    struct {
+        nlmsghdr header;
+        ndmsg message;
+    } request;
+    memset(&request, 0, sizeof(request));
+    request.header.nlmsg_len = NLMSG_LENGTH(sizeof(ndmsg));
+    request.header.nlmsg_type = RTM_GETNEIGH;
+    request.header.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    request.header.nlmsg_seq = 1;
+    request.message.ndm_family = AF_UNSPEC;
+    if (send(fd, &request, request.header.nlmsg_len, 0) == -1) {
+        close(fd);
+        return false;
+    }
+    const uint16_t valid_states = NUD_REACHABLE | NUD_PERMANENT | NUD_STALE |
+                                  NUD_DELAY | NUD_PROBE;
+    uint8_t buffer[16384];
+    bool done = false;
+    bool success = true;
+    while (!done) {
+        ssize_t size = recv(fd, buffer, sizeof(buffer), 0);
+        if (size < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            success = false;
+            break;
+        }
+        int length = static_cast<int>(size);
+        for (const nlmsghdr* header = (const nlmsghdr*)buffer; NLMSG_OK(header, length);
+             header = NLMSG_NEXT(header, length)) {
+            if (header->nlmsg_type == NLMSG_DONE) {
+                done = true;
+                break;
+            }
+            if (header->nlmsg_type == NLMSG_ERROR) {
+                done = true;
+                success = false;
+                break;
+            }
+            if (header->nlmsg_type != RTM_NEWNEIGH || 
+                header->nlmsg_len < NLMSG_LENGTH(sizeof(ndmsg))) {
+                continue;
+            }
+            const ndmsg* message = (const ndmsg*)NLMSG_DATA(header);
+            if ((message->ndm_state & valid_states) == 0) {
+                continue;
+            }
+            const bool reachable = (message->ndm_state & (NUD_REACHABLE | NUD_PERMANENT)) != 0;
+            // Dump requests aren't filtered by the kernel unless strict checking 
+            // is enabled, so do it here
+            const uint32_t message_iface = static_cast<uint32_t>(message->ndm_ifindex);
+            if (iface_index != ANY_INTERFACE && message_iface != iface_index) {
+                continue;
+            }
+            int attr_length = static_cast<int>(header->nlmsg_len - NLMSG_LENGTH(sizeof(ndmsg)));
+            const uint8_t* dst = 0;
+            const uint8_t* lladdr = 0;
+            size_t dst_size = 0;
+            for (const rtattr* attr = (const rtattr*)((const uint8_t*)message + NLMSG_ALIGN(sizeof(ndmsg)));
+                 RTA_OK(attr, attr_length); attr = RTA_NEXT(attr, attr_length)) {
+                if (attr->rta_type == NDA_DST) {
+                    dst = (const uint8_t*)RTA_DATA(attr);
+                    dst_size = RTA_PAYLOAD(attr);
+                }
+                else if (attr->rta_type == NDA_LLADDR && 
+                         RTA_PAYLOAD(attr) == NeighborCache::hwaddress_type::address_size) {
+                    lladdr = (const uint8_t*)RTA_DATA(attr);
+                }
+            }
+            if (!dst || !lladdr) {
+                continue;
+            }
+            if (message->ndm_family == AF_INET && dst_size == IPv4Address::address_size) {
+                uint32_t addr;
+                memcpy(&addr, dst, sizeof(addr));
+                ipv4_neighbors.push_back(kernel_neighbor<IPv4Address>(
+                    message_iface, IPv4Address(addr), NeighborCache::hwaddress_type(lladdr),
+                    reachable
+                ));
+            }
+            else if (message->ndm_family == AF_INET6 && dst_size == IPv6Address::address_size) {
+                ipv6_neighbors.push_back(kernel_neighbor<IPv6Address>(
+                    message_iface, IPv6Address(dst), NeighborCache::hwaddress_type(lladdr),
+                    reachable
+                ));
+            }
+        }
+    }
+    close(fd);
+    return success;
+}
+
+#else
+
+bool read_kernel_neighbors(uint32_t, ipv4_kernel_neighbors&, ipv6_kernel_neighbors&) {
+    return false;
+}
+
+#endif // __linux__
+
+} // anonymous namespace
+
+NeighborCache::NeighborCache()
+: max_age_(DEFAULT_MAX_AGE) {
+    #if TINS_IS_CXX11
+    refresh_stopping_ = false;
+    #endif // TINS_IS_CXX11
+}
+
+NeighborCache::~NeighborCache() {
+    #if TINS_IS_CXX11
+    stop_refresh();
+    #endif // TINS_IS_CXX11
+}
+
+bool NeighborCache::load() {
+    return load(ANY_INTERFACE);
+}
+
+bool NeighborCache::load(const NetworkInterface& iface) {
+    return load(iface.id());
+}
+
+void NeighborCache::add(const NetworkInterface& iface, IPv4Address addr,
+                        const hwaddress_type& hw_addr) {
+    add(iface.id(), addr, hw_addr, time(0));
+}
+
+void NeighborCache::add(const NetworkInterface& iface, const IPv6Address& addr,
+                        const hwaddress_type& hw_addr) {
+    add(iface.id(), addr, hw_addr, time(0));
+}
+
+bool NeighborCache::remove(const NetworkInterface& iface, IPv4Address addr) {
+    #if TINS_IS_CXX11
+    std::lock_guard<std::mutex> lock(mutex_);
+    #endif // TINS_IS_CXX11
+    return ipv4_entries_.erase(make_pair(iface.id(), addr)) != 0;
+}
+
+bool NeighborCache::remove(const NetworkInterface& iface, const IPv6Address& addr) {
+    #if TINS_IS_CXX11
+    std::lock_guard<std::mutex> lock(mutex_);
+    #endif // TINS_IS_CXX11
+    return ipv6_entries_.erase(make_pair(iface.id(), addr)) != 0;
+}
+
+bool NeighborCache::find(const NetworkInterface& iface, IPv4Address addr,
+                         hwaddress_type& hw_addr) const {
+    #if TINS_IS_CXX11
+    std::lock_guard<std::mutex> lock(mutex_);
+    #endif // TINS_IS_CXX11
+    ipv4_entries::const_iterator it = ipv4_entries_.find(make_pair(iface.id(), addr));
+    if (it == ipv4_entries_.end()) {
+        return false;
+    }
+    hw_addr = it->second.hw_addr;
+    return true;
+}
+
+bool NeighborCache::find(const NetworkInterface& iface, const IPv6Address& addr,
+                         hwaddress_type& hw_addr) const {
+    #if TINS_IS_CXX11
+    std::lock_guard<std::mutex> lock(mutex_);
+    #endif // TINS_IS_CXX11
+    ipv6_entries::const_iterator it = ipv6_entries_.find(make_pair(iface.id(), addr));
+    if (it == ipv6_entries_.end()) {
+        return false;
+    }
+    hw_addr = it->second.hw_addr;
+    return true;
+}
+
+NeighborCache::hwaddress_type NeighborCache::resolve(const NetworkInterface& iface,
+                                                     IPv4Address addr,
+                                                     PacketSender& sender) {
+    hwaddress_type hw_addr;
+    if (resolve(iface, vector<IPv4Address>(1, addr), sender) == 0 || 
+        !find(iface, addr, hw_addr)) {
+        throw exception_base("Could not resolve hardware address");
+    }
+    return hw_addr;
+}
+
+size_t NeighborCache::resolve(const NetworkInterface& iface,
+                              const vector<IPv4Address>& addresses,
+                              PacketSender& sender) {
+    const uint32_t iface_index = iface.id();
+    vector<IPv4Address> pending = missing(iface_index, addresses);
+    if (!pending.empty()) {
+        resolve_pending(iface, pending, sender);
+    }
+    return count_present(iface_index, addresses);
+}
+
+size_t NeighborCache::refresh(const NetworkInterface& iface, PacketSender& sender) {
+    const uint32_t iface_index = iface.id();
+    vector<IPv4Address> stale;
+    {
+        #if TINS_IS_CXX11
+        std::lock_guard<std::mutex> lock(mutex_);
+        #endif // TINS_IS_CXX11
+        const std::time_t now = time(0);
+        ipv4_entries::const_iterator it = ipv4_entries_.lower_bound(
+            make_pair(iface_index, IPv4Address())
+        );
+        for (; it != ipv4_entries_.end() && it->first.first == iface_index; ++it) {
+            if (is_stale(it->second, now)) {
+                stale.push_back(it->first.second);
+            }
+        }
+    }
+    if (stale.empty()) {
+        return 0;
+    }
+    resolve_pending(iface, stale, sender);
+    return count_present(iface_index, stale);
+}
+
+#if TINS_IS_CXX11
+
+void NeighborCache::start_refresh(unsigned interval) {
+    std::lock_guard<std::mutex> refresh_lock(refresh_mutex_);
+    if (refresh_thread_.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            refresh_stopping_ = true;
+        }
+        refresh_stopped_.notify_all();
+        refresh_thread_.join();
+    }
+    refresh_stopping_ = false;
+    refresh_thread_ = std::thread(&NeighborCache::run_refresh, this, interval);
+}
+
+void NeighborCache::stop_refresh() {
+    std::lock_guard<std::mutex> refresh_lock(refresh_mutex_);
+    if (!refresh_thread_.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        refresh_stopping_ = true;
+    }
+    refresh_stopped_.notify_all();
+    refresh_thread_.join();
+}
+
+void NeighborCache::run_refresh(unsigned interval) {
+    PacketSender sender;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!refresh_stopped_.wait_for(lock, std::chrono::seconds(interval),
+                                      [&] { return refresh_stopping_; })) {
+        set<uint32_t> iface_indexes;
+        for (ipv4_entries::const_iterator it = ipv4_entries_.begin();
+             it != ipv4_entries_.end(); ++it) {
+            iface_indexes.insert(it->first.first);
+        }
+        lock.unlock();
+        for (set<uint32_t>::const_iterator it = iface_indexes.begin();
+             it != iface_indexes.end(); ++it) {
+            try {
+                refresh(NetworkInterface::from_index(*it), sender);
+            }
+            catch (std::exception&) {
+                // The interface may be gone. Its entries will be tried again
+            }
+        }
+        lock.lock();
+    }
+}
+
+#endif // TINS_IS_CXX11
+
+void NeighborCache::max_age(unsigned value) {
+    #if TINS_IS_CXX11
+    std::lock_guard<std::mutex> lock(mutex_);
+    #endif // TINS_IS_CXX11
+    max_age_ = value;
+}
+
+unsigned NeighborCache::max_age() const {
+    #if TINS_IS_CXX11
+    std::lock_guard<std::mutex> lock(mutex_);
+    #endif // TINS_IS_CXX11
+    return max_age_;
+}
+
+size_t NeighborCache::size() const {
+    #if TINS_IS_CXX11
+    std::lock_guard<std::mutex> lock(mutex_);
+    #endif // TINS_IS_CXX11
+    return ipv4_entries_.size() + ipv6_entries_.size();
+}
+
+void NeighborCache::clear() {
+    #if TINS_IS_CXX11
+    std::lock_guard<std::mutex> lock(mutex_);
+    #endif // TINS_IS_CXX11
+    ipv4_entries_.clear();
+    ipv6_entries_.clear();
+}
+
+bool NeighborCache::load(uint32_t iface_index) {
+    ipv4_kernel_neighbors ipv4_neighbors;
+    ipv6_kernel_neighbors ipv6_neighbors;
+    if (!read_kernel_neighbors(iface_index, ipv4_neighbors, ipv6_neighbors)) {
+        return false;
+    }
+    // Entries the kernel hasn't confirmed lately are added as expired ones
+    const std::time_t now = time(0);
+    for (size_t i = 0; i < ipv4_neighbors.size(); ++i) {
+        add(ipv4_neighbors[i].iface_index, ipv4_neighbors[i].addr, ipv4_neighbors[i].hw_addr,
+            ipv4_neighbors[i].reachable ? now : 0);
+    }
+    for (size_t i = 0; i < ipv6_neighbors.size(); ++i) {
+        add(ipv6_neighbors[i].iface_index, ipv6_neighbors[i].addr, ipv6_neighbors[i].hw_addr,
+            ipv6_neighbors[i].reachable ? now : 0);
+    }
+    return true;
+}
+
+// Entries are only replaced by ones which are at least as fresh
+void NeighborCache::add(uint32_t iface_index, IPv4Address addr, const hwaddress_type& hw_addr,
+                        std::time_t updated_at) {
+    #if TINS_IS_CXX11
+    std::lock_guard<std::mutex> lock(mutex_);
+    #endif // TINS_IS_CXX11
+    pair<ipv4_entries::iterator, bool> result = ipv4_entries_.insert(
+        make_pair(make_pair(iface_index, addr), entry_type())
+    );
+    entry_type& entry = result.first->second;
+    if (result.second || entry.updated_at <= updated_at) {
+        entry.hw_addr = hw_addr;
+        entry.updated_at = updated_at;
+    }
+}
+
+void NeighborCache::add(uint32_t iface_index, const IPv6Address& addr,
+                        const hwaddress_type& hw_addr, std::time_t updated_at) {
+    #if TINS_IS_CXX11
+    std::lock_guard<std::mutex> lock(mutex_);
+    #endif // TINS_IS_CXX11
+    pair<ipv6_entries::iterator, bool> result = ipv6_entries_.insert(
+        make_pair(make_pair(iface_index, addr), entry_type())
+    );
+    entry_type& entry = result.first->second;
+    if (result.second || entry.updated_at <= updated_at) {
+        entry.hw_addr = hw_addr;
+        entry.updated_at = updated_at;
+    }
+}
+
+// Resolves addresses which are missing or stale. The ones being resolved by 
+// another thread are waited for instead of being requested again
+void NeighborCache::resolve_pending(const NetworkInterface& iface,
+                                    const vector<IPv4Address>& pending,
+                                    PacketSender& sender) {
+    const uint32_t iface_index = iface.id();
+    vector<IPv4Address> owned;
+    vector<IPv4Address> waiting;
+    {
+        #if TINS_IS_CXX11
+        std::lock_guard<std::mutex> lock(mutex_);
+        #endif // TINS_IS_CXX11
+        set<IPv4Address> seen;
+        for (size_t i = 0; i < pending.size(); ++i) {
+            if (!seen.insert(pending[i]).second) {
+                continue;
+            }
+            if (pending_.insert(make_pair(iface_index, pending[i])).second) {
+                owned.push_back(pending[i]);
+            }
+            else {
+                waiting.push_back(pending[i]);
+            }
+        }
+    }
+    try {
+        vector<IPv4Address> requested = owned;
+        if (!requested.empty() && load(iface_index)) {
+            requested = missing(iface_index, requested);
+        }
+        if (!requested.empty()) {
+            vector<ipv4_neighbor> resolved = request_hw_addresses(iface, requested, sender);
+            set<IPv4Address> refreshed;
+            const std::time_t now = time(0);
+            for (size_t i = 0; i < resolved.size(); ++i) {
+                add(iface_index, resolved[i].first, resolved[i].second, now);
+                refreshed.insert(resolved[i].first);
+            }
+            // Whatever is still pending had a stale entry or none at all. Either 
+            // way, it's not there anymore
+            for (size_t i = 0; i < requested.size(); ++i) {
+                if (refreshed.count(requested[i]) == 0) {
+                    remove(iface, requested[i]);
+                }
+            }
+        }
+    }
+    catch (...) {
+        release_pending(iface_index, owned);
+        throw;
+    }
+    release_pending(iface_index, owned);
+    #if TINS_IS_CXX11
+    if (!waiting.empty()) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        pending_resolved_.wait(lock, [&] {
+            for (size_t i = 0; i < waiting.size(); ++i) {
+                if (pending_.count(make_pair(iface_index, waiting[i])) != 0) {
+                    return false;
+                }
+            }
+            return true;
+        });
+    }
+    #endif // TINS_IS_CXX11
+}
+
+void NeighborCache::release_pending(uint32_t iface_index, const vector<IPv4Address>& pending) {
+    if (pending.empty()) {
+        return;
+    }
+    {
+        #if TINS_IS_CXX11
+        std::lock_guard<std::mutex> lock(mutex_);
+        #endif // TINS_IS_CXX11
+        for (size_t i = 0; i < pending.size(); ++i) {
+            pending_.erase(make_pair(iface_index, pending[i]));
+        }
+    }
+    #if TINS_IS_CXX11
+    pending_resolved_.notify_all();
+    #endif // TINS_IS_CXX11
+}
+
+bool NeighborCache::is_stale(const entry_type& entry, std::time_t now) const {
+    return now - entry.updated_at >= static_cast<std::time_t>(max_age_);
+}
+
+vector<IPv4Address> NeighborCache::missing(uint32_t iface_index,
+                                           const vector<IPv4Address>& addresses) const {
+    #if TINS_IS_CXX11
+    std::lock_guard<std::mutex> lock(mutex_);
+    #endif // TINS_IS_CXX11
+    const std::time_t now = time(0);
+    vector<IPv4Address> output;
+    for (size_t i = 0; i < addresses.size(); ++i) {
+        ipv4_entries::const_iterator it = ipv4_entries_.find(
+            make_pair(iface_index, addresses[i])
+        );
+        if (it == ipv4_entries_.end() || is_stale(it->second, now)) {
+            output.push_back(addresses[i]);
+        }
+    }
+    return output;
+}
+
+size_t NeighborCache::count_present(uint32_t iface_index,
+                                    const vector<IPv4Address>& addresses) const {
+    #if TINS_IS_CXX11
+    std::lock_guard<std::mutex> lock(mutex_);
+    #endif // TINS_IS_CXX11
+    size_t output = 0;
+    for (size_t i = 0; i < addresses.size(); ++i) {
+        if (ipv4_entries_.count(make_pair(iface_index, addresses[i])) != 0) {
+            ++output;
+        }
+    }
+    return output;
+}
+
+namespace Utils {
+
+NeighborCache& neighbor_cache() {
+    static NeighborCache cache;
+    return cache;
+}
+
+} // Utils
+} // Tins
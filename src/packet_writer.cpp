@@ -49,6 +49,36 @@ PacketWriter::~PacketWriter() {
         pcap_dump_close(dumper_);
         pcap_close(handle_);
     }
+    if (index_) {
+        // Best effort, use save_index to find out whether this works
+        if (!index_saved_) {
+            try {
+                index_->save(PcapIndex::index_file_name(file_name_));
+            }
+            catch (const file_write_error&) {
+
+            }
+        }
+        delete index_;
+    }
+}
+
+void PacketWriter::save_index() {
+    if (!index_) {
+        return;
+    }
+    // The index covers every record, so they must be in the file as well
+    if (pcap_dump_flush(dumper_) != 0) {
+        throw file_write_error("Failed to write " + file_name_);
+    }
+    index_->save(PcapIndex::index_file_name(file_name_));
+    index_saved_ = true;
+}
+
+void PacketWriter::enable_index(uint32_t block_size) {
+    if (!index_) {
+        index_ = new PcapIndex(pcap_datalink(handle_), block_size);
+    }
 }
 
 void PacketWriter::write(PDU& pdu) {
@@ -76,10 +106,17 @@ void PacketWriter::write(PDU& pdu, const struct timeval& tv) {
     header.ts = tv;
     header.caplen = static_cast<bpf_u_int32>(buffer.size());
     header.len = static_cast<bpf_u_int32>(buffer.size());
+    if (index_) {
+        index_->add_record(pcap_dump_ftell(dumper_), tv, &buffer[0], header.caplen);
+        index_saved_ = false;
+    }
     pcap_dump((u_char*)dumper_, &header, &buffer[0]);
 }
 
 void PacketWriter::init(const string& file_name, int link_type) {
+    index_ = 0;
+    index_saved_ = false;
+    file_name_ = file_name;
     handle_ = pcap_open_dead(link_type, 65535);
     if (!handle_) {
         throw pcap_open_failed();
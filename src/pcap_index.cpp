@@ -0,0 +1,798 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifdef _WIN32
+    #include <winsock2.h>
+#else
+    #include <sys/time.h>
+#endif
+#include <cstring>
+#include <algorithm>
+#include <tins/pcap_index.h>
+#include <tins/pdu.h>
+#include <tins/ip.h>
+#include <tins/ipv6.h>
+#include <tins/tcp.h>
+#include <tins/udp.h>
+#include <tins/rawpdu.h>
+#include <tins/ip_address.h>
+#include <tins/ipv6_address.h>
+#include <tins/endianness.h>
+#include <tins/exceptions.h>
+#include <tins/detail/pdu_helpers.h>
+
+using std::string;
+using std::vector;
+using std::ifstream;
+using std::ofstream;
+using std::ios;
+using std::memcpy;
+using std::memcmp;
+using std::swap;
+using std::lower_bound;
+using std::upper_bound;
+
+namespace Tins {
+
+namespace {
+
+const uint32_t PCAP_MAGIC = 0xa1b2c3d4;
+const uint32_t PCAP_NANOSECOND_MAGIC = 0xa1b23c4d;
+const size_t PCAP_FILE_HEADER_SIZE = 24;
+const size_t PCAP_RECORD_HEADER_SIZE = 16;
+// Larger records are considered a sign of a corrupted file
+const uint32_t MAX_RECORD_SIZE = 64 * 1024 * 1024;
+
+const char INDEX_MAGIC[8] = { 'T', 'I', 'N', 'S', 'P', 'I', 'D', 'X' };
+const uint32_t INDEX_VERSION = 1;
+const size_t INDEX_HEADER_SIZE = 56;
+const size_t INDEX_BLOCK_SIZE = 28;
+const size_t INDEX_FLOW_SIZE = 16;
+
+// The link types, as defined by libpcap
+const int LINKTYPE_NULL = 0;
+const int LINKTYPE_ETHERNET = 1;
+const int LINKTYPE_RAW = 101;
+const int LINKTYPE_LOOP = 108;
+const int LINKTYPE_LINUX_SLL = 113;
+// Some platforms use these values for DLT_RAW
+const int DLT_RAW_1 = 12;
+const int DLT_RAW_2 = 14;
+
+const uint16_t ETHERTYPE_IP = 0x0800;
+const uint16_t ETHERTYPE_IPV6 = 0x86dd;
+const uint16_t ETHERTYPE_VLAN = 0x8100;
+const uint16_t ETHERTYPE_QINQ = 0x88a8;
+
+const uint8_t PROTOCOL_TCP = 6;
+const uint8_t PROTOCOL_UDP = 17;
+const uint8_t PROTOCOL_SCTP = 132;
+
+struct pcap_file_info {
+    int link_type;
+    bool swapped;
+    bool nanoseconds;
+};
+
+struct pcap_record_info {
+    uint64_t timestamp;
+    uint32_t captured_size;
+    uint32_t original_size;
+};
+
+uint16_t read_be16(const uint8_t* buffer) {
+    return static_cast<uint16_t>((buffer[0] << 8) | buffer[1]);
+}
+
+uint32_t read_uint32(const uint8_t* buffer, bool swapped) {
+    uint32_t value;
+    memcpy(&value, buffer, sizeof(value));
+    return swapped ? Endian::do_change_endian(value) : value;
+}
+
+bool read_file_header(std::istream& input, pcap_file_info& info) {
+    uint8_t buffer[PCAP_FILE_HEADER_SIZE];
+    if (!input.read(reinterpret_cast<char*>(buffer), sizeof(buffer))) {
+        return false;
+    }
+    const uint32_t magic = read_uint32(buffer, false);
+    if (magic == PCAP_MAGIC || magic == PCAP_NANOSECOND_MAGIC) {
+        info.swapped = false;
+    }
+    else if (Endian::do_change_endian(magic) == PCAP_MAGIC || 
+             Endian::do_change_endian(magic) == PCAP_NANOSECOND_MAGIC) {
+        info.swapped = true;
+    }
+    else {
+        return false;
+    }
+    info.nanoseconds = read_uint32(buffer, info.swapped) == PCAP_NANOSECOND_MAGIC;
+    // The upper bits can contain FCS information
+    info.link_type = static_cast<int>(read_uint32(buffer + 20, info.swapped) & 0x0fffffff);
+    return true;
+}
+
+bool read_record_header(std::istream& input, const pcap_file_info& info,
+                        pcap_record_info& record) {
+    uint8_t buffer[PCAP_RECORD_HEADER_SIZE];
+    if (!input.read(reinterpret_cast<char*>(buffer), sizeof(buffer))) {
+        return false;
+    }
+    const uint64_t seconds = read_uint32(buffer, info.swapped);
+    uint64_t fraction = read_uint32(buffer + 4, info.swapped);
+    if (info.nanoseconds) {
+        fraction /= 1000;
+    }
+    record.timestamp = seconds * 1000000 + fraction;
+    record.captured_size = read_uint32(buffer + 8, info.swapped);
+    record.original_size = read_uint32(buffer + 12, info.swapped);
+    if (record.captured_size > MAX_RECORD_SIZE) {
+        throw invalid_pcap_file();
+    }
+    return true;
+}
+
+bool read_record_data(std::istream& input, uint32_t size, vector<uint8_t>& data) {
+    data.resize(size);
+    return size == 0 || input.read(reinterpret_cast<char*>(&data[0]), size);
+}
+
+uint64_t timestamp_value(const Timestamp& ts) {
+    return static_cast<uint64_t>(ts.seconds()) * 1000000 + ts.microseconds();
+}
+
+Timestamp make_timestamp(uint64_t value) {
+    timeval tv;
+    tv.tv_sec = static_cast<long>(value / 1000000);
+    tv.tv_usec = static_cast<long>(value % 1000000);
+    return tv;
+}
+
+// FNV-1a followed by a final mix so that the low bits are usable as well
+uint64_t hash_bytes(uint64_t hash, const uint8_t* data, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ data[i]) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+uint64_t hash_endpoints(const uint8_t* address1, uint16_t port1,
+                        const uint8_t* address2, uint16_t port2,
+                        size_t address_size, uint8_t protocol) {
+    // Sort the endpoints so both directions yield the same hash
+    const int comparison = memcmp(address1, address2, address_size);
+    if (comparison > 0 || (comparison == 0 && port1 > port2)) {
+        swap(address1, address2);
+        swap(port1, port2);
+    }
+    const uint8_t prefix[2] = { protocol, static_cast<uint8_t>(address_size) };
+    const uint8_t ports[4] = { 
+        static_cast<uint8_t>(port1 >> 8), static_cast<uint8_t>(port1),
+        static_cast<uint8_t>(port2 >> 8), static_cast<uint8_t>(port2)
+    };
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    hash = hash_bytes(hash, prefix, sizeof(prefix));
+    hash = hash_bytes(hash, address1, address_size);
+    hash = hash_bytes(hash, ports, 2);
+    hash = hash_bytes(hash, address2, address_size);
+    hash = hash_bytes(hash, ports + 2, 2);
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    // 0 means "no flow"
+    return hash ? hash : 1;
+}
+
+bool has_ports(uint8_t protocol) {
+    return protocol == PROTOCOL_TCP || protocol == PROTOCOL_UDP || 
+           protocol == PROTOCOL_SCTP;
+}
+
+// The IPv6 extension headers ipv6_flow_hash skips, other than fragments
+bool is_skipped_ipv6_header(uint8_t type) {
+    return type == IPv6::HOP_BY_HOP || type == IPv6::ROUTING || 
+           type == IPv6::DESTINATION_OPTIONS || type == IPv6::AUTHENTICATION;
+}
+
+// The protocol of an IP layer's payload. Constructed packets only set it 
+// when serialized, so it's taken from the inner PDU when possible
+uint8_t payload_protocol(const PDU& layer, uint8_t protocol) {
+    if (layer.inner_pdu()) {
+        const uint8_t inner_protocol = Internals::pdu_flag_to_ip_type(
+            layer.inner_pdu()->pdu_type()
+        );
+        if (inner_protocol != 0xff) {
+            return inner_protocol;
+        }
+    }
+    return protocol;
+}
+
+// Reads the ports the same way the raw packet version does. Fragments
+// are parsed as RawPDUs, so the ports are read from their payload
+void payload_ports(const PDU* payload, uint16_t& sport, uint16_t& dport) {
+    if (!payload) {
+        return;
+    }
+    if (const TCP* tcp = tins_cast<const TCP*>(payload)) {
+        sport = tcp->sport();
+        dport = tcp->dport();
+    }
+    else if (const UDP* udp = tins_cast<const UDP*>(payload)) {
+        sport = udp->sport();
+        dport = udp->dport();
+    }
+    else if (const RawPDU* raw = tins_cast<const RawPDU*>(payload)) {
+        if (raw->payload().size() >= 4) {
+            sport = read_be16(&raw->payload()[0]);
+            dport = read_be16(&raw->payload()[2]);
+        }
+    }
+}
+
+uint64_t ipv4_flow_hash(const uint8_t* data, uint32_t size) {
+    if (size < 20 || (data[0] >> 4) != 4) {
+        return 0;
+    }
+    const uint32_t header_size = (data[0] & 0x0f) * 4;
+    if (header_size < 20 || header_size > size) {
+        return 0;
+    }
+    const uint8_t protocol = data[9];
+    const bool first_fragment = (read_be16(data + 6) & 0x1fff) == 0;
+    uint16_t sport = 0, dport = 0;
+    if (first_fragment && has_ports(protocol) && header_size + 4 <= size) {
+        sport = read_be16(data + header_size);
+        dport = read_be16(data + header_size + 2);
+    }
+    return hash_endpoints(data + 12, sport, data + 16, dport, 4, protocol);
+}
+
+uint64_t ipv6_flow_hash(const uint8_t* data, uint32_t size) {
+    if (size < 40 || (data[0] >> 4) != 6) {
+        return 0;
+    }
+    uint8_t protocol = data[6];
+    uint32_t index = 40;
+    bool first_fragment = true;
+    // Skip extension headers until the upper layer protocol is found
+    for (int i = 0; i < 8 && index + 8 <= size; ++i) {
+        if (protocol == IPv6::HOP_BY_HOP || protocol == IPv6::ROUTING || 
+            protocol == IPv6::DESTINATION_OPTIONS) {
+            const uint8_t next = data[index];
+            index += (data[index + 1] + 1) * 8;
+            protocol = next;
+        }
+        else if (protocol == IPv6::FRAGMENT) {
+            first_fragment = (read_be16(data + index + 2) & 0xfff8) == 0;
+            protocol = data[index];
+            index += 8;
+        }
+        else if (protocol == IPv6::AUTHENTICATION) {
+            const uint8_t next = data[index];
+            index += (data[index + 1] + 2) * 4;
+            protocol = next;
+        }
+        else {
+            break;
+        }
+    }
+    uint16_t sport = 0, dport = 0;
+    if (first_fragment && has_ports(protocol) && index + 4 <= size) {
+        sport = read_be16(data + index);
+        dport = read_be16(data + index + 2);
+    }
+    return hash_endpoints(data + 8, sport, data + 24, dport, 16, protocol);
+}
+
+void write_le32(vector<uint8_t>& buffer, uint32_t value) {
+    value = Endian::host_to_le(value);
+    const uint8_t* ptr = reinterpret_cast<const uint8_t*>(&value);
+    buffer.insert(buffer.end(), ptr, ptr + sizeof(value));
+}
+
+void write_le64(vector<uint8_t>& buffer, uint64_t value) {
+    value = Endian::host_to_le(value);
+    const uint8_t* ptr = reinterpret_cast<const uint8_t*>(&value);
+    buffer.insert(buffer.end(), ptr, ptr + sizeof(value));
+}
+
+uint32_t read_le32(const uint8_t* buffer) {
+    uint32_t value;
+    memcpy(&value, buffer, sizeof(value));
+    return Endian::le_to_host(value);
+}
+
+uint64_t read_le64(const uint8_t* buffer) {
+    uint64_t value;
+    memcpy(&value, buffer, sizeof(value));
+    return Endian::le_to_host(value);
+}
+
+} // anonymous namespace
+
+// PcapIndex
+
+string PcapIndex::index_file_name(const string& pcap_file) {
+    return pcap_file + ".idx";
+}
+
+PcapIndex PcapIndex::build(const string& pcap_file, uint32_t block_size) {
+    ifstream input(pcap_file.c_str(), ios::binary);
+    pcap_file_info info;
+    if (!input || !read_file_header(input, info)) {
+        throw invalid_pcap_file();
+    }
+    PcapIndex output(info.link_type, block_size);
+    output.file_size_ = PCAP_FILE_HEADER_SIZE;
+    uint64_t offset = PCAP_FILE_HEADER_SIZE;
+    pcap_record_info record;
+    vector<uint8_t> data;
+    // A truncated record at the end is expected if the file is being written
+    while (read_record_header(input, info, record) && 
+           read_record_data(input, record.captured_size, data)) {
+        output.add_record(offset, make_timestamp(record.timestamp), 
+                          data.empty() ? 0 : &data[0], record.captured_size);
+        offset += PCAP_RECORD_HEADER_SIZE + record.captured_size;
+    }
+    output.sort_flows();
+    return output;
+}
+
+PcapIndex PcapIndex::load(const string& index_file) {
+    ifstream input(index_file.c_str(), ios::binary);
+    uint8_t header[INDEX_HEADER_SIZE];
+    if (!input || !input.read(reinterpret_cast<char*>(header), sizeof(header)) ||
+        memcmp(header, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0 ||
+        read_le32(header + 8) != INDEX_VERSION) {
+        throw invalid_pcap_file();
+    }
+    PcapIndex output(static_cast<int>(read_le32(header + 16)), read_le32(header + 12));
+    output.record_count_ = read_le64(header + 24);
+    output.file_size_ = read_le64(header + 32);
+    const uint64_t block_count = read_le64(header + 40);
+    const uint64_t flow_count = read_le64(header + 48);
+    if (block_count > output.record_count_ || flow_count > output.record_count_) {
+        throw invalid_pcap_file();
+    }
+
+    vector<uint8_t> buffer(static_cast<size_t>(block_count) * INDEX_BLOCK_SIZE);
+    if (!buffer.empty() && !input.read(reinterpret_cast<char*>(&buffer[0]), buffer.size())) {
+        throw invalid_pcap_file();
+    }
+    output.blocks_.resize(static_cast<size_t>(block_count));
+    for (size_t i = 0; i < output.blocks_.size(); ++i) {
+        const uint8_t* ptr = &buffer[i * INDEX_BLOCK_SIZE];
+        time_block& block = output.blocks_[i];
+        block.offset = read_le64(ptr);
+        block.first_timestamp = read_le64(ptr + 8);
+        block.last_timestamp = read_le64(ptr + 16);
+        block.record_count = read_le32(ptr + 24);
+    }
+
+    buffer.resize(static_cast<size_t>(flow_count) * INDEX_FLOW_SIZE);
+    if (!buffer.empty() && !input.read(reinterpret_cast<char*>(&buffer[0]), buffer.size())) {
+        throw invalid_pcap_file();
+    }
+    output.flows_.resize(static_cast<size_t>(flow_count));
+    for (size_t i = 0; i < output.flows_.size(); ++i) {
+        const uint8_t* ptr = &buffer[i * INDEX_FLOW_SIZE];
+        output.flows_[i].flow_hash = read_le64(ptr);
+        output.flows_[i].offset = read_le64(ptr + 8);
+    }
+    // Don't trust the file to be sorted
+    for (size_t i = 1; i < output.flows_.size() && output.flows_sorted_; ++i) {
+        output.flows_sorted_ = !(output.flows_[i] < output.flows_[i - 1]);
+    }
+    output.sort_flows();
+    return output;
+}
+
+uint64_t PcapIndex::flow_hash(int link_type, const uint8_t* data, uint32_t size) {
+    uint32_t offset = 0;
+    uint16_t ether_type = 0;
+    switch (link_type) {
+        case LINKTYPE_ETHERNET:
+            if (size < 14) {
+                return 0;
+            }
+            ether_type = read_be16(data + 12);
+            offset = 14;
+            while ((ether_type == ETHERTYPE_VLAN || ether_type == ETHERTYPE_QINQ) && 
+                   offset + 4 <= size) {
+                ether_type = read_be16(data + offset + 2);
+                offset += 4;
+            }
+            break;
+        case LINKTYPE_LINUX_SLL:
+            if (size < 16) {
+                return 0;
+            }
+            ether_type = read_be16(data + 14);
+            offset = 16;
+            break;
+        case LINKTYPE_NULL:
+        case LINKTYPE_LOOP:
+            // The address family's values and byte order depend on the OS, 
+            // so the IP version is used instead
+            offset = 4;
+            break;
+        case LINKTYPE_RAW:
+        case DLT_RAW_1:
+        case DLT_RAW_2:
+            break;
+        default:
+            return 0;
+    }
+    if (offset >= size) {
+        return 0;
+    }
+    if (ether_type == 0) {
+        const uint8_t version = data[offset] >> 4;
+        ether_type = (version == 4) ? ETHERTYPE_IP : (version == 6 ? ETHERTYPE_IPV6 : 0);
+    }
+    if (ether_type == ETHERTYPE_IP) {
+        return ipv4_flow_hash(data + offset, size - offset);
+    }
+    if (ether_type == ETHERTYPE_IPV6) {
+        return ipv6_flow_hash(data + offset, size - offset);
+    }
+    return 0;
+}
+
+uint64_t PcapIndex::flow_hash(const PDU& pdu) {
+    // Use the outermost IP layer, just like the raw packet version does
+    const PDU* layer = &pdu;
+    while (layer && layer->pdu_type() != PDU::IP && layer->pdu_type() != PDU::IPv6) {
+        layer = layer->inner_pdu();
+    }
+    if (!layer) {
+        return 0;
+    }
+    uint16_t sport = 0, dport = 0;
+    if (layer->pdu_type() == PDU::IP) {
+        const IP& ip = static_cast<const IP&>(*layer);
+        const uint8_t protocol = payload_protocol(ip, ip.protocol());
+        if (ip.fragment_offset() == 0 && has_ports(protocol)) {
+            payload_ports(ip.inner_pdu(), sport, dport);
+        }
+        return flow_hash(ip.src_addr(), sport, ip.dst_addr(), dport, protocol);
+    }
+    const IPv6& ipv6 = static_cast<const IPv6&>(*layer);
+    uint8_t protocol = payload_protocol(ipv6, ipv6.upper_layer_protocol());
+    bool first_fragment = true;
+    const IPv6::headers_type& headers = ipv6.headers();
+    for (size_t i = 0; i < headers.size(); ++i) {
+        const uint8_t type = headers[i].option();
+        if (type == IPv6::FRAGMENT) {
+            first_fragment = headers[i].data_size() < 2 ||
+                             (read_be16(headers[i].data_ptr()) & 0xfff8) == 0;
+        }
+        else if (!is_skipped_ipv6_header(type)) {
+            // The raw packet version stops at the first header it can't skip
+            protocol = type;
+            break;
+        }
+    }
+    if (first_fragment && has_ports(protocol)) {
+        payload_ports(ipv6.inner_pdu(), sport, dport);
+    }
+    return flow_hash(ipv6.src_addr(), sport, ipv6.dst_addr(), dport, protocol);
+}
+
+uint64_t PcapIndex::flow_hash(const IPv4Address& address1, uint16_t port1,
+                              const IPv4Address& address2, uint16_t port2,
+                              uint8_t protocol) {
+    // Both addresses are stored in network byte order
+    const uint32_t value1 = address1;
+    const uint32_t value2 = address2;
+    uint8_t buffer1[4], buffer2[4];
+    memcpy(buffer1, &value1, sizeof(buffer1));
+    memcpy(buffer2, &value2, sizeof(buffer2));
+    if (!has_ports(protocol)) {
+        port1 = port2 = 0;
+    }
+    return hash_endpoints(buffer1, port1, buffer2, port2, sizeof(buffer1), protocol);
+}
+
+uint64_t PcapIndex::flow_hash(const IPv6Address& address1, uint16_t port1,
+                              const IPv6Address& address2, uint16_t port2,
+                              uint8_t protocol) {
+    if (!has_ports(protocol)) {
+        port1 = port2 = 0;
+    }
+    return hash_endpoints(address1.begin(), port1, address2.begin(), port2,
+                          IPv6Address::address_size, protocol);
+}
+
+PcapIndex::PcapIndex(int link_type, uint32_t block_size)
+: flows_sorted_(true), record_count_(0), file_size_(PCAP_FILE_HEADER_SIZE),
+  block_size_(block_size ? block_size : 1), link_type_(link_type) {
+
+}
+
+void PcapIndex::add_record(uint64_t offset, const Timestamp& ts, const uint8_t* data,
+                           uint32_t size) {
+    const uint64_t timestamp = timestamp_value(ts);
+    if (blocks_.empty() || blocks_.back().record_count == block_size_) {
+        time_block block;
+        block.offset = offset;
+        block.first_timestamp = timestamp;
+        block.last_timestamp = timestamp;
+        block.record_count = 0;
+        blocks_.push_back(block);
+    }
+    time_block& block = blocks_.back();
+    block.first_timestamp = std::min(block.first_timestamp, timestamp);
+    block.last_timestamp = std::max(block.last_timestamp, timestamp);
+    ++block.record_count;
+
+    const uint64_t hash = flow_hash(link_type_, data, size);
+    if (hash != 0) {
+        flow_entry entry;
+        entry.flow_hash = hash;
+        entry.offset = offset;
+        if (flows_sorted_ && !flows_.empty() && entry < flows_.back()) {
+            flows_sorted_ = false;
+        }
+        flows_.push_back(entry);
+    }
+    ++record_count_;
+    file_size_ = offset + PCAP_RECORD_HEADER_SIZE + size;
+}
+
+void PcapIndex::save(const string& index_file) const {
+    // Records added through add_record are appended, so sort a copy of them
+    vector<flow_entry> unsorted_flows;
+    if (!flows_sorted_) {
+        unsorted_flows = flows_;
+        std::sort(unsorted_flows.begin(), unsorted_flows.end());
+    }
+    const vector<flow_entry>& flows = flows_sorted_ ? flows_ : unsorted_flows;
+    vector<uint8_t> buffer;
+    buffer.reserve(INDEX_HEADER_SIZE + blocks_.size() * INDEX_BLOCK_SIZE + 
+                   flows.size() * INDEX_FLOW_SIZE);
+    buffer.insert(buffer.end(), INDEX_MAGIC, INDEX_MAGIC + sizeof(INDEX_MAGIC));
+    write_le32(buffer, INDEX_VERSION);
+    write_le32(buffer, block_size_);
+    write_le32(buffer, static_cast<uint32_t>(link_type_));
+    write_le32(buffer, 0);
+    write_le64(buffer, record_count_);
+    write_le64(buffer, file_size_);
+    write_le64(buffer, blocks_.size());
+    write_le64(buffer, flows.size());
+    for (size_t i = 0; i < blocks_.size(); ++i) {
+        write_le64(buffer, blocks_[i].offset);
+        write_le64(buffer, blocks_[i].first_timestamp);
+        write_le64(buffer, blocks_[i].last_timestamp);
+        write_le32(buffer, blocks_[i].record_count);
+    }
+    for (size_t i = 0; i < flows.size(); ++i) {
+        write_le64(buffer, flows[i].flow_hash);
+        write_le64(buffer, flows[i].offset);
+    }
+    ofstream output(index_file.c_str(), ios::binary | ios::trunc);
+    if (!output || !output.write(reinterpret_cast<const char*>(&buffer[0]), buffer.size())) {
+        throw file_write_error("Failed to write pcap index " + index_file);
+    }
+    output.close();
+    if (output.fail()) {
+        throw file_write_error("Failed to write pcap index " + index_file);
+    }
+}
+
+vector<PcapIndex::time_block> PcapIndex::find_window(const Timestamp& start, 
+                                                     const Timestamp& end) const {
+    const uint64_t start_value = timestamp_value(start);
+    const uint64_t end_value = timestamp_value(end);
+    vector<time_block> output;
+    for (size_t i = 0; i < blocks_.size(); ++i) {
+        if (blocks_[i].last_timestamp >= start_value && 
+            blocks_[i].first_timestamp < end_value) {
+            output.push_back(blocks_[i]);
+        }
+    }
+    return output;
+}
+
+vector<uint64_t> PcapIndex::find_flow(uint64_t flow_hash) const {
+    vector<uint64_t> output;
+    if (!flows_sorted_) {
+        // Records are added in file order, so the offsets are already sorted
+        for (size_t i = 0; i < flows_.size(); ++i) {
+            if (flows_[i].flow_hash == flow_hash) {
+                output.push_back(flows_[i].offset);
+            }
+        }
+        return output;
+    }
+    flow_entry key;
+    key.flow_hash = flow_hash;
+    key.offset = 0;
+    vector<flow_entry>::const_iterator iter = lower_bound(flows_.begin(), flows_.end(), key);
+    while (iter != flows_.end() && iter->flow_hash == flow_hash) {
+        output.push_back(iter->offset);
+        ++iter;
+    }
+    return output;
+}
+
+int PcapIndex::link_type() const {
+    return link_type_;
+}
+
+uint32_t PcapIndex::block_size() const {
+    return block_size_;
+}
+
+uint64_t PcapIndex::record_count() const {
+    return record_count_;
+}
+
+uint64_t PcapIndex::file_size() const {
+    return file_size_;
+}
+
+const vector<PcapIndex::time_block>& PcapIndex::blocks() const {
+    return blocks_;
+}
+
+void PcapIndex::sort_flows() {
+    if (!flows_sorted_) {
+        std::sort(flows_.begin(), flows_.end());
+        flows_sorted_ = true;
+    }
+}
+
+// IndexedPcapReader
+
+IndexedPcapReader::IndexedPcapReader(const string& pcap_file) 
+: index_loaded_(false) {
+    open(pcap_file);
+    input_.seekg(0, ios::end);
+    const uint64_t file_size = static_cast<uint64_t>(input_.tellg());
+    try {
+        PcapIndex index = PcapIndex::load(PcapIndex::index_file_name(pcap_file));
+        // Only use the index if the file hasn't changed since it was created
+        if (index.file_size() == file_size && index.link_type() == link_type_) {
+            index_ = index;
+            index_loaded_ = true;
+        }
+    }
+    catch (const invalid_pcap_file&) {
+
+    }
+    if (!index_loaded_) {
+        index_ = PcapIndex::build(pcap_file);
+    }
+}
+
+IndexedPcapReader::IndexedPcapReader(const string& pcap_file, const PcapIndex& index)
+: index_(index), index_loaded_(false) {
+    open(pcap_file);
+}
+
+void IndexedPcapReader::open(const string& pcap_file) {
+    input_.open(pcap_file.c_str(), ios::binary);
+    pcap_file_info info;
+    if (!input_ || !read_file_header(input_, info)) {
+        throw invalid_pcap_file();
+    }
+    link_type_ = info.link_type;
+    swapped_ = info.swapped;
+    nanoseconds_ = info.nanoseconds;
+}
+
+vector<IndexedPcapReader::record> IndexedPcapReader::read_window(const Timestamp& start,
+                                                                 const Timestamp& end) {
+    const uint64_t start_value = timestamp_value(start);
+    const uint64_t end_value = timestamp_value(end);
+    const vector<PcapIndex::time_block> blocks = index_.find_window(start, end);
+    vector<record> output;
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        uint64_t offset = blocks[i].offset;
+        for (uint32_t j = 0; j < blocks[i].record_count; ++j) {
+            record entry;
+            if (!read_record(offset, entry)) {
+                break;
+            }
+            offset += PCAP_RECORD_HEADER_SIZE + entry.data.size();
+            const uint64_t timestamp = timestamp_value(entry.timestamp);
+            if (timestamp >= start_value && timestamp < end_value) {
+                output.push_back(entry);
+            }
+        }
+    }
+    return output;
+}
+
+vector<IndexedPcapReader::record> IndexedPcapReader::read_flow(uint64_t flow_hash) {
+    const vector<uint64_t> offsets = index_.find_flow(flow_hash);
+    vector<record> output(offsets.size());
+    size_t count = 0;
+    for (size_t i = 0; i < offsets.size(); ++i) {
+        if (read_record(offsets[i], output[count])) {
+            ++count;
+        }
+    }
+    output.resize(count);
+    return output;
+}
+
+vector<IndexedPcapReader::record> IndexedPcapReader::read_flow(uint64_t flow_hash,
+                                                               const Timestamp& start,
+                                                               const Timestamp& end) {
+    const uint64_t start_value = timestamp_value(start);
+    const uint64_t end_value = timestamp_value(end);
+    vector<record> output = read_flow(flow_hash);
+    size_t count = 0;
+    for (size_t i = 0; i < output.size(); ++i) {
+        const uint64_t timestamp = timestamp_value(output[i].timestamp);
+        if (timestamp >= start_value && timestamp < end_value) {
+            if (count != i) {
+                swap(output[count], output[i]);
+            }
+            ++count;
+        }
+    }
+    output.resize(count);
+    return output;
+}
+
+bool IndexedPcapReader::read_record(uint64_t offset, record& output) {
+    pcap_file_info info;
+    info.link_type = link_type_;
+    info.swapped = swapped_;
+    info.nanoseconds = nanoseconds_;
+    pcap_record_info record_info;
+    input_.clear();
+    if (!input_.seekg(static_cast<std::streamoff>(offset)) ||
+        !read_record_header(input_, info, record_info) ||
+        !read_record_data(input_, record_info.captured_size, output.data)) {
+        return false;
+    }
+    output.offset = offset;
+    output.timestamp = make_timestamp(record_info.timestamp);
+    output.original_size = record_info.original_size;
+    return true;
+}
+
+const PcapIndex& IndexedPcapReader::index() const {
+    return index_;
+}
+
+bool IndexedPcapReader::index_loaded() const {
+    return index_loaded_;
+}
+
+int IndexedPcapReader::link_type() const {
+    return link_type_;
+}
+
+} // Tins
@@ -35,6 +35,40 @@ using std::vector;
 
 namespace Tins {
 
+// Indexes the layers of a PDU chain. Only the outermost PDU owns one, 
+// inner PDUs use their outermost PDU's index.
+struct PDU::layer_index {
+    // Every PDUType below this value can be indexed
+    static const uint32_t MAX_INDEXED_TYPE = 64;
+    // Chains deeper than this aren't indexed
+    static const size_t MAX_INDEXED_DEPTH = 255;
+
+    layer_index() : present(0), complete(true) { }
+
+    uint64_t present;
+    // Whether every PDU in the chain could be indexed
+    bool complete;
+    // The depth of the first PDU of each type that's present
+    uint8_t first_depth[MAX_INDEXED_TYPE];
+    // Every PDU in the chain, outermost first
+    vector<PDU*> layers;
+};
+
+// These types are also matched by PDUs of other types (e.g. a Dot11Beacon
+// matches DOT11 and DOT11_MANAGEMENT), so they can't be looked up by type
+static bool is_parent_type(PDU::PDUType type) {
+    switch (type) {
+        case PDU::DOT11:
+        case PDU::DOT11_CONTROL:
+        case PDU::DOT11_DATA:
+        case PDU::DOT11_MANAGEMENT:
+        case PDU::EAPOL:
+            return true;
+        default:
+            return false;
+    }
+}
+
 PDU::metadata::metadata() 
 : header_size(0), current_pdu_type(PDU::UNKNOWN), next_pdu_type(PDU::UNKNOWN) {
 
@@ -48,12 +82,12 @@ PDU::metadata::metadata(uint32_t header_size, PDUType current_type, PDUType next
 // PDU
 
 PDU::PDU()
-: inner_pdu_(), parent_pdu_() {
+: inner_pdu_(), parent_pdu_(), layer_index_(0) {
 
 }
 
 PDU::PDU(const PDU& other) 
-: inner_pdu_(), parent_pdu_() {
+: inner_pdu_(), parent_pdu_(), layer_index_(0) {
     copy_inner_pdu(other);
 }
 
@@ -63,6 +97,7 @@ PDU& PDU::operator=(const PDU& other) {
 }
 
 PDU::~PDU() {
+    delete static_cast<layer_index*>(layer_index_);
     delete inner_pdu_;
 }
 
@@ -98,9 +133,12 @@ bool PDU::matches_response(const uint8_t* /*ptr*/, uint32_t /*total_sz*/) const
 }
 
 void PDU::inner_pdu(PDU* next_pdu) {
+    invalidate_layer_index();
     delete inner_pdu_;
     inner_pdu_ = next_pdu;
     if (inner_pdu_) {
+        // It's no longer the outermost PDU of its chain
+        inner_pdu_->invalidate_layer_index();
         inner_pdu_->parent_pdu(this);
     }
 }
@@ -110,6 +148,7 @@ void PDU::inner_pdu(const PDU& next_pdu) {
 }
 
 PDU* PDU::release_inner_pdu() {
+    invalidate_layer_index();
     PDU* result = 0;
     swap(result, inner_pdu_);
     if (result) {
@@ -141,4 +180,94 @@ void PDU::parent_pdu(PDU* parent) {
     parent_pdu_ = parent;
 }
 
+PDU* PDU::find_layer(PDUType type) {
+    if (static_cast<uint32_t>(type) < layer_index::MAX_INDEXED_TYPE && 
+        !is_parent_type(type)) {
+        size_t depth = 0;
+        PDU* outermost = this;
+        while (outermost->parent_pdu_) {
+            outermost = outermost->parent_pdu_;
+            ++depth;
+        }
+        const layer_index& index = outermost->get_layer_index();
+        if (index.complete) {
+            const uint64_t mask = static_cast<uint64_t>(1) << type;
+            if ((index.present & mask) == 0) {
+                return 0;
+            }
+            if (index.first_depth[type] >= depth) {
+                return index.layers[index.first_depth[type]];
+            }
+            // The first one is above this PDU, look for one below it
+            for (size_t i = depth; i < index.layers.size(); ++i) {
+                if (index.layers[i]->pdu_type() == type) {
+                    return index.layers[i];
+                }
+            }
+            return 0;
+        }
+    }
+    PDU* pdu = this;
+    while (pdu) {
+        if (pdu->matches_flag(type)) {
+            return pdu;
+        }
+        pdu = pdu->inner_pdu();
+    }
+    return 0;
+}
+
+const PDU::layer_index& PDU::get_layer_index() {
+    #if TINS_IS_CXX11
+        layer_index* current = layer_index_.load(std::memory_order_acquire);
+    #else
+        layer_index* current = layer_index_;
+    #endif // TINS_IS_CXX11
+    if (current) {
+        return *current;
+    }
+    layer_index* index = new layer_index();
+    for (PDU* pdu = this; pdu; pdu = pdu->inner_pdu()) {
+        const uint32_t type = pdu->pdu_type();
+        // User defined PDUs could match any flag
+        if (type >= layer_index::MAX_INDEXED_TYPE ||
+            index->layers.size() == layer_index::MAX_INDEXED_DEPTH) {
+            index->complete = false;
+            index->layers.clear();
+            break;
+        }
+        const uint64_t mask = static_cast<uint64_t>(1) << type;
+        if ((index->present & mask) == 0) {
+            index->present |= mask;
+            index->first_depth[type] = static_cast<uint8_t>(index->layers.size());
+        }
+        index->layers.push_back(pdu);
+    }
+    #if TINS_IS_CXX11
+        // Several threads could be looking up PDUs in this same const PDU
+        if (!layer_index_.compare_exchange_strong(current, index,
+                                                  std::memory_order_acq_rel)) {
+            delete index;
+            return *current;
+        }
+    #else
+        layer_index_ = index;
+    #endif // TINS_IS_CXX11
+    return *index;
+}
+
+void PDU::invalidate_layer_index() {
+    // Only the outermost PDU holds an index, and it covers this one as well
+    PDU* pdu = this;
+    while (pdu->parent_pdu_) {
+        pdu = pdu->parent_pdu_;
+    }
+    #if TINS_IS_CXX11
+        delete pdu->layer_index_.exchange(0);
+    #else
+        delete pdu->layer_index_;
+        pdu->layer_index_ = 0;
+    #endif // TINS_IS_CXX11
+}
+
 } // Tins
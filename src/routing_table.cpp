@@ -0,0 +1,522 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <tins/routing_table.h>
+#include <tins/interface_cache.h>
+#include <tins/endianness.h>
+#include <tins/cxxstd.h>
+#ifdef __linux__
+    #include <sys/socket.h>
+    #include <unistd.h>
+    #include <errno.h>
+    #include <linux/netlink.h>
+    #include <linux/rtnetlink.h>
+#endif // __linux__
+#if TINS_IS_CXX11
+    #include <mutex>
+#endif // TINS_IS_CXX11
+
+using std::vector;
+using std::time;
+using std::lower_bound;
+using std::greater;
+
+namespace Tins {
+
+const unsigned RoutingTable::DEFAULT_MAX_AGE = 5;
+
+namespace {
+
+uint32_t ipv4_mask(int prefix_length) {
+    return prefix_length == 0 ? 0 : Endian::host_to_be<uint32_t>(0xffffffff << (32 - prefix_length));
+}
+
+int prefix_length(IPv4Address mask) {
+    uint32_t value = Endian::be_to_host<uint32_t>(mask);
+    int output = 0;
+    while (output < 32 && (value & 0x80000000) != 0) {
+        value <<= 1;
+        ++output;
+    }
+    return output;
+}
+
+int prefix_length(const IPv6Address& mask) {
+    int output = 0;
+    for (IPv6Address::const_iterator it = mask.begin(); it != mask.end(); ++it) {
+        uint8_t value = *it;
+        while ((value & 0x80) != 0) {
+            value <<= 1;
+            ++output;
+        }
+        if (value != 0 || *it != 0xff) {
+            break;
+        }
+    }
+    return output;
+}
+
+bool same_route(const Utils::RouteEntry& lhs, const Utils::RouteEntry& rhs) {
+    return lhs.destination == rhs.destination && lhs.mask == rhs.mask &&
+           lhs.gateway == rhs.gateway && lhs.interface == rhs.interface &&
+           lhs.metric == rhs.metric;
+}
+
+bool same_route(const Utils::Route6Entry& lhs, const Utils::Route6Entry& rhs) {
+    return lhs.destination == rhs.destination && lhs.mask == rhs.mask &&
+           lhs.gateway == rhs.gateway && lhs.interface == rhs.interface &&
+           lhs.metric == rhs.metric;
+}
+
+// Adds a route to the ones sharing its prefix, keeping them sorted by metric
+template <typename Routes, typename Entry>
+bool insert_route(Routes& routes, const Entry& entry) {
+    typename Routes::iterator it = routes.begin();
+    while (it != routes.end() && it->metric <= entry.metric) {
+        if (same_route(*it, entry)) {
+            return false;
+        }
+        ++it;
+    }
+    routes.insert(it, entry);
+    return true;
+}
+
+template <typename Routes, typename Entry>
+bool erase_route(Routes& routes, const Entry& entry) {
+    for (typename Routes::iterator it = routes.begin(); it != routes.end(); ++it) {
+        if (same_route(*it, entry)) {
+            routes.erase(it);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Keeps the prefix lengths in use sorted from longest to shortest
+void add_length(vector<int>& lengths, int length) {
+    vector<int>::iterator it = lower_bound(lengths.begin(), lengths.end(), length,
+                                           greater<int>());
+    if (it == lengths.end() || *it != length) {
+        lengths.insert(it, length);
+    }
+}
+
+void remove_length(vector<int>& lengths, int length) {
+    vector<int>::iterator it = lower_bound(lengths.begin(), lengths.end(), length,
+                                           greater<int>());
+    if (it != lengths.end() && *it == length) {
+        lengths.erase(it);
+    }
+}
+
+} // anonymous namespace
+
+RoutingTable::RoutingTable()
+: ipv4_size_(0), ipv6_size_(0), loaded_at_(0), max_age_(DEFAULT_MAX_AGE),
+  notifications_fd_(-1), loaded_(false) {
+
+}
+
+RoutingTable::~RoutingTable() {
+    close_notifications();
+}
+
+void RoutingTable::load() {
+    vector<Utils::RouteEntry> entries = Utils::route_entries();
+    vector<Utils::Route6Entry> entries6 = Utils::route6_entries();
+    clear();
+    for (size_t i = 0; i < entries.size(); ++i) {
+        add(entries[i]);
+    }
+    for (size_t i = 0; i < entries6.size(); ++i) {
+        add(entries6[i]);
+    }
+    loaded_at_ = time(0);
+    loaded_ = true;
+}
+
+void RoutingTable::sync() {
+    if (notifications_fd_ != -1) {
+        if (!process_notifications()) {
+            loaded_ = false;
+        }
+    }
+    if (notifications_fd_ == -1 && loaded_ && time(0) - loaded_at_ >= (std::time_t)max_age_) {
+        loaded_ = false;
+    }
+    if (!loaded_) {
+        load();
+    }
+}
+
+void RoutingTable::invalidate() {
+    loaded_ = false;
+}
+
+void RoutingTable::max_age(unsigned value) {
+    max_age_ = value;
+}
+
+unsigned RoutingTable::max_age() const {
+    return max_age_;
+}
+
+void RoutingTable::add(const Utils::RouteEntry& entry) {
+    const int length = prefix_length(entry.mask);
+    const uint32_t prefix = entry.destination & ipv4_mask(length);
+    if (insert_route(ipv4_prefixes_[length][prefix], entry)) {
+        add_length(ipv4_lengths_, length);
+        ++ipv4_size_;
+    }
+}
+
+void RoutingTable::add(const Utils::Route6Entry& entry) {
+    const int length = prefix_length(entry.mask);
+    const IPv6Address prefix = entry.destination & IPv6Address::from_prefix_length(length);
+    if (insert_route(ipv6_prefixes_[length][prefix], entry)) {
+        add_length(ipv6_lengths_, length);
+        ++ipv6_size_;
+    }
+}
+
+bool RoutingTable::remove(const Utils::RouteEntry& entry) {
+    const int length = prefix_length(entry.mask);
+    ipv4_prefix_map& prefixes = ipv4_prefixes_[length];
+    ipv4_prefix_map::iterator it = prefixes.find(entry.destination & ipv4_mask(length));
+    if (it == prefixes.end() || !erase_route(it->second, entry)) {
+        return false;
+    }
+    if (it->second.empty()) {
+        prefixes.erase(it);
+        if (prefixes.empty()) {
+            remove_length(ipv4_lengths_, length);
+        }
+    }
+    --ipv4_size_;
+    return true;
+}
+
+bool RoutingTable::remove(const Utils::Route6Entry& entry) {
+    const int length = prefix_length(entry.mask);
+    ipv6_prefix_map& prefixes = ipv6_prefixes_[length];
+    ipv6_prefix_map::iterator it = prefixes.find(
+        entry.destination & IPv6Address::from_prefix_length(length)
+    );
+    if (it == prefixes.end() || !erase_route(it->second, entry)) {
+        return false;
+    }
+    if (it->second.empty()) {
+        prefixes.erase(it);
+        if (prefixes.empty()) {
+            remove_length(ipv6_lengths_, length);
+        }
+    }
+    --ipv6_size_;
+    return true;
+}
+
+const Utils::RouteEntry* RoutingTable::find(IPv4Address addr) const {
+    const uint32_t addr_int = addr;
+    for (size_t i = 0; i < ipv4_lengths_.size(); ++i) {
+        const int length = ipv4_lengths_[i];
+        const ipv4_prefix_map& prefixes = ipv4_prefixes_[length];
+        ipv4_prefix_map::const_iterator it = prefixes.find(addr_int & ipv4_mask(length));
+        if (it != prefixes.end()) {
+            return &it->second.front();
+        }
+    }
+    return 0;
+}
+
+const Utils::Route6Entry* RoutingTable::find(const IPv6Address& addr) const {
+    for (size_t i = 0; i < ipv6_lengths_.size(); ++i) {
+        const int length = ipv6_lengths_[i];
+        const ipv6_prefix_map& prefixes = ipv6_prefixes_[length];
+        ipv6_prefix_map::const_iterator it = prefixes.find(
+            addr & IPv6Address::from_prefix_length(length)
+        );
+        if (it != prefixes.end()) {
+            return &it->second.front();
+        }
+    }
+    return 0;
+}
+
+size_t RoutingTable::ipv4_size() const {
+    return ipv4_size_;
+}
+
+size_t RoutingTable::ipv6_size() const {
+    return ipv6_size_;
+}
+
+void RoutingTable::clear() {
+    for (size_t i = 0; i < ipv4_lengths_.size(); ++i) {
+        ipv4_prefixes_[ipv4_lengths_[i]].clear();
+    }
+    for (size_t i = 0; i < ipv6_lengths_.size(); ++i) {
+        ipv6_prefixes_[ipv6_lengths_[i]].clear();
+    }
+    ipv4_lengths_.clear();
+    ipv6_lengths_.clear();
+    ipv4_size_ = 0;
+    ipv6_size_ = 0;
+}
+
+#ifdef __linux__
+
+bool RoutingTable::watch() {
+    if (notifications_fd_ != -1) {
+        return true;
+    }
+    int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC | SOCK_NONBLOCK, NETLINK_ROUTE);
+    if (fd == -1) {
+        return false;
+    }
+    sockaddr_nl addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = RTMGRP_IPV4_ROUTE | RTMGRP_IPV6_ROUTE;
+    if (bind(fd, (const sockaddr*)&addr, sizeof(addr)) == -1) {
+        ::close(fd);
+        return false;
+    }
+    notifications_fd_ = fd;
+    // Anything that changed before now is only seen by reloading the table
+    loaded_ = false;
+    return true;
+}
+
+void RoutingTable::close_notifications() {
+    if (notifications_fd_ != -1) {
+        ::close(notifications_fd_);
+        notifications_fd_ = -1;
+    }
+}
+
+namespace {
+
+void read_address(const uint8_t* data, IPv4Address& address) {
+    uint32_t value;
+    memcpy(&value, data, sizeof(value));
+    address = IPv4Address(value);
+}
+
+void read_address(const uint8_t* data, IPv6Address& address) {
+    address = IPv6Address(data);
+}
+
+// Parses a single RTM_NEWROUTE/RTM_DELROUTE message. Returns false if the
+// route's interface can't be found, in which case the table has to be reloaded.
+template <typename Entry, typename Address>
+bool parse_route_message(const nlmsghdr* header, Entry& entry) {
+    const rtmsg* message = (const rtmsg*)NLMSG_DATA(header);
+    int length = RTM_PAYLOAD(header);
+    entry.destination = Address();
+    entry.gateway = Address();
+    entry.mask = Address::from_prefix_length(message->rtm_dst_len);
+    entry.metric = 0;
+    entry.interface.clear();
+    for (const rtattr* attr = RTM_RTA(message); RTA_OK(attr, length);
+         attr = RTA_NEXT(attr, length)) {
+        const uint8_t* data = (const uint8_t*)RTA_DATA(attr);
+        switch (attr->rta_type) {
+            case RTA_DST:
+                if (RTA_PAYLOAD(attr) >= Address::address_size) {
+                    read_address(data, entry.destination);
+                }
+                break;
+            case RTA_GATEWAY:
+                if (RTA_PAYLOAD(attr) >= Address::address_size) {
+                    read_address(data, entry.gateway);
+                }
+                break;
+            case RTA_PRIORITY:
+                if (RTA_PAYLOAD(attr) >= sizeof(uint32_t)) {
+                    uint32_t metric;
+                    memcpy(&metric, data, sizeof(metric));
+                    entry.metric = metric;
+                }
+                break;
+            case RTA_OIF:
+                if (RTA_PAYLOAD(attr) >= sizeof(uint32_t)) {
+                    uint32_t index;
+                    InterfaceCache::entry_type iface;
+                    memcpy(&index, data, sizeof(index));
+                    if (!Utils::interface_cache().find(index, iface)) {
+                        return false;
+                    }
+                    entry.interface = iface.name;
+                }
+                break;
+        }
+    }
+    return !entry.interface.empty();
+}
+
+} // anonymous namespace
+
+bool RoutingTable::process_notifications() {
+    bool consistent = true;
+    // Large enough for the biggest notification the kernel sends
+    uint8_t buffer[8192];
+    while (true) {
+        ssize_t size = recv(notifications_fd_, buffer, sizeof(buffer), 0);
+        if (size < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return consistent;
+            }
+            if (errno == ENOBUFS) {
+                // Some notifications were dropped
+                consistent = false;
+                continue;
+            }
+            close_notifications();
+            return false;
+        }
+        int length = static_cast<int>(size);
+        for (const nlmsghdr* header = (const nlmsghdr*)buffer; NLMSG_OK(header, length);
+             header = NLMSG_NEXT(header, length)) {
+            if ((header->nlmsg_type != RTM_NEWROUTE && header->nlmsg_type != RTM_DELROUTE) ||
+                header->nlmsg_len < NLMSG_LENGTH(sizeof(rtmsg))) {
+                continue;
+            }
+            const rtmsg* message = (const rtmsg*)NLMSG_DATA(header);
+            const bool is_new = header->nlmsg_type == RTM_NEWROUTE;
+            if ((message->rtm_flags & RTM_F_CLONED) != 0) {
+                continue;
+            }
+            if (message->rtm_family == AF_INET) {
+                // The kernel only lists unicast routes in the main table
+                if (message->rtm_table != RT_TABLE_MAIN || message->rtm_type != RTN_UNICAST) {
+                    continue;
+                }
+                Utils::RouteEntry entry;
+                if (!parse_route_message<Utils::RouteEntry, IPv4Address>(header, entry)) {
+                    consistent = false;
+                }
+                else if (is_new) {
+                    add(entry);
+                }
+                else {
+                    remove(entry);
+                }
+            }
+            else if (message->rtm_family == AF_INET6) {
+                Utils::Route6Entry entry;
+                if (!parse_route_message<Utils::Route6Entry, IPv6Address>(header, entry)) {
+                    consistent = false;
+                }
+                else if (is_new) {
+                    add(entry);
+                }
+                else {
+                    remove(entry);
+                }
+            }
+        }
+    }
+}
+
+#else
+
+bool RoutingTable::watch() {
+    return false;
+}
+
+void RoutingTable::close_notifications() {
+
+}
+
+bool RoutingTable::process_notifications() {
+    return true;
+}
+
+#endif // __linux__
+
+namespace Utils {
+
+namespace {
+
+#if TINS_IS_CXX11
+std::mutex system_table_mutex;
+#endif // TINS_IS_CXX11
+
+RoutingTable& system_table() {
+    static RoutingTable table;
+    static bool watching = table.watch();
+    (void)watching;
+    return table;
+}
+
+} // anonymous namespace
+
+bool route_from_ip(IPv4Address ip, RouteEntry& route) {
+    #if TINS_IS_CXX11
+    std::lock_guard<std::mutex> lock(system_table_mutex);
+    #endif // TINS_IS_CXX11
+    RoutingTable& table = system_table();
+    table.sync();
+    const RouteEntry* entry = table.find(ip);
+    if (!entry) {
+        return false;
+    }
+    route = *entry;
+    return true;
+}
+
+bool route_from_ip(const IPv6Address& ip, Route6Entry& route) {
+    #if TINS_IS_CXX11
+    std::lock_guard<std::mutex> lock(system_table_mutex);
+    #endif // TINS_IS_CXX11
+    RoutingTable& table = system_table();
+    table.sync();
+    const Route6Entry* entry = table.find(ip);
+    if (!entry) {
+        return false;
+    }
+    route = *entry;
+    return true;
+}
+
+void invalidate_route_cache() {
+    #if TINS_IS_CXX11
+    std::lock_guard<std::mutex> lock(system_table_mutex);
+    #endif // TINS_IS_CXX11
+    system_table().invalidate();
+}
+
+} // Utils
+} // Tins
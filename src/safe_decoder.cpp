@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <algorithm>
+#include <tins/safe_decoder.h>
+#include <tins/exceptions.h>
+
+namespace Tins {
+
+SafeDecoder::SafeDecoder() {
+    reset_counters();
+}
+
+SafeDecoder::Status SafeDecoder::decode(PDU::PDUType type, factory_type factory,
+                                        const uint8_t* buffer, uint32_t total_sz,
+                                        PDU*& output) {
+    Internals::decode_context context(malformed_layers_);
+    output = 0;
+    if (Internals::header_fits(type, buffer, total_sz)) {
+        try {
+            output = factory(buffer, total_sz);
+        }
+        catch (const malformed_packet&) {
+        }
+    }
+    Status status;
+    if (!output) {
+        context.layer_failed(type);
+        status = NOT_DECODED;
+    }
+    else {
+        status = context.failed_layers() > 0 ? PARTIALLY_DECODED : DECODED;
+    }
+    packet_counts_[status]++;
+    return status;
+}
+
+uint64_t SafeDecoder::packet_count(Status status) const {
+    return packet_counts_[status];
+}
+
+uint64_t SafeDecoder::malformed_count(PDU::PDUType type) const {
+    const counters_type::const_iterator iter = malformed_layers_.find(type);
+    return iter != malformed_layers_.end() ? iter->second : 0;
+}
+
+const SafeDecoder::counters_type& SafeDecoder::malformed_layers() const {
+    return malformed_layers_;
+}
+
+void SafeDecoder::reset_counters() {
+    malformed_layers_.clear();
+    std::fill(packet_counts_, packet_counts_ + NOT_DECODED + 1, 0);
+}
+
+} // Tins
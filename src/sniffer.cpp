@@ -45,14 +45,18 @@
 #include <tins/ppi.h>
 #include <tins/ip.h>
 #include <tins/ipv6.h>
+#include <tins/safe_decoder.h>
 #include <tins/detail/pdu_helpers.h>
+#ifdef TINS_HAVE_TCPIP
+    #include <tins/tcp_ip/flow_bypass_table.h>
+#endif // TINS_HAVE_TCPIP
 
 using std::string;
 
 namespace Tins {
 
 BaseSniffer::BaseSniffer() 
-: handle_(0), mask_(0), extract_raw_(false) {
+: handle_(0), mask_(0), extract_raw_(false), bypass_table_(0), decoder_(0) {
     
 }
     
@@ -86,12 +90,42 @@ struct sniff_data {
     struct timeval tv;
     PDU* pdu;
     bool packet_processed;
-
-sniff_data() : tv(), pdu(0), packet_processed(true) { }
+    #ifdef TINS_HAVE_TCPIP
+    TCPIP::FlowBypassTable* bypass_table;
+    #endif // TINS_HAVE_TCPIP
+    PDU::PDUType link_layer;
+    SafeDecoder* decoder;
+
+sniff_data() 
+: tv(), pdu(0), packet_processed(true), 
+  #ifdef TINS_HAVE_TCPIP
+  bypass_table(0), 
+  #endif // TINS_HAVE_TCPIP
+  link_layer(PDU::UNKNOWN), decoder(0) { }
 };
 
+// Marks the packet as processed and returns true if it has to be skipped
+bool start_processing(sniff_data* data, const struct pcap_pkthdr* h, const u_char* bytes) {
+    data->packet_processed = true;
+    data->tv = h->ts;
+    #ifdef TINS_HAVE_TCPIP
+    if (data->bypass_table) {
+        return data->bypass_table->should_bypass((const uint8_t*)bytes, h->caplen,
+                                                 data->link_layer);
+    }
+    #else
+    (void)bytes;
+    #endif // TINS_HAVE_TCPIP
+    return false;
+}
+
 template<typename T>
-T* safe_alloc(const u_char* bytes, bpf_u_int32 len) {
+T* safe_alloc(const u_char* bytes, bpf_u_int32 len, SafeDecoder* decoder) {
+    if (decoder) {
+        T* output;
+        decoder->decode((const uint8_t*)bytes, len, output);
+        return output;
+    }
     try {
         return new T((const uint8_t*)bytes, len);
     }
@@ -103,20 +137,22 @@ T* safe_alloc(const u_char* bytes, bpf_u_int32 len) {
 template<typename T>
 void sniff_loop_handler(u_char* user, const struct pcap_pkthdr* h, const u_char* bytes) {
     sniff_data* data = (sniff_data*)user;
-    data->packet_processed = true;
-    data->tv = h->ts;
-    data->pdu = safe_alloc<T>(bytes, h->caplen);
+    if (start_processing(data, h, bytes)) {
+        return;
+    }
+    data->pdu = safe_alloc<T>(bytes, h->caplen, data->decoder);
 }
 
 void sniff_loop_eth_handler(u_char* user, const struct pcap_pkthdr* h, const u_char* bytes) {
     sniff_data* data = (sniff_data*)user;
-    data->packet_processed = true;
-    data->tv = h->ts;
+    if (start_processing(data, h, bytes)) {
+        return;
+    }
     if (Internals::is_dot3((const uint8_t*)bytes, h->caplen)) {
-        data->pdu = safe_alloc<Dot3>((const uint8_t*)bytes, h->caplen);
+        data->pdu = safe_alloc<Dot3>(bytes, h->caplen, data->decoder);
     }
     else {
-        data->pdu = safe_alloc<EthernetII>((const uint8_t*)bytes, h->caplen);
+        data->pdu = safe_alloc<EthernetII>(bytes, h->caplen, data->decoder);
     }
 }
 
@@ -134,23 +170,32 @@ void sniff_loop_raw_handler(u_char* user, const struct pcap_pkthdr* h, const u_c
 
     sniff_data* data = (sniff_data*)user;
     const base_ip_header* header = (const base_ip_header*)bytes;
-    data->packet_processed = true;
-    data->tv = h->ts;
+    if (start_processing(data, h, bytes)) {
+        return;
+    }
     switch (header->version) {
         case 4:
-            data->pdu = safe_alloc<IP>((const uint8_t*)bytes, h->caplen);
+            data->pdu = safe_alloc<IP>(bytes, h->caplen, data->decoder);
             break;
         case 6:
-            data->pdu = safe_alloc<IPv6>((const uint8_t*)bytes, h->caplen);
+            data->pdu = safe_alloc<IPv6>(bytes, h->caplen, data->decoder);
             break;
     };
 }
 
 #ifdef TINS_HAVE_DOT11
+PDU* dot11_from_bytes(const uint8_t* buffer, uint32_t total_sz) {
+    return Dot11::from_bytes(buffer, total_sz);
+}
+
 void sniff_loop_dot11_handler(u_char* user, const struct pcap_pkthdr* h, const u_char* bytes) {
     sniff_data* data = (sniff_data*)user;
     data->packet_processed = true;
     data->tv = h->ts;
+    if (data->decoder) {
+        data->decoder->decode(PDU::DOT11, &dot11_from_bytes, bytes, h->caplen, data->pdu);
+        return;
+    }
     try {
         data->pdu = Dot11::from_bytes(bytes, h->caplen);
     }
@@ -209,6 +254,26 @@ PtrPacket BaseSniffer::next_packet() {
                 throw unknown_link_type();
         }
     }
+    #ifdef TINS_HAVE_TCPIP
+    if (bypass_table_) {
+        data.bypass_table = bypass_table_;
+        switch (iface_type) {
+            case DLT_EN10MB:
+                data.link_layer = PDU::ETHERNET_II;
+                break;
+            case DLT_NULL:
+                data.link_layer = PDU::LOOPBACK;
+                break;
+            case DLT_LINUX_SLL:
+                data.link_layer = PDU::SLL;
+                break;
+            case DLT_RAW:
+                data.link_layer = PDU::IP;
+                break;
+        };
+    }
+    #endif // TINS_HAVE_TCPIP
+    data.decoder = decoder_;
     // keep calling pcap_loop until a well-formed packet is found.
     while (data.pdu == 0 && data.packet_processed) {
         data.packet_processed = false;
@@ -230,6 +295,16 @@ void BaseSniffer::set_pcap_sniffing_method(PcapSniffingMethod method) {
     pcap_sniffing_method_ = method;
 }
 
+#ifdef TINS_HAVE_TCPIP
+void BaseSniffer::set_flow_bypass_table(TCPIP::FlowBypassTable* table) {
+    bypass_table_ = table;
+}
+#endif // TINS_HAVE_TCPIP
+
+void BaseSniffer::set_safe_decoder(SafeDecoder* decoder) {
+    decoder_ = decoder;
+}
+
 void BaseSniffer::stop_sniff() {
     pcap_breakloop(handle_);
 }
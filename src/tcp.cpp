@@ -73,49 +73,10 @@ TCP::TCP(const uint8_t* buffer, uint32_t total_sz) {
     }
     const uint8_t* header_end = buffer + (data_offset() * sizeof(uint32_t));
 
-    if (stream.pointer() < header_end) {
-        // Estimate about 4 bytes per option and reserver that so we avoid doing 
-        // multiple reallocations on the vector
-        options_.reserve((header_end - stream.pointer()) / sizeof(uint32_t));
-    }
-
-    while (stream.pointer() < header_end) {
-        const OptionTypes option_type = (OptionTypes)stream.read<uint8_t>();
-        if (option_type == EOL) {
-            stream.skip(header_end - stream.pointer());
-            break;
-        }
-        else if (option_type == NOP) {
-            #if TINS_IS_CXX11
-            add_option(option_type, 0);
-            #else
-            add_option(option(option_type, 0));
-            #endif // TINS_IS_CXX11
-        }
-        else {
-            // Extract the length
-            uint32_t len = stream.read<uint8_t>();
-            const uint8_t* data_start = stream.pointer();
-
-            // We need to subtract the option type and length from the size
-            if (TINS_UNLIKELY(len < sizeof(uint8_t) << 1)) {
-                throw malformed_packet();
-            }
-            len -= (sizeof(uint8_t) << 1);
-            // Make sure we have enough bytes for the advertised option payload length
-            if (TINS_UNLIKELY(data_start + len > header_end)) {
-                throw malformed_packet(); 
-            }
-            // If we're using C++11, use the variadic template overload
-            #if TINS_IS_CXX11
-            add_option(option_type, data_start, data_start + len);
-            #else
-            add_option(option(option_type, data_start, data_start + len));
-            #endif // TINS_IS_CXX11
-            // Skip the option's payload
-            stream.skip(len);
-        }
-    }
+    // Options are only parsed when they're needed
+    Internals::validate_options(Internals::TCP_OPTION_LAYOUT, stream.pointer(), header_end);
+    options_.assign(stream.pointer(), header_end);
+    stream.skip(header_end - stream.pointer());
     // If we still have any bytes left
     if (stream) {
         inner_pdu(new RawPDU(stream.pointer(), stream.size()));
@@ -176,7 +137,8 @@ void TCP::sack_permitted() {
 }
 
 bool TCP::has_sack_permitted() const {
-    return search_option(SACK_OK) != NULL;
+    option storage;
+    return options_.search(SACK_OK, storage) != NULL;
 }
 
 void TCP::sack(const sack_type& edges) {
@@ -191,7 +153,8 @@ void TCP::sack(const sack_type& edges) {
 }
 
 TCP::sack_type TCP::sack() const {
-    const option* opt = search_option(SACK);
+    option storage;
+    const option* opt = options_.search(SACK, storage);
     if (!opt) {
         throw option_not_found();
     }
@@ -205,7 +168,8 @@ void TCP::timestamp(uint32_t value, uint32_t reply) {
 }
 
 pair<uint32_t, uint32_t> TCP::timestamp() const {
-    const option* opt = search_option(TSOPT);
+    option storage;
+    const option* opt = options_.search(TSOPT, storage);
     if (!opt) {
         throw option_not_found();
     }
@@ -292,7 +256,7 @@ void TCP::flags(small_uint<12> value) {
 }
 
 void TCP::add_option(const option& opt) {
-    options_.push_back(opt);
+    options_.get_mutable().push_back(opt);
 }
 
 uint32_t TCP::header_size() const {
@@ -307,7 +271,8 @@ void TCP::write_serialization(uint8_t* buffer, uint32_t total_sz) {
     checksum(0);
     header_.doff = (sizeof(tcp_header) + total_options_size) / sizeof(uint32_t);
     stream.write(header_);
-    for (options_type::const_iterator it = options_.begin(); it != options_.end(); ++it) {
+    const options_type& options = options_.get();
+    for (options_type::const_iterator it = options.begin(); it != options.end(); ++it) {
         write_option(*it, stream);
     }
 
@@ -348,15 +313,15 @@ void TCP::write_serialization(uint8_t* buffer, uint32_t total_sz) {
 const TCP::option* TCP::search_option(OptionTypes type) const {
     // Search for the iterator. If we found something, return it, otherwise return nullptr.
     options_type::const_iterator iter = search_option_iterator(type);
-    return (iter != options_.end()) ? &*iter : 0;
+    return (iter != options_.get().end()) ? &*iter : 0;
 }
 
 TCP::options_type::const_iterator TCP::search_option_iterator(OptionTypes type) const {
-    return Internals::find_option_const<option>(options_, type);
+    return Internals::find_option_const<option>(options_.get(), type);
 }
 
 TCP::options_type::iterator TCP::search_option_iterator(OptionTypes type) {
-    return Internals::find_option<option>(options_, type);
+    return Internals::find_option<option>(options_.get_mutable(), type);
 }
 
 /* options */
@@ -378,7 +343,8 @@ void TCP::write_option(const option& opt, OutputMemoryStream& stream) {
 
 uint32_t TCP::calculate_options_size() const {
     uint32_t options_size = 0;
-    for (options_type::const_iterator iter = options_.begin(); iter != options_.end(); ++iter) {
+    const options_type& options = options_.get();
+    for (options_type::const_iterator iter = options.begin(); iter != options.end(); ++iter) {
         const option& opt = *iter;
         options_size += sizeof(uint8_t);
         // SACK_OK contains length but not data
@@ -397,10 +363,11 @@ uint32_t TCP::pad_options_size(uint32_t size) const {
 
 bool TCP::remove_option(OptionTypes type) {
     options_type::iterator iter = search_option_iterator(type);
-    if (iter == options_.end()) {
+    options_type& options = options_.get_mutable();
+    if (iter == options.end()) {
         return false;
     }
-    options_.erase(iter);
+    options.erase(iter);
     return true;
 }
 
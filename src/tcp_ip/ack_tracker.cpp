@@ -32,36 +32,52 @@
 #ifdef TINS_HAVE_ACK_TRACKER
 
 #include <limits>
+#include <algorithm>
 #include <tins/tcp.h>
+#include <tins/memory_helpers.h>
 #include <tins/detail/sequence_number_helpers.h>
 
 using std::vector;
 using std::numeric_limits;
+using std::copy;
 
-using boost::icl::interval_bounds;
-using boost::icl::contains;
-
+using Tins::Memory::InputMemoryStream;
+using Tins::Memory::OutputBufferStream;
 using Tins::Internals::seq_compare;
 
 namespace Tins {
 namespace TCPIP {
 
-uint32_t interval_start(const AckedRange::interval_type& interval) {
-    if (interval.bounds() == interval_bounds::left_open()) {
-        return interval.lower() + 1;
-    }
-    else {
-        return interval.lower();
-    }
+// SequenceInterval
+
+SequenceInterval::SequenceInterval()
+: first_(0), last_(0) {
+
 }
 
-uint32_t interval_end(const AckedRange::interval_type& interval) {
-    if (interval.bounds() == interval_bounds::right_open()) {
-        return interval.upper() - 1;
-    }
-    else {
-        return interval.upper();
-    }
+SequenceInterval::SequenceInterval(uint32_t first, uint32_t last)
+: first_(first), last_(last) {
+
+}
+
+uint32_t SequenceInterval::first() const {
+    return first_;
+}
+
+uint32_t SequenceInterval::last() const {
+    return last_;
+}
+
+uint32_t SequenceInterval::size() const {
+    return last_ - first_ + 1;
+}
+
+bool SequenceInterval::operator==(const SequenceInterval& rhs) const {
+    return first_ == rhs.first_ && last_ == rhs.last_;
+}
+
+bool SequenceInterval::operator!=(const SequenceInterval& rhs) const {
+    return !(*this == rhs);
 }
 
 // AckedRange
@@ -76,12 +92,12 @@ AckedRange::interval_type AckedRange::next() {
     // Regular case
     if (first_ <= last_) {
         first_ = last_ + 1;
-        return interval_type::closed(interval_first, last_);
+        return interval_type(interval_first, last_);
     }
     else {
         // Range wraps around 
         first_ = 0;
-        return interval_type::closed(interval_first, numeric_limits<uint32_t>::max());
+        return interval_type(interval_first, numeric_limits<uint32_t>::max());
     }
 }
 
@@ -97,6 +113,144 @@ uint32_t AckedRange::last() const {
     return last_;
 }
 
+// SackIntervalSet
+
+const size_t SackIntervalSet::INLINE_CAPACITY;
+
+SackIntervalSet::SackIntervalSet()
+: inline_size_(0) {
+
+}
+
+void SackIntervalSet::insert(const value_type& interval) {
+    const value_type* data = intervals();
+    const size_t count = iterative_size();
+    size_t index = 0;
+    // Skip the intervals that end before this one starts and are not adjacent to it
+    while (index < count && seq_compare(data[index].last() + 1, interval.first()) < 0) {
+        ++index;
+    }
+    // Now merge every interval that overlaps or is adjacent to this one
+    uint32_t first = interval.first();
+    uint32_t last = interval.last();
+    size_t end_index = index;
+    while (end_index < count && seq_compare(data[end_index].first(), last + 1) <= 0) {
+        if (seq_compare(data[end_index].first(), first) < 0) {
+            first = data[end_index].first();
+        }
+        if (seq_compare(data[end_index].last(), last) > 0) {
+            last = data[end_index].last();
+        }
+        ++end_index;
+    }
+    const value_type merged(first, last);
+    replace(index, end_index - index, &merged, 1);
+}
+
+void SackIntervalSet::erase(const value_type& interval) {
+    const value_type* data = intervals();
+    const size_t count = iterative_size();
+    size_t index = 0;
+    // Skip the intervals that end before this one starts
+    while (index < count && seq_compare(data[index].last(), interval.first()) < 0) {
+        ++index;
+    }
+    size_t end_index = index;
+    while (end_index < count && seq_compare(data[end_index].first(), interval.last()) <= 0) {
+        ++end_index;
+    }
+    if (index == end_index) {
+        return;
+    }
+    // Keep whatever part of the first and last overlapping intervals lies
+    // outside of the erased one
+    value_type remaining[2];
+    size_t remaining_count = 0;
+    if (seq_compare(data[index].first(), interval.first()) < 0) {
+        remaining[remaining_count++] = value_type(data[index].first(), interval.first() - 1);
+    }
+    if (seq_compare(data[end_index - 1].last(), interval.last()) > 0) {
+        remaining[remaining_count++] = value_type(interval.last() + 1,
+                                                  data[end_index - 1].last());
+    }
+    replace(index, end_index - index, remaining, remaining_count);
+}
+
+void SackIntervalSet::clear() {
+    heap_intervals_.clear();
+    inline_size_ = 0;
+}
+
+bool SackIntervalSet::contains(const value_type& interval) const {
+    for (const_iterator iter = begin(); iter != end(); ++iter) {
+        // Intervals are merged, so only the one containing the first sequence
+        // number can contain the whole interval
+        if (seq_compare(iter->first(), interval.first()) <= 0 &&
+            seq_compare(interval.first(), iter->last()) <= 0) {
+            return seq_compare(interval.last(), iter->last()) <= 0;
+        }
+    }
+    return false;
+}
+
+bool SackIntervalSet::empty() const {
+    return iterative_size() == 0;
+}
+
+size_t SackIntervalSet::size() const {
+    size_t output = 0;
+    for (const_iterator iter = begin(); iter != end(); ++iter) {
+        output += iter->size();
+    }
+    return output;
+}
+
+size_t SackIntervalSet::iterative_size() const {
+    return is_inline() ? inline_size_ : heap_intervals_.size();
+}
+
+SackIntervalSet::const_iterator SackIntervalSet::begin() const {
+    return intervals();
+}
+
+SackIntervalSet::const_iterator SackIntervalSet::end() const {
+    return intervals() + iterative_size();
+}
+
+bool SackIntervalSet::is_inline() const {
+    return heap_intervals_.empty();
+}
+
+SackIntervalSet::value_type* SackIntervalSet::intervals() {
+    return is_inline() ? inline_intervals_ : &heap_intervals_[0];
+}
+
+const SackIntervalSet::value_type* SackIntervalSet::intervals() const {
+    return is_inline() ? inline_intervals_ : &heap_intervals_[0];
+}
+
+void SackIntervalSet::replace(size_t index, size_t count, const value_type* values,
+                              size_t values_count) {
+    if (is_inline()) {
+        const size_t new_size = inline_size_ - count + values_count;
+        if (new_size <= INLINE_CAPACITY) {
+            value_type tail[INLINE_CAPACITY];
+            const size_t tail_size = inline_size_ - index - count;
+            copy(inline_intervals_ + index + count, inline_intervals_ + inline_size_, tail);
+            copy(values, values + values_count, inline_intervals_ + index);
+            copy(tail, tail + tail_size, inline_intervals_ + index + values_count);
+            inline_size_ = new_size;
+            return;
+        }
+        // We ran out of inline space, move everything to the heap
+        heap_intervals_.assign(inline_intervals_, inline_intervals_ + inline_size_);
+        inline_size_ = 0;
+    }
+    heap_intervals_.erase(heap_intervals_.begin() + index,
+                          heap_intervals_.begin() + index + count);
+    heap_intervals_.insert(heap_intervals_.begin() + index, values, values + values_count);
+}
+
 // AckTracker
 
 AckTracker::AckTracker()
@@ -131,22 +285,19 @@ void AckTracker::process_sack(const vector<uint32_t>& sack) {
     for (size_t i = 1; i < sack.size(); i += 2) {
         // Left edge must be lower than right edge
         if (seq_compare(sack[i - 1], sack[i]) < 0) {
-            AckedRange range(sack[i - 1], sack[i] - 1);
-            // If this range ends after our current ack number
-            if (seq_compare(range.last(), ack_number_) > 0) {
-                while (range.has_next()) {
-                    AckedRange::interval_type next = range.next();
-                    uint32_t start = interval_start(next);
-                    if (seq_compare(start, ack_number_) <= 0) {
-                        // If this interval starts before or at our ACK number
-                        // then we need to update our ACK number to the end of 
-                        // this interval
-                        ack_number_ = interval_end(next);
-                    }
-                    else {
-                        // Otherwise, push the interval into the ACK set
-                        acked_intervals_.insert(next);
-                    }
+            const SequenceInterval interval(sack[i - 1], sack[i] - 1);
+            // If this interval ends after our current ack number
+            if (seq_compare(interval.last(), ack_number_) > 0) {
+                if (seq_compare(interval.first(), ack_number_) <= 0) {
+                    // If this interval starts before or at our ACK number
+                    // then we need to update our ACK number to the end of 
+                    // this interval
+                    cleanup_sacked_intervals(ack_number_, interval.last());
+                    ack_number_ = interval.last();
+                }
+                else {
+                    // Otherwise, push the interval into the ACK set
+                    acked_intervals_.insert(interval);
                 }
             }
         }
@@ -154,10 +305,7 @@ void AckTracker::process_sack(const vector<uint32_t>& sack) {
 }
 
 void AckTracker::cleanup_sacked_intervals(uint32_t old_ack, uint32_t new_ack) {
-    AckedRange range(old_ack, new_ack);
-    while (range.has_next()) {
-        acked_intervals_.erase(range.next());
-    }
+    acked_intervals_.erase(SequenceInterval(old_ack, new_ack));
 }
 
 void AckTracker::use_sack() {
@@ -176,16 +324,35 @@ bool AckTracker::is_segment_acked(uint32_t sequence_number, uint32_t length) con
     if (length == 0) {
         return true;
     }
-    AckedRange range(sequence_number, sequence_number + length - 1);
-    while (range.has_next()) {
-        AckedRange::interval_type interval = range.next();
-        const int comparison = seq_compare(interval_end(interval), ack_number_);
-        // Only check for SACKed intervals if the segment finishes after our ACK number
-        if (comparison >= 0 && !contains(acked_intervals_, interval)) {
-            return false;
-        }
+    const SequenceInterval segment(sequence_number, sequence_number + length - 1);
+    // Only check for SACKed intervals if the segment finishes after our ACK number
+    if (seq_compare(segment.last(), ack_number_) < 0) {
+        return true;
+    }
+    return acked_intervals_.contains(segment);
+}
+
+void AckTracker::serialize_state(OutputBufferStream& output) const {
+    output.write_le(ack_number_);
+    output.write<uint8_t>(use_sack_);
+    output.write_le<uint32_t>(acked_intervals_.iterative_size());
+    for (interval_set_type::const_iterator iter = acked_intervals_.begin(); 
+         iter != acked_intervals_.end(); ++iter) {
+        output.write_le(iter->first());
+        output.write_le(iter->last());
+    }
+}
+
+void AckTracker::restore_state(InputMemoryStream& input) {
+    ack_number_ = input.read_le<uint32_t>();
+    use_sack_ = input.read<uint8_t>() != 0;
+    acked_intervals_.clear();
+    const uint32_t interval_count = input.read_le<uint32_t>();
+    for (uint32_t i = 0; i < interval_count; ++i) {
+        const uint32_t first = input.read_le<uint32_t>();
+        const uint32_t last = input.read_le<uint32_t>();
+        acked_intervals_.insert(SequenceInterval(first, last));
     }
-    return true;
 }
 
 } // TCPIP
@@ -31,22 +31,33 @@
 
 #ifdef TINS_HAVE_TCPIP
 
+#include <algorithm>
+#include <tins/tcp_ip/spill_file.h>
 #include <tins/detail/sequence_number_helpers.h>
+#include <tins/exceptions.h>
+#include <tins/memory_helpers.h>
 
 using std::move;
+using std::vector;
+using std::sort;
+using std::make_shared;
+using std::make_pair;
 
+using Tins::Memory::InputMemoryStream;
+using Tins::Memory::OutputBufferStream;
 using Tins::Internals::seq_compare;
 
 namespace Tins {
 namespace TCPIP {
 
 DataTracker::DataTracker() 
-: seq_number_(0), total_buffered_bytes_(0) {
+: seq_number_(0), total_buffered_bytes_(0), spill_threshold_(0), total_spilled_bytes_(0) {
 
 }
 
 DataTracker::DataTracker(uint32_t seq_number)
-: seq_number_(seq_number), total_buffered_bytes_(0) {
+: seq_number_(seq_number), total_buffered_bytes_(0), spill_threshold_(0),
+  total_spilled_bytes_(0) {
 
 }
 
@@ -65,9 +76,23 @@ bool DataTracker::process_payload(uint32_t seq, payload_type payload) {
         );
         seq = seq_number_;
     }
-    bool added_some = false;
     // Store this payload
     store_payload(seq, move(payload));
+    bool added_some = consume_buffered_payload();
+    // Bring back any spilled chunks we've reached and process them as well
+    while (read_spilled_payload()) {
+        if (consume_buffered_payload()) {
+            added_some = true;
+        }
+    }
+    if (spill_threshold_ > 0 && total_buffered_bytes_ > spill_threshold_) {
+        spill_payload();
+    }
+    return added_some;
+}
+
+bool DataTracker::consume_buffered_payload() {
+    bool added_some = false;
     // Keep looping while the fragments seq is lower or equal to our seq
     buffered_payload_type::iterator iter = buffered_payload_.find(seq_number_);
     while (iter != buffered_payload_.end() && seq_compare(iter->first, seq_number_) <= 0) {
@@ -121,6 +146,15 @@ void DataTracker::advance_sequence(uint32_t seq) {
             it++;
         }
     }
+    for (auto it = spilled_payload_.begin(); it != spilled_payload_.end();) {
+        if (seq_compare(it->first, seq) <= 0) {
+            total_spilled_bytes_ -= it->second.size;
+            it = spilled_payload_.erase(it);
+        } else {
+            it++;
+        }
+    }
+    clear_spill_file();
 
     seq_number_ = seq;
 }
@@ -153,6 +187,30 @@ uint32_t DataTracker::total_buffered_bytes() const {
     return total_buffered_bytes_;
 }
 
+void DataTracker::enable_spilling(uint32_t memory_threshold, uint64_t max_spilled_bytes) {
+    #ifndef _WIN32
+    // Keep using the current file if there's any data in it
+    if (spilled_payload_.empty()) {
+        spill_file_ = make_shared<SpillFile>(max_spilled_bytes);
+    }
+    spill_threshold_ = memory_threshold;
+    #else
+    throw feature_disabled();
+    #endif // _WIN32
+}
+
+bool DataTracker::spilling_enabled() const {
+    return spill_threshold_ > 0;
+}
+
+uint64_t DataTracker::total_spilled_bytes() const {
+    return total_spilled_bytes_;
+}
+
+size_t DataTracker::spilled_chunks() const {
+    return spilled_payload_.size();
+}
+
 void DataTracker::store_payload(uint32_t seq, payload_type payload) {
     buffered_payload_type::iterator iter = buffered_payload_.find(seq);
     // New segment, store it
@@ -181,6 +239,143 @@ DataTracker::erase_iterator(buffered_payload_type::iterator iter) {
     return output;
 }
 
+void DataTracker::serialize_state(OutputBufferStream& output) const {
+    output.write_le(seq_number_);
+    output.write_le(spill_threshold_);
+    output.write_le<uint64_t>(spill_file_ ? spill_file_->max_size() : 0);
+    output.write_le<uint32_t>(payload_.size());
+    output.write(payload_.begin(), payload_.end());
+    output.write_le<uint32_t>(buffered_payload_.size() + spilled_payload_.size());
+    for (buffered_payload_type::const_iterator iter = buffered_payload_.begin();
+         iter != buffered_payload_.end(); ++iter) {
+        output.write_le(iter->first);
+        output.write_le<uint32_t>(iter->second.size());
+        output.write(iter->second.begin(), iter->second.end());
+    }
+    payload_type chunk;
+    for (spilled_payload_type::const_iterator iter = spilled_payload_.begin();
+         iter != spilled_payload_.end(); ++iter) {
+        chunk.resize(iter->second.size);
+        if (!chunk.empty()) {
+            spill_file_->read(iter->second.offset, chunk.size(), &chunk[0]);
+        }
+        output.write_le(iter->first);
+        output.write_le<uint32_t>(chunk.size());
+        output.write(chunk.begin(), chunk.end());
+    }
+}
+
+void DataTracker::restore_state(InputMemoryStream& input) {
+    seq_number_ = input.read_le<uint32_t>();
+    const uint32_t spill_threshold = input.read_le<uint32_t>();
+    const uint64_t max_spilled_bytes = input.read_le<uint64_t>();
+    input.read(payload_, input.read_le<uint32_t>());
+    buffered_payload_.clear();
+    spilled_payload_.clear();
+    spill_file_.reset();
+    total_buffered_bytes_ = 0;
+    total_spilled_bytes_ = 0;
+    spill_threshold_ = 0;
+    if (spill_threshold > 0) {
+        enable_spilling(spill_threshold, max_spilled_bytes);
+    }
+    const uint32_t chunk_count = input.read_le<uint32_t>();
+    for (uint32_t i = 0; i < chunk_count; ++i) {
+        const uint32_t seq = input.read_le<uint32_t>();
+        payload_type chunk;
+        input.read(chunk, input.read_le<uint32_t>());
+        store_payload(seq, move(chunk));
+    }
+    if (spill_threshold_ > 0 && total_buffered_bytes_ > spill_threshold_) {
+        spill_payload();
+    }
+}
+
+void DataTracker::spill_payload() {
+    // Spill the chunks that are the furthest away from our sequence number first, 
+    // as those are the ones that will take the longest to be used
+    vector<uint32_t> sequence_numbers;
+    sequence_numbers.reserve(buffered_payload_.size());
+    for (buffered_payload_type::const_iterator iter = buffered_payload_.begin();
+         iter != buffered_payload_.end(); ++iter) {
+        sequence_numbers.push_back(iter->first);
+    }
+    const uint32_t current_seq = seq_number_;
+    sort(sequence_numbers.begin(), sequence_numbers.end(),
+         [&](uint32_t lhs, uint32_t rhs) {
+            return lhs - current_seq > rhs - current_seq;
+         });
+    // Free up to half the threshold so we don't spill on every new chunk
+    const uint32_t target = spill_threshold_ / 2;
+    for (size_t i = 0; i < sequence_numbers.size() && total_buffered_bytes_ > target; ++i) {
+        buffered_payload_type::iterator iter = buffered_payload_.find(sequence_numbers[i]);
+        const payload_type& payload = iter->second;
+        // Keep it in memory if it overlaps something we already spilled
+        if (spilled_payload_.count(iter->first)) {
+            continue;
+        }
+        uint64_t offset = 0;
+        if (!payload.empty() && !spill_file_->write(&payload[0], payload.size(), offset)) {
+            // The file is full or can't be written. Keep the rest in memory
+            break;
+        }
+        spilled_payload_.insert(make_pair(iter->first, spilled_chunk(offset, payload.size())));
+        total_spilled_bytes_ += payload.size();
+        total_buffered_bytes_ -= payload.size();
+        buffered_payload_.erase(iter);
+    }
+}
+
+bool DataTracker::read_spilled_payload() {
+    if (spilled_payload_.empty()) {
+        return false;
+    }
+    // Chunks that are at or before our sequence number are within the 2^31
+    // sequence numbers right before it. Depending on where that window lies,
+    // it either is a single range or it wraps around the end of the map.
+    const uint32_t window_start = seq_number_ - (1U << 31);
+    vector<spilled_payload_type::iterator> ready;
+    spilled_payload_type::iterator iter = spilled_payload_.lower_bound(window_start);
+    spilled_payload_type::iterator window_end = spilled_payload_.upper_bound(seq_number_);
+    if (window_start > seq_number_) {
+        for (; iter != spilled_payload_.end(); ++iter) {
+            ready.push_back(iter);
+        }
+        iter = spilled_payload_.begin();
+    }
+    for (; iter != window_end; ++iter) {
+        ready.push_back(iter);
+    }
+    bool read_some = false;
+    for (size_t i = 0; i < ready.size(); ++i) {
+        if (seq_compare(ready[i]->first, seq_number_) > 0) {
+            continue;
+        }
+        const spilled_chunk& chunk = ready[i]->second;
+        const uint32_t chunk_end = ready[i]->first + chunk.size;
+        // Only the part after our sequence number is still needed
+        if (seq_compare(chunk_end, seq_number_) > 0) {
+            const uint32_t skip = seq_number_ - ready[i]->first;
+            payload_type payload(chunk.size - skip);
+            spill_file_->read(chunk.offset + skip, payload.size(), &payload[0]);
+            store_payload(seq_number_, move(payload));
+        }
+        total_spilled_bytes_ -= chunk.size;
+        spilled_payload_.erase(ready[i]);
+        read_some = true;
+    }
+    clear_spill_file();
+    return read_some;
+}
+
+void DataTracker::clear_spill_file() {
+    // The file can be reused from scratch once nobody references its contents
+    if (spilled_payload_.empty() && spill_file_ && spill_file_.use_count() == 1 &&
+        spill_file_->size() > 0) {
+        spill_file_->clear();
+    }
+}
+
 } // TCPIP
 } // Tins
 
@@ -49,6 +49,7 @@ using std::numeric_limits;
 
 using Tins::Memory::OutputMemoryStream;
 using Tins::Memory::InputMemoryStream;
+using Tins::Memory::OutputBufferStream;
 using Tins::Internals::seq_compare;
 
 namespace Tins {
@@ -86,8 +87,17 @@ void Flow::out_of_order_callback(const flow_packet_callback_type& callback) {
 }
 
 void Flow::process_packet(PDU& pdu) {
-    TCP* tcp = pdu.find_pdu<TCP>();
     RawPDU* raw = pdu.find_pdu<RawPDU>(); 
+    process_packet(pdu, raw ? &raw->payload() : 0);
+}
+
+void Flow::process_packet(const PDU& pdu) {
+    process_packet(pdu, 0);
+}
+
+void Flow::process_packet(const PDU& pdu, payload_type* movable_payload) {
+    const TCP* tcp = pdu.find_pdu<TCP>();
+    const RawPDU* raw = pdu.find_pdu<RawPDU>(); 
     // Update the internal state first
     if (tcp) {
         update_state(*tcp);
@@ -115,7 +125,10 @@ void Flow::process_packet(PDU& pdu) {
     }
 
     // can process either way, since it will abort immediately if not needed
-    if (data_tracker_.process_payload(tcp->seq(), move(raw->payload()))) {
+    const bool has_new_data = movable_payload ? 
+        data_tracker_.process_payload(tcp->seq(), move(*movable_payload)) :
+        data_tracker_.process_payload(tcp->seq(), raw->payload());
+    if (has_new_data) {
         if (on_data_callback_) {
             on_data_callback_(*this);
         }
@@ -217,6 +230,18 @@ uint32_t Flow::total_buffered_bytes() const {
     return data_tracker_.total_buffered_bytes();
 }
 
+void Flow::enable_spilling(uint32_t memory_threshold, uint64_t max_spilled_bytes) {
+    data_tracker_.enable_spilling(memory_threshold, max_spilled_bytes);
+}
+
+bool Flow::spilling_enabled() const {
+    return data_tracker_.spilling_enabled();
+}
+
+uint64_t Flow::total_spilled_bytes() const {
+    return data_tracker_.total_spilled_bytes();
+}
+
 Flow::payload_type& Flow::payload() {
     return data_tracker_.payload();
 }
@@ -229,6 +254,10 @@ void Flow::ignore_data_packets() {
     flags_.ignore_data_packets = true;
 }
 
+bool Flow::data_packets_ignored() const {
+    return flags_.ignore_data_packets;
+}
+
 int Flow::mss() const {
     return mss_;
 }
@@ -260,6 +289,46 @@ AckTracker& Flow::ack_tracker() {
 
 #endif // TINS_HAVE_ACK_TRACKER
 
+void Flow::serialize_state(OutputBufferStream& output) const {
+    output.write(dest_address_.begin(), dest_address_.end());
+    output.write_le(dest_port_);
+    output.write<uint8_t>(state_);
+    output.write_le<int32_t>(mss_);
+    output.write<uint8_t>(flags_.is_v6 | (flags_.ignore_data_packets << 1) | 
+                          (flags_.sack_permitted << 2) | (flags_.ack_tracking << 3));
+    data_tracker_.serialize_state(output);
+    #ifdef TINS_HAVE_ACK_TRACKER
+    if (flags_.ack_tracking) {
+        ack_tracker_.serialize_state(output);
+    }
+    #endif // TINS_HAVE_ACK_TRACKER
+}
+
+void Flow::restore_state(InputMemoryStream& input) {
+    input.read(dest_address_.data(), dest_address_.size());
+    dest_port_ = input.read_le<uint16_t>();
+    const uint8_t state = input.read<uint8_t>();
+    if (state > RST_SENT) {
+        throw malformed_packet();
+    }
+    state_ = static_cast<State>(state);
+    mss_ = input.read_le<int32_t>();
+    const uint8_t flags = input.read<uint8_t>();
+    flags_.is_v6 = (flags & 1) != 0;
+    flags_.ignore_data_packets = (flags & 2) != 0;
+    flags_.sack_permitted = (flags & 4) != 0;
+    flags_.ack_tracking = 0;
+    data_tracker_.restore_state(input);
+    if ((flags & 8) != 0) {
+        #ifdef TINS_HAVE_ACK_TRACKER
+        flags_.ack_tracking = 1;
+        ack_tracker_.restore_state(input);
+        #else
+        throw feature_disabled();
+        #endif // TINS_HAVE_ACK_TRACKER
+    }
+}
+
 } // TCPIP
 } // Tins
 
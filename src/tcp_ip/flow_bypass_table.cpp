@@ -0,0 +1,261 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <tins/tcp_ip/flow_bypass_table.h>
+
+#ifdef TINS_HAVE_TCPIP
+
+#include <cstring>
+#include <tins/constants.h>
+#include <tins/tcp.h>
+#include <tins/ip_address.h>
+#include <tins/ipv6_address.h>
+#include <tins/tcp_ip/stream.h>
+
+using std::memcpy;
+
+namespace Tins {
+namespace TCPIP {
+
+static uint16_t read_be16(const uint8_t* buffer) {
+    return static_cast<uint16_t>((buffer[0] << 8) | buffer[1]);
+}
+
+size_t FlowBypassTable::stream_id_hash::operator()(const stream_id& id) const {
+    // FNV-1a over the identifier's fields
+    size_t output = 2166136261U;
+    for (size_t i = 0; i < id.min_address.size(); ++i) {
+        output = (output ^ id.min_address[i]) * 16777619U;
+        output = (output ^ id.max_address[i]) * 16777619U;
+    }
+    output = (output ^ id.min_address_port) * 16777619U;
+    output = (output ^ id.max_address_port) * 16777619U;
+    return output;
+}
+
+FlowBypassTable::FlowBypassTable()
+: bypassed_packets_(0) {
+
+}
+
+void FlowBypassTable::update(const Stream& stream) {
+    // A flow tracking ACKs needs every packet, whether its data is ignored or not
+    const bool bypass_client = stream.client_flow().data_packets_ignored() &&
+                               !stream.client_flow().ack_tracking_enabled();
+    const bool bypass_server = stream.server_flow().data_packets_ignored() &&
+                               !stream.server_flow().ack_tracking_enabled();
+    const stream_id id = stream_id::make_identifier(stream);
+    if (!bypass_client && !bypass_server) {
+        entries_.erase(id);
+        return;
+    }
+    entry& stream_entry = entries_[id];
+    if (stream.is_v6()) {
+        stream_entry.client_addr = stream_id::serialize(stream.client_addr_v6());
+    }
+    else {
+        stream_entry.client_addr = stream_id::serialize(stream.client_addr_v4());
+    }
+    stream_entry.client_port = stream.client_port();
+    stream_entry.bypass_client = bypass_client;
+    stream_entry.bypass_server = bypass_server;
+    stream_entry.bypass_all = false;
+}
+
+void FlowBypassTable::bypass(const stream_id& id) {
+    entry& stream_entry = entries_[id];
+    stream_entry.bypass_all = true;
+    stream_entry.active = true;
+}
+
+void FlowBypassTable::remove(const stream_id& id) {
+    entries_.erase(id);
+}
+
+bool FlowBypassTable::should_bypass(const uint8_t* buffer, uint32_t total_sz,
+                                    PDU::PDUType link_layer) {
+    if (entries_.empty()) {
+        return false;
+    }
+    uint16_t ether_type;
+    switch (link_layer) {
+        case PDU::ETHERNET_II:
+            if (total_sz < 14) {
+                return false;
+            }
+            ether_type = read_be16(buffer + 12);
+            buffer += 14;
+            total_sz -= 14;
+            // Skip any VLAN tags
+            while (ether_type == Constants::Ethernet::VLAN ||
+                   ether_type == Constants::Ethernet::QINQ ||
+                   ether_type == Constants::Ethernet::OLD_QINQ) {
+                if (total_sz < 4) {
+                    return false;
+                }
+                ether_type = read_be16(buffer + 2);
+                buffer += 4;
+                total_sz -= 4;
+            }
+            break;
+        case PDU::SLL:
+            if (total_sz < 16) {
+                return false;
+            }
+            ether_type = read_be16(buffer + 14);
+            buffer += 16;
+            total_sz -= 16;
+            break;
+        case PDU::LOOPBACK:
+            // The address family's value depends on the platform, so just
+            // look at the IP version field after it
+            if (total_sz < 4) {
+                return false;
+            }
+            buffer += 4;
+            total_sz -= 4;
+            return should_bypass_ip(buffer, total_sz);
+        case PDU::IP:
+        case PDU::IPv6:
+            return should_bypass_ip(buffer, total_sz);
+        default:
+            return false;
+    }
+    if (ether_type != Constants::Ethernet::IP && ether_type != Constants::Ethernet::IPV6) {
+        return false;
+    }
+    return should_bypass_ip(buffer, total_sz);
+}
+
+bool FlowBypassTable::should_bypass_ip(const uint8_t* buffer, uint32_t total_sz) {
+    if (total_sz < 1) {
+        return false;
+    }
+    stream_id::address_type src_addr;
+    stream_id::address_type dst_addr;
+    const uint8_t version = buffer[0] >> 4;
+    if (version == 4) {
+        const uint32_t header_size = (buffer[0] & 0x0f) * 4;
+        if (total_sz < 20 || header_size < 20 || total_sz < header_size) {
+            return false;
+        }
+        // Non first fragments don't contain the TCP header
+        if (buffer[9] != Constants::IP::PROTO_TCP || (read_be16(buffer + 6) & 0x1fff) != 0) {
+            return false;
+        }
+        src_addr.fill(0);
+        dst_addr.fill(0);
+        memcpy(src_addr.data(), buffer + 12, IPv4Address::address_size);
+        memcpy(dst_addr.data(), buffer + 16, IPv4Address::address_size);
+        return should_bypass_tcp(src_addr, dst_addr, buffer + header_size,
+                                 total_sz - header_size);
+    }
+    else if (version == 6) {
+        // Extension headers are not skipped, those go through the regular path
+        if (total_sz < 40 || buffer[6] != Constants::IP::PROTO_TCP) {
+            return false;
+        }
+        memcpy(src_addr.data(), buffer + 8, IPv6Address::address_size);
+        memcpy(dst_addr.data(), buffer + 24, IPv6Address::address_size);
+        return should_bypass_tcp(src_addr, dst_addr, buffer + 40, total_sz - 40);
+    }
+    return false;
+}
+
+bool FlowBypassTable::should_bypass_tcp(const stream_id::address_type& src_addr,
+                                        const stream_id::address_type& dst_addr,
+                                        const uint8_t* buffer, uint32_t total_sz) {
+    // Ports and flags are within the first 14 bytes
+    if (total_sz < 14) {
+        return false;
+    }
+    const uint16_t sport = read_be16(buffer);
+    const uint16_t dport = read_be16(buffer + 2);
+    const uint8_t flags = buffer[13];
+    entries_type::iterator iter = entries_.find(stream_id(src_addr, sport, dst_addr, dport));
+    if (iter == entries_.end()) {
+        return false;
+    }
+    entry& stream_entry = iter->second;
+    bool output;
+    if (stream_entry.bypass_all) {
+        // Let new connections through
+        output = (flags & (TCP::SYN | TCP::ACK)) != TCP::SYN;
+    }
+    else if ((flags & (TCP::SYN | TCP::FIN | TCP::RST)) != 0) {
+        // Keep the stream's state up to date
+        output = false;
+    }
+    else if (sport == stream_entry.client_port && src_addr == stream_entry.client_addr) {
+        output = stream_entry.bypass_client;
+    }
+    else {
+        output = stream_entry.bypass_server;
+    }
+    if (output) {
+        stream_entry.active = true;
+        bypassed_packets_++;
+    }
+    return output;
+}
+
+bool FlowBypassTable::is_active(const stream_id& id) const {
+    entries_type::const_iterator iter = entries_.find(id);
+    return iter != entries_.end() && iter->second.active;
+}
+
+void FlowBypassTable::expire_inactive() {
+    entries_type::iterator iter = entries_.begin();
+    while (iter != entries_.end()) {
+        if (iter->second.bypass_all && !iter->second.active) {
+            iter = entries_.erase(iter);
+        }
+        else {
+            iter->second.active = false;
+            ++iter;
+        }
+    }
+}
+
+size_t FlowBypassTable::size() const {
+    return entries_.size();
+}
+
+bool FlowBypassTable::empty() const {
+    return entries_.empty();
+}
+
+uint64_t FlowBypassTable::bypassed_packets() const {
+    return bypassed_packets_;
+}
+
+} // TCPIP
+} // Tins
+
+#endif // TINS_HAVE_TCPIP
@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <tins/tcp_ip/spill_file.h>
+
+#ifdef TINS_HAVE_TCPIP
+
+#include <cstring>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <algorithm>
+#ifndef _WIN32
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+#endif // _WIN32
+
+using std::string;
+using std::vector;
+
+namespace Tins {
+namespace TCPIP {
+
+// Grow the file in steps of at least 1MB
+static const uint64_t MIN_CAPACITY = 1024 * 1024;
+
+const uint64_t SpillFile::DEFAULT_MAX_SIZE = 256 * 1024 * 1024;
+
+SpillFile::SpillFile(uint64_t max_size)
+: fd_(-1), mapping_(0), capacity_(0), size_(0), max_size_(max_size) {
+
+}
+
+SpillFile::~SpillFile() {
+    #ifndef _WIN32
+    unmap();
+    if (fd_ != -1) {
+        ::close(fd_);
+    }
+    #endif // _WIN32
+}
+
+bool SpillFile::write(const uint8_t* data, uint32_t size, uint64_t& offset) {
+    if (size_ + size > max_size_ || !reserve(size_ + size)) {
+        return false;
+    }
+    std::memcpy(mapping_ + size_, data, size);
+    offset = size_;
+    size_ += size;
+    return true;
+}
+
+void SpillFile::read(uint64_t offset, uint32_t size, uint8_t* output) const {
+    std::memcpy(output, mapping_ + offset, size);
+}
+
+void SpillFile::clear() {
+    size_ = 0;
+    #ifndef _WIN32
+    // Give the disk space back
+    if (capacity_ > MIN_CAPACITY) {
+        unmap();
+        if (::ftruncate(fd_, 0) != 0) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+    }
+    #endif // _WIN32
+}
+
+uint64_t SpillFile::size() const {
+    return size_;
+}
+
+uint64_t SpillFile::max_size() const {
+    return max_size_;
+}
+
+#ifndef _WIN32
+
+// Allocates the disk blocks for the given range of the file, growing it if 
+// needed. Writing through a mapping of a sparse file raises SIGBUS once the 
+// disk is full, so every mapped byte has to be backed by an allocated block
+static bool allocate_range(int fd, uint64_t offset, uint64_t length) {
+    #ifdef __APPLE__
+        // There's no posix_fallocate, so write zeros instead
+        static const uint8_t zeros[4096] = { 0 };
+        while (length > 0) {
+            const size_t chunk_size = static_cast<size_t>(
+                std::min<uint64_t>(length, sizeof(zeros))
+            );
+            const ssize_t written = ::pwrite(fd, zeros, chunk_size, offset);
+            if (written < 0 && errno == EINTR) {
+                continue;
+            }
+            if (written <= 0) {
+                return false;
+            }
+            offset += written;
+            length -= written;
+        }
+        return true;
+    #else
+        int result;
+        do {
+            result = ::posix_fallocate(fd, offset, length);
+        } while (result == EINTR);
+        return result == 0;
+    #endif // __APPLE__
+}
+
+#endif // _WIN32
+
+bool SpillFile::open() {
+    #ifndef _WIN32
+    const char* directory = std::getenv("TMPDIR");
+    string path_template = string(directory ? directory : "/tmp") + "/libtins-spill-XXXXXX";
+    vector<char> path(path_template.begin(), path_template.end());
+    path.push_back(0);
+    fd_ = ::mkstemp(&path[0]);
+    if (fd_ == -1) {
+        return false;
+    }
+    // The file only lives as long as the descriptor is open
+    ::unlink(&path[0]);
+    return true;
+    #else
+    return false;
+    #endif // _WIN32
+}
+
+bool SpillFile::reserve(uint64_t size) {
+    #ifndef _WIN32
+    if (size <= capacity_) {
+        return true;
+    }
+    if (fd_ == -1 && !open()) {
+        return false;
+    }
+    uint64_t new_capacity = capacity_ < MIN_CAPACITY ? MIN_CAPACITY : capacity_;
+    while (new_capacity < size) {
+        new_capacity *= 2;
+    }
+    if (new_capacity > max_size_) {
+        new_capacity = max_size_;
+    }
+    // On failure, the caller keeps the data in memory
+    if (!allocate_range(fd_, capacity_, new_capacity - capacity_)) {
+        return false;
+    }
+    void* mapping = ::mmap(0, new_capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+    // Data is always written through the mapping, so the new one already
+    // contains everything written so far
+    unmap();
+    mapping_ = (uint8_t*)mapping;
+    capacity_ = new_capacity;
+    return true;
+    #else
+    return size == 0;
+    #endif // _WIN32
+}
+
+void SpillFile::unmap() {
+    #ifndef _WIN32
+    if (mapping_) {
+        ::munmap(mapping_, capacity_);
+        mapping_ = 0;
+        capacity_ = 0;
+    }
+    #endif // _WIN32
+}
+
+} // TCPIP
+} // Tins
+
+#endif // TINS_HAVE_TCPIP
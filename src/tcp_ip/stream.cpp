@@ -40,16 +40,27 @@
 #include <tins/ethernetII.h>
 #include <tins/rawpdu.h>
 #include <tins/exceptions.h>
+#include <tins/memory_helpers.h>
 
 using std::make_pair;
 using std::bind;
 using std::pair;
 using std::numeric_limits;
 
+using Tins::Memory::InputMemoryStream;
+using Tins::Memory::OutputBufferStream;
+
 namespace Tins {
 namespace TCPIP {
 
-Stream::Stream(PDU& packet, const timestamp_type& ts) 
+Stream::Stream() 
+: client_flow_(IPv4Address(), 0, 0), server_flow_(IPv4Address(), 0, 0), 
+  create_time_(0), last_seen_(0), auto_cleanup_client_(true), auto_cleanup_server_(true),
+  is_partial_stream_(false), directions_recovery_mode_enabled_(0) {
+
+}
+
+Stream::Stream(const PDU& packet, const timestamp_type& ts) 
 : client_flow_(extract_client_flow(packet)),
   server_flow_(extract_server_flow(packet)), create_time_(ts), 
   last_seen_(ts), auto_cleanup_client_(true), auto_cleanup_server_(true),
@@ -65,22 +76,40 @@ Stream::Stream(PDU& packet, const timestamp_type& ts)
 }
 
 void Stream::process_packet(PDU& packet, const timestamp_type& ts) {
+    process_packet(packet, &packet, ts);
+}
+
+void Stream::process_packet(PDU& packet) {
+    return process_packet(packet, timestamp_type(0));
+}
+
+void Stream::process_packet(const PDU& packet, const timestamp_type& ts) {
+    process_packet(packet, 0, ts);
+}
+
+// If mutable_packet is not null, it's the same as packet and payload can be moved out of it
+void Stream::process_packet(const PDU& packet, PDU* mutable_packet, const timestamp_type& ts) {
     last_seen_ = ts;
+    Flow* flow = 0;
     if (client_flow_.packet_belongs(packet)) {
-        client_flow_.process_packet(packet);
+        flow = &client_flow_;
     }
     else if (server_flow_.packet_belongs(packet)) {
-        server_flow_.process_packet(packet);
+        flow = &server_flow_;
+    }
+    if (flow) {
+        if (mutable_packet) {
+            flow->process_packet(*mutable_packet);
+        }
+        else {
+            flow->process_packet(packet);
+        }
     }
     if (is_finished() && on_stream_closed_) {
         on_stream_closed_(*this);
     }
 }
 
-void Stream::process_packet(PDU& packet) {
-    return process_packet(packet, timestamp_type(0));
-}
-
 Flow& Stream::client_flow() {
     return client_flow_;
 }
@@ -263,6 +292,11 @@ bool Stream::ack_tracking_enabled() const {
     return client_flow().ack_tracking_enabled() && server_flow().ack_tracking_enabled();
 }
 
+void Stream::enable_spilling(uint32_t memory_threshold, uint64_t max_spilled_bytes) {
+    client_flow().enable_spilling(memory_threshold, max_spilled_bytes);
+    server_flow().enable_spilling(memory_threshold, max_spilled_bytes);
+}
+
 bool Stream::is_partial_stream() const {
     return is_partial_stream_;
 }
@@ -282,6 +316,31 @@ bool Stream::is_recovery_mode_enabled() const {
     return directions_recovery_mode_enabled_ > 0;
 }
 
+void Stream::serialize_state(OutputBufferStream& output) const {
+    client_flow_.serialize_state(output);
+    server_flow_.serialize_state(output);
+    output.write(client_hw_addr_.begin(), client_hw_addr_.end());
+    output.write(server_hw_addr_.begin(), server_hw_addr_.end());
+    output.write_le<int64_t>(create_time_.count());
+    output.write_le<int64_t>(last_seen_.count());
+    output.write<uint8_t>(auto_cleanup_client_ | (auto_cleanup_server_ << 1) | 
+                          (is_partial_stream_ << 2));
+}
+
+void Stream::restore_state(InputMemoryStream& input) {
+    client_flow_.restore_state(input);
+    server_flow_.restore_state(input);
+    input.read(client_hw_addr_);
+    input.read(server_hw_addr_);
+    create_time_ = timestamp_type(input.read_le<int64_t>());
+    last_seen_ = timestamp_type(input.read_le<int64_t>());
+    const uint8_t flags = input.read<uint8_t>();
+    auto_cleanup_client_ = (flags & 1) != 0;
+    auto_cleanup_server_ = (flags & 2) != 0;
+    is_partial_stream_ = (flags & 4) != 0;
+    directions_recovery_mode_enabled_ = 0;
+}
+
 void Stream::on_client_flow_data(const Flow& /*flow*/) {
     if (on_client_data_callback_) {
         on_client_data_callback_(*this);
@@ -32,6 +32,8 @@
 #ifdef TINS_HAVE_TCPIP
 
 #include <limits>
+#include <vector>
+#include <algorithm>
 #include <tins/ip_address.h>
 #include <tins/ipv6_address.h>
 #include <tins/tcp.h>
@@ -40,18 +42,35 @@
 #include <tins/rawpdu.h>
 #include <tins/packet.h>
 #include <tins/exceptions.h>
+#include <tins/memory_helpers.h>
 
 using std::make_pair;
 using std::bind;
 using std::pair;
 using std::numeric_limits;
+using std::vector;
+using std::sort;
+using std::min;
+using std::move;
 using std::chrono::system_clock;
 using std::chrono::minutes;
 using std::chrono::duration_cast;
 
+using Tins::Memory::InputMemoryStream;
+using Tins::Memory::OutputBufferStream;
+
 namespace Tins {
 namespace TCPIP {
 
+// "TSNP", used to identify snapshots
+static const uint32_t SNAPSHOT_MAGIC = 0x504e5354;
+static const uint8_t SNAPSHOT_VERSION = 1;
+
+static uint32_t stream_buffered_bytes(const Stream& stream) {
+    return stream.client_flow().total_buffered_bytes() +
+           stream.server_flow().total_buffered_bytes();
+}
+
 const size_t StreamFollower::DEFAULT_MAX_BUFFERED_CHUNKS = 512;
 const size_t StreamFollower::DEFAULT_MAX_SACKED_INTERVALS = 1024;
 const uint32_t StreamFollower::DEFAULT_MAX_BUFFERED_BYTES = 3 * 1024 * 1024; // 3MB
@@ -60,21 +79,42 @@ const StreamFollower::timestamp_type StreamFollower::DEFAULT_KEEP_ALIVE = minute
 StreamFollower::StreamFollower() 
 : max_buffered_chunks_(DEFAULT_MAX_BUFFERED_CHUNKS),
   max_buffered_bytes_(DEFAULT_MAX_BUFFERED_BYTES), last_cleanup_(0),
-  stream_keep_alive_(DEFAULT_KEEP_ALIVE), attach_to_flows_(false) {
+  stream_keep_alive_(DEFAULT_KEEP_ALIVE), max_total_buffered_bytes_(0),
+  total_buffered_bytes_(0), memory_budget_evictions_(0), attach_to_flows_(false) {
 
 }
 
 void StreamFollower::process_packet(PDU& packet) {
-    // Use current time
-    const system_clock::duration ts = system_clock::now().time_since_epoch();
-    process_packet(packet, duration_cast<timestamp_type>(ts));
+    process_packet(packet, &packet, current_time());
 }
 
 void StreamFollower::process_packet(Packet& packet) {
-    process_packet(*packet.pdu(), packet.timestamp());
+    if (packet.use_count() > 1) {
+        // Don't clone a PDU that other Packets are using just to move its payload out
+        process_packet(static_cast<const Packet&>(packet));
+    }
+    else {
+        PDU* pdu = packet.pdu();
+        process_packet(*pdu, pdu, packet.timestamp());
+    }
+}
+
+void StreamFollower::process_packet(const PDU& packet) {
+    process_packet(packet, 0, current_time());
+}
+
+void StreamFollower::process_packet(const Packet& packet) {
+    process_packet(*packet.pdu(), 0, packet.timestamp());
+}
+
+StreamFollower::timestamp_type StreamFollower::current_time() {
+    const system_clock::duration ts = system_clock::now().time_since_epoch();
+    return duration_cast<timestamp_type>(ts);
 }
 
-void StreamFollower::process_packet(PDU& packet, const timestamp_type& ts) {
+// If mutable_packet is not null, it's the same as packet and payload can be moved out of it
+void StreamFollower::process_packet(const PDU& packet, PDU* mutable_packet,
+                                    const timestamp_type& ts) {
     const TCP* tcp = packet.find_pdu<TCP>();
     if (!tcp) {
         return;
@@ -86,6 +126,8 @@ void StreamFollower::process_packet(PDU& packet, const timestamp_type& ts) {
         // to an already running flow).
         if (tcp->flags() == TCP::SYN || (attach_to_flows_ && tcp->find_pdu<RawPDU>() != 0)) {
             iter = streams_.insert(make_pair(identifier, Stream(packet, ts))).first;
+            // This could be a new connection reusing a terminated stream's endpoints
+            bypass_table_.remove(identifier);
             iter->second.setup_flows_callbacks();
             if (on_new_connection_) {
                 on_new_connection_(iter->second);
@@ -110,12 +152,24 @@ void StreamFollower::process_packet(PDU& packet, const timestamp_type& ts) {
     // We'll process it if we had already seen this stream or if we just attached to
     // it and it contains payload
     Stream& stream = iter->second;
-    stream.process_packet(packet, ts);
+    const uint32_t previous_buffered_bytes = stream_buffered_bytes(stream);
+    if (mutable_packet) {
+        stream.process_packet(*mutable_packet, ts);
+    }
+    else {
+        stream.process_packet(packet, ts);
+    }
     // Check for different potential termination
     size_t total_chunks = stream.client_flow().buffered_payload().size() +
                           stream.server_flow().buffered_payload().size();
-    uint32_t total_buffered_bytes = stream.client_flow().total_buffered_bytes() +
-                                    stream.server_flow().total_buffered_bytes();
+    uint32_t total_buffered_bytes = stream_buffered_bytes(stream);
+    if (stream.client_flow().data_packets_ignored() ||
+        stream.server_flow().data_packets_ignored()) {
+        bypass_table_.update(stream);
+    }
+    // Account for the data this stream buffered or released
+    total_buffered_bytes_ += total_buffered_bytes;
+    total_buffered_bytes_ -= min<uint64_t>(previous_buffered_bytes, total_buffered_bytes_);
     bool terminate_stream = total_chunks > max_buffered_chunks_ ||
                             total_buffered_bytes > max_buffered_bytes_;
     TerminationReason reason = BUFFERED_DATA;
@@ -133,7 +187,15 @@ void StreamFollower::process_packet(PDU& packet, const timestamp_type& ts) {
         if (terminate_stream && on_stream_termination_) {
             on_stream_termination_(stream, reason);
         }
-        streams_.erase(iter);
+        erase_stream(iter);
+        if (terminate_stream) {
+            // Any further packets on this stream can be dropped
+            bypass_table_.bypass(identifier);
+        }
+    }
+    else if (max_total_buffered_bytes_ > 0 &&
+             total_buffered_bytes_ > max_total_buffered_bytes_) {
+        enforce_memory_budget();
     }
 
     if (last_cleanup_ + stream_keep_alive_ <= ts) {
@@ -177,23 +239,149 @@ void StreamFollower::follow_partial_streams(bool value) {
     attach_to_flows_ = value;
 }
 
+void StreamFollower::max_total_buffered_bytes(uint64_t value) {
+    max_total_buffered_bytes_ = value;
+}
+
+uint64_t StreamFollower::max_total_buffered_bytes() const {
+    return max_total_buffered_bytes_;
+}
+
+uint64_t StreamFollower::total_buffered_bytes() const {
+    return total_buffered_bytes_;
+}
+
+uint64_t StreamFollower::memory_budget_evictions() const {
+    return memory_budget_evictions_;
+}
+
+FlowBypassTable& StreamFollower::flow_bypass_table() {
+    return bypass_table_;
+}
+
 void StreamFollower::cleanup_streams(const timestamp_type& now) {
     streams_type::iterator iter = streams_.begin();
     while (iter != streams_.end()) {
-        if (iter->second.last_seen() + stream_keep_alive_ <= now) {
+        // Streams whose packets are being bypassed are still alive
+        if (iter->second.last_seen() + stream_keep_alive_ <= now &&
+            !bypass_table_.is_active(iter->first)) {
             // If we have a termination callback, execute it
             if (on_stream_termination_) {
                 on_stream_termination_(iter->second, TIMEOUT);
             }
-            streams_.erase(iter++);
+            erase_stream(iter++);
         }
         else {
             ++iter;
         }
     }
+    bypass_table_.expire_inactive();
     last_cleanup_ = now;
 }
 
+void StreamFollower::enforce_memory_budget() {
+    // Flows can be modified outside of process_packet (e.g. by advancing their
+    // sequence number), so recompute the actual amount of buffered bytes
+    typedef pair<timestamp_type, streams_type::iterator> candidate_type;
+    vector<candidate_type> candidates;
+    total_buffered_bytes_ = 0;
+    for (streams_type::iterator iter = streams_.begin(); iter != streams_.end(); ++iter) {
+        const uint32_t buffered_bytes = stream_buffered_bytes(iter->second);
+        if (buffered_bytes > 0) {
+            total_buffered_bytes_ += buffered_bytes;
+            candidates.push_back(make_pair(iter->second.last_seen(), iter));
+        }
+    }
+    if (total_buffered_bytes_ <= max_total_buffered_bytes_) {
+        return;
+    }
+    // Evict the least recently seen streams first. Go a bit below the budget so
+    // we don't end up doing this again on the very next packet
+    const uint64_t target = max_total_buffered_bytes_ - max_total_buffered_bytes_ / 4;
+    sort(candidates.begin(), candidates.end(),
+         [](const candidate_type& lhs, const candidate_type& rhs) {
+            return lhs.first < rhs.first;
+         });
+    for (size_t i = 0; i < candidates.size() && total_buffered_bytes_ > target; ++i) {
+        streams_type::iterator iter = candidates[i].second;
+        if (on_stream_termination_) {
+            on_stream_termination_(iter->second, MEMORY_BUDGET);
+        }
+        const stream_id identifier = iter->first;
+        erase_stream(iter);
+        bypass_table_.bypass(identifier);
+        memory_budget_evictions_++;
+    }
+}
+
+void StreamFollower::erase_stream(streams_type::iterator iter) {
+    total_buffered_bytes_ -= min<uint64_t>(stream_buffered_bytes(iter->second),
+                                           total_buffered_bytes_);
+    bypass_table_.remove(iter->first);
+    streams_.erase(iter);
+}
+
+vector<uint8_t> StreamFollower::serialize_state() const {
+    vector<uint8_t> output;
+    OutputBufferStream stream(output);
+    stream.write_le(SNAPSHOT_MAGIC);
+    stream.write(SNAPSHOT_VERSION);
+    stream.write_le<int64_t>(last_cleanup_.count());
+    stream.write_le<uint32_t>(streams_.size());
+    for (streams_type::const_iterator iter = streams_.begin(); iter != streams_.end(); ++iter) {
+        iter->second.serialize_state(stream);
+    }
+    return output;
+}
+
+void StreamFollower::restore_state(const uint8_t* buffer, uint32_t total_sz) {
+    if (!on_new_connection_) {
+        throw callback_not_set();
+    }
+    streams_type streams;
+    timestamp_type last_cleanup;
+    // Parse everything first so the current state is kept if the snapshot is invalid
+    try {
+        InputMemoryStream stream(buffer, total_sz);
+        if (stream.read_le<uint32_t>() != SNAPSHOT_MAGIC ||
+            stream.read<uint8_t>() != SNAPSHOT_VERSION) {
+            throw invalid_stream_snapshot();
+        }
+        last_cleanup = timestamp_type(stream.read_le<int64_t>());
+        const uint32_t stream_count = stream.read_le<uint32_t>();
+        for (uint32_t i = 0; i < stream_count; ++i) {
+            Stream restored_stream;
+            restored_stream.restore_state(stream);
+            const stream_id identifier = stream_id::make_identifier(restored_stream);
+            streams.insert(make_pair(identifier, move(restored_stream)));
+        }
+        if (stream.size() != 0) {
+            throw invalid_stream_snapshot();
+        }
+    }
+    catch (malformed_packet&) {
+        throw invalid_stream_snapshot();
+    }
+    streams_.swap(streams);
+    bypass_table_ = FlowBypassTable();
+    last_cleanup_ = last_cleanup;
+    total_buffered_bytes_ = 0;
+    for (streams_type::iterator iter = streams_.begin(); iter != streams_.end(); ++iter) {
+        Stream& stream = iter->second;
+        stream.setup_flows_callbacks();
+        on_new_connection_(stream);
+        if (stream.client_flow().data_packets_ignored() ||
+            stream.server_flow().data_packets_ignored()) {
+            bypass_table_.update(stream);
+        }
+        total_buffered_bytes_ += stream_buffered_bytes(stream);
+    }
+}
+
+void StreamFollower::restore_state(const vector<uint8_t>& snapshot) {
+    restore_state(snapshot.empty() ? 0 : &snapshot[0], snapshot.size());
+}
+
 } // TCPIP
 } // Tins
 
@@ -52,11 +52,9 @@
 #include <tins/ip_address.h>
 #include <tins/ipv6_address.h>
 #include <tins/hw_address.h>
-#include <tins/ethernetII.h>
-#include <tins/arp.h>
 #include <tins/packet_sender.h>
 #include <tins/network_interface.h>
-#include <tins/detail/smart_ptr.h>
+#include <tins/neighbor_cache.h>
 
 using std::string;
 
@@ -97,30 +95,7 @@ IPv6Address resolve_domain6(const string& to_resolve) {
 HWAddress<6> resolve_hwaddr(const NetworkInterface& iface,
                             IPv4Address ip,
                             PacketSender& sender) {
-    NetworkInterface::Info info(iface.addresses());
-    #ifdef _WIN32
-        // On Windows, use SendARP
-        IPAddr source;
-        IPAddr dest;
-        ULONG hw_address[2];
-        ULONG address_length = 6;
-        source = static_cast<uint32_t>(info.ip_addr);
-        dest = static_cast<uint32_t>(ip);
-        if (SendARP(dest, source, &hw_address, &address_length) == NO_ERROR && address_length == 6) {
-            return HWAddress<6>((const uint8_t*)hw_address);
-        }
-    #else
-        // On other platforms, just do the ARP resolution ourselves
-        EthernetII packet = ARP::make_arp_request(ip, info.ip_addr, info.hw_addr);
-        Internals::smart_ptr<PDU>::type response(sender.send_recv(packet, iface));
-        if (response.get()) {
-            const ARP* arp_resp = response->find_pdu<ARP>();
-            if (arp_resp) {
-                return arp_resp->sender_hw_addr();
-            }
-        }
-    #endif 
-    throw exception_base("Could not resolve hardware address");
+    return neighbor_cache().resolve(iface, ip, sender);
 }
 
 HWAddress<6> resolve_hwaddr(IPv4Address ip, PacketSender& sender) {
@@ -56,6 +56,7 @@
 #include <set>
 #include <fstream>
 #include <tins/network_interface.h>
+#include <tins/interface_cache.h>
 #include <tins/exceptions.h>
 
 using std::vector;
@@ -395,48 +396,23 @@ vector<Route6Entry> route6_entries() {
 
 #endif
 
-#ifdef _WIN32
 set<string> network_interfaces() {
+    const InterfaceCache::snapshot_ptr snapshot = interface_cache().snapshot();
+    const InterfaceSnapshot::entries_type& interfaces = snapshot->interfaces();
     set<string> output;
-    ULONG size;
-    ::GetAdaptersAddresses(AF_INET, 0, 0, 0, &size);
-    vector<uint8_t> buffer(size);
-    if (::GetAdaptersAddresses(AF_INET, 0, 0, (IP_ADAPTER_ADDRESSES *)&buffer[0], &size) == ERROR_SUCCESS) {
-        PIP_ADAPTER_ADDRESSES iface = (IP_ADAPTER_ADDRESSES *)&buffer[0];
-        while (iface) {
-            output.insert(iface->AdapterName);
-            iface = iface->Next;
-        }
-    }
-    return output;
-}
-#else
-set<string> network_interfaces() {
-    set<string> output;
-    struct ifaddrs* ifaddrs = 0;
-    struct ifaddrs* if_it = 0;
-    getifaddrs(&ifaddrs);
-    for (if_it = ifaddrs; if_it; if_it = if_it->ifa_next) {
-        output.insert(if_it->ifa_name);
-    }
-    if (ifaddrs) {
-        freeifaddrs(ifaddrs);
+    for (size_t i = 0; i < interfaces.size(); ++i) {
+        output.insert(interfaces[i].name);
     }
     return output;
 }
-#endif // _WIN32
 
 bool gateway_from_ip(IPv4Address ip, IPv4Address& gw_addr) {
-    typedef vector<RouteEntry> entries_type;
-    entries_type entries = route_entries();
-    uint32_t ip_int = ip;
-    for (entries_type::const_iterator it(entries.begin()); it != entries.end(); ++it) {
-        if ((ip_int & it->mask) == it->destination) {
-            gw_addr = it->gateway;
-            return true;
-        }
+    RouteEntry route;
+    if (!route_from_ip(ip, route)) {
+        return false;
     }
-    return false;
+    gw_addr = route.gateway;
+    return true;
 }
 
 } // Utils
@@ -0,0 +1,112 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <tins/address_set.h>
+
+using std::string;
+
+using namespace Tins;
+
+class AddressSetTest : public testing::Test {
+public:
+
+};
+
+TEST_F(AddressSetTest, LongestPrefixMatch) {
+    AddressMap<IPv4Address, string> networks;
+    networks.insert(IPv4Address("10.0.0.0") / 8, "internal");
+    networks.insert(IPv4Address("10.1.0.0") / 16, "customer");
+    networks.insert(IPv4Address("10.1.2.0"), 23, "office");
+    networks.insert(IPv4Address("10.1.3.7"), 32, "host");
+    EXPECT_EQ(4U, networks.size());
+
+    ASSERT_TRUE(networks.find("10.1.3.7") != 0);
+    EXPECT_EQ("host", *networks.find("10.1.3.7"));
+    EXPECT_EQ("office", *networks.find("10.1.3.8"));
+    EXPECT_EQ("office", *networks.find("10.1.2.1"));
+    EXPECT_EQ("customer", *networks.find("10.1.4.1"));
+    EXPECT_EQ("internal", *networks.find("10.2.0.0"));
+    EXPECT_TRUE(networks.find("11.0.0.0") == 0);
+    EXPECT_TRUE(networks.find("9.255.255.255") == 0);
+}
+
+TEST_F(AddressSetTest, InsertionOrderDoesNotMatter) {
+    AddressMap<IPv4Address, int> networks;
+    networks.insert(IPv4Address("192.168.1.0"), 24, 24);
+    networks.insert(IPv4Address("192.168.1.128"), 25, 25);
+    networks.insert(IPv4Address("192.168.0.0"), 22, 22);
+    networks.insert(IPv4Address("192.168.1.0"), 26, 26);
+    EXPECT_EQ(26, *networks.find("192.168.1.1"));
+    EXPECT_EQ(24, *networks.find("192.168.1.64"));
+    EXPECT_EQ(25, *networks.find("192.168.1.200"));
+    EXPECT_EQ(22, *networks.find("192.168.3.1"));
+}
+
+TEST_F(AddressSetTest, ReplaceValue) {
+    AddressMap<IPv4Address, int> networks;
+    networks.insert(IPv4Address("10.0.0.0"), 7, 1);
+    networks.insert(IPv4Address("10.0.0.0"), 8, 2);
+    networks.insert(IPv4Address("10.0.0.0"), 7, 3);
+    EXPECT_EQ(2U, networks.size());
+    EXPECT_EQ(2, *networks.find("10.0.0.1"));
+    EXPECT_EQ(3, *networks.find("11.0.0.1"));
+}
+
+TEST_F(AddressSetTest, DefaultRoute) {
+    IPv4AddressSet addresses;
+    EXPECT_FALSE(addresses.contains("1.2.3.4"));
+    addresses.insert(IPv4Address("1.2.3.4"), 0);
+    EXPECT_TRUE(addresses.contains("1.2.3.4"));
+    EXPECT_TRUE(addresses.contains("255.255.255.255"));
+    addresses.clear();
+    EXPECT_TRUE(addresses.empty());
+    EXPECT_FALSE(addresses.contains("1.2.3.4"));
+}
+
+TEST_F(AddressSetTest, InsertRange) {
+    IPv4AddressSet addresses;
+    addresses.insert(IPv4Range(IPv4Address("192.168.0.10"), IPv4Address("192.168.0.20")));
+    // 10-11, 12-15, 16-19, 20
+    EXPECT_EQ(4U, addresses.size());
+    EXPECT_FALSE(addresses.contains("192.168.0.9"));
+    IPv4Range range(IPv4Address("192.168.0.10"), IPv4Address("192.168.0.20"));
+    for (IPv4Range::const_iterator it = range.begin(); it != range.end(); ++it) {
+        EXPECT_TRUE(addresses.contains(*it));
+    }
+    EXPECT_FALSE(addresses.contains("192.168.0.21"));
+
+    // Masked ranges are stored as a single prefix
+    IPv4AddressSet networks;
+    networks.insert(IPv4Address("172.16.0.0") / 12);
+    EXPECT_EQ(1U, networks.size());
+    EXPECT_TRUE(networks.contains("172.31.255.255"));
+    EXPECT_FALSE(networks.contains("172.32.0.0"));
+
+    networks.insert(IPv4Range(IPv4Address("0.0.0.0"), IPv4Address("255.255.255.255")));
+    EXPECT_TRUE(networks.contains("1.1.1.1"));
+}
+
+TEST_F(AddressSetTest, IPv6) {
+    AddressMap<IPv6Address, int> networks;
+    networks.insert(IPv6Address("2001:db8::"), 32, 32);
+    networks.insert(IPv6Address("2001:db8:ab00::"), 40, 40);
+    networks.insert(IPv6Address("2001:db8:abcd::1"), 128, 128);
+    networks.insert(IPv6Address("2001:db8:abcd::"), 47, 47);
+    EXPECT_EQ(128, *networks.find("2001:db8:abcd::1"));
+    EXPECT_EQ(47, *networks.find("2001:db8:abcd::2"));
+    EXPECT_EQ(47, *networks.find("2001:db8:abcc::2"));
+    EXPECT_EQ(40, *networks.find("2001:db8:abce::2"));
+    EXPECT_EQ(32, *networks.find("2001:db8:1::"));
+    EXPECT_TRUE(networks.find("2001:db9::") == 0);
+
+    IPv6AddressSet addresses;
+    addresses.insert(IPv6Range(IPv6Address("fe80::1"), IPv6Address("fe80::ffff")));
+    EXPECT_TRUE(addresses.contains("fe80::1"));
+    EXPECT_TRUE(addresses.contains("fe80::abcd"));
+    EXPECT_FALSE(addresses.contains("fe80::"));
+    EXPECT_FALSE(addresses.contains("fe80::1:0"));
+}
+
+TEST_F(AddressSetTest, InvalidPrefixLength) {
+    IPv4AddressSet addresses;
+    EXPECT_THROW(addresses.insert(IPv4Address("1.2.3.4"), 33), exception_base);
+}
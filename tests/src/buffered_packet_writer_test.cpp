@@ -0,0 +1,281 @@
+#include <gtest/gtest.h>
+#include <tins/buffered_packet_writer.h>
+
+#if TINS_IS_CXX11 && !defined(_WIN32)
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iterator>
+#include <cstring>
+#include <cstdlib>
+#include <stdint.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <tins/ethernetII.h>
+#include <tins/ip.h>
+#include <tins/tcp.h>
+#include <tins/rawpdu.h>
+#include <tins/exceptions.h>
+
+using std::string;
+using std::vector;
+
+using namespace Tins;
+
+class BufferedPacketWriterTest : public testing::Test {
+public:
+    struct record {
+        uint32_t seconds;
+        uint32_t microseconds;
+        uint32_t original_size;
+        vector<uint8_t> data;
+    };
+
+    struct file {
+        uint32_t magic;
+        uint32_t snap_length;
+        uint32_t link_type;
+        vector<record> records;
+    };
+
+    static const int LINK_TYPE = 1;
+
+    void SetUp() {
+        char path[] = "/tmp/libtins_writer_XXXXXX";
+        ASSERT_TRUE(mkdtemp(path) != 0);
+        directory = path;
+    }
+
+    void TearDown() {
+        DIR* dir = opendir(directory.c_str());
+        if (dir) {
+            while (dirent* entry = readdir(dir)) {
+                if (entry->d_name[0] != '.') {
+                    unlink((directory + "/" + entry->d_name).c_str());
+                }
+            }
+            closedir(dir);
+        }
+        rmdir(directory.c_str());
+    }
+
+    string path(const string& name) const {
+        return directory + "/" + name;
+    }
+
+    static uint32_t read_uint32(const vector<uint8_t>& buffer, size_t index) {
+        uint32_t value;
+        std::memcpy(&value, &buffer[index], sizeof(value));
+        return value;
+    }
+
+    static file read_file(const string& file_name) {
+        std::ifstream input(file_name.c_str(), std::ios::binary);
+        EXPECT_TRUE(input.good()) << file_name;
+        const vector<uint8_t> buffer((std::istreambuf_iterator<char>(input)),
+                                     std::istreambuf_iterator<char>());
+        file output;
+        EXPECT_GE(buffer.size(), 24UL);
+        if (buffer.size() < 24) {
+            return output;
+        }
+        output.magic = read_uint32(buffer, 0);
+        output.snap_length = read_uint32(buffer, 16);
+        output.link_type = read_uint32(buffer, 20);
+        size_t index = 24;
+        while (index + 16 <= buffer.size()) {
+            record entry;
+            entry.seconds = read_uint32(buffer, index);
+            entry.microseconds = read_uint32(buffer, index + 4);
+            const uint32_t size = read_uint32(buffer, index + 8);
+            entry.original_size = read_uint32(buffer, index + 12);
+            index += 16;
+            EXPECT_LE(index + size, buffer.size());
+            entry.data.assign(buffer.begin() + index, buffer.begin() + index + size);
+            index += size;
+            output.records.push_back(entry);
+        }
+        EXPECT_EQ(buffer.size(), index);
+        return output;
+    }
+
+    static vector<uint8_t> make_payload(size_t size, uint8_t value) {
+        return vector<uint8_t>(size, value);
+    }
+
+    static Timestamp make_timestamp(uint64_t seconds, uint64_t microseconds = 0) {
+        return Timestamp(std::chrono::microseconds(seconds * 1000000 + microseconds));
+    }
+
+    string directory;
+};
+
+TEST_F(BufferedPacketWriterTest, WritePackets) {
+    const string file_name = path("test.pcap");
+    EthernetII eth = EthernetII() / IP("1.2.3.4") / TCP(22, 23) / RawPDU("hello");
+    const vector<uint8_t> payload = make_payload(100, 0x2a);
+    {
+        BufferedPacketWriter writer(file_name, LINK_TYPE);
+        EXPECT_EQ(file_name, writer.current_file_name());
+        writer.write(eth, make_timestamp(1500000000, 123456));
+        writer.write(&payload[0], payload.size(), make_timestamp(1500000001, 42));
+        writer.close();
+        EXPECT_EQ(2UL, writer.packets_written());
+        EXPECT_EQ(0UL, writer.packets_dropped());
+    }
+    const file output = read_file(file_name);
+    EXPECT_EQ(0xa1b2c3d4, output.magic);
+    EXPECT_EQ(65535U, output.snap_length);
+    EXPECT_EQ(static_cast<uint32_t>(LINK_TYPE), output.link_type);
+    ASSERT_EQ(2UL, output.records.size());
+
+    EXPECT_EQ(1500000000U, output.records[0].seconds);
+    EXPECT_EQ(123456U, output.records[0].microseconds);
+    EXPECT_EQ(eth.serialize(), output.records[0].data);
+    EXPECT_EQ(eth.size(), output.records[0].original_size);
+
+    EXPECT_EQ(1500000001U, output.records[1].seconds);
+    EXPECT_EQ(42U, output.records[1].microseconds);
+    EXPECT_EQ(payload, output.records[1].data);
+    EXPECT_EQ(100U, output.records[1].original_size);
+}
+
+TEST_F(BufferedPacketWriterTest, SnapLength) {
+    const string file_name = path("test.pcap");
+    BufferedPacketWriter::options opts;
+    opts.snap_length = 20;
+    EthernetII eth = EthernetII() / IP("1.2.3.4") / TCP(22, 23);
+    const vector<uint8_t> payload = make_payload(100, 0x2a);
+    {
+        BufferedPacketWriter writer(file_name, LINK_TYPE, opts);
+        writer.write(eth, make_timestamp(1));
+        writer.write(&payload[0], payload.size(), make_timestamp(2));
+        writer.write(&payload[0], 10, make_timestamp(3), 1500);
+    }
+    const file output = read_file(file_name);
+    EXPECT_EQ(20U, output.snap_length);
+    ASSERT_EQ(3UL, output.records.size());
+    const vector<uint8_t> serialized = eth.serialize();
+    EXPECT_EQ(vector<uint8_t>(serialized.begin(), serialized.begin() + 20), 
+              output.records[0].data);
+    EXPECT_EQ(serialized.size(), output.records[0].original_size);
+    EXPECT_EQ(make_payload(20, 0x2a), output.records[1].data);
+    EXPECT_EQ(100U, output.records[1].original_size);
+    EXPECT_EQ(make_payload(10, 0x2a), output.records[2].data);
+    EXPECT_EQ(1500U, output.records[2].original_size);
+}
+
+TEST_F(BufferedPacketWriterTest, ManyBuffers) {
+    const string file_name = path("test.pcap");
+    BufferedPacketWriter::options opts;
+    opts.buffer_count = 2;
+    opts.buffer_size = 1;
+    opts.snap_length = 1000;
+    const size_t packet_count = 20000;
+    {
+        BufferedPacketWriter writer(file_name, LINK_TYPE, opts);
+        for (size_t i = 0; i < packet_count; ++i) {
+            const vector<uint8_t> payload = make_payload(i % 1000 + 1, static_cast<uint8_t>(i));
+            writer.write(&payload[0], payload.size(), make_timestamp(i));
+        }
+        writer.close();
+        EXPECT_EQ(packet_count, writer.packets_written());
+    }
+    const file output = read_file(file_name);
+    ASSERT_EQ(packet_count, output.records.size());
+    for (size_t i = 0; i < packet_count; ++i) {
+        EXPECT_EQ(i, output.records[i].seconds);
+        EXPECT_EQ(make_payload(i % 1000 + 1, static_cast<uint8_t>(i)), output.records[i].data);
+    }
+}
+
+TEST_F(BufferedPacketWriterTest, Flush) {
+    const string file_name = path("test.pcap");
+    const vector<uint8_t> payload = make_payload(50, 1);
+    BufferedPacketWriter writer(file_name, LINK_TYPE);
+    EXPECT_EQ(0UL, read_file(file_name).records.size());
+    writer.write(&payload[0], payload.size(), make_timestamp(1));
+    writer.write(&payload[0], payload.size(), make_timestamp(2));
+    writer.flush();
+    EXPECT_EQ(2UL, read_file(file_name).records.size());
+    writer.write(&payload[0], payload.size(), make_timestamp(3));
+    writer.close();
+    EXPECT_EQ(3UL, read_file(file_name).records.size());
+    EXPECT_THROW(writer.write(&payload[0], payload.size(), make_timestamp(4)), 
+                 file_write_error);
+}
+
+TEST_F(BufferedPacketWriterTest, RotateBySize) {
+    const string file_name = path("test.pcap");
+    BufferedPacketWriter::options opts;
+    // Room for 3 records of 100 bytes per file
+    opts.rotate_size = 24 + 3 * (16 + 100);
+    const vector<uint8_t> payload = make_payload(100, 1);
+    {
+        BufferedPacketWriter writer(file_name, LINK_TYPE, opts);
+        for (size_t i = 0; i < 10; ++i) {
+            writer.write(&payload[0], payload.size(), make_timestamp(i));
+        }
+        EXPECT_EQ(file_name + "3", writer.current_file_name());
+    }
+    EXPECT_EQ(3UL, read_file(file_name).records.size());
+    EXPECT_EQ(3UL, read_file(file_name + "1").records.size());
+    EXPECT_EQ(3UL, read_file(file_name + "2").records.size());
+    const file last = read_file(file_name + "3");
+    ASSERT_EQ(1UL, last.records.size());
+    EXPECT_EQ(9U, last.records[0].seconds);
+}
+
+TEST_F(BufferedPacketWriterTest, RotateBySizeMaxFiles) {
+    const string file_name = path("test.pcap");
+    BufferedPacketWriter::options opts;
+    opts.rotate_size = 24 + 2 * (16 + 100);
+    opts.max_files = 2;
+    const vector<uint8_t> payload = make_payload(100, 1);
+    {
+        BufferedPacketWriter writer(file_name, LINK_TYPE, opts);
+        EXPECT_EQ(file_name + "0", writer.current_file_name());
+        for (size_t i = 0; i < 5; ++i) {
+            writer.write(&payload[0], payload.size(), make_timestamp(i));
+        }
+    }
+    // The first file was overwritten by the third one
+    const file first = read_file(file_name + "0");
+    ASSERT_EQ(1UL, first.records.size());
+    EXPECT_EQ(4U, first.records[0].seconds);
+    EXPECT_EQ(2UL, read_file(file_name + "1").records.size());
+}
+
+TEST_F(BufferedPacketWriterTest, RotateByInterval) {
+    const string file_name = path("test-%s.pcap");
+    BufferedPacketWriter::options opts;
+    opts.rotate_interval = 10;
+    const vector<uint8_t> payload = make_payload(10, 1);
+    string first_file_name;
+    {
+        BufferedPacketWriter writer(file_name, LINK_TYPE, opts);
+        first_file_name = writer.current_file_name();
+        writer.write(&payload[0], payload.size(), make_timestamp(1000));
+        writer.write(&payload[0], payload.size(), make_timestamp(1009));
+        writer.write(&payload[0], payload.size(), make_timestamp(1010));
+        EXPECT_EQ(path("test-1010.pcap"), writer.current_file_name());
+        writer.write(&payload[0], payload.size(), make_timestamp(1015));
+        // Timestamps going backwards don't cause a rotation
+        writer.write(&payload[0], payload.size(), make_timestamp(900));
+        writer.write(&payload[0], payload.size(), make_timestamp(1025));
+        EXPECT_EQ(path("test-1025.pcap"), writer.current_file_name());
+    }
+    EXPECT_EQ(2UL, read_file(first_file_name).records.size());
+    EXPECT_EQ(3UL, read_file(path("test-1010.pcap")).records.size());
+    EXPECT_EQ(1UL, read_file(path("test-1025.pcap")).records.size());
+}
+
+TEST_F(BufferedPacketWriterTest, InvalidFile) {
+    EXPECT_THROW(
+        BufferedPacketWriter(path("missing/test.pcap"), LINK_TYPE),
+        file_write_error
+    );
+}
+
+#endif // TINS_IS_CXX11 && !_WIN32
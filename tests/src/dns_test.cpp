@@ -2,6 +2,8 @@
 #include <iostream>
 #include <tins/dns.h>
 #include <tins/ipv6_address.h>
+#include <tins/ip_address.h>
+#include <tins/exceptions.h>
 
 using namespace Tins;
 
@@ -156,6 +158,252 @@ TEST_F(DNSTest, ConstructorFromBuffer3) {
     EXPECT_EQ("version.bind", queries.front().dname());
 }
 
+TEST_F(DNSTest, RecordReader) {
+    DNS::record_reader reader(dns_response1, sizeof(dns_response1));
+    DNS::record_view record;
+    char name[DNS::name_view::MAX_NAME_SIZE];
+
+    ASSERT_TRUE(reader.next(record));
+    EXPECT_EQ(DNS::record_view::QUESTION, record.section());
+    EXPECT_EQ(DNS::MX, record.query_type());
+    EXPECT_EQ(DNS::INTERNET, record.query_class());
+    EXPECT_EQ(10U, record.dname().decode(name, sizeof(name)));
+    EXPECT_EQ("google.com", std::string(name));
+    EXPECT_TRUE(record.dname().equals("GOOGLE.com"));
+    EXPECT_FALSE(record.dname().equals("google.co"));
+    EXPECT_FALSE(record.dname().equals("google.comm"));
+    EXPECT_TRUE(record.dname().equals("google.com."));
+    EXPECT_FALSE(record.dname().equals("google.com.."));
+    EXPECT_FALSE(record.dname().equals("google.com.x"));
+    uint32_t encoded_size = 0;
+    EXPECT_EQ(10U, record.dname().decode(name, sizeof(name), encoded_size));
+    EXPECT_EQ(12U, encoded_size);
+
+    const char* expected_names[] = {
+        "alt4.aspmx.l.google.com", "alt3.aspmx.l.google.com", "alt1.aspmx.l.google.com",
+        "aspmx.l.google.com", "alt2.aspmx.l.google.com"
+    };
+    const uint16_t expected_preferences[] = { 50, 40, 20, 10, 30 };
+    for (size_t i = 0; i < 5; ++i) {
+        ASSERT_TRUE(reader.next(record));
+        EXPECT_EQ(DNS::record_view::ANSWER, record.section());
+        EXPECT_EQ(DNS::MX, record.query_type());
+        EXPECT_EQ(600U, record.ttl());
+        EXPECT_TRUE(record.dname().equals("google.com"));
+        EXPECT_EQ(expected_preferences[i], record.preference());
+        EXPECT_EQ(expected_names[i], record.data_name().to_string());
+        // Every name in the data ends with a pointer
+        record.data_name().decode(name, sizeof(name), encoded_size);
+        EXPECT_EQ(record.data_size() - sizeof(uint16_t), encoded_size);
+    }
+    EXPECT_FALSE(reader.next(record));
+}
+
+TEST_F(DNSTest, RecordReaderFromPDU) {
+    DNS dns(expected_packet, sizeof(expected_packet));
+    DNS::record_reader reader(dns);
+    DNS::record_view record;
+    ASSERT_TRUE(reader.next(record));
+    EXPECT_EQ(DNS::record_view::QUESTION, record.section());
+    EXPECT_EQ("www.example.com", record.dname().to_string());
+    ASSERT_TRUE(reader.next(record));
+    EXPECT_EQ(DNS::record_view::ANSWER, record.section());
+    EXPECT_EQ(DNS::A, record.query_type());
+    EXPECT_EQ(0x1234U, record.ttl());
+    ASSERT_EQ(4, record.data_size());
+    EXPECT_EQ(IPv4Address("192.168.0.1"), IPv4Address(*(const uint32_t*)record.data_ptr()));
+    EXPECT_TRUE(record.data_name().empty());
+    EXPECT_FALSE(reader.next(record));
+}
+
+TEST_F(DNSTest, RecordReaderMalformedNames) {
+    // A name that points to itself
+    const uint8_t pointer_loop[] = {
+        0, 1, 1, 0, 0, 1, 0, 0, 0, 0, 0, 0, 192, 12, 0, 1, 0, 1
+    };
+    DNS::record_reader reader(pointer_loop, sizeof(pointer_loop));
+    DNS::record_view record;
+    ASSERT_TRUE(reader.next(record));
+    char name[DNS::name_view::MAX_NAME_SIZE];
+    EXPECT_THROW(record.dname().decode(name, sizeof(name)), malformed_packet);
+    EXPECT_THROW(record.dname().equals("example.com"), malformed_packet);
+
+    // The record says there's one question but it's truncated
+    DNS::record_reader truncated_reader(pointer_loop, sizeof(pointer_loop) - 2);
+    EXPECT_THROW(truncated_reader.next(record), malformed_packet);
+}
+
+TEST_F(DNSTest, MessageBuilder) {
+    DNS::message_builder builder;
+    builder.add_query(DNS::query("www.example.com", DNS::A, DNS::INTERNET));
+    builder.add_answer(
+        DNS::resource("www.example.com", "192.168.0.1", DNS::A, DNS::INTERNET, 0x1234)
+    );
+    builder.add_answer(
+        DNS::resource("WWW.example.com", "::1", DNS::AAAA, DNS::INTERNET, 0x1234)
+    );
+    builder.add_authority(
+        DNS::resource("example.com", "ns1.example.com", DNS::NS, DNS::INTERNET, 60)
+    );
+    builder.add_additional(
+        DNS::resource("example.com", "mail.example.com", DNS::MX, DNS::INTERNET, 60, 10)
+    );
+    DNS dns = builder.build();
+    // The query name is written in full, every other name is compressed:
+    // header (12) + query (17 + 4) + A (2 + 10 + 4) + AAAA (2 + 10 + 16) + 
+    // NS (2 + 10 + 4 + 2) + MX (2 + 10 + 2 + 5 + 2)
+    EXPECT_EQ(116U, dns.size());
+
+    PDU::serialization_type buffer = dns.serialize();
+    DNS parsed(&buffer[0], buffer.size());
+    EXPECT_EQ(1, parsed.questions_count());
+    EXPECT_EQ(2, parsed.answers_count());
+    EXPECT_EQ(1, parsed.authority_count());
+    EXPECT_EQ(1, parsed.additional_count());
+    test_equals(parsed.queries().front(), DNS::query("www.example.com", DNS::A,
+                                                     DNS::INTERNET));
+    DNS::resources_type answers = parsed.answers();
+    ASSERT_EQ(2U, answers.size());
+    test_equals(answers[0], DNS::resource("www.example.com", "192.168.0.1", DNS::A,
+                                          DNS::INTERNET, 0x1234));
+    test_equals(answers[1], DNS::resource("www.example.com", "::1", DNS::AAAA,
+                                          DNS::INTERNET, 0x1234));
+    DNS::resources_type authority = parsed.authority();
+    ASSERT_EQ(1U, authority.size());
+    test_equals(authority[0], DNS::resource("example.com", "ns1.example.com", DNS::NS,
+                                            DNS::INTERNET, 60));
+    DNS::resources_type additional = parsed.additional();
+    ASSERT_EQ(1U, additional.size());
+    test_equals(additional[0], DNS::resource("example.com", "mail.example.com", DNS::MX,
+                                             DNS::INTERNET, 60, 10));
+
+    // Records can still be added to the built PDU
+    dns.add_answer(DNS::resource("foo.bar", "10.0.0.1", DNS::A, DNS::INTERNET, 1));
+    buffer = dns.serialize();
+    parsed = DNS(&buffer[0], buffer.size());
+    EXPECT_EQ(3U, parsed.answers().size());
+    EXPECT_EQ("ns1.example.com", parsed.authority().front().data());
+}
+
+TEST_F(DNSTest, MessageBuilderFailuresLeaveBuilderUntouched) {
+    DNS::message_builder builder;
+    builder.add_answer(DNS::resource("example.com", "1.2.3.4", DNS::A, DNS::INTERNET, 1));
+    const size_t size = builder.size();
+    EXPECT_THROW(
+        builder.add_additional(DNS::resource("www.a..example.com", "1.2.3.4", DNS::A,
+                                             DNS::INTERNET, 1)),
+        invalid_domain_name
+    );
+    EXPECT_THROW(
+        builder.add_additional(DNS::resource("www.example.com", "1.2.3", DNS::A,
+                                             DNS::INTERNET, 1)),
+        invalid_address
+    );
+    EXPECT_THROW(
+        builder.add_additional(DNS::resource("www.example.com", "dead::beef::1", DNS::AAAA,
+                                             DNS::INTERNET, 1)),
+        invalid_address
+    );
+    EXPECT_THROW(
+        builder.add_additional(DNS::resource("www.example.com", "a..com", DNS::CNAME,
+                                             DNS::INTERNET, 1)),
+        invalid_domain_name
+    );
+    EXPECT_EQ(size, builder.size());
+
+    // The section didn't move on and names must not be compressed against 
+    // data written by the failed records
+    builder.add_answer(DNS::resource("www.example.com", "1.2.3.5", DNS::A, DNS::INTERNET, 1));
+    DNS dns = builder.build();
+    PDU::serialization_type buffer = dns.serialize();
+    DNS parsed(&buffer[0], buffer.size());
+    DNS::resources_type answers = parsed.answers();
+    ASSERT_EQ(2U, answers.size());
+    EXPECT_EQ("www.example.com", answers[1].dname());
+    EXPECT_EQ(0U, parsed.additional_count());
+}
+
+TEST_F(DNSTest, MessageBuilderNameSizeLimit) {
+    // 4 labels of 61 bytes + "abcde" take exactly 255 bytes once encoded
+    const std::string label(61, 'a');
+    const std::string name = label + "." + label + "." + label + "." + label + ".abcde";
+    DNS::message_builder builder;
+    builder.add_query(DNS::query(name, DNS::A, DNS::INTERNET));
+    builder.add_query(DNS::query(name + ".", DNS::A, DNS::INTERNET));
+    const size_t size = builder.size();
+    EXPECT_THROW(
+        builder.add_query(DNS::query(name + "d", DNS::A, DNS::INTERNET)),
+        invalid_domain_name
+    );
+    EXPECT_THROW(
+        builder.add_answer(DNS::resource("example.com", name + "d", DNS::CNAME,
+                                         DNS::INTERNET, 1)),
+        invalid_domain_name
+    );
+    EXPECT_EQ(size, builder.size());
+
+    DNS dns = builder.build();
+    PDU::serialization_type buffer = dns.serialize();
+    DNS parsed(&buffer[0], buffer.size());
+    DNS::queries_type queries = parsed.queries();
+    ASSERT_EQ(2U, queries.size());
+    EXPECT_EQ(name, queries[0].dname());
+    EXPECT_EQ(name, queries[1].dname());
+}
+
+TEST_F(DNSTest, MessageBuilderCompression) {
+    DNS::message_builder builder;
+    builder.add_query(DNS::query("www.example.com", DNS::A, DNS::INTERNET));
+    // Only "mail" is written, followed by a pointer to "example.com"
+    builder.add_query(DNS::query("mail.EXAMPLE.com", DNS::A, DNS::INTERNET));
+    // Same labels in a different order must not be compressed together
+    builder.add_query(DNS::query("com.example.www", DNS::A, DNS::INTERNET));
+    // Whole name is a pointer
+    builder.add_query(DNS::query("Mail.Example.Com.", DNS::A, DNS::INTERNET));
+    // "examplf" shares a prefix but is a different label
+    builder.add_query(DNS::query("www.examplf.com", DNS::A, DNS::INTERNET));
+    // (17 + 4) + (5 + 2 + 4) + (17 + 4) + (2 + 4) + (12 + 2 + 4)
+    EXPECT_EQ(77U, builder.size());
+
+    DNS dns = builder.build();
+    PDU::serialization_type buffer = dns.serialize();
+    DNS parsed(&buffer[0], buffer.size());
+    DNS::queries_type queries = parsed.queries();
+    ASSERT_EQ(5U, queries.size());
+    EXPECT_EQ("www.example.com", queries[0].dname());
+    EXPECT_EQ("mail.example.com", queries[1].dname());
+    EXPECT_EQ("com.example.www", queries[2].dname());
+    EXPECT_EQ("mail.example.com", queries[3].dname());
+    EXPECT_EQ("www.examplf.com", queries[4].dname());
+}
+
+TEST_F(DNSTest, MessageBuilderSectionOrder) {
+    DNS::message_builder builder;
+    builder.add_authority(
+        DNS::resource("example.com", "ns1.example.com", DNS::NS, DNS::INTERNET, 60)
+    );
+    EXPECT_THROW(
+        builder.add_query(DNS::query("www.example.com", DNS::A, DNS::INTERNET)),
+        invalid_section_order
+    );
+    EXPECT_THROW(
+        builder.add_answer(DNS::resource("example.com", "1.2.3.4", DNS::A, DNS::INTERNET, 1)),
+        invalid_section_order
+    );
+    EXPECT_THROW(
+        builder.add_additional(DNS::resource("a..b", "1.2.3.4", DNS::A, DNS::INTERNET, 1)),
+        invalid_domain_name
+    );
+
+    builder.clear();
+    EXPECT_EQ(0U, builder.size());
+    builder.add_answer(DNS::resource("example.com", "1.2.3.4", DNS::A, DNS::INTERNET, 1));
+    DNS dns = builder.build();
+    EXPECT_EQ(0U, dns.queries().size());
+    EXPECT_EQ(1U, dns.answers().size());
+    EXPECT_EQ(0U, dns.authority().size());
+}
+
 TEST_F(DNSTest, NoRecords) {
     DNS dns;
     EXPECT_TRUE(dns.queries().empty());
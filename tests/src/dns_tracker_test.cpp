@@ -0,0 +1,189 @@
+#include <gtest/gtest.h>
+#include <tins/dns_tracker.h>
+
+#if TINS_IS_CXX11
+
+#include <vector>
+#include <tins/dns.h>
+#include <tins/ethernetII.h>
+#include <tins/ip.h>
+#include <tins/ipv6.h>
+#include <tins/udp.h>
+#include <tins/rawpdu.h>
+
+using std::vector;
+
+using namespace Tins;
+
+class DNSTrackerTest : public testing::Test {
+public:
+    typedef DNSTransactionTracker::timestamp_type timestamp_type;
+
+    static EthernetII make_query(uint16_t id, const char* name, const char* client,
+                                 const char* server, uint16_t client_port = 1234);
+    static EthernetII make_response(uint16_t id, const char* name, const char* client,
+                                    const char* server, uint16_t client_port = 1234);
+    static timestamp_type ms(int64_t value);
+};
+
+EthernetII DNSTrackerTest::make_query(uint16_t id, const char* name, const char* client,
+                                      const char* server, uint16_t client_port) {
+    DNS dns;
+    dns.id(id);
+    dns.add_query(DNS::query(name, DNS::A, DNS::INTERNET));
+    const vector<uint8_t> buffer = dns.serialize();
+    // Use a raw payload, just like sniffed packets do
+    return EthernetII() / IP(server, client) / UDP(53, client_port) / 
+           RawPDU(buffer.begin(), buffer.end());
+}
+
+EthernetII DNSTrackerTest::make_response(uint16_t id, const char* name, const char* client,
+                                         const char* server, uint16_t client_port) {
+    DNS dns;
+    dns.id(id);
+    dns.type(DNS::RESPONSE);
+    dns.add_query(DNS::query(name, DNS::A, DNS::INTERNET));
+    dns.add_answer(DNS::resource(name, "1.2.3.4", DNS::A, DNS::INTERNET, 60));
+    const vector<uint8_t> buffer = dns.serialize();
+    return EthernetII() / IP(client, server) / UDP(client_port, 53) / 
+           RawPDU(buffer.begin(), buffer.end());
+}
+
+DNSTrackerTest::timestamp_type DNSTrackerTest::ms(int64_t value) {
+    return std::chrono::milliseconds(value);
+}
+
+TEST_F(DNSTrackerTest, MatchesResponses) {
+    DNSTransactionTracker tracker;
+    EXPECT_EQ(DNSTransactionTracker::QUERY, 
+              tracker.process(make_query(1, "www.example.com", "10.0.0.1", "8.8.8.8"), ms(1000)));
+    EXPECT_EQ(DNSTransactionTracker::DUPLICATE_QUERY, 
+              tracker.process(make_query(1, "www.example.com", "10.0.0.1", "8.8.8.8"), ms(1100)));
+    EXPECT_EQ(1U, tracker.pending_queries());
+    // Same identifier but a different question or client port
+    EXPECT_EQ(DNSTransactionTracker::UNMATCHED_RESPONSE, 
+              tracker.process(make_response(1, "www.example.org", "10.0.0.1", "8.8.8.8"), ms(1150)));
+    EXPECT_EQ(DNSTransactionTracker::UNMATCHED_RESPONSE, 
+              tracker.process(make_response(1, "www.example.com", "10.0.0.1", "8.8.8.8", 4321),
+                              ms(1150)));
+    // Names are case insensitive
+    EXPECT_EQ(DNSTransactionTracker::RESPONSE, 
+              tracker.process(make_response(1, "WWW.example.com", "10.0.0.1", "8.8.8.8"), ms(1200)));
+    EXPECT_EQ(0U, tracker.pending_queries());
+
+    const DNSTransactionTracker::statistics& stats = tracker.stats();
+    EXPECT_EQ(2U, stats.queries);
+    EXPECT_EQ(1U, stats.duplicate_queries);
+    EXPECT_EQ(2U, stats.unmatched_responses);
+    EXPECT_EQ(1U, stats.total.latency.count());
+    EXPECT_EQ(ms(200), stats.total.latency.max());
+    ASSERT_EQ(1U, stats.ipv4_servers.count("8.8.8.8"));
+    EXPECT_EQ(1U, stats.ipv4_servers.find("8.8.8.8")->second.latency.count());
+    ASSERT_EQ(1U, stats.query_types.count(DNS::A));
+    EXPECT_EQ(1U, stats.query_types.find(DNS::A)->second.latency.count());
+}
+
+TEST_F(DNSTrackerTest, MatchesDNSPDUs) {
+    DNSTransactionTracker tracker;
+    DNS query;
+    query.id(7);
+    query.add_query(DNS::query("example.com", DNS::AAAA, DNS::INTERNET));
+    DNS response = query;
+    response.type(DNS::RESPONSE);
+    EthernetII first = EthernetII() / IPv6("dead::53", "dead::1") / UDP(53, 5000) / query;
+    EthernetII second = EthernetII() / IPv6("dead::1", "dead::53") / UDP(5000, 53) / response;
+    EXPECT_EQ(DNSTransactionTracker::QUERY, tracker.process(first, ms(0)));
+    EXPECT_EQ(DNSTransactionTracker::RESPONSE, tracker.process(second, ms(3)));
+    const DNSTransactionTracker::statistics& stats = tracker.stats();
+    ASSERT_EQ(1U, stats.ipv6_servers.count("dead::53"));
+    EXPECT_EQ(ms(3), stats.ipv6_servers.find("dead::53")->second.latency.mean());
+    EXPECT_EQ(1U, stats.query_types.count(DNS::AAAA));
+}
+
+TEST_F(DNSTrackerTest, IgnoresOtherTraffic) {
+    DNSTransactionTracker tracker;
+    EthernetII other = EthernetII() / IP("1.1.1.1") / UDP(80, 1234) / RawPDU("hello");
+    EXPECT_EQ(DNSTransactionTracker::NOT_DNS, tracker.process(other, ms(0)));
+    EthernetII malformed = EthernetII() / IP("1.1.1.1") / UDP(53, 1234) / RawPDU("hello");
+    EXPECT_EQ(DNSTransactionTracker::NOT_DNS, tracker.process(malformed, ms(0)));
+    EXPECT_EQ(0U, tracker.stats().queries);
+}
+
+TEST_F(DNSTrackerTest, ExpiresUnansweredQueries) {
+    DNSTransactionTracker tracker;
+    tracker.timeout(std::chrono::seconds(2));
+    tracker.process(make_query(1, "a.com", "10.0.0.1", "8.8.8.8"), ms(0));
+    tracker.process(make_query(2, "b.com", "10.0.0.1", "8.8.4.4"), ms(1500));
+    tracker.advance(ms(1999));
+    EXPECT_EQ(2U, tracker.pending_queries());
+    tracker.advance(ms(2000));
+    EXPECT_EQ(1U, tracker.pending_queries());
+    const DNSTransactionTracker::statistics& stats = tracker.stats();
+    EXPECT_EQ(1U, stats.total.unanswered);
+    EXPECT_EQ(1U, stats.ipv4_servers.find("8.8.8.8")->second.unanswered);
+    EXPECT_EQ(1U, stats.query_types.find(DNS::A)->second.unanswered);
+    // A response after the timeout doesn't match
+    EXPECT_EQ(DNSTransactionTracker::UNMATCHED_RESPONSE, 
+              tracker.process(make_response(1, "a.com", "10.0.0.1", "8.8.8.8"), ms(2100)));
+    // A long gap expires everything
+    tracker.advance(ms(60000));
+    EXPECT_EQ(0U, tracker.pending_queries());
+    EXPECT_EQ(2U, stats.total.unanswered);
+}
+
+TEST_F(DNSTrackerTest, MaxPendingQueries) {
+    DNSTransactionTracker tracker;
+    tracker.max_pending_queries(2);
+    tracker.process(make_query(1, "a.com", "10.0.0.1", "8.8.8.8"), ms(0));
+    tracker.process(make_query(2, "a.com", "10.0.0.1", "8.8.8.8"), ms(0));
+    EXPECT_EQ(DNSTransactionTracker::DROPPED_QUERY,
+              tracker.process(make_query(3, "a.com", "10.0.0.1", "8.8.8.8"), ms(0)));
+    EXPECT_EQ(2U, tracker.pending_queries());
+    EXPECT_EQ(1U, tracker.stats().dropped_queries);
+    tracker.process(make_response(1, "a.com", "10.0.0.1", "8.8.8.8"), ms(10));
+    EXPECT_EQ(DNSTransactionTracker::QUERY,
+              tracker.process(make_query(3, "a.com", "10.0.0.1", "8.8.8.8"), ms(10)));
+}
+
+TEST_F(DNSTrackerTest, Shards) {
+    const size_t shard_count = 8;
+    vector<DNSTransactionTracker> trackers(shard_count);
+    for (uint16_t i = 0; i < 32; ++i) {
+        EthernetII query = make_query(i, "a.com", "10.0.0.1", "8.8.8.8", 1000 + i);
+        EthernetII response = make_response(i, "a.com", "10.0.0.1", "8.8.8.8", 1000 + i);
+        const size_t index = DNSTransactionTracker::shard(query, shard_count);
+        EXPECT_EQ(index, DNSTransactionTracker::shard(response, shard_count));
+        trackers[index].process(query, ms(0));
+        EXPECT_EQ(DNSTransactionTracker::RESPONSE, trackers[index].process(response, ms(i)));
+    }
+    DNSTransactionTracker::statistics stats;
+    for (size_t i = 0; i < shard_count; ++i) {
+        stats.merge(trackers[i].stats());
+    }
+    EXPECT_EQ(32U, stats.queries);
+    EXPECT_EQ(32U, stats.total.latency.count());
+    EXPECT_EQ(ms(31), stats.total.latency.max());
+    EXPECT_EQ(32U, stats.ipv4_servers.find("8.8.8.8")->second.latency.count());
+}
+
+TEST_F(DNSTrackerTest, LatencyHistogram) {
+    DNSTransactionTracker::latency_histogram histogram;
+    EXPECT_EQ(timestamp_type(0), histogram.percentile(0.5));
+    histogram.add(timestamp_type(1));
+    histogram.add(timestamp_type(3));
+    histogram.add(timestamp_type(1000));
+    histogram.add(timestamp_type(1500));
+    EXPECT_EQ(1U, histogram.bucket(0));
+    EXPECT_EQ(1U, histogram.bucket(1));
+    // 1000 and 1500 lie in [1024, 2048) and [512, 1024)
+    EXPECT_EQ(1U, histogram.bucket(9));
+    EXPECT_EQ(1U, histogram.bucket(10));
+    EXPECT_EQ(timestamp_type(1), histogram.min());
+    EXPECT_EQ(timestamp_type(1500), histogram.max());
+    EXPECT_EQ(timestamp_type(626), histogram.mean());
+    EXPECT_EQ(timestamp_type(4), histogram.percentile(0.5));
+    EXPECT_EQ(timestamp_type(1024), histogram.percentile(0.75));
+    EXPECT_EQ(timestamp_type(1500), histogram.percentile(1.0));
+}
+
+#endif // TINS_IS_CXX11
@@ -5,6 +5,7 @@
 #include <sstream>
 #include <stdint.h>
 #include <tins/hw_address.h>
+#include <tins/exceptions.h>
 
 using namespace Tins;
 
@@ -108,6 +109,22 @@ TEST_F(HWAddressTest, OutputOperator) {
     EXPECT_EQ(oss.str(), address);
 }
 
+TEST_F(HWAddressTest, ToChars) {
+    char buffer[HWAddress<6>::max_string_length];
+    const HWAddress<6> addr(address);
+    EXPECT_EQ(17UL, sizeof(buffer));
+    EXPECT_EQ(address, std::string(buffer, addr.to_chars(buffer, sizeof(buffer))));
+    EXPECT_EQ(0UL, addr.to_chars(buffer, sizeof(buffer) - 1));
+    EXPECT_EQ("ab:cd:ef:01:23:45", HWAddress<6>("AB:CD:EF:01:23:45").to_string());
+}
+
+TEST_F(HWAddressTest, InvalidString) {
+    EXPECT_THROW(HWAddress<6>("00:de:ad:be:ef:0"), invalid_address);
+    EXPECT_THROW(HWAddress<6>("00:de:ad:be:ef:0g"), invalid_address);
+    EXPECT_THROW(HWAddress<6>("00-de-ad-be-ef-00"), invalid_address);
+    EXPECT_THROW(HWAddress<6>(std::string("00:de:ad:be:ef:0")), invalid_address);
+}
+
 TEST_F(HWAddressTest, Mask) {
     typedef HWAddress<6> address_type;
     EXPECT_EQ(
@@ -0,0 +1,94 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include <tins/interface_cache.h>
+#include <tins/network_interface.h>
+
+using std::string;
+using std::vector;
+
+using namespace Tins;
+
+class InterfaceCacheTest : public testing::Test {
+public:
+    typedef InterfaceSnapshot::entry_type entry_type;
+
+    static entry_type make_entry(InterfaceSnapshot::id_type id, const string& name) {
+        entry_type entry;
+        entry.id = id;
+        entry.name = name;
+        entry.friendly_name = std::wstring(name.begin(), name.end());
+        entry.info.is_up = true;
+        entry.has_addresses = true;
+        return entry;
+    }
+};
+
+TEST_F(InterfaceCacheTest, SnapshotLookup) {
+    InterfaceSnapshot::entries_type entries;
+    entries.push_back(make_entry(1, "lo"));
+    entries.push_back(make_entry(7, "eth0"));
+    const InterfaceSnapshot snapshot(entries);
+    EXPECT_EQ(2U, snapshot.size());
+
+    const entry_type* entry = snapshot.find(7);
+    ASSERT_TRUE(entry != 0);
+    EXPECT_EQ("eth0", entry->name);
+
+    entry = snapshot.find(string("lo"));
+    ASSERT_TRUE(entry != 0);
+    EXPECT_EQ(1U, entry->id);
+
+    EXPECT_TRUE(snapshot.find(2) == 0);
+    EXPECT_TRUE(snapshot.find(string("eth1")) == 0);
+    EXPECT_TRUE(InterfaceSnapshot().find(1) == 0);
+}
+
+#ifndef _WIN32
+TEST_F(InterfaceCacheTest, CaptureMatchesInterfaces) {
+    const InterfaceSnapshot snapshot = InterfaceSnapshot::capture();
+    const InterfaceSnapshot::entries_type& interfaces = snapshot.interfaces();
+    ASSERT_FALSE(interfaces.empty());
+    for (size_t i = 0; i < interfaces.size(); ++i) {
+        NetworkInterface iface(interfaces[i].name);
+        EXPECT_EQ(iface.id(), interfaces[i].id);
+        EXPECT_EQ(&interfaces[i], snapshot.find(interfaces[i].id));
+    }
+}
+
+TEST_F(InterfaceCacheTest, Find) {
+    InterfaceCache cache;
+    InterfaceCache::entry_type by_name, by_id;
+    const NetworkInterface iface = NetworkInterface::all().front();
+    ASSERT_TRUE(cache.find(iface.name(), by_name));
+    ASSERT_TRUE(cache.find(iface.id(), by_id));
+    EXPECT_EQ(by_name.name, by_id.name);
+    EXPECT_EQ(iface.id(), by_name.id);
+    EXPECT_FALSE(cache.find(string("ishallnotexist"), by_name));
+
+    cache.invalidate();
+    EXPECT_EQ(NetworkInterface::all().size(), cache.snapshot()->size());
+}
+
+#if TINS_IS_CXX11
+TEST_F(InterfaceCacheTest, MissesAreRateLimited) {
+    InterfaceCache cache;
+    InterfaceCache::entry_type entry;
+    const InterfaceCache::snapshot_ptr first = cache.snapshot();
+    InterfaceCache::snapshot_ptr previous = first;
+    size_t snapshots_taken = 0;
+    // At most one new snapshot can be taken while these run
+    for (size_t i = 0; i < 1000; ++i) {
+        EXPECT_FALSE(cache.find(string("ishallnotexist"), entry));
+        InterfaceCache::snapshot_ptr current = cache.snapshot();
+        if (current != previous) {
+            ++snapshots_taken;
+            previous = current;
+        }
+    }
+    EXPECT_LE(snapshots_taken, 1U);
+    // Snapshots handed out are never modified
+    EXPECT_EQ(NetworkInterface::all().size(), first->size());
+}
+#endif // TINS_IS_CXX11
+#endif // _WIN32
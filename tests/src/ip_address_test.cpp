@@ -4,6 +4,7 @@
 #include <sstream>
 #include <stdint.h>
 #include <tins/ip_address.h>
+#include <tins/exceptions.h>
 
 using namespace Tins;
 
@@ -116,3 +117,42 @@ TEST(IPv4AddressTest, Size) {
     EXPECT_EQ(4UL, IPv4Address("127.0.0.1").size());
     EXPECT_EQ(4UL, IPv4Address().size());
 }
+
+TEST(IPv4AddressTest, FromPrefixLength) {
+    EXPECT_EQ(IPv4Address("0.0.0.0"), IPv4Address::from_prefix_length(0));
+    EXPECT_EQ(IPv4Address("255.255.240.0"), IPv4Address::from_prefix_length(20));
+    EXPECT_EQ(IPv4Address("255.255.255.255"), IPv4Address::from_prefix_length(32));
+}
+
+TEST(IPv4AddressTest, ToChars) {
+    char buffer[IPv4Address::max_string_length];
+    const char* addresses[] = {
+        "0.0.0.0", "1.2.3.4", "10.20.30.40", "192.168.100.255", "255.255.255.255"
+    };
+    for (size_t i = 0; i < sizeof(addresses) / sizeof(addresses[0]); ++i) {
+        const size_t length = IPv4Address(addresses[i]).to_chars(buffer, sizeof(buffer));
+        EXPECT_EQ(std::string(addresses[i]), std::string(buffer, length));
+    }
+    EXPECT_EQ(0UL, IPv4Address("192.168.100.255").to_chars(buffer, 14));
+    EXPECT_EQ(7UL, IPv4Address("1.2.3.4").to_chars(buffer, 7));
+}
+
+TEST(IPv4AddressTest, FromChars) {
+    IPv4Address address;
+    const std::string input = "192.168.0.1 trailing";
+    EXPECT_TRUE(IPv4Address::from_chars(input.data(), input.data() + 11, address));
+    EXPECT_EQ(IPv4Address("192.168.0.1"), address);
+
+    const char* invalid[] = {
+        "", "1.2.3", "1.2.3.4.5", "1.2.3.", ".1.2.3", "1..2.3", "256.1.1.1",
+        "01.2.3.4", "1.2.3.4a", "1.2.3.-4", " 1.2.3.4", "1000.1.1.1"
+    };
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); ++i) {
+        const char* str = invalid[i];
+        address = "5.6.7.8";
+        EXPECT_FALSE(IPv4Address::from_chars(str, str + strlen(str), address)) << str;
+        EXPECT_EQ(IPv4Address("5.6.7.8"), address);
+    }
+    EXPECT_THROW(IPv4Address("01.2.3.4"), invalid_address);
+    EXPECT_THROW(IPv4Address("1.2.3"), invalid_address);
+}
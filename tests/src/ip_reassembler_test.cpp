@@ -7,6 +7,7 @@
 #include <tins/udp.h>
 #include <tins/ip.h>
 #include <tins/rawpdu.h>
+#include <tins/constants.h>
 
 using std::vector;
 using std::pair;
@@ -115,3 +116,114 @@ TEST_F(IPv4ReassemblerTest, PacketHasMFAndDF) {
     EXPECT_EQ(IPv4Reassembler::FRAGMENTED, reassembler.process(packet1));
     EXPECT_EQ(IPv4Reassembler::REASSEMBLED, reassembler.process(packet2));
 }
+
+EthernetII make_fragment(uint16_t id, const char* src_addr, uint16_t offset,
+                         const std::string& payload, bool more_fragments) {
+    EthernetII eth = EthernetII() / IP("1.1.1.1", src_addr) / 
+                     RawPDU(payload.begin(), payload.end());
+    IP& ip = eth.rfind_pdu<IP>();
+    ip.id(id);
+    // Experimental protocol number, so the payload is kept as a RawPDU
+    ip.protocol(253);
+    ip.fragment_offset(offset / 8);
+    ip.flags(more_fragments ? IP::MORE_FRAGMENTS : static_cast<IP::Flags>(0));
+    return eth;
+}
+
+TEST_F(IPv4ReassemblerTest, OverlappingFragmentsKeepFirstData) {
+    IPv4Reassembler reassembler;
+    IPv4Reassembler::timestamp_type ts(1000);
+    EthernetII fragment1 = make_fragment(1, "2.2.2.2", 8, "BBBBBBBBCCCCCCCC", true);
+    EthernetII fragment2 = make_fragment(1, "2.2.2.2", 16, "XXXXXXXXDDDD", false);
+    EthernetII fragment3 = make_fragment(1, "2.2.2.2", 0, "AAAAAAAAYYYYYYYY", true);
+    EXPECT_EQ(IPv4Reassembler::FRAGMENTED, reassembler.process(fragment1, ts));
+    EXPECT_EQ(IPv4Reassembler::FRAGMENTED, reassembler.process(fragment2, ts));
+    EXPECT_EQ(28U, reassembler.buffered_bytes());
+    EXPECT_EQ(IPv4Reassembler::REASSEMBLED, reassembler.process(fragment3, ts));
+    const RawPDU& raw = fragment3.rfind_pdu<RawPDU>();
+    EXPECT_EQ("AAAAAAAABBBBBBBBCCCCCCCCDDDD", 
+              std::string(raw.payload().begin(), raw.payload().end()));
+    EXPECT_EQ(0U, reassembler.buffered_bytes());
+    EXPECT_EQ(0U, reassembler.buffered_datagrams());
+}
+
+TEST_F(IPv4ReassemblerTest, ReassembleConstructedFragments) {
+    // The first fragment isn't parsed from a buffer, so its payload is a UDP PDU
+    EthernetII fragment1 = EthernetII() / IP("1.1.1.1", "2.2.2.2") / UDP(53, 1337) / 
+                           RawPDU("AAAAAAAA");
+    IP& ip = fragment1.rfind_pdu<IP>();
+    ip.id(7);
+    ip.flags(IP::MORE_FRAGMENTS);
+    EthernetII fragment2 = make_fragment(7, "2.2.2.2", 16, "BBBBBBBB", false);
+    fragment2.rfind_pdu<IP>().protocol(Constants::IP::PROTO_UDP);
+
+    IPv4Reassembler reassembler;
+    IPv4Reassembler::timestamp_type ts(1000);
+    EXPECT_EQ(IPv4Reassembler::FRAGMENTED, reassembler.process(fragment1, ts));
+    EXPECT_EQ(16U, reassembler.buffered_bytes());
+    EXPECT_EQ(IPv4Reassembler::REASSEMBLED, reassembler.process(fragment2, ts));
+    const UDP* udp = fragment2.find_pdu<UDP>();
+    ASSERT_TRUE(udp != 0);
+    EXPECT_EQ(53, udp->dport());
+    EXPECT_EQ(1337, udp->sport());
+    const RawPDU& raw = udp->rfind_pdu<RawPDU>();
+    EXPECT_EQ("AAAAAAAABBBBBBBB", std::string(raw.payload().begin(), raw.payload().end()));
+}
+
+TEST_F(IPv4ReassemblerTest, InvalidFragmentsDiscardDatagram) {
+    IPv4Reassembler reassembler;
+    IPv4Reassembler::timestamp_type ts(1000);
+    EthernetII fragment1 = make_fragment(1, "2.2.2.2", 0, "AAAAAAAA", true);
+    EthernetII fragment2 = make_fragment(1, "2.2.2.2", 8, "BBBBBBBB", false);
+    // Data after the last fragment
+    EthernetII fragment3 = make_fragment(1, "2.2.2.2", 16, "CCCCCCCC", true);
+    EXPECT_EQ(IPv4Reassembler::FRAGMENTED, reassembler.process(fragment2, ts));
+    EXPECT_EQ(IPv4Reassembler::FRAGMENTED, reassembler.process(fragment3, ts));
+    EXPECT_EQ(0U, reassembler.buffered_datagrams());
+    EXPECT_EQ(1U, reassembler.discarded_datagrams());
+    EXPECT_EQ(IPv4Reassembler::FRAGMENTED, reassembler.process(fragment1, ts));
+}
+
+TEST_F(IPv4ReassemblerTest, IncompleteDatagramsTimeOut) {
+    IPv4Reassembler reassembler;
+    reassembler.timeout(std::chrono::seconds(10));
+    IPv4Reassembler::timestamp_type ts(std::chrono::seconds(100));
+    EthernetII fragment1 = make_fragment(1, "2.2.2.2", 0, "AAAAAAAA", true);
+    EthernetII fragment2 = make_fragment(1, "2.2.2.2", 8, "BBBBBBBB", false);
+    EthernetII other_fragment = make_fragment(2, "2.2.2.2", 0, "AAAAAAAA", true);
+    EXPECT_EQ(IPv4Reassembler::FRAGMENTED, reassembler.process(fragment1, ts));
+    ts += std::chrono::seconds(11);
+    EXPECT_EQ(IPv4Reassembler::FRAGMENTED, reassembler.process(other_fragment, ts));
+    EXPECT_EQ(1U, reassembler.discarded_datagrams());
+    EXPECT_EQ(1U, reassembler.buffered_datagrams());
+    // The first fragment is gone, so this can't be reassembled
+    EXPECT_EQ(IPv4Reassembler::FRAGMENTED, reassembler.process(fragment2, ts));
+}
+
+TEST_F(IPv4ReassemblerTest, MemoryCaps) {
+    IPv4Reassembler reassembler;
+    reassembler.max_buffered_bytes(64);
+    reassembler.max_buffered_bytes_per_source(40);
+    IPv4Reassembler::timestamp_type ts(1000);
+    const std::string chunk(16, 'A');
+    // Each of these datagrams buffers 32 bytes
+    for (uint16_t id = 0; id < 2; ++id) {
+        EthernetII fragment = make_fragment(id, "2.2.2.2", 16, chunk, true);
+        EXPECT_EQ(IPv4Reassembler::FRAGMENTED, reassembler.process(fragment, ts));
+    }
+    // The second one exceeded the per source cap
+    EXPECT_EQ(1U, reassembler.discarded_datagrams());
+    EXPECT_EQ(32U, reassembler.buffered_bytes());
+
+    for (uint16_t id = 0; id < 2; ++id) {
+        ts += std::chrono::milliseconds(1);
+        EthernetII fragment = make_fragment(id, "3.3.3.3", 16, chunk, true);
+        EXPECT_EQ(IPv4Reassembler::FRAGMENTED, reassembler.process(fragment, ts));
+    }
+    // The second one from 3.3.3.3 exceeded the global cap, so the oldest one is gone
+    EXPECT_EQ(2U, reassembler.discarded_datagrams());
+    EXPECT_EQ(64U, reassembler.buffered_bytes());
+    EthernetII fragment = make_fragment(0, "2.2.2.2", 0, chunk, true);
+    EXPECT_EQ(IPv4Reassembler::FRAGMENTED, reassembler.process(fragment, ts));
+    EXPECT_EQ(2U, reassembler.buffered_datagrams());
+}
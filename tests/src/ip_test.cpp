@@ -661,6 +661,18 @@ TEST_F(IPTest, ConstructorFromBuffer) {
     EXPECT_EQ(sec.transmission_control, 0x68656cU);
 }
 
+TEST_F(IPTest, SerializeParsedOptions) {
+    IP ip1(expected_packet, sizeof(expected_packet));
+    IP ip2(ip1);
+    EXPECT_EQ(1U, ip1.options().size());
+    EXPECT_EQ(ip1.header_size(), ip2.header_size());
+    EXPECT_EQ(ip1.serialize(), ip2.serialize());
+
+    ip2.stream_identifier(0x91fd);
+    EXPECT_EQ(2U, ip2.options().size());
+    EXPECT_EQ(0x746a, ip2.security().security);
+}
+
 TEST_F(IPTest, StackedProtocols) {
     IP ip = IP(TINS_DEFAULT_TEST_IP) / TCP();
     IP::serialization_type buffer = ip.serialize();
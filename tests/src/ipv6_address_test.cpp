@@ -6,6 +6,7 @@
 #include <stdint.h>
 #include <tins/ipv6_address.h>
 #include <tins/macros.h>
+#include <tins/exceptions.h>
 
 using namespace Tins;
 
@@ -54,6 +55,58 @@ TEST(IPv6AddressTest, ToString) {
     test_to_string("::1:2:3");
 }
 
+TEST(IPv6AddressTest, ToChars) {
+    char buffer[IPv6Address::max_string_length];
+    // Expected outputs are the ones produced by inet_ntop
+    const char* addresses[][2] = {
+        { "::", "::" },
+        { "::1", "::1" },
+        { "1::", "1::" },
+        { "0:0:0:0:0:0:0:1", "::1" },
+        { "2001:DB8:0:0:1:0:0:1", "2001:db8::1:0:0:1" },
+        { "2001:db8:0:1:1:1:1:1", "2001:db8:0:1:1:1:1:1" },
+        { "2001:0db8:0000:0000:0000:0000:0002:0001", "2001:db8::2:1" },
+        { "1:0:0:2:0:0:0:3", "1:0:0:2::3" },
+        { "1:2:3:4:5:6:7:8", "1:2:3:4:5:6:7:8" },
+        { "ffff:ffff:ffff:ffff:ffff:ffff:ffff:ffff", "ffff:ffff:ffff:ffff:ffff:ffff:ffff:ffff" },
+        { "::ffff:192.168.1.1", "::ffff:192.168.1.1" },
+        { "::ffff:c0a8:101", "::ffff:192.168.1.1" },
+        { "::1.2.3.4", "::1.2.3.4" },
+        { "::ffff:0:1.2.3.4", "::ffff:0:102:304" },
+        { "fe80::1:2.3.4.5", "fe80::1:203:405" }
+    };
+    for (size_t i = 0; i < sizeof(addresses) / sizeof(addresses[0]); ++i) {
+        const IPv6Address address(addresses[i][0]);
+        const size_t length = address.to_chars(buffer, sizeof(buffer));
+        EXPECT_EQ(std::string(addresses[i][1]), std::string(buffer, length));
+        EXPECT_EQ(std::string(addresses[i][1]), address.to_string());
+    }
+    EXPECT_EQ(0UL, IPv6Address("dead::beef").to_chars(buffer, 9));
+    EXPECT_EQ(10UL, IPv6Address("dead::beef").to_chars(buffer, 10));
+}
+
+TEST(IPv6AddressTest, FromChars) {
+    IPv6Address address;
+    const std::string input = "dead:beef::1/64";
+    EXPECT_TRUE(IPv6Address::from_chars(input.data(), input.data() + 12, address));
+    EXPECT_EQ(IPv6Address("dead:beef::1"), address);
+
+    const char* invalid[] = {
+        "", ":", ":::", "1:::2", "1::2::3", ":1::2", "1::2:", "12345::",
+        "1:2:3:4:5:6:7", "1:2:3:4:5:6:7:8:9", "1:2:3:4:5:6:7:8::", "::1:2:3:4:5:6:7:8",
+        "g::", "::1.2.3", "::1.2.3.4.5", "1:2:3:4:5:6:7:1.2.3.4", "::01.2.3.4",
+        "::ffff:1.2.3.4:1"
+    };
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); ++i) {
+        const char* str = invalid[i];
+        address = "feed::1";
+        EXPECT_FALSE(IPv6Address::from_chars(str, str + strlen(str), address)) << str;
+        EXPECT_EQ(IPv6Address("feed::1"), address);
+    }
+    EXPECT_THROW(IPv6Address("1::2::3"), invalid_address);
+    EXPECT_THROW(IPv6Address("1:2:3:4:5:6:7:8:9"), invalid_address);
+}
+
 TEST(IPv6AddressTest, EqualOperator) {
     EXPECT_EQ(IPv6Address("17f8::1"), IPv6Address("17f8:0::0:1"));
     EXPECT_EQ(IPv6Address("::1"), IPv6Address("::1"));
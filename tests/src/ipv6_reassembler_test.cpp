@@ -0,0 +1,167 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include <tins/ipv6_reassembler.h>
+#include <tins/ethernetII.h>
+#include <tins/ipv6.h>
+#include <tins/udp.h>
+#include <tins/rawpdu.h>
+#include <tins/constants.h>
+
+using std::string;
+using std::vector;
+
+using namespace Tins;
+
+class IPv6ReassemblerTest : public testing::Test {
+public:
+    typedef IPv6Reassembler::timestamp_type timestamp_type;
+
+    static EthernetII make_fragment(uint32_t id, const char* src_addr, uint16_t offset,
+                                    const vector<uint8_t>& payload, bool more_fragments,
+                                    uint8_t next_header = 253);
+    static EthernetII make_fragment(uint32_t id, const char* src_addr, uint16_t offset,
+                                    const string& payload, bool more_fragments);
+};
+
+EthernetII IPv6ReassemblerTest::make_fragment(uint32_t id, const char* src_addr,
+                                              uint16_t offset,
+                                              const vector<uint8_t>& payload,
+                                              bool more_fragments, uint8_t next_header) {
+    const uint16_t offset_field = offset | (more_fragments ? 1 : 0);
+    const uint8_t fragment_data[] = {
+        static_cast<uint8_t>(offset_field >> 8), static_cast<uint8_t>(offset_field),
+        static_cast<uint8_t>(id >> 24), static_cast<uint8_t>(id >> 16),
+        static_cast<uint8_t>(id >> 8), static_cast<uint8_t>(id)
+    };
+    IPv6 ipv6("dead::1", src_addr);
+    ipv6.add_header(IPv6::ext_header(IPv6::FRAGMENT, sizeof(fragment_data), fragment_data));
+    ipv6.next_header(next_header);
+    EthernetII eth = EthernetII() / ipv6 / RawPDU(payload.begin(), payload.end());
+    // Parse it back so it looks like a captured fragment
+    PDU::serialization_type buffer = eth.serialize();
+    return EthernetII(&buffer[0], buffer.size());
+}
+
+EthernetII IPv6ReassemblerTest::make_fragment(uint32_t id, const char* src_addr,
+                                              uint16_t offset, const string& payload,
+                                              bool more_fragments) {
+    return make_fragment(id, src_addr, offset, vector<uint8_t>(payload.begin(), payload.end()),
+                         more_fragments);
+}
+
+TEST_F(IPv6ReassemblerTest, NotFragmented) {
+    IPv6Reassembler reassembler;
+    EthernetII eth = EthernetII() / IPv6("dead::1", "beef::1") / UDP(1, 2);
+    EXPECT_EQ(IPv6Reassembler::NOT_FRAGMENTED, reassembler.process(eth));
+}
+
+TEST_F(IPv6ReassemblerTest, Reassemble) {
+    PDU::serialization_type payload = (UDP(53, 1337) / RawPDU(string(40, 'A'))).serialize();
+    vector<uint8_t> chunk1(payload.begin(), payload.begin() + 24);
+    vector<uint8_t> chunk2(payload.begin() + 24, payload.end());
+    EthernetII fragment1 = make_fragment(0x12345678, "beef::1", 0, chunk1, true,
+                                         Constants::IP::PROTO_UDP);
+    EthernetII fragment2 = make_fragment(0x12345678, "beef::1", 24, chunk2, false,
+                                         Constants::IP::PROTO_UDP);
+    ASSERT_TRUE(fragment1.find_pdu<RawPDU>() != 0);
+
+    IPv6Reassembler reassembler;
+    timestamp_type ts(1000);
+    EXPECT_EQ(IPv6Reassembler::FRAGMENTED, reassembler.process(fragment2, ts));
+    EXPECT_EQ(1U, reassembler.buffered_datagrams());
+    EXPECT_EQ(IPv6Reassembler::REASSEMBLED, reassembler.process(fragment1, ts));
+
+    const IPv6& ipv6 = fragment1.rfind_pdu<IPv6>();
+    EXPECT_EQ(IPv6Address("beef::1"), ipv6.src_addr());
+    EXPECT_TRUE(ipv6.search_header(IPv6::FRAGMENT) == 0);
+    EXPECT_EQ(Constants::IP::PROTO_UDP, ipv6.next_header());
+    const UDP* udp = fragment1.find_pdu<UDP>();
+    ASSERT_TRUE(udp != 0);
+    EXPECT_EQ(53, udp->dport());
+    EXPECT_EQ(1337, udp->sport());
+    const RawPDU& raw = udp->rfind_pdu<RawPDU>();
+    EXPECT_EQ(string(40, 'A'), string(raw.payload().begin(), raw.payload().end()));
+    EXPECT_EQ(0U, reassembler.buffered_bytes());
+    EXPECT_EQ(0U, reassembler.buffered_datagrams());
+}
+
+TEST_F(IPv6ReassemblerTest, ReassembleConstructedFragments) {
+    EthernetII fragment1 = make_fragment(7, "beef::1", 0, "", true);
+    // Replace the parsed payload with a UDP PDU, as if it was built by hand
+    fragment1.rfind_pdu<IPv6>().inner_pdu(UDP(53, 1337) / RawPDU("AAAAAAAA"));
+    EthernetII fragment2 = make_fragment(7, "beef::1", 16, "BBBBBBBB", false);
+
+    IPv6Reassembler reassembler;
+    timestamp_type ts(1000);
+    EXPECT_EQ(IPv6Reassembler::FRAGMENTED, reassembler.process(fragment1, ts));
+    EXPECT_EQ(16U, reassembler.buffered_bytes());
+    EXPECT_EQ(IPv6Reassembler::REASSEMBLED, reassembler.process(fragment2, ts));
+    const UDP* udp = fragment2.find_pdu<UDP>();
+    ASSERT_TRUE(udp != 0);
+    EXPECT_EQ(53, udp->dport());
+    EXPECT_EQ(1337, udp->sport());
+    const RawPDU& raw = udp->rfind_pdu<RawPDU>();
+    EXPECT_EQ("AAAAAAAABBBBBBBB", string(raw.payload().begin(), raw.payload().end()));
+}
+
+TEST_F(IPv6ReassemblerTest, DatagramsAreKeyedBySourceDestinationAndId) {
+    IPv6Reassembler reassembler;
+    timestamp_type ts(1000);
+    EthernetII fragment1 = make_fragment(1, "beef::1", 0, "AAAAAAAA", true);
+    EthernetII fragment2 = make_fragment(1, "beef::2", 8, "BBBBBBBB", false);
+    EthernetII fragment3 = make_fragment(2, "beef::1", 8, "CCCCCCCC", false);
+    EthernetII fragment4 = make_fragment(1, "beef::1", 8, "DDDDDDDD", false);
+    EXPECT_EQ(IPv6Reassembler::FRAGMENTED, reassembler.process(fragment1, ts));
+    EXPECT_EQ(IPv6Reassembler::FRAGMENTED, reassembler.process(fragment2, ts));
+    EXPECT_EQ(IPv6Reassembler::FRAGMENTED, reassembler.process(fragment3, ts));
+    EXPECT_EQ(3U, reassembler.buffered_datagrams());
+    EXPECT_EQ(IPv6Reassembler::REASSEMBLED, reassembler.process(fragment4, ts));
+    const RawPDU& raw = fragment4.rfind_pdu<RawPDU>();
+    EXPECT_EQ("AAAAAAAADDDDDDDD", string(raw.payload().begin(), raw.payload().end()));
+    EXPECT_EQ(2U, reassembler.buffered_datagrams());
+
+    reassembler.remove_stream(2, "beef::1", "dead::1");
+    EXPECT_EQ(1U, reassembler.buffered_datagrams());
+    EXPECT_EQ(16U, reassembler.buffered_bytes());
+}
+
+TEST_F(IPv6ReassemblerTest, IncompleteDatagramsTimeOut) {
+    IPv6Reassembler reassembler;
+    reassembler.timeout(std::chrono::seconds(10));
+    timestamp_type ts(std::chrono::seconds(100));
+    EthernetII fragment1 = make_fragment(1, "beef::1", 0, "AAAAAAAA", true);
+    EthernetII fragment2 = make_fragment(1, "beef::1", 8, "BBBBBBBB", false);
+    EthernetII other_fragment = make_fragment(2, "beef::1", 0, "AAAAAAAA", true);
+    EXPECT_EQ(IPv6Reassembler::FRAGMENTED, reassembler.process(fragment1, ts));
+    ts += std::chrono::seconds(11);
+    EXPECT_EQ(IPv6Reassembler::FRAGMENTED, reassembler.process(other_fragment, ts));
+    EXPECT_EQ(1U, reassembler.discarded_datagrams());
+    EXPECT_EQ(1U, reassembler.buffered_datagrams());
+    EXPECT_EQ(IPv6Reassembler::FRAGMENTED, reassembler.process(fragment2, ts));
+}
+
+TEST_F(IPv6ReassemblerTest, MemoryCaps) {
+    IPv6Reassembler reassembler;
+    reassembler.max_buffered_bytes(64);
+    reassembler.max_buffered_bytes_per_source(40);
+    timestamp_type ts(1000);
+    const string chunk(16, 'A');
+    // Each of these datagrams buffers 32 bytes
+    for (uint32_t id = 0; id < 2; ++id) {
+        EthernetII fragment = make_fragment(id, "beef::1", 16, chunk, true);
+        EXPECT_EQ(IPv6Reassembler::FRAGMENTED, reassembler.process(fragment, ts));
+    }
+    // The second one exceeded the per source cap
+    EXPECT_EQ(1U, reassembler.discarded_datagrams());
+    EXPECT_EQ(32U, reassembler.buffered_bytes());
+
+    for (uint32_t id = 0; id < 2; ++id) {
+        ts += std::chrono::milliseconds(1);
+        EthernetII fragment = make_fragment(id, "beef::2", 16, chunk, true);
+        EXPECT_EQ(IPv6Reassembler::FRAGMENTED, reassembler.process(fragment, ts));
+    }
+    // The global cap was exceeded, so the oldest datagram is gone
+    EXPECT_EQ(2U, reassembler.discarded_datagrams());
+    EXPECT_EQ(64U, reassembler.buffered_bytes());
+}
@@ -0,0 +1,137 @@
+#include <gtest/gtest.h>
+#include <vector>
+#include <tins/neighbor_cache.h>
+#include <tins/network_interface.h>
+#include <tins/packet_sender.h>
+
+using std::vector;
+
+using namespace Tins;
+
+class NeighborCacheTest : public testing::Test {
+public:
+    typedef NeighborCache::hwaddress_type hwaddress_type;
+
+    NeighborCacheTest()
+    : iface(NetworkInterface::from_index(1)) {
+
+    }
+
+    NetworkInterface iface;
+};
+
+TEST_F(NeighborCacheTest, AddAndFind) {
+    NeighborCache cache;
+    hwaddress_type hw_addr;
+    EXPECT_FALSE(cache.find(iface, IPv4Address("192.168.0.1"), hw_addr));
+
+    cache.add(iface, IPv4Address("192.168.0.1"), "00:01:02:03:04:05");
+    cache.add(iface, IPv6Address("fe80::1"), "00:01:02:03:04:06");
+    EXPECT_EQ(2U, cache.size());
+
+    ASSERT_TRUE(cache.find(iface, IPv4Address("192.168.0.1"), hw_addr));
+    EXPECT_EQ(hwaddress_type("00:01:02:03:04:05"), hw_addr);
+    ASSERT_TRUE(cache.find(iface, IPv6Address("fe80::1"), hw_addr));
+    EXPECT_EQ(hwaddress_type("00:01:02:03:04:06"), hw_addr);
+    EXPECT_FALSE(cache.find(iface, IPv4Address("192.168.0.2"), hw_addr));
+
+    // Adding an existing address updates it
+    cache.add(iface, IPv4Address("192.168.0.1"), "00:01:02:03:04:07");
+    EXPECT_EQ(2U, cache.size());
+    ASSERT_TRUE(cache.find(iface, IPv4Address("192.168.0.1"), hw_addr));
+    EXPECT_EQ(hwaddress_type("00:01:02:03:04:07"), hw_addr);
+}
+
+TEST_F(NeighborCacheTest, Remove) {
+    NeighborCache cache;
+    hwaddress_type hw_addr;
+    cache.add(iface, IPv4Address("192.168.0.1"), "00:01:02:03:04:05");
+    cache.add(iface, IPv6Address("fe80::1"), "00:01:02:03:04:06");
+    EXPECT_TRUE(cache.remove(iface, IPv4Address("192.168.0.1")));
+    EXPECT_FALSE(cache.remove(iface, IPv4Address("192.168.0.1")));
+    EXPECT_FALSE(cache.find(iface, IPv4Address("192.168.0.1"), hw_addr));
+    EXPECT_EQ(1U, cache.size());
+
+    cache.clear();
+    EXPECT_FALSE(cache.find(iface, IPv6Address("fe80::1"), hw_addr));
+    EXPECT_EQ(0U, cache.size());
+}
+
+TEST_F(NeighborCacheTest, EntriesArePerInterface) {
+    NeighborCache cache;
+    const NetworkInterface other_iface = NetworkInterface::from_index(2);
+    hwaddress_type hw_addr;
+    cache.add(iface, IPv4Address("192.168.0.1"), "00:01:02:03:04:05");
+    cache.add(other_iface, IPv4Address("192.168.0.1"), "00:01:02:03:04:06");
+    cache.add(iface, IPv6Address("fe80::1"), "00:01:02:03:04:07");
+    EXPECT_EQ(3U, cache.size());
+
+    ASSERT_TRUE(cache.find(iface, IPv4Address("192.168.0.1"), hw_addr));
+    EXPECT_EQ(hwaddress_type("00:01:02:03:04:05"), hw_addr);
+    ASSERT_TRUE(cache.find(other_iface, IPv4Address("192.168.0.1"), hw_addr));
+    EXPECT_EQ(hwaddress_type("00:01:02:03:04:06"), hw_addr);
+    EXPECT_FALSE(cache.find(other_iface, IPv6Address("fe80::1"), hw_addr));
+
+    EXPECT_TRUE(cache.remove(other_iface, IPv4Address("192.168.0.1")));
+    EXPECT_TRUE(cache.find(iface, IPv4Address("192.168.0.1"), hw_addr));
+}
+
+TEST_F(NeighborCacheTest, ResolveCachedAddresses) {
+    NeighborCache cache;
+    PacketSender sender;
+    cache.add(iface, IPv4Address("192.168.0.1"), "00:01:02:03:04:05");
+    cache.add(iface, IPv4Address("192.168.0.2"), "00:01:02:03:04:06");
+
+    // Cached addresses never hit the network
+    vector<IPv4Address> addresses;
+    addresses.push_back("192.168.0.1");
+    addresses.push_back("192.168.0.2");
+    EXPECT_EQ(2U, cache.resolve(iface, addresses, sender));
+    EXPECT_EQ(
+        hwaddress_type("00:01:02:03:04:06"),
+        cache.resolve(iface, IPv4Address("192.168.0.2"), sender)
+    );
+}
+
+TEST_F(NeighborCacheTest, RefreshWithoutStaleEntries) {
+    NeighborCache cache;
+    PacketSender sender;
+    EXPECT_EQ(NeighborCache::DEFAULT_MAX_AGE, cache.max_age());
+    cache.max_age(3600);
+    EXPECT_EQ(3600U, cache.max_age());
+    cache.add(iface, IPv4Address("192.168.0.1"), "00:01:02:03:04:05");
+    EXPECT_EQ(0U, cache.refresh(iface, sender));
+    EXPECT_EQ(1U, cache.size());
+}
+
+TEST_F(NeighborCacheTest, AddReplacesEntries) {
+    NeighborCache cache;
+    PacketSender sender;
+    cache.max_age(3600);
+    cache.add(iface, IPv4Address("192.168.0.1"), "00:01:02:03:04:05");
+    cache.add(iface, IPv4Address("192.168.0.1"), "00:01:02:03:04:06");
+    // Entries added explicitly are fresh, so this doesn't hit the network
+    EXPECT_EQ(
+        hwaddress_type("00:01:02:03:04:06"),
+        cache.resolve(iface, IPv4Address("192.168.0.1"), sender)
+    );
+}
+
+#if TINS_IS_CXX11
+TEST_F(NeighborCacheTest, StartAndStopRefresh) {
+    NeighborCache cache;
+    hwaddress_type hw_addr;
+    cache.max_age(3600);
+    cache.add(iface, IPv4Address("192.168.0.1"), "00:01:02:03:04:05");
+    cache.start_refresh(3600);
+    // Restarting and stopping don't wait for the interval
+    cache.start_refresh(3600);
+    cache.stop_refresh();
+    cache.stop_refresh();
+    EXPECT_TRUE(cache.find(iface, IPv4Address("192.168.0.1"), hw_addr));
+
+    // Destroying the cache stops the refresh as well
+    NeighborCache other_cache;
+    other_cache.start_refresh(3600);
+}
+#endif // TINS_IS_CXX11
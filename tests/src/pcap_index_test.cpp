@@ -0,0 +1,293 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include <tins/pcap_index.h>
+#include <tins/ethernetII.h>
+#include <tins/dot1q.h>
+#include <tins/arp.h>
+#include <tins/ip.h>
+#include <tins/ipv6.h>
+#include <tins/tcp.h>
+#include <tins/udp.h>
+#include <tins/icmpv6.h>
+#include <tins/rawpdu.h>
+#include <tins/exceptions.h>
+
+using std::string;
+using std::vector;
+
+using namespace Tins;
+
+const int LINK_TYPE_ETHERNET = 1;
+const int LINK_TYPE_RAW = 101;
+
+uint64_t raw_flow_hash(PDU& pdu, int link_type = LINK_TYPE_ETHERNET) {
+    const PDU::serialization_type buffer = pdu.serialize();
+    return PcapIndex::flow_hash(link_type, &buffer[0], buffer.size());
+}
+
+TEST(PcapIndexTest, FlowHashIPv4) {
+    EthernetII forward = EthernetII() / IP("10.0.0.1", "10.0.0.2") / TCP(80, 1234);
+    EthernetII backward = EthernetII() / IP("10.0.0.2", "10.0.0.1") / TCP(1234, 80);
+    const uint64_t expected = PcapIndex::flow_hash(IPv4Address("10.0.0.2"), 1234,
+                                                   IPv4Address("10.0.0.1"), 80, 6);
+    EXPECT_NE(0ULL, expected);
+    EXPECT_EQ(expected, raw_flow_hash(forward));
+    EXPECT_EQ(expected, raw_flow_hash(backward));
+    EXPECT_EQ(expected, PcapIndex::flow_hash(forward));
+    EXPECT_EQ(expected, PcapIndex::flow_hash(backward));
+
+    IP raw_ip = IP("10.0.0.1", "10.0.0.2") / TCP(80, 1234);
+    EXPECT_EQ(expected, raw_flow_hash(raw_ip, LINK_TYPE_RAW));
+
+    EthernetII tagged = EthernetII() / Dot1Q(10) / IP("10.0.0.1", "10.0.0.2") / TCP(80, 1234);
+    EXPECT_EQ(expected, raw_flow_hash(tagged));
+
+    EthernetII other_port = EthernetII() / IP("10.0.0.1", "10.0.0.2") / TCP(80, 1235);
+    EthernetII udp = EthernetII() / IP("10.0.0.1", "10.0.0.2") / UDP(80, 1234);
+    EXPECT_NE(expected, raw_flow_hash(other_port));
+    EXPECT_NE(expected, raw_flow_hash(udp));
+    EXPECT_EQ(PcapIndex::flow_hash(IPv4Address("10.0.0.1"), 80, IPv4Address("10.0.0.2"), 1234, 17),
+              raw_flow_hash(udp));
+}
+
+TEST(PcapIndexTest, FlowHashIPv6) {
+    EthernetII forward = EthernetII() / IPv6("dead::1", "beef::2") / UDP(53, 4000);
+    EthernetII backward = EthernetII() / IPv6("beef::2", "dead::1") / UDP(4000, 53);
+    const uint64_t expected = PcapIndex::flow_hash(IPv6Address("beef::2"), 4000,
+                                                   IPv6Address("dead::1"), 53, 17);
+    EXPECT_NE(0ULL, expected);
+    EXPECT_EQ(expected, raw_flow_hash(forward));
+    EXPECT_EQ(expected, raw_flow_hash(backward));
+    EXPECT_EQ(expected, PcapIndex::flow_hash(forward));
+}
+
+// Checks that hashing the PDU, its serialization and the PDU parsed back
+// from it all give the expected hash
+void check_flow_hash(uint64_t expected, EthernetII& packet) {
+    const PDU::serialization_type buffer = packet.serialize();
+    EthernetII parsed(&buffer[0], buffer.size());
+    EXPECT_EQ(expected, PcapIndex::flow_hash(LINK_TYPE_ETHERNET, &buffer[0], buffer.size()));
+    EXPECT_EQ(expected, PcapIndex::flow_hash(packet));
+    EXPECT_EQ(expected, PcapIndex::flow_hash(parsed));
+}
+
+TEST(PcapIndexTest, FlowHashUsesUpperLayerProtocol) {
+    const uint8_t padding[] = { 1, 4, 0, 0, 0, 0 };
+    IPv6 ipv6("dead::1", "beef::2");
+    ipv6.add_header(IPv6::ext_header(IPv6::HOP_BY_HOP, sizeof(padding), padding));
+    EthernetII icmp = EthernetII() / ipv6 / ICMPv6(ICMPv6::ECHO_REQUEST);
+    check_flow_hash(PcapIndex::flow_hash(IPv6Address("dead::1"), 0, 
+                                         IPv6Address("beef::2"), 0, 58), icmp);
+    EthernetII udp = EthernetII() / ipv6 / UDP(53, 4000);
+    check_flow_hash(PcapIndex::flow_hash(IPv6Address("dead::1"), 53,
+                                         IPv6Address("beef::2"), 4000, 17), udp);
+}
+
+TEST(PcapIndexTest, FlowHashFirstFragments) {
+    // The first fragment is parsed as a RawPDU but it still has the ports
+    IP ip("10.0.0.1", "10.0.0.2");
+    ip.flags(IP::MORE_FRAGMENTS);
+    EthernetII fragment = EthernetII() / ip / TCP(80, 1234);
+    check_flow_hash(PcapIndex::flow_hash(IPv4Address("10.0.0.1"), 80,
+                                         IPv4Address("10.0.0.2"), 1234, 6), fragment);
+
+    const uint8_t fragment_header[] = { 0, 1, 0, 0, 0, 1 };
+    IPv6 ipv6("dead::1", "beef::2");
+    ipv6.add_header(IPv6::ext_header(IPv6::FRAGMENT, sizeof(fragment_header),
+                                     fragment_header));
+    EthernetII ipv6_fragment = EthernetII() / ipv6 / UDP(53, 4000);
+    check_flow_hash(PcapIndex::flow_hash(IPv6Address("dead::1"), 53,
+                                         IPv6Address("beef::2"), 4000, 17), ipv6_fragment);
+}
+
+TEST(PcapIndexTest, FlowHashUsesOutermostIPLayer) {
+    EthernetII tunnel = EthernetII() / IP("10.0.0.1", "10.0.0.2") / 
+                        IP("192.168.0.1", "192.168.0.2") / TCP(80, 1234);
+    check_flow_hash(PcapIndex::flow_hash(IPv4Address("10.0.0.1"), 0,
+                                         IPv4Address("10.0.0.2"), 0, 4), tunnel);
+}
+
+TEST(PcapIndexTest, FlowHashNonIP) {
+    EthernetII arp = EthernetII() / ARP("1.2.3.4", "4.3.2.1");
+    EXPECT_EQ(0ULL, raw_flow_hash(arp));
+    EXPECT_EQ(0ULL, PcapIndex::flow_hash(arp));
+    const uint8_t garbage[] = { 1, 2, 3 };
+    EXPECT_EQ(0ULL, PcapIndex::flow_hash(LINK_TYPE_ETHERNET, garbage, sizeof(garbage)));
+    EXPECT_EQ(0ULL, PcapIndex::flow_hash(12345, garbage, sizeof(garbage)));
+}
+
+TEST(PcapIndexTest, AddRecord) {
+    PcapIndex index(LINK_TYPE_ETHERNET, 2);
+    EthernetII flow1 = EthernetII() / IP("10.0.0.1", "10.0.0.2") / TCP(80, 1234);
+    EthernetII flow2 = EthernetII() / IP("10.0.0.3", "10.0.0.4") / UDP(53, 53);
+    const PDU::serialization_type buffer1 = flow1.serialize();
+    const PDU::serialization_type buffer2 = flow2.serialize();
+    uint64_t offset = 24;
+    vector<uint64_t> offsets;
+    for (size_t i = 0; i < 5; ++i) {
+        const PDU::serialization_type& buffer = (i % 2) ? buffer2 : buffer1;
+        timeval tv = { static_cast<long>(100 - i), 0 };
+        index.add_record(offset, tv, &buffer[0], buffer.size());
+        offsets.push_back(offset);
+        offset += 16 + buffer.size();
+    }
+    EXPECT_EQ(5ULL, index.record_count());
+    EXPECT_EQ(offset, index.file_size());
+    ASSERT_EQ(3UL, index.blocks().size());
+    EXPECT_EQ(offsets[0], index.blocks()[0].offset);
+    EXPECT_EQ(99000000ULL, index.blocks()[0].first_timestamp);
+    EXPECT_EQ(100000000ULL, index.blocks()[0].last_timestamp);
+    EXPECT_EQ(2U, index.blocks()[0].record_count);
+    EXPECT_EQ(offsets[4], index.blocks()[2].offset);
+    EXPECT_EQ(1U, index.blocks()[2].record_count);
+
+    vector<uint64_t> expected;
+    expected.push_back(offsets[0]);
+    expected.push_back(offsets[2]);
+    expected.push_back(offsets[4]);
+    EXPECT_EQ(expected, index.find_flow(PcapIndex::flow_hash(flow1)));
+    EXPECT_EQ(2UL, index.find_flow(PcapIndex::flow_hash(flow2)).size());
+    EXPECT_TRUE(index.find_flow(12345).empty());
+
+    timeval start = { 97, 0 }, end = { 98, 0 };
+    const vector<PcapIndex::time_block> blocks = index.find_window(start, end);
+    ASSERT_EQ(1UL, blocks.size());
+    EXPECT_EQ(offsets[2], blocks[0].offset);
+}
+
+TEST(PcapIndexTest, InvalidFiles) {
+    EXPECT_THROW(PcapIndex::build("/this/file/does/not/exist.pcap"), invalid_pcap_file);
+    EXPECT_THROW(PcapIndex::load("/this/file/does/not/exist.pcap.idx"), invalid_pcap_file);
+    EXPECT_THROW(IndexedPcapReader("/this/file/does/not/exist.pcap"), invalid_pcap_file);
+}
+
+TEST(PcapIndexTest, SaveFailure) {
+    PcapIndex index(LINK_TYPE_ETHERNET);
+    EXPECT_THROW(index.save("/this/directory/does/not/exist.pcap.idx"), file_write_error);
+}
+
+#if TINS_IS_CXX11 && !defined(_WIN32)
+
+#include <unistd.h>
+#include <fstream>
+#include <tins/buffered_packet_writer.h>
+
+class PcapIndexFileTest : public testing::Test {
+public:
+    void SetUp() {
+        char path[] = "/tmp/libtins_index_XXXXXX";
+        ASSERT_TRUE(mkdtemp(path) != 0);
+        directory = path;
+        file_name = directory + "/test.pcap";
+    }
+
+    void TearDown() {
+        unlink(file_name.c_str());
+        unlink(PcapIndex::index_file_name(file_name).c_str());
+        rmdir(directory.c_str());
+    }
+
+    static Timestamp make_timestamp(uint64_t seconds) {
+        return Timestamp(std::chrono::seconds(seconds));
+    }
+
+    static EthernetII make_packet(size_t i) {
+        // 4 flows, one of them IPv6
+        const uint16_t port = static_cast<uint16_t>(1000 + i % 4);
+        if (i % 4 == 3) {
+            return EthernetII() / IPv6("dead::1", "beef::1") / UDP(port, 53);
+        }
+        return EthernetII() / IP("10.0.0.1", "10.0.0.2") / TCP(port, 80) / RawPDU("data");
+    }
+
+    // Writes 1000 packets, one per second starting at 1000
+    void write_file(bool write_index) {
+        BufferedPacketWriter::options opts;
+        opts.write_index = write_index;
+        BufferedPacketWriter writer(file_name, LINK_TYPE_ETHERNET, opts);
+        for (size_t i = 0; i < 1000; ++i) {
+            EthernetII packet = make_packet(i);
+            writer.write(packet, make_timestamp(1000 + i));
+        }
+        writer.close();
+    }
+
+    string directory;
+    string file_name;
+};
+
+TEST_F(PcapIndexFileTest, BuildMatchesWriterIndex) {
+    write_file(true);
+    const PcapIndex built = PcapIndex::build(file_name, PcapIndex::DEFAULT_BLOCK_SIZE);
+    const PcapIndex loaded = PcapIndex::load(PcapIndex::index_file_name(file_name));
+    EXPECT_EQ(1000ULL, built.record_count());
+    EXPECT_EQ(built.record_count(), loaded.record_count());
+    EXPECT_EQ(built.file_size(), loaded.file_size());
+    EXPECT_EQ(LINK_TYPE_ETHERNET, loaded.link_type());
+    ASSERT_EQ(built.blocks().size(), loaded.blocks().size());
+    for (size_t i = 0; i < built.blocks().size(); ++i) {
+        EXPECT_EQ(built.blocks()[i].offset, loaded.blocks()[i].offset);
+        EXPECT_EQ(built.blocks()[i].first_timestamp, loaded.blocks()[i].first_timestamp);
+        EXPECT_EQ(built.blocks()[i].last_timestamp, loaded.blocks()[i].last_timestamp);
+        EXPECT_EQ(built.blocks()[i].record_count, loaded.blocks()[i].record_count);
+    }
+    for (size_t i = 0; i < 4; ++i) {
+        EthernetII packet = make_packet(i);
+        const uint64_t hash = PcapIndex::flow_hash(packet);
+        EXPECT_EQ(250UL, built.find_flow(hash).size());
+        EXPECT_EQ(built.find_flow(hash), loaded.find_flow(hash));
+    }
+}
+
+TEST_F(PcapIndexFileTest, ReadWindow) {
+    write_file(false);
+    PcapIndex::build(file_name, 16).save(PcapIndex::index_file_name(file_name));
+    IndexedPcapReader reader(file_name);
+    EXPECT_TRUE(reader.index_loaded());
+    EXPECT_EQ(LINK_TYPE_ETHERNET, reader.link_type());
+
+    const vector<IndexedPcapReader::record> records = reader.read_window(
+        make_timestamp(1500), make_timestamp(1510));
+    ASSERT_EQ(10UL, records.size());
+    for (size_t i = 0; i < records.size(); ++i) {
+        EXPECT_EQ(1500 + i, static_cast<size_t>(records[i].timestamp.seconds()));
+        EthernetII expected = make_packet(500 + i);
+        EXPECT_EQ(expected.serialize(), records[i].data);
+        EXPECT_EQ(records[i].data.size(), records[i].original_size);
+    }
+    EXPECT_TRUE(reader.read_window(make_timestamp(0), make_timestamp(1000)).empty());
+    EXPECT_EQ(1000UL, reader.read_window(make_timestamp(0), make_timestamp(5000)).size());
+}
+
+TEST_F(PcapIndexFileTest, ReadFlow) {
+    write_file(true);
+    IndexedPcapReader reader(file_name);
+    EXPECT_TRUE(reader.index_loaded());
+    EthernetII packet = make_packet(3);
+    const uint64_t hash = PcapIndex::flow_hash(packet);
+    const vector<IndexedPcapReader::record> records = reader.read_flow(hash);
+    ASSERT_EQ(250UL, records.size());
+    for (size_t i = 0; i < records.size(); ++i) {
+        EXPECT_EQ(1003 + i * 4, static_cast<size_t>(records[i].timestamp.seconds()));
+        EthernetII parsed(&records[i].data[0], records[i].data.size());
+        EXPECT_EQ(hash, PcapIndex::flow_hash(parsed));
+    }
+    const vector<IndexedPcapReader::record> window = reader.read_flow(
+        hash, make_timestamp(1100), make_timestamp(1200));
+    EXPECT_EQ(25UL, window.size());
+}
+
+TEST_F(PcapIndexFileTest, StaleIndex) {
+    write_file(true);
+    // Append a few bytes, as if the file was still being written
+    {
+        std::ofstream output(file_name.c_str(), std::ios::binary | std::ios::app);
+        output.write("abcd", 4);
+    }
+    IndexedPcapReader reader(file_name);
+    EXPECT_FALSE(reader.index_loaded());
+    EXPECT_EQ(1000ULL, reader.index().record_count());
+}
+
+#endif // TINS_IS_CXX11 && !_WIN32
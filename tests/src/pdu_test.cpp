@@ -102,3 +102,105 @@ TEST_F(PDUTest, TinsCast) {
     EXPECT_THROW(tins_cast<UDP>(*pdu), bad_tins_cast);
 }
 
+
+TEST_F(PDUTest, FindPDUAfterModifyingChain) {
+    IP ip = IP("192.168.0.1") / TCP(22, 52) / RawPDU("Test");
+    TCP* tcp = ip.find_pdu<TCP>();
+    ASSERT_TRUE(tcp != NULL);
+    EXPECT_TRUE(tcp->find_pdu<RawPDU>() != NULL);
+    EXPECT_TRUE(ip.find_pdu<UDP>() == NULL);
+
+    // Modifying an inner PDU's chain has to be seen by the outer ones
+    delete tcp->release_inner_pdu();
+    EXPECT_TRUE(ip.find_pdu<RawPDU>() == NULL);
+    EXPECT_TRUE(tcp->find_pdu<RawPDU>() == NULL);
+    tcp->inner_pdu(RawPDU("Test"));
+    EXPECT_TRUE(ip.find_pdu<RawPDU>() != NULL);
+
+    ip.inner_pdu(UDP(22, 52) / RawPDU("Test"));
+    EXPECT_TRUE(ip.find_pdu<TCP>() == NULL);
+    ASSERT_TRUE(ip.find_pdu<UDP>() != NULL);
+    EXPECT_EQ(ip.find_pdu<UDP>()->inner_pdu(), ip.find_pdu<RawPDU>());
+}
+
+TEST_F(PDUTest, FindPDUReturnsFirstMatch) {
+    IP ip = IP("192.168.0.1") / IP("192.168.0.2") / UDP(22, 52);
+    const IP* inner_ip = ip.find_pdu<UDP>()->parent_pdu()->find_pdu<IP>();
+    ASSERT_TRUE(inner_ip != NULL);
+    EXPECT_EQ(&ip, ip.find_pdu<IP>());
+    EXPECT_EQ(IPv4Address("192.168.0.2"), inner_ip->dst_addr());
+
+    // Copies don't share the original's index
+    const IP copy = ip;
+    EXPECT_NE(ip.find_pdu<UDP>(), copy.find_pdu<UDP>());
+    EXPECT_EQ(copy.inner_pdu()->inner_pdu(), copy.find_pdu<UDP>());
+}
+
+TEST_F(PDUTest, PacketCopiesSharePDU) {
+    Packet packet = IP("192.168.0.1") / TCP(22, 52);
+    EXPECT_EQ(1U, packet.use_count());
+
+    const Packet copy = packet;
+    Packet assigned;
+    assigned = copy;
+    EXPECT_EQ(3U, packet.use_count());
+    EXPECT_EQ(static_cast<const Packet&>(packet).pdu(), copy.pdu());
+    EXPECT_EQ(copy.pdu(), static_cast<const Packet&>(assigned).pdu());
+    EXPECT_EQ(packet.timestamp().microseconds(), copy.timestamp().microseconds());
+
+    // Non const access makes the packet get its own PDU
+    PDU* modified = packet.pdu();
+    EXPECT_NE(modified, copy.pdu());
+    EXPECT_EQ(1U, packet.use_count());
+    EXPECT_EQ(2U, copy.use_count());
+    modified->rfind_pdu<IP>().dst_addr("192.168.0.2");
+    EXPECT_EQ(IPv4Address("192.168.0.1"), copy.pdu()->rfind_pdu<IP>().dst_addr());
+    EXPECT_EQ(modified, packet.pdu());
+}
+
+TEST_F(PDUTest, PacketReleaseSharedPDU) {
+    Packet packet = IP("192.168.0.1") / TCP(22, 52);
+    Packet copy = packet;
+    const PDU* shared = copy.pdu();
+
+    PDU* released = packet.release_pdu();
+    ASSERT_TRUE(released != NULL);
+    EXPECT_NE(shared, released);
+    EXPECT_FALSE(packet);
+    EXPECT_EQ(0U, packet.use_count());
+    EXPECT_EQ(1U, copy.use_count());
+
+    // The last owner hands out the PDU itself
+    PDU* last = copy.release_pdu();
+    EXPECT_EQ(shared, last);
+    EXPECT_FALSE(copy);
+    delete released;
+    delete last;
+}
+
+TEST_F(PDUTest, OperatorConcatOnSharedPacket) {
+    Packet packet = IP("192.168.0.1") / TCP(22, 52);
+    const Packet copy = packet;
+    packet /= RawPDU("Test");
+    EXPECT_TRUE(packet.pdu()->find_pdu<RawPDU>() != NULL);
+    EXPECT_TRUE(copy.pdu()->find_pdu<RawPDU>() == NULL);
+}
+
+TEST_F(PDUTest, FindPDUAfterAttachingIndexedChain) {
+    IP ip("192.168.0.1");
+    TCP* tcp = new TCP(22, 52);
+    // This builds an index owned by the TCP PDU
+    EXPECT_TRUE(tcp->find_pdu<RawPDU>() == NULL);
+    ip.inner_pdu(tcp);
+    EXPECT_EQ(tcp, ip.find_pdu<TCP>());
+    EXPECT_TRUE(tcp->find_pdu<IP>() == NULL);
+    tcp->inner_pdu(RawPDU("Test"));
+    EXPECT_EQ(tcp->inner_pdu(), ip.find_pdu<RawPDU>());
+    EXPECT_EQ(tcp->inner_pdu(), tcp->find_pdu<RawPDU>());
+
+    PDU* released = ip.release_inner_pdu();
+    EXPECT_TRUE(ip.find_pdu<TCP>() == NULL);
+    EXPECT_EQ(released, released->find_pdu<TCP>());
+    EXPECT_EQ(released->inner_pdu(), released->find_pdu<RawPDU>());
+    delete released;
+}
@@ -0,0 +1,130 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <tins/routing_table.h>
+
+using std::string;
+
+using namespace Tins;
+using Tins::Utils::RouteEntry;
+using Tins::Utils::Route6Entry;
+
+class RoutingTableTest : public testing::Test {
+public:
+    static RouteEntry make_route(const string& destination, uint32_t prefix_length,
+                                 const string& gateway, const string& iface,
+                                 int metric = 0) {
+        RouteEntry entry;
+        entry.destination = destination;
+        entry.mask = IPv4Address::from_prefix_length(prefix_length);
+        entry.gateway = gateway;
+        entry.interface = iface;
+        entry.metric = metric;
+        return entry;
+    }
+
+    static Route6Entry make_route6(const string& destination, uint32_t prefix_length,
+                                   const string& gateway, const string& iface,
+                                   int metric = 0) {
+        Route6Entry entry;
+        entry.destination = destination;
+        entry.mask = IPv6Address::from_prefix_length(prefix_length);
+        entry.gateway = gateway;
+        entry.interface = iface;
+        entry.metric = metric;
+        return entry;
+    }
+};
+
+TEST_F(RoutingTableTest, LongestPrefixMatch) {
+    RoutingTable table;
+    table.add(make_route("0.0.0.0", 0, "10.0.0.1", "eth0"));
+    table.add(make_route("192.168.0.0", 16, "10.0.0.2", "eth1"));
+    table.add(make_route("192.168.5.0", 24, "0.0.0.0", "eth2"));
+    EXPECT_EQ(3U, table.ipv4_size());
+
+    const RouteEntry* route = table.find(IPv4Address("192.168.5.7"));
+    ASSERT_TRUE(route != 0);
+    EXPECT_EQ("eth2", route->interface);
+
+    route = table.find(IPv4Address("192.168.6.7"));
+    ASSERT_TRUE(route != 0);
+    EXPECT_EQ("eth1", route->interface);
+    EXPECT_EQ(IPv4Address("10.0.0.2"), route->gateway);
+
+    route = table.find(IPv4Address("8.8.8.8"));
+    ASSERT_TRUE(route != 0);
+    EXPECT_EQ("eth0", route->interface);
+}
+
+TEST_F(RoutingTableTest, LowestMetricWins) {
+    RoutingTable table;
+    table.add(make_route("10.0.0.0", 8, "0.0.0.0", "eth1", 100));
+    table.add(make_route("10.0.0.0", 8, "0.0.0.0", "eth0", 10));
+    // Adding the same route twice has no effect
+    table.add(make_route("10.0.0.0", 8, "0.0.0.0", "eth0", 10));
+    EXPECT_EQ(2U, table.ipv4_size());
+
+    const RouteEntry* route = table.find(IPv4Address("10.1.2.3"));
+    ASSERT_TRUE(route != 0);
+    EXPECT_EQ("eth0", route->interface);
+
+    EXPECT_TRUE(table.remove(make_route("10.0.0.0", 8, "0.0.0.0", "eth0", 10)));
+    route = table.find(IPv4Address("10.1.2.3"));
+    ASSERT_TRUE(route != 0);
+    EXPECT_EQ("eth1", route->interface);
+}
+
+TEST_F(RoutingTableTest, Remove) {
+    RoutingTable table;
+    table.add(make_route("0.0.0.0", 0, "10.0.0.1", "eth0"));
+    table.add(make_route("192.168.0.0", 16, "0.0.0.0", "eth1"));
+    EXPECT_FALSE(table.remove(make_route("192.168.0.0", 16, "0.0.0.0", "eth2")));
+    EXPECT_FALSE(table.remove(make_route("192.168.0.0", 24, "0.0.0.0", "eth1")));
+    EXPECT_TRUE(table.remove(make_route("192.168.0.0", 16, "0.0.0.0", "eth1")));
+    EXPECT_EQ(1U, table.ipv4_size());
+    ASSERT_TRUE(table.find(IPv4Address("192.168.1.1")) != 0);
+    EXPECT_EQ("eth0", table.find(IPv4Address("192.168.1.1"))->interface);
+
+    EXPECT_TRUE(table.remove(make_route("0.0.0.0", 0, "10.0.0.1", "eth0")));
+    EXPECT_TRUE(table.find(IPv4Address("192.168.1.1")) == 0);
+    EXPECT_EQ(0U, table.ipv4_size());
+}
+
+TEST_F(RoutingTableTest, IPv6LongestPrefixMatch) {
+    RoutingTable table;
+    table.add(make_route6("::", 0, "fe80::1", "eth0"));
+    table.add(make_route6("2001:db8::", 32, "::", "eth1"));
+    table.add(make_route6("2001:db8:0:1::", 64, "::", "eth2"));
+    table.add(make_route6("2001:db8:0:1::5", 128, "::", "lo"));
+    EXPECT_EQ(4U, table.ipv6_size());
+    EXPECT_EQ(0U, table.ipv4_size());
+
+    const Route6Entry* route = table.find(IPv6Address("2001:db8:0:1::5"));
+    ASSERT_TRUE(route != 0);
+    EXPECT_EQ("lo", route->interface);
+
+    route = table.find(IPv6Address("2001:db8:0:1::6"));
+    ASSERT_TRUE(route != 0);
+    EXPECT_EQ("eth2", route->interface);
+
+    route = table.find(IPv6Address("2001:db8:ffff::1"));
+    ASSERT_TRUE(route != 0);
+    EXPECT_EQ("eth1", route->interface);
+
+    route = table.find(IPv6Address("2a00::1"));
+    ASSERT_TRUE(route != 0);
+    EXPECT_EQ("eth0", route->interface);
+
+    table.clear();
+    EXPECT_TRUE(table.find(IPv6Address("2a00::1")) == 0);
+    EXPECT_EQ(0U, table.ipv6_size());
+}
+
+TEST_F(RoutingTableTest, LoadMatchesSystemRoutes) {
+    RoutingTable table;
+    table.load();
+    EXPECT_LE(table.ipv4_size(), Utils::route_entries().size());
+    table.invalidate();
+    table.sync();
+    EXPECT_LE(table.ipv4_size(), Utils::route_entries().size());
+}
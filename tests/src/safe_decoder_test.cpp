@@ -0,0 +1,100 @@
+#include <gtest/gtest.h>
+#include <vector>
+#include <tins/safe_decoder.h>
+#include <tins/ethernetII.h>
+#include <tins/ip.h>
+#include <tins/tcp.h>
+#include <tins/udp.h>
+#include <tins/rawpdu.h>
+
+using std::vector;
+
+using namespace Tins;
+
+class SafeDecoderTest : public testing::Test {
+public:
+    static vector<uint8_t> make_packet();
+};
+
+vector<uint8_t> SafeDecoderTest::make_packet() {
+    EthernetII eth = EthernetII() / IP("1.2.3.4", "5.6.7.8") / TCP(80, 1234) / 
+                     RawPDU("payload");
+    return eth.serialize();
+}
+
+TEST_F(SafeDecoderTest, DecodesValidPackets) {
+    const vector<uint8_t> buffer = make_packet();
+    SafeDecoder decoder;
+    EthernetII* eth = 0;
+    EXPECT_EQ(SafeDecoder::DECODED, 
+              decoder.decode(&buffer[0], static_cast<uint32_t>(buffer.size()), eth));
+    ASSERT_TRUE(eth != NULL);
+    EXPECT_TRUE(eth->find_pdu<TCP>() != NULL);
+    EXPECT_TRUE(eth->find_pdu<RawPDU>() != NULL);
+    EXPECT_EQ(1U, decoder.packet_count(SafeDecoder::DECODED));
+    EXPECT_TRUE(decoder.malformed_layers().empty());
+    delete eth;
+}
+
+TEST_F(SafeDecoderTest, TruncatedInnerLayer) {
+    const vector<uint8_t> buffer = make_packet();
+    // Ethernet + IP + 10 bytes of TCP header
+    const uint32_t size = 14 + 20 + 10;
+    EXPECT_THROW(EthernetII(&buffer[0], size), malformed_packet);
+
+    SafeDecoder decoder;
+    EthernetII* eth = 0;
+    EXPECT_EQ(SafeDecoder::PARTIALLY_DECODED, decoder.decode(&buffer[0], size, eth));
+    ASSERT_TRUE(eth != NULL);
+    ASSERT_TRUE(eth->find_pdu<IP>() != NULL);
+    EXPECT_TRUE(eth->find_pdu<TCP>() == NULL);
+    const RawPDU* raw = eth->find_pdu<RawPDU>();
+    ASSERT_TRUE(raw != NULL);
+    EXPECT_EQ(10U, raw->payload_size());
+    EXPECT_EQ(1U, decoder.malformed_count(PDU::TCP));
+    EXPECT_EQ(0U, decoder.malformed_count(PDU::IP));
+    EXPECT_EQ(1U, decoder.packet_count(SafeDecoder::PARTIALLY_DECODED));
+    delete eth;
+}
+
+TEST_F(SafeDecoderTest, MalformedInnerLayer) {
+    vector<uint8_t> buffer = make_packet();
+    // A TCP data offset larger than the segment
+    buffer[14 + 20 + 12] = 0xf0;
+    SafeDecoder decoder;
+    EthernetII* eth = 0;
+    EXPECT_EQ(SafeDecoder::PARTIALLY_DECODED, 
+              decoder.decode(&buffer[0], static_cast<uint32_t>(buffer.size()), eth));
+    ASSERT_TRUE(eth != NULL);
+    EXPECT_TRUE(eth->find_pdu<RawPDU>() != NULL);
+    EXPECT_EQ(1U, decoder.malformed_count(PDU::TCP));
+    delete eth;
+}
+
+TEST_F(SafeDecoderTest, MalformedOutermostLayer) {
+    const vector<uint8_t> buffer = make_packet();
+    SafeDecoder decoder;
+    EthernetII* eth = 0;
+    EXPECT_EQ(SafeDecoder::NOT_DECODED, decoder.decode(&buffer[0], 10, eth));
+    EXPECT_TRUE(eth == NULL);
+    IP* ip = 0;
+    EXPECT_EQ(SafeDecoder::NOT_DECODED, decoder.decode(&buffer[14], 19, ip));
+    EXPECT_TRUE(ip == NULL);
+    EXPECT_EQ(1U, decoder.malformed_count(PDU::ETHERNET_II));
+    EXPECT_EQ(1U, decoder.malformed_count(PDU::IP));
+    EXPECT_EQ(2U, decoder.packet_count(SafeDecoder::NOT_DECODED));
+
+    decoder.reset_counters();
+    EXPECT_EQ(0U, decoder.packet_count(SafeDecoder::NOT_DECODED));
+    EXPECT_TRUE(decoder.malformed_layers().empty());
+}
+
+TEST_F(SafeDecoderTest, OnlyAffectsDecodeCalls) {
+    const vector<uint8_t> buffer = make_packet();
+    SafeDecoder decoder;
+    EthernetII* eth = 0;
+    decoder.decode(&buffer[0], 14 + 20 + 10, eth);
+    delete eth;
+    // Once decode returns, constructors throw again
+    EXPECT_THROW(EthernetII(&buffer[0], 14 + 20 + 10), malformed_packet);
+}
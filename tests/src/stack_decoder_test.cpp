@@ -0,0 +1,101 @@
+#include <tins/stack_decoder.h>
+
+#if TINS_IS_CXX11
+
+#include <gtest/gtest.h>
+#include <vector>
+#include <memory>
+#include <tins/rawpdu.h>
+
+using std::vector;
+using std::unique_ptr;
+
+using namespace Tins;
+
+class StackDecoderTest : public testing::Test {
+public:
+    typedef StackDecoder<EthernetII, IP, TCP> tcp_decoder;
+    typedef StackDecoder<EthernetII, Dot1Q, IP, UDP> vlan_udp_decoder;
+    typedef StackDecoder<EthernetII, IPv6, UDP> ipv6_udp_decoder;
+};
+
+TEST_F(StackDecoderTest, DecodesMatchingStack) {
+    IP ip("1.2.3.4", "5.6.7.8");
+    for (size_t i = 0; i < 4; ++i) {
+        ip.add_option(IP::option(IP::NOOP));
+    }
+    TCP tcp(80, 1234);
+    tcp.mss(1460);
+    EthernetII eth = EthernetII() / ip / tcp / RawPDU("payload");
+    vector<uint8_t> buffer = eth.serialize();
+    // Ethernet padding isn't part of the IP datagram
+    buffer.resize(buffer.size() + 6);
+
+    EXPECT_TRUE(tcp_decoder::matches(&buffer[0], buffer.size()));
+    unique_ptr<EthernetII> output(tcp_decoder::try_decode(&buffer[0], buffer.size()));
+    ASSERT_TRUE(output != nullptr);
+    EthernetII expected(&buffer[0], buffer.size());
+    EXPECT_EQ(expected.serialize(), output->serialize());
+
+    const TCP& decoded_tcp = tcp_decoder::layer<2>(*output);
+    EXPECT_EQ(output->find_pdu<TCP>(), &decoded_tcp);
+    EXPECT_EQ(80, decoded_tcp.dport());
+    EXPECT_EQ(1460, decoded_tcp.mss());
+    EXPECT_EQ(IPv4Address("1.2.3.4"), tcp_decoder::layer<1>(*output).dst_addr());
+    ASSERT_TRUE(output->find_pdu<RawPDU>() != nullptr);
+    EXPECT_EQ(7U, output->rfind_pdu<RawPDU>().payload_size());
+}
+
+TEST_F(StackDecoderTest, DecodesVLANs) {
+    EthernetII eth = EthernetII() / Dot1Q(10) / IP("1.2.3.4") / UDP(53, 1234) / RawPDU("a");
+    const vector<uint8_t> buffer = eth.serialize();
+    EXPECT_FALSE(tcp_decoder::matches(&buffer[0], buffer.size()));
+    unique_ptr<EthernetII> output(vlan_udp_decoder::try_decode(&buffer[0], buffer.size()));
+    ASSERT_TRUE(output != nullptr);
+    EXPECT_EQ(10, vlan_udp_decoder::layer<1>(*output).id());
+    EXPECT_EQ(53, vlan_udp_decoder::layer<3>(*output).dport());
+    EthernetII expected(&buffer[0], buffer.size());
+    EXPECT_EQ(expected.serialize(), output->serialize());
+}
+
+TEST_F(StackDecoderTest, DecodesIPv6) {
+    EthernetII eth = EthernetII() / IPv6("dead::1") / UDP(53, 1234) / RawPDU("a");
+    const vector<uint8_t> buffer = eth.serialize();
+    unique_ptr<EthernetII> output(ipv6_udp_decoder::try_decode(&buffer[0], buffer.size()));
+    ASSERT_TRUE(output != nullptr);
+    EXPECT_EQ(IPv6Address("dead::1"), ipv6_udp_decoder::layer<1>(*output).dst_addr());
+    EXPECT_EQ(buffer, output->serialize());
+
+    // Extension headers are left to the generic path
+    IPv6 ipv6("dead::1");
+    const uint8_t options[] = { 1, 4, 0, 0, 0, 0 };
+    ipv6.add_header(IPv6::ext_header(IPv6::DESTINATION_ROUTING_OPTIONS, sizeof(options),
+                                     options));
+    eth = EthernetII() / ipv6 / UDP(53, 1234);
+    const vector<uint8_t> other_buffer = eth.serialize();
+    EXPECT_FALSE(ipv6_udp_decoder::matches(&other_buffer[0], other_buffer.size()));
+}
+
+TEST_F(StackDecoderTest, FallsBack) {
+    EthernetII eth = EthernetII() / IP("1.2.3.4") / UDP(53, 1234) / RawPDU("a");
+    const vector<uint8_t> buffer = eth.serialize();
+    EXPECT_TRUE(tcp_decoder::try_decode(&buffer[0], buffer.size()) == nullptr);
+    unique_ptr<EthernetII> output(tcp_decoder::decode(&buffer[0], buffer.size()));
+    ASSERT_TRUE(output != nullptr);
+    EXPECT_TRUE(output->find_pdu<UDP>() != nullptr);
+
+    // Truncated TCP header
+    eth = EthernetII() / IP("1.2.3.4") / TCP(80, 1234);
+    const vector<uint8_t> tcp_buffer = eth.serialize();
+    EXPECT_TRUE(tcp_decoder::matches(&tcp_buffer[0], 14 + 20 + 20));
+    EXPECT_FALSE(tcp_decoder::matches(&tcp_buffer[0], 14 + 20 + 19));
+
+    // Fragments
+    IP fragment("1.2.3.4");
+    fragment.flags(IP::MORE_FRAGMENTS);
+    eth = EthernetII() / fragment / TCP(80, 1234);
+    const vector<uint8_t> fragment_buffer = eth.serialize();
+    EXPECT_FALSE(tcp_decoder::matches(&fragment_buffer[0], fragment_buffer.size()));
+}
+
+#endif // TINS_IS_CXX11
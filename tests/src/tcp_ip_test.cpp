@@ -286,6 +286,61 @@ TEST_F(FlowTest, Overlapping) {
     run_tests(chunks, payload);
 }
 
+TEST_F(FlowTest, ReassembleStreamWithSpilling) {
+    using std::placeholders::_1;
+
+    ordering_info_type chunks = split_payload(payload, 5);
+    reverse(chunks.begin(), chunks.end());
+    // Swap a few of them so chunks are read back from the file in between
+    for (size_t i = 0; i + 10 < chunks.size(); i += 10) {
+        swap(chunks[i], chunks[i + 10]);
+    }
+    const uint32_t initial_seqs[] = {
+        0, 20, numeric_limits<uint32_t>::max() / 2, numeric_limits<uint32_t>::max() - 34 
+    };
+    for (size_t i = 0; i < sizeof(initial_seqs) / sizeof(initial_seqs[0]); ++i) {
+        flow_payload_chunks.clear();
+        Flow flow(IPv4Address("1.2.3.4"), 22, initial_seqs[i]);
+        flow.data_callback(bind(&FlowTest::cumulative_flow_data_handler, this, _1));
+        flow.enable_spilling(50);
+        EXPECT_TRUE(flow.spilling_enabled());
+        vector<EthernetII> packets = chunks_to_packets(initial_seqs[i], chunks, payload);
+        uint64_t max_spilled_bytes = 0;
+        for (size_t j = 0; j < packets.size(); ++j) {
+            flow.process_packet(packets[j]);
+            EXPECT_LE(flow.total_buffered_bytes(), 50U);
+            max_spilled_bytes = max(max_spilled_bytes, flow.total_spilled_bytes());
+        }
+        EXPECT_GT(max_spilled_bytes, 0U);
+        EXPECT_EQ(payload, merge_chunks(flow_payload_chunks));
+        EXPECT_EQ(0U, flow.total_buffered_bytes());
+        EXPECT_EQ(0U, flow.total_spilled_bytes());
+        EXPECT_TRUE(flow.buffered_payload().empty());
+    }
+}
+
+TEST_F(FlowTest, SpillingOverlappingChunks) {
+    using std::placeholders::_1;
+
+    string payload = "Hello world. This is a payload";
+    ordering_info_type chunks;
+    chunks.push_back(order_element(10, payload.size() - 10));
+    chunks.push_back(order_element(3, 8));
+    chunks.push_back(order_element(9, 1));
+    chunks.push_back(order_element(1, 7));
+    chunks.push_back(order_element(0, 6));
+
+    Flow flow(IPv4Address("1.2.3.4"), 22, 0);
+    flow.data_callback(bind(&FlowTest::cumulative_flow_data_handler, this, _1));
+    flow.enable_spilling(1);
+    vector<EthernetII> packets = chunks_to_packets(0, chunks, payload);
+    for (size_t i = 0; i < packets.size(); ++i) {
+        flow.process_packet(packets[i]);
+    }
+    EXPECT_EQ(payload, merge_chunks(flow_payload_chunks));
+    EXPECT_EQ(0U, flow.total_spilled_bytes());
+}
+
 TEST_F(FlowTest, IgnoreDataPackets) {
     using std::placeholders::_1;
 
@@ -514,6 +569,30 @@ TEST_F(FlowTest, StreamFollower_FollowStream) {
     EXPECT_EQ(payload, merge_chunks(stream_client_payload_chunks));
 }
 
+TEST_F(FlowTest, StreamFollower_FollowStreamWithSharedPackets) {
+    using std::placeholders::_1;
+
+    vector<EthernetII> packets = three_way_handshake(29, 60, "1.2.3.4", 22, "4.3.2.1", 25);
+    ordering_info_type chunks = split_payload(payload, 5);
+    vector<EthernetII> chunk_packets = chunks_to_packets(30 /*initial_seq*/, chunks, payload);
+    set_endpoints(chunk_packets, "1.2.3.4", 22, "4.3.2.1", 25);
+    packets.insert(packets.end(), chunk_packets.begin(), chunk_packets.end());
+    StreamFollower follower;
+    follower.new_stream_callback(bind(&FlowTest::on_new_stream, this, _1));
+    vector<Packet> copies;
+    for (size_t i = 0; i < packets.size(); ++i) {
+        Packet packet(packets[i], Timestamp());
+        copies.push_back(packet);
+        const PDU* shared_pdu = static_cast<const Packet&>(packet).pdu();
+        follower.process_packet(packet);
+        // The PDU is still shared, so it must not have been cloned or moved from
+        EXPECT_EQ(shared_pdu, static_cast<const Packet&>(packet).pdu());
+        EXPECT_EQ(packets[i].size(), static_cast<const Packet&>(copies.back()).pdu()->size());
+    }
+    EXPECT_EQ(chunk_packets.size(), stream_client_payload_chunks.size());
+    EXPECT_EQ(payload, merge_chunks(stream_client_payload_chunks));
+}
+
 TEST_F(FlowTest, StreamFollower_AttachToStreams) {
     using std::placeholders::_1;
 
@@ -617,10 +696,228 @@ TEST_F(FlowTest, StreamFollower_AttachToStreams_RecoveryMode) {
     EXPECT_EQ(trimmed_payload, merge_chunks(stream_client_payload_chunks));
 }
 
+TEST_F(FlowTest, StreamFollower_MemoryBudgetEvictsOldestStreams) {
+    using std::placeholders::_1;
+
+    vector<Stream::timestamp_type> terminated_streams;
+    StreamFollower follower;
+    follower.max_total_buffered_bytes(150);
+    follower.new_stream_callback(bind(&FlowTest::on_new_stream, this, _1));
+    follower.stream_termination_callback([&](Stream& stream,
+                                             StreamFollower::TerminationReason reason) {
+        EXPECT_EQ(StreamFollower::MEMORY_BUDGET, reason);
+        terminated_streams.push_back(stream.create_time());
+    });
+    Stream::timestamp_type ts(1000);
+    for (uint16_t client_port = 22; client_port < 25; ++client_port) {
+        vector<EthernetII> packets = three_way_handshake(29, 60, "1.2.3.4", client_port,
+                                                         "4.3.2.1", 25);
+        // Skip the first chunk so everything else is buffered
+        ordering_info_type chunks = split_payload(payload.substr(0, 60), 10);
+        chunks.erase(chunks.begin());
+        vector<EthernetII> chunk_packets = chunks_to_packets(30, chunks, payload);
+        set_endpoints(chunk_packets, "1.2.3.4", client_port, "4.3.2.1", 25);
+        packets.insert(packets.end(), chunk_packets.begin(), chunk_packets.end());
+        for (size_t i = 0; i < packets.size(); ++i) {
+            Packet packet(packets[i], ts);
+            follower.process_packet(packet);
+            ts += milliseconds(1);
+        }
+    }
+    // 3 streams buffering 50 bytes each fit in the budget
+    EXPECT_EQ(150U, follower.total_buffered_bytes());
+    EXPECT_TRUE(terminated_streams.empty());
+
+    // Now add some more data to the newest one
+    EthernetII eth = EthernetII() / IP("4.3.2.1", "1.2.3.4") / TCP(25, 24) /
+                     RawPDU("abcdefghij");
+    eth.rfind_pdu<TCP>().seq(100);
+    Packet packet(eth, ts);
+    follower.process_packet(packet);
+
+    // The oldest stream should have been evicted
+    ASSERT_EQ(1U, terminated_streams.size());
+    EXPECT_EQ(Stream::timestamp_type(1000), terminated_streams[0]);
+    EXPECT_EQ(1U, follower.memory_budget_evictions());
+    EXPECT_EQ(110U, follower.total_buffered_bytes());
+    EXPECT_THROW(
+        follower.find_stream(IPv4Address("1.2.3.4"), 22, IPv4Address("4.3.2.1"), 25),
+        stream_not_found
+    );
+    EXPECT_NO_THROW(
+        follower.find_stream(IPv4Address("1.2.3.4"), 23, IPv4Address("4.3.2.1"), 25)
+    );
+}
+
+TEST_F(FlowTest, StreamFollower_SerializeAndRestoreState) {
+    using std::placeholders::_1;
+
+    vector<EthernetII> packets = three_way_handshake(29, 60, "1.2.3.4", 22, "4.3.2.1", 25);
+    ordering_info_type chunks = split_payload(payload, 5);
+    // The first chunk is delivered late, so everything else but it is buffered
+    swap(chunks[0], chunks[chunks.size() / 2]);
+    vector<EthernetII> chunk_packets = chunks_to_packets(30, chunks, payload);
+    set_endpoints(chunk_packets, "1.2.3.4", 22, "4.3.2.1", 25);
+    const size_t split_index = chunk_packets.size() / 4;
+
+    vector<uint8_t> snapshot;
+    Stream::timestamp_type ts(1000);
+    {
+        StreamFollower follower;
+        follower.new_stream_callback([&](Stream& stream) {
+            stream.enable_ack_tracking();
+        });
+        for (size_t i = 0; i < packets.size(); ++i) {
+            follower.process_packet(packets[i]);
+        }
+        for (size_t i = 0; i < split_index; ++i) {
+            Packet packet(chunk_packets[i], ts);
+            follower.process_packet(packet);
+        }
+        Stream& stream = follower.find_stream(IPv4Address("1.2.3.4"), 22,
+                                              IPv4Address("4.3.2.1"), 25);
+        EXPECT_GT(stream.client_flow().total_buffered_bytes(), 0U);
+        snapshot = follower.serialize_state();
+    }
+
+    StreamFollower follower;
+    follower.new_stream_callback(bind(&FlowTest::on_new_stream, this, _1));
+    follower.restore_state(snapshot);
+    Stream& stream = follower.find_stream(IPv4Address("1.2.3.4"), 22,
+                                          IPv4Address("4.3.2.1"), 25);
+    EXPECT_EQ(Flow::ESTABLISHED, stream.client_flow().state());
+    EXPECT_EQ(30U, stream.client_flow().sequence_number());
+    EXPECT_EQ(61U, stream.server_flow().sequence_number());
+    EXPECT_TRUE(stream.ack_tracking_enabled());
+    EXPECT_EQ(ts, stream.last_seen());
+    EXPECT_FALSE(stream.is_partial_stream());
+    EXPECT_EQ(stream.client_flow().total_buffered_bytes(), follower.total_buffered_bytes());
+    for (size_t i = split_index; i < chunk_packets.size(); ++i) {
+        follower.process_packet(chunk_packets[i]);
+    }
+    EXPECT_EQ(payload, merge_chunks(stream_client_payload_chunks));
+}
+
+TEST_F(FlowTest, StreamFollower_RestoreInvalidState) {
+    using std::placeholders::_1;
+
+    vector<EthernetII> packets = three_way_handshake(29, 60, "1.2.3.4", 22, "4.3.2.1", 25);
+    StreamFollower follower;
+    follower.new_stream_callback(bind(&FlowTest::on_new_stream, this, _1));
+    for (size_t i = 0; i < packets.size(); ++i) {
+        follower.process_packet(packets[i]);
+    }
+    vector<uint8_t> snapshot = follower.serialize_state();
+    vector<uint8_t> truncated(snapshot.begin(), snapshot.end() - 1);
+    EXPECT_THROW(follower.restore_state(truncated), invalid_stream_snapshot);
+    snapshot[0] ^= 1;
+    EXPECT_THROW(follower.restore_state(snapshot), invalid_stream_snapshot);
+    // The stream is still there
+    EXPECT_NO_THROW(
+        follower.find_stream(IPv4Address("1.2.3.4"), 22, IPv4Address("4.3.2.1"), 25)
+    );
+}
+
+TEST_F(FlowTest, FlowBypassTable_IgnoredDirectionIsBypassed) {
+    vector<EthernetII> packets = three_way_handshake(29, 60, "1.2.3.4", 22, "4.3.2.1", 25);
+    StreamFollower follower;
+    follower.new_stream_callback([&](Stream& stream) {
+        stream.ignore_client_data();
+    });
+    for (size_t i = 0; i < packets.size(); ++i) {
+        follower.process_packet(packets[i]);
+    }
+    FlowBypassTable& table = follower.flow_bypass_table();
+    EXPECT_EQ(1U, table.size());
+
+    EthernetII client_packet = EthernetII() / IP("4.3.2.1", "1.2.3.4") / TCP(25, 22) /
+                               RawPDU("abcde");
+    client_packet.rfind_pdu<TCP>().flags(TCP::ACK | TCP::PSH);
+    EthernetII server_packet = EthernetII() / IP("1.2.3.4", "4.3.2.1") / TCP(22, 25) /
+                               RawPDU("abcde");
+    server_packet.rfind_pdu<TCP>().flags(TCP::ACK | TCP::PSH);
+    PDU::serialization_type buffer = client_packet.serialize();
+    EXPECT_TRUE(table.should_bypass(&buffer[0], buffer.size(), PDU::ETHERNET_II));
+    buffer = client_packet.rfind_pdu<IP>().serialize();
+    EXPECT_TRUE(table.should_bypass(&buffer[0], buffer.size(), PDU::IP));
+
+    buffer = server_packet.serialize();
+    EXPECT_FALSE(table.should_bypass(&buffer[0], buffer.size(), PDU::ETHERNET_II));
+
+    // Control packets always go through
+    client_packet.rfind_pdu<TCP>().flags(TCP::ACK | TCP::FIN);
+    buffer = client_packet.serialize();
+    EXPECT_FALSE(table.should_bypass(&buffer[0], buffer.size(), PDU::ETHERNET_II));
+    EXPECT_EQ(2U, table.bypassed_packets());
+}
+
 #ifdef TINS_HAVE_ACK_TRACKER
 
-using namespace boost;
-using namespace boost::icl;
+TEST_F(FlowTest, FlowBypassTable_AckTrackedDirectionIsNotBypassed) {
+    vector<EthernetII> packets = three_way_handshake(29, 60, "1.2.3.4", 22, "4.3.2.1", 25);
+    StreamFollower follower;
+    follower.new_stream_callback([&](Stream& stream) {
+        stream.enable_ack_tracking();
+        stream.ignore_client_data();
+    });
+    for (size_t i = 0; i < packets.size(); ++i) {
+        follower.process_packet(packets[i]);
+    }
+    FlowBypassTable& table = follower.flow_bypass_table();
+    EXPECT_TRUE(table.empty());
+
+    // The client's packets keep reaching the follower, so its ACKs are tracked
+    EthernetII client_packet = EthernetII() / IP("4.3.2.1", "1.2.3.4") / TCP(25, 22) /
+                               RawPDU("abcde");
+    client_packet.rfind_pdu<TCP>().flags(TCP::ACK | TCP::PSH);
+    client_packet.rfind_pdu<TCP>().seq(30);
+    client_packet.rfind_pdu<TCP>().ack_seq(61);
+    PDU::serialization_type buffer = client_packet.serialize();
+    EXPECT_FALSE(table.should_bypass(&buffer[0], buffer.size(), PDU::ETHERNET_II));
+    follower.process_packet(client_packet);
+    EthernetII ack_packet = EthernetII() / IP("4.3.2.1", "1.2.3.4") / TCP(25, 22);
+    ack_packet.rfind_pdu<TCP>().flags(TCP::ACK);
+    ack_packet.rfind_pdu<TCP>().seq(35);
+    ack_packet.rfind_pdu<TCP>().ack_seq(66);
+    buffer = ack_packet.serialize();
+    EXPECT_FALSE(table.should_bypass(&buffer[0], buffer.size(), PDU::ETHERNET_II));
+    follower.process_packet(ack_packet);
+    EXPECT_TRUE(table.empty());
+    EXPECT_EQ(0U, table.bypassed_packets());
+
+    Stream& stream = follower.find_stream(IPv4Address("1.2.3.4"), 22,
+                                          IPv4Address("4.3.2.1"), 25);
+    EXPECT_EQ(66U, stream.client_flow().ack_tracker().ack_number());
+}
+
+#endif // TINS_HAVE_ACK_TRACKER
+
+TEST_F(FlowTest, FlowBypassTable_TerminatedStreamsExpire) {
+    vector<EthernetII> packets = three_way_handshake(29, 60, "1.2.3.4", 22, "4.3.2.1", 25);
+    StreamIdentifier id = StreamIdentifier::make_identifier(packets[0]);
+    FlowBypassTable table;
+    table.bypass(id);
+
+    EthernetII packet = EthernetII() / IP("1.2.3.4", "4.3.2.1") / TCP(22, 25) /
+                        RawPDU("abcde");
+    packet.rfind_pdu<TCP>().flags(TCP::ACK | TCP::FIN);
+    PDU::serialization_type buffer = packet.serialize();
+    EXPECT_TRUE(table.should_bypass(&buffer[0], buffer.size(), PDU::ETHERNET_II));
+    EXPECT_TRUE(table.is_active(id));
+
+    // A new connection using the same endpoints is let through
+    buffer = packets[0].serialize();
+    EXPECT_FALSE(table.should_bypass(&buffer[0], buffer.size(), PDU::ETHERNET_II));
+
+    // Active entries survive the first expiration, idle ones don't
+    table.expire_inactive();
+    EXPECT_EQ(1U, table.size());
+    EXPECT_FALSE(table.is_active(id));
+    table.expire_inactive();
+    EXPECT_TRUE(table.empty());
+}
+
+#ifdef TINS_HAVE_ACK_TRACKER
 
 class AckTrackerTest : public testing::Test {
 public:
@@ -659,26 +956,25 @@ TCP make_tcp_ack(uint32_t ack_number, SackEdges&&... rest) {
 //
 // EXPECT_TRUE(r1 == r2)
 //
-// Since otherwise gtest fails to compile when trying to print an interval
-// to a std::ostream
+// Since there's no operator<< to print an interval to a std::ostream
 TEST_F(AckTrackerTest, AckedRange_1) {
     AckedRange range(0, 100);
     EXPECT_TRUE(range.has_next());
-    EXPECT_TRUE(interval_type::closed(0, 100) == range.next());
+    EXPECT_TRUE(interval_type(0, 100) == range.next());
     EXPECT_FALSE(range.has_next());
 }
 
 TEST_F(AckTrackerTest, AckedRange_2) {
     AckedRange range(2, 3);
     EXPECT_TRUE(range.has_next());
-    EXPECT_TRUE(interval_type::closed(2, 3) == range.next());
+    EXPECT_TRUE(interval_type(2, 3) == range.next());
     EXPECT_FALSE(range.has_next());
 }
 
 TEST_F(AckTrackerTest, AckedRange_3) {
     AckedRange range(0, 0);
     EXPECT_TRUE(range.has_next());
-    EXPECT_TRUE(interval_type::right_open(0, 1) == range.next());
+    EXPECT_TRUE(interval_type(0, 0) == range.next());
     EXPECT_FALSE(range.has_next());
 }
 
@@ -686,7 +982,7 @@ TEST_F(AckTrackerTest, AckedRange_4) {
     uint32_t maximum = numeric_limits<uint32_t>::max();
     AckedRange range(maximum, maximum);
     EXPECT_TRUE(range.has_next());
-    EXPECT_TRUE(interval_type::left_open(maximum - 1, maximum) == range.next());
+    EXPECT_TRUE(interval_type(maximum, maximum) == range.next());
     EXPECT_FALSE(range.has_next());
 }
 
@@ -695,14 +991,81 @@ TEST_F(AckTrackerTest, AckedRange_WrapAround) {
     AckedRange range(first, 100);
     EXPECT_TRUE(range.has_next());
     EXPECT_TRUE(
-        interval_type::closed(first, numeric_limits<uint32_t>::max()) ==
+        interval_type(first, numeric_limits<uint32_t>::max()) ==
         range.next()
     );
     EXPECT_TRUE(range.has_next());
-    EXPECT_TRUE(interval_type::closed(0, 100) == range.next());
+    EXPECT_TRUE(interval_type(0, 100) == range.next());
     EXPECT_FALSE(range.has_next());
 }
 
+TEST_F(AckTrackerTest, SackIntervalSet_MergesIntervals) {
+    SackIntervalSet intervals;
+    EXPECT_TRUE(intervals.empty());
+    intervals.insert(interval_type(10, 19));
+    intervals.insert(interval_type(30, 39));
+    EXPECT_EQ(2U, intervals.iterative_size());
+    EXPECT_EQ(20U, intervals.size());
+    // Adjacent on the left
+    intervals.insert(interval_type(20, 24));
+    EXPECT_EQ(2U, intervals.iterative_size());
+    // Fills the hole
+    intervals.insert(interval_type(22, 32));
+    ASSERT_EQ(1U, intervals.iterative_size());
+    EXPECT_TRUE(interval_type(10, 39) == *intervals.begin());
+    EXPECT_TRUE(intervals.contains(interval_type(15, 35)));
+    EXPECT_FALSE(intervals.contains(interval_type(5, 15)));
+    EXPECT_FALSE(intervals.contains(interval_type(35, 45)));
+}
+
+TEST_F(AckTrackerTest, SackIntervalSet_EraseSplitsIntervals) {
+    SackIntervalSet intervals;
+    intervals.insert(interval_type(10, 39));
+    intervals.erase(interval_type(20, 29));
+    ASSERT_EQ(2U, intervals.iterative_size());
+    EXPECT_TRUE(interval_type(10, 19) == intervals.begin()[0]);
+    EXPECT_TRUE(interval_type(30, 39) == intervals.begin()[1]);
+    intervals.erase(interval_type(0, 35));
+    ASSERT_EQ(1U, intervals.iterative_size());
+    EXPECT_TRUE(interval_type(36, 39) == intervals.begin()[0]);
+    intervals.erase(interval_type(36, 39));
+    EXPECT_TRUE(intervals.empty());
+}
+
+TEST_F(AckTrackerTest, SackIntervalSet_WrapAround) {
+    uint32_t maximum = numeric_limits<uint32_t>::max();
+    SackIntervalSet intervals;
+    intervals.insert(interval_type(5, 9));
+    intervals.insert(interval_type(maximum - 4, maximum));
+    intervals.insert(interval_type(0, 2));
+    ASSERT_EQ(2U, intervals.iterative_size());
+    EXPECT_TRUE(interval_type(maximum - 4, 2) == intervals.begin()[0]);
+    EXPECT_TRUE(interval_type(5, 9) == intervals.begin()[1]);
+    EXPECT_EQ(13U, intervals.size());
+    EXPECT_TRUE(intervals.contains(interval_type(maximum - 1, 1)));
+    intervals.erase(interval_type(maximum - 10, 0));
+    EXPECT_TRUE(interval_type(1, 2) == intervals.begin()[0]);
+}
+
+TEST_F(AckTrackerTest, SackIntervalSet_ManyIntervals) {
+    SackIntervalSet intervals;
+    const uint32_t count = SackIntervalSet::INLINE_CAPACITY * 4;
+    // Insert them in reverse order so every insertion shifts the others
+    for (uint32_t i = count; i > 0; --i) {
+        intervals.insert(interval_type(i * 10, i * 10 + 4));
+    }
+    ASSERT_EQ(count, intervals.iterative_size());
+    for (uint32_t i = 0; i < count; ++i) {
+        EXPECT_TRUE(interval_type((i + 1) * 10, (i + 1) * 10 + 4) == intervals.begin()[i]);
+    }
+    SackIntervalSet copied = intervals;
+    intervals.erase(interval_type(0, count * 10 - 1));
+    ASSERT_EQ(1U, intervals.iterative_size());
+    EXPECT_TRUE(interval_type(count * 10, count * 10 + 4) == *intervals.begin());
+    EXPECT_EQ(count, copied.iterative_size());
+    EXPECT_EQ(count * 5, copied.size());
+}
+
 TEST_F(AckTrackerTest, AckingTcp1) {
     AckTracker tracker(0, false);
     EXPECT_EQ(0U, tracker.ack_number());
@@ -6,6 +6,9 @@
 #include <tins/tcp.h>
 #include <tins/ip.h>
 #include <tins/ethernetII.h>
+#if TINS_IS_CXX11
+    #include <thread>
+#endif // TINS_IS_CXX11
 
 using namespace std;
 using namespace Tins;
@@ -300,3 +303,41 @@ TEST_F(TCPTest, RemoveOption) {
     PDU::serialization_type new_buffer = tcp.serialize();
     EXPECT_EQ(old_buffer, new_buffer);
 }
+
+TEST_F(TCPTest, ModifyOptionsFromBuffer) {
+    TCP tcp(expected_packet, sizeof(expected_packet));
+    EXPECT_EQ(0x98fa, tcp.mss());
+    EXPECT_TRUE(tcp.remove_option(TCP::MSS));
+    EXPECT_THROW(tcp.mss(), option_not_found);
+    EXPECT_EQ(0x7a, tcp.winscale());
+    tcp.mss(1460);
+    EXPECT_EQ(1460, tcp.mss());
+    EXPECT_EQ(5U, tcp.options().size());
+
+    TCP copy(expected_packet, sizeof(expected_packet));
+    TCP copied = copy;
+    EXPECT_EQ(copy.options().size(), copied.options().size());
+    EXPECT_EQ(copy.mss(), copied.mss());
+}
+
+#if TINS_IS_CXX11
+
+TEST_F(TCPTest, ConcurrentOptionsAccess) {
+    const TCP tcp(expected_packet, sizeof(expected_packet));
+    vector<size_t> sizes(4);
+    vector<std::thread> threads;
+    for (size_t i = 0; i < sizes.size(); ++i) {
+        threads.emplace_back([&, i]() {
+            sizes[i] = tcp.options().size();
+        });
+    }
+    for (size_t i = 0; i < threads.size(); ++i) {
+        threads[i].join();
+    }
+    for (size_t i = 0; i < sizes.size(); ++i) {
+        EXPECT_EQ(5U, sizes[i]);
+    }
+    EXPECT_EQ(&tcp.options(), &tcp.options());
+}
+
+#endif // TINS_IS_CXX11
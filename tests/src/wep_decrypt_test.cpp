@@ -4,9 +4,12 @@
 
 #include <gtest/gtest.h>
 #include <cstring>
+#include <functional>
 #include <string>
+#include <vector>
 #include <stdint.h>
 #include <tins/crypto.h>
+#include <tins/parallel_decrypter.h>
 #include <tins/arp.h>
 #include <tins/dot11/dot11_data.h>
 
@@ -46,4 +49,32 @@ TEST_F(WEPDecryptTest, Decrypt1) {
     EXPECT_FALSE(decrypter.decrypt(dot11));
 }
 
+#if TINS_IS_CXX11
+
+TEST_F(WEPDecryptTest, ParallelDecrypterProxy) {
+    std::vector<uint32_t> forwarded;
+    Crypto::ParallelDecrypterProxy<std::function<bool(PDU&)>, Crypto::WEPDecrypter> proxy(
+        [&](PDU& pdu) {
+            const ARP* arp = pdu.find_pdu<ARP>();
+            EXPECT_TRUE(arp != NULL);
+            forwarded.push_back(arp ? arp->opcode() : 0);
+            return true;
+        },
+        2
+    );
+    proxy.decrypter().add_password("00:12:bf:12:32:29", "\x1f\x1f\x1f\x1f\x1f");
+    for (size_t i = 0; i < 20; ++i) {
+        Dot11Data dot11(expected_packet, sizeof(expected_packet));
+        ASSERT_TRUE(proxy(dot11));
+    }
+    // Not encrypted with a known password, so it's not forwarded
+    Dot11Data other(expected_packet, sizeof(expected_packet));
+    other.addr2("00:12:bf:12:32:30");
+    ASSERT_TRUE(proxy(other));
+    ASSERT_TRUE(proxy.flush());
+    EXPECT_EQ(std::vector<uint32_t>(20, ARP::REQUEST), forwarded);
+}
+
+#endif // TINS_IS_CXX11
+
 #endif // TINS_HAVE_DOT11
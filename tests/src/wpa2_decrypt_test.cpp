@@ -3,15 +3,29 @@
 #if defined(TINS_HAVE_DOT11) && defined(TINS_HAVE_WPA2_DECRYPTION)
 
 #include <gtest/gtest.h>
+#ifndef _WIN32
+    #include <glob.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif // _WIN32
 #include <cstring>
+#include <functional>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <new>
 #include <string>
 #include <stdint.h>
 #include <tins/crypto.h>
+#include <tins/parallel_decrypter.h>
+#include <tins/packet.h>
 #include <tins/radiotap.h>
 #include <tins/dot11/dot11_data.h>
 #include <tins/udp.h>
 #include <tins/tcp.h>
 #include <tins/arp.h>
+#include <tins/rawpdu.h>
+#include <tins/snap.h>
 
 using namespace Tins;
 
@@ -225,6 +239,59 @@ TEST_F(WPA2DecryptTest, DecryptCCMPUsingKey) {
     EXPECT_TRUE(session_keys.uses_ccmp());
 }
 
+TEST_F(WPA2DecryptTest, DecryptCCMPUsingCCMPDecrypter) {
+    Crypto::WPA2::SessionKeys session_keys;
+    {
+        Crypto::WPA2Decrypter decrypter;
+        decrypter.add_ap_data("Induction", "Coherer", "00:0c:41:82:b2:55");
+        for(size_t i = 1; i < 5; ++i) {
+            RadioTap radio(ccmp_packets[i], ccmp_packets_size[i]);
+            ASSERT_FALSE(decrypter.decrypt(radio));
+        }
+        ASSERT_EQ(1ULL, decrypter.get_keys().size());
+        session_keys = decrypter.get_keys().begin()->second;
+    }
+
+    // A corrupted copy of packet 5 followed by packets 5 and 6
+    RadioTap packets[] = {
+        RadioTap(ccmp_packets[5], ccmp_packets_size[5]),
+        RadioTap(ccmp_packets[5], ccmp_packets_size[5]),
+        RadioTap(ccmp_packets[6], ccmp_packets_size[6])
+    };
+    vector<Crypto::WPA2::CCMPDecrypter::frame> frames;
+    for(size_t i = 0; i < 3; ++i) {
+        RawPDU::payload_type& payload = packets[i].rfind_pdu<RawPDU>().payload();
+        Crypto::WPA2::CCMPDecrypter::frame frame = {
+            &session_keys,
+            &packets[i].rfind_pdu<Dot11Data>(),
+            &payload[0],
+            static_cast<uint32_t>(payload.size()),
+            false
+        };
+        frames.push_back(frame);
+    }
+    frames[0].buffer[20] ^= 1;
+
+    Crypto::WPA2::CCMPDecrypter decrypter;
+    EXPECT_EQ(2U, decrypter.decrypt(frames));
+    EXPECT_FALSE(frames[0].decrypted);
+    EXPECT_TRUE(frames[1].decrypted);
+    EXPECT_TRUE(frames[2].decrypted);
+    for(size_t i = 1; i < 3; ++i) {
+        const uint32_t size = frames[i].size - Crypto::WPA2::CCMPDecrypter::HEADER_SIZE - 
+                              Crypto::WPA2::CCMPDecrypter::MIC_SIZE;
+        SNAP* snap = new SNAP(frames[i].buffer + Crypto::WPA2::CCMPDecrypter::HEADER_SIZE,
+                              size);
+        packets[i].rfind_pdu<Dot11Data>().inner_pdu(snap);
+    }
+    check_ccmp_packet5(packets[1]);
+    check_ccmp_packet6(packets[2]);
+
+    // Too short to hold the CCMP header and MIC
+    uint8_t buffer[15] = { 0 };
+    EXPECT_FALSE(decrypter.decrypt(session_keys, *frames[0].dot11, buffer, sizeof(buffer)));
+}
+
 TEST_F(WPA2DecryptTest, DecryptTKIPUsingBeacon) {
     Crypto::WPA2Decrypter decrypter;
     decrypter.add_ap_data("libtinstest", "NODO");
@@ -350,6 +417,372 @@ TEST_F(WPA2DecryptTest, DecryptCCMPAndTKIPWithoutUsingBeacon) {
     }
 }
 
+TEST_F(WPA2DecryptTest, DecryptCCMPAndTKIPUsingBulkAPData) {
+    vector<Crypto::WPA2Decrypter::ap_data_type> networks;
+    networks.push_back(std::make_pair("libtinstest", "NODO"));
+    networks.push_back(std::make_pair("Induction", "Coherer"));
+    // Already added SSIDs are ignored
+    networks.push_back(std::make_pair("wrong", "Coherer"));
+    Crypto::WPA2Decrypter decrypter;
+    decrypter.add_ap_data(networks, 2);
+    for(size_t i = 0; i < 7; ++i) {
+        RadioTap radio(ccmp_packets[i], ccmp_packets_size[i]);
+        if(i > 4) {
+            ASSERT_TRUE(decrypter.decrypt(radio));
+            if(i == 5)
+                check_ccmp_packet5(radio);
+            else
+                check_ccmp_packet6(radio);
+        }
+        else 
+            ASSERT_FALSE(decrypter.decrypt(radio));
+    }
+    for(size_t i = 0; i < 7; ++i) {
+        RadioTap radio(tkip_packets[i], tkip_packets_size[i]);
+        if(i > 4) {
+            ASSERT_TRUE(decrypter.decrypt(radio));
+            if(i == 5)
+                check_tkip_packet5(radio);
+            else
+                check_tkip_packet6(radio);
+        }
+        else 
+            ASSERT_FALSE(decrypter.decrypt(radio));
+    }
+}
+
+TEST_F(WPA2DecryptTest, DerivePMK) {
+    // IEEE 802.11i-2004, Annex H.4.1
+    const uint8_t expected[] = {
+        0xf4, 0x2c, 0x6f, 0xc5, 0x2d, 0xf0, 0xeb, 0xef, 0x9e, 0xbb, 0x4b, 0x90,
+        0xb3, 0x8a, 0x5f, 0x90, 0x2e, 0x83, 0xfe, 0x1b, 0x13, 0x5a, 0x70, 0xe2,
+        0x3a, 0xed, 0x76, 0x2e, 0x97, 0x10, 0xa1, 0x2e
+    };
+    const Crypto::WPA2::PMKCache::pmk_type pmk =
+        Crypto::WPA2::PMKCache::derive_pmk("password", "IEEE");
+    EXPECT_EQ(vector<uint8_t>(expected, expected + sizeof(expected)), pmk);
+    EXPECT_EQ(pmk, Crypto::WPA2::SupplicantData("password", "IEEE").pmk());
+}
+
+TEST_F(WPA2DecryptTest, PMKCache) {
+    const string file_name = "libtins_pmk_cache_test.bin";
+    Crypto::WPA2::PMKCache cache;
+    EXPECT_TRUE(cache.empty());
+    vector<Crypto::WPA2Decrypter::ap_data_type> networks;
+    networks.push_back(std::make_pair("libtinstest", "NODO"));
+    networks.push_back(std::make_pair("Induction", "Coherer"));
+    {
+        Crypto::WPA2Decrypter decrypter;
+        decrypter.pmk_cache(&cache);
+        decrypter.add_ap_data(networks);
+    }
+    ASSERT_EQ(2U, cache.size());
+    cache.save(file_name);
+
+    Crypto::WPA2::PMKCache loaded;
+    loaded.load(file_name);
+    std::remove(file_name.c_str());
+    ASSERT_EQ(2U, loaded.size());
+    Crypto::WPA2::PMKCache::pmk_type pmk;
+    ASSERT_TRUE(loaded.find("Induction", "Coherer", pmk));
+    EXPECT_EQ(Crypto::WPA2::SupplicantData("Induction", "Coherer").pmk(), pmk);
+    EXPECT_FALSE(loaded.find("induction", "Coherer", pmk));
+    EXPECT_FALSE(loaded.find("Induction", "coherer", pmk));
+
+    // PMKs taken from the cache decrypt just like derived ones
+    Crypto::WPA2Decrypter decrypter;
+    decrypter.pmk_cache(&loaded);
+    decrypter.add_ap_data("Induction", "Coherer");
+    EXPECT_EQ(2U, loaded.size());
+    for(size_t i = 0; i < 7; ++i) {
+        RadioTap radio(ccmp_packets[i], ccmp_packets_size[i]);
+        if(i > 4) {
+            ASSERT_TRUE(decrypter.decrypt(radio));
+        }
+        else {
+            ASSERT_FALSE(decrypter.decrypt(radio));
+        }
+    }
+}
+
+TEST_F(WPA2DecryptTest, PMKCacheInvalidFile) {
+    const string file_name = "libtins_pmk_cache_test.bin";
+    Crypto::WPA2::PMKCache cache;
+    cache.insert("password", "IEEE", Crypto::WPA2::PMKCache::derive_pmk("password", "IEEE"));
+    EXPECT_THROW(cache.load(file_name), Crypto::WPA2::invalid_pmk_cache);
+    cache.save(file_name);
+
+    // Truncate the last entry
+    std::ifstream input(file_name.c_str(), std::ios::binary);
+    string contents((std::istreambuf_iterator<char>(input)), 
+                    std::istreambuf_iterator<char>());
+    input.close();
+    std::ofstream output(file_name.c_str(), std::ios::binary | std::ios::trunc);
+    output.write(contents.data(), contents.size() - 1);
+    output.close();
+
+    Crypto::WPA2::PMKCache loaded;
+    EXPECT_THROW(loaded.load(file_name), Crypto::WPA2::invalid_pmk_cache);
+    EXPECT_TRUE(loaded.empty());
+    std::remove(file_name.c_str());
+}
+
+TEST_F(WPA2DecryptTest, PMKCacheSalt) {
+    const string file_name = "libtins_pmk_cache_test.bin";
+    const string other_file_name = "libtins_pmk_cache_test2.bin";
+    const Crypto::WPA2::PMKCache::pmk_type pmk =
+        Crypto::WPA2::PMKCache::derive_pmk("password", "IEEE");
+    Crypto::WPA2::PMKCache cache;
+    cache.insert("password", "IEEE", pmk);
+    cache.save(file_name);
+    Crypto::WPA2::PMKCache other_cache;
+    other_cache.insert("password", "IEEE", pmk);
+    other_cache.save(other_file_name);
+
+    // Each cache uses its own salt, so the same entry is keyed differently
+    std::ifstream input(file_name.c_str(), std::ios::binary);
+    string contents((std::istreambuf_iterator<char>(input)), 
+                    std::istreambuf_iterator<char>());
+    std::ifstream other_input(other_file_name.c_str(), std::ios::binary);
+    string other_contents((std::istreambuf_iterator<char>(other_input)), 
+                          std::istreambuf_iterator<char>());
+    ASSERT_EQ(contents.size(), other_contents.size());
+    EXPECT_NE(contents, other_contents);
+
+    // Entries keyed using a different salt can't be merged
+    EXPECT_THROW(cache.load(other_file_name), Crypto::WPA2::invalid_pmk_cache);
+    EXPECT_EQ(1U, cache.size());
+
+    // An empty cache takes the file's salt and can load it again
+    Crypto::WPA2::PMKCache loaded;
+    loaded.load(file_name);
+    loaded.load(file_name);
+    loaded.insert("password2", "IEEE", pmk);
+    EXPECT_EQ(2U, loaded.size());
+    Crypto::WPA2::PMKCache::pmk_type found_pmk;
+    ASSERT_TRUE(loaded.find("password", "IEEE", found_pmk));
+    EXPECT_EQ(pmk, found_pmk);
+    std::remove(file_name.c_str());
+    std::remove(other_file_name.c_str());
+}
+
+#ifndef _WIN32
+
+TEST_F(WPA2DecryptTest, PMKCacheSaveIsOwnerOnly) {
+    const string file_name = "libtins_pmk_cache_test.bin";
+    std::ofstream(file_name.c_str()) << "old contents";
+    ASSERT_EQ(0, ::chmod(file_name.c_str(), 0644));
+    Crypto::WPA2::PMKCache cache;
+    cache.insert("password", "IEEE", Crypto::WPA2::PMKCache::derive_pmk("password", "IEEE"));
+    cache.save(file_name);
+
+    struct stat info;
+    ASSERT_EQ(0, ::stat(file_name.c_str(), &info));
+    EXPECT_EQ(static_cast<mode_t>(S_IRUSR | S_IWUSR), info.st_mode & 0777);
+    Crypto::WPA2::PMKCache loaded;
+    loaded.load(file_name);
+    EXPECT_EQ(1U, loaded.size());
+    std::remove(file_name.c_str());
+}
+
+TEST_F(WPA2DecryptTest, PMKCacheFailedSave) {
+    // A directory can't be replaced by the saved file
+    const string directory = "libtins_pmk_cache_test_dir";
+    ASSERT_EQ(0, ::mkdir(directory.c_str(), 0755));
+    Crypto::WPA2::PMKCache cache;
+    cache.insert("password", "IEEE", Crypto::WPA2::PMKCache::derive_pmk("password", "IEEE"));
+    EXPECT_THROW(cache.save(directory), file_write_error);
+
+    struct stat info;
+    ASSERT_EQ(0, ::stat(directory.c_str(), &info));
+    EXPECT_TRUE(S_ISDIR(info.st_mode));
+    EXPECT_EQ(0, ::rmdir(directory.c_str()));
+    // The temporary file must be gone as well
+    glob_t matches;
+    EXPECT_EQ(GLOB_NOMATCH, ::glob((directory + ".*").c_str(), 0, 0, &matches));
+    globfree(&matches);
+}
+
+#endif // _WIN32
+
+#if TINS_IS_CXX11
+
+TEST_F(WPA2DecryptTest, ParallelDecrypterProxy) {
+    // The handshakes, followed by the data frames of both sessions repeated
+    // many times, so workers finish them out of order
+    vector<RadioTap> packets;
+    for(size_t i = 0; i < 5; ++i) {
+        packets.push_back(RadioTap(ccmp_packets[i], ccmp_packets_size[i]));
+        packets.push_back(RadioTap(tkip_packets[i], tkip_packets_size[i]));
+    }
+    for(size_t i = 0; i < 200; ++i) {
+        packets.push_back(RadioTap(ccmp_packets[5 + i % 2], ccmp_packets_size[5 + i % 2]));
+        packets.push_back(RadioTap(tkip_packets[5 + i % 2], tkip_packets_size[5 + i % 2]));
+    }
+
+    vector<PDU::serialization_type> expected;
+    Crypto::WPA2Decrypter decrypter;
+    decrypter.add_ap_data("libtinstest", "NODO");
+    decrypter.add_ap_data("Induction", "Coherer");
+    for(size_t i = 0; i < packets.size(); ++i) {
+        RadioTap radio = packets[i];
+        if(decrypter.decrypt(radio)) {
+            expected.push_back(radio.serialize());
+        }
+    }
+    ASSERT_EQ(400U, expected.size());
+
+    vector<PDU::serialization_type> forwarded;
+    Crypto::ParallelDecrypterProxy<std::function<bool(PDU&)>, Crypto::WPA2Decrypter> proxy(
+        [&](PDU& pdu) {
+            forwarded.push_back(pdu.serialize());
+            return true;
+        },
+        4,
+        16
+    );
+    proxy.decrypter().add_ap_data("libtinstest", "NODO");
+    proxy.decrypter().add_ap_data("Induction", "Coherer");
+    for(size_t i = 0; i < packets.size(); ++i) {
+        Packet packet(packets[i]);
+        ASSERT_TRUE(proxy(packet));
+    }
+    ASSERT_TRUE(proxy.flush());
+    EXPECT_EQ(expected, forwarded);
+    EXPECT_EQ(0U, proxy.failures());
+}
+
+TEST_F(WPA2DecryptTest, FindFrameKeysSharesKeys) {
+    Crypto::WPA2Decrypter decrypter;
+    decrypter.add_ap_data("Induction", "Coherer", "00:0c:41:82:b2:55");
+    Crypto::WPA2Decrypter::frame_keys_type keys;
+    for(size_t i = 1; i < 5; ++i) {
+        RadioTap radio(ccmp_packets[i], ccmp_packets_size[i]);
+        ASSERT_FALSE(decrypter.find_frame_keys(radio, keys));
+    }
+    RadioTap radio(ccmp_packets[5], ccmp_packets_size[5]);
+    ASSERT_TRUE(decrypter.find_frame_keys(radio, keys));
+    Crypto::WPA2Decrypter::frame_keys_type other_keys;
+    ASSERT_TRUE(decrypter.find_frame_keys(radio, other_keys));
+    EXPECT_EQ(keys, other_keys);
+
+    // Replacing the session's keys leaves the ones handed out untouched
+    const Crypto::WPA2::SessionKeys::ptk_type ptk = keys->get_ptk();
+    const Crypto::WPA2Decrypter::addr_pair addresses = decrypter.get_keys().begin()->first;
+    Crypto::WPA2::SessionKeys::ptk_type new_ptk(ptk.size(), 0);
+    decrypter.add_decryption_keys(addresses, Crypto::WPA2::SessionKeys(new_ptk, true));
+    ASSERT_TRUE(decrypter.find_frame_keys(radio, other_keys));
+    EXPECT_NE(keys, other_keys);
+    EXPECT_EQ(ptk, keys->get_ptk());
+    EXPECT_EQ(new_ptk, other_keys->get_ptk());
+
+    Crypto::WPA2Decrypter::frame_decrypter frame_decrypter;
+    ASSERT_TRUE(frame_decrypter.decrypt(radio, keys));
+    check_ccmp_packet5(radio);
+}
+
+TEST_F(WPA2DecryptTest, ParallelDecrypterProxySharedPackets) {
+    size_t forwarded = 0;
+    Crypto::ParallelDecrypterProxy<std::function<bool(PDU&)>, Crypto::WPA2Decrypter> proxy(
+        [&](PDU&) {
+            ++forwarded;
+            return true;
+        },
+        2
+    );
+    proxy.decrypter().add_ap_data("Induction", "Coherer");
+    // Handshake frames aren't decrypted, so a shared PDU must be left alone
+    for(size_t i = 0; i < 5; ++i) {
+        Packet packet(RadioTap(ccmp_packets[i], ccmp_packets_size[i]));
+        Packet copy = packet;
+        const PDU* shared_pdu = static_cast<const Packet&>(packet).pdu();
+        ASSERT_TRUE(proxy(packet));
+        EXPECT_EQ(shared_pdu, static_cast<const Packet&>(packet).pdu());
+        EXPECT_EQ(shared_pdu, static_cast<const Packet&>(copy).pdu());
+    }
+    // Data frames are, but the other copy keeps the encrypted frame
+    Packet packet(RadioTap(ccmp_packets[5], ccmp_packets_size[5]));
+    Packet copy = packet;
+    const PDU* shared_pdu = static_cast<const Packet&>(packet).pdu();
+    ASSERT_TRUE(proxy(packet));
+    ASSERT_TRUE(proxy.flush());
+    EXPECT_EQ(1U, forwarded);
+    EXPECT_EQ(shared_pdu, static_cast<const Packet&>(copy).pdu());
+    EXPECT_EQ(ccmp_packets_size[5], shared_pdu->size());
+}
+
+// Every other frame fails to decrypt by throwing something that isn't
+// a libtins exception
+struct ThrowingDecrypter {
+    typedef int frame_keys_type;
+
+    struct frame_decrypter {
+        bool decrypt(PDU&, int key) {
+            if (key % 2) {
+                throw std::bad_alloc();
+            }
+            return true;
+        }
+    };
+
+    ThrowingDecrypter() : next_key(0) { }
+
+    bool find_frame_keys(const PDU&, int& key) {
+        key = next_key++;
+        return true;
+    }
+
+    int next_key;
+};
+
+TEST_F(WPA2DecryptTest, ParallelDecrypterProxyDecryptionThrows) {
+    size_t forwarded = 0;
+    Crypto::ParallelDecrypterProxy<std::function<bool(PDU&)>, ThrowingDecrypter> proxy(
+        [&](PDU&) {
+            ++forwarded;
+            return true;
+        },
+        2
+    );
+    for(size_t i = 0; i < 20; ++i) {
+        RawPDU raw("payload");
+        ASSERT_TRUE(proxy(raw));
+    }
+    ASSERT_TRUE(proxy.flush());
+    EXPECT_EQ(10U, forwarded);
+    EXPECT_EQ(10U, proxy.failures());
+}
+
+TEST_F(WPA2DecryptTest, ParallelDecrypterProxyStop) {
+    size_t forwarded = 0;
+    Crypto::ParallelDecrypterProxy<std::function<bool(PDU&)>, Crypto::WPA2Decrypter> proxy(
+        [&](PDU&) {
+            return ++forwarded < 3;
+        },
+        2
+    );
+    proxy.decrypter().add_ap_data("Induction", "Coherer");
+    bool running = true;
+    for(size_t i = 0; i < 5; ++i) {
+        RadioTap radio(ccmp_packets[i], ccmp_packets_size[i]);
+        running = proxy(radio);
+        ASSERT_TRUE(running);
+    }
+    for(size_t i = 0; i < 50 && running; ++i) {
+        RadioTap radio(ccmp_packets[5 + i % 2], ccmp_packets_size[5 + i % 2]);
+        running = proxy(radio);
+    }
+    running = running && proxy.flush();
+    EXPECT_FALSE(running);
+    EXPECT_EQ(3U, forwarded);
+    RadioTap radio(ccmp_packets[5], ccmp_packets_size[5]);
+    EXPECT_FALSE(proxy(radio));
+    EXPECT_FALSE(proxy.flush());
+    EXPECT_EQ(3U, forwarded);
+}
+
+#endif // TINS_IS_CXX11
+
 #ifdef TINS_HAVE_WPA2_CALLBACKS
 
 TEST_F(WPA2DecryptTest, HandshakeCapturedCallback) {